@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "lcd_defs.h"
+#include "rgb_lcd.h"
+#include "adv_status.h"
+
+
+#define STATUS_TIMER_PRESCALER  0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+
+static app_timer_id_t              m_timer_id;
+static volatile bool               m_timer_running;                  /**< An update has been made less than ADV_STATUS_INTERVAL_MS ago. */
+static volatile bool               m_check_due;                      /**< The record may differ from the one advertised. */
+static adv_status_update_handler_t m_update_handler;
+static adv_status_record_t         m_record;                         /**< Record in the advertising data. */
+static uint8_t                     m_wash;
+static uint8_t                     m_minutes;
+
+
+/**@brief Function for handling the end of the interval, the state may have changed during it. */
+static void status_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_timer_running = false;
+    m_check_due     = true;
+}
+
+
+void adv_status_init(adv_status_update_handler_t update_handler)
+{
+    uint32_t err_code;
+
+    m_update_handler = update_handler;
+    m_wash           = ADV_STATUS_WASH_UNKNOWN;
+    m_minutes        = ADV_STATUS_MINUTES_UNKNOWN;
+
+    // The backlight color is only known once the display is up, the first pass of the main
+    // loop puts it in the record.
+    m_record.version = ADV_STATUS_VERSION;
+    m_record.seq     = 0;
+    m_record.wash    = m_wash;
+    m_record.minutes = m_minutes;
+    m_check_due      = true;
+
+    err_code = app_timer_create(&m_timer_id, APP_TIMER_MODE_SINGLE_SHOT, status_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void adv_status_manuf_data_get(ble_advdata_manuf_data_t * p_manuf_data)
+{
+    p_manuf_data->company_identifier = ADV_STATUS_COMPANY_ID;
+    p_manuf_data->data.p_data        = (uint8_t *)&m_record;
+    p_manuf_data->data.size          = sizeof(m_record);
+}
+
+
+void adv_status_wash_set(adv_status_wash_t wash)
+{
+    m_wash      = wash;
+    m_check_due = true;
+}
+
+
+void adv_status_minutes_set(uint8_t minutes)
+{
+    m_minutes   = minutes;
+    m_check_due = true;
+}
+
+
+void adv_status_touch(void)
+{
+    m_check_due = true;
+}
+
+
+void adv_status_process(void)
+{
+    adv_status_record_t record;
+    uint32_t            err_code;
+
+    if (!m_check_due || m_timer_running)
+    {
+        return;
+    }
+    m_check_due = false;
+
+    record         = m_record;
+    record.wash    = m_wash;
+    record.minutes = m_minutes;
+    record.rgb[0]  = rgb_lcd_getReg(REG_RED);
+    record.rgb[1]  = rgb_lcd_getReg(REG_GREEN);
+    record.rgb[2]  = rgb_lcd_getReg(REG_BLUE);
+    if (memcmp(&record, &m_record, sizeof(record)) == 0)
+    {
+        return;
+    }
+
+    record.seq = m_record.seq + 1;
+    m_record   = record;
+    m_update_handler();
+
+    err_code = app_timer_start(m_timer_id,
+                               APP_TIMER_TICKS(ADV_STATUS_INTERVAL_MS, STATUS_TIMER_PRESCALER),
+                               NULL);
+    APP_ERROR_CHECK(err_code);
+    m_timer_running = true;
+}
@@ -0,0 +1,86 @@
+/**@file
+ *
+ * @brief    Display status broadcast in the advertising data.
+ *
+ * @details  The advertising data carries a status record as manufacturer specific data, so a
+ *           scanner learns whether the machine is open or closed from any advertising packet,
+ *           without connecting. All fields are single bytes:
+ *
+ *           | Offset | Field                                                        |
+ *           |--------|--------------------------------------------------------------|
+ *           | 0      | ADV_STATUS_VERSION                                           |
+ *           | 1      | Sequence number, incremented for every new record            |
+ *           | 2      | Wash state, @ref adv_status_wash_t                           |
+ *           | 3      | Remaining minutes, ADV_STATUS_MINUTES_UNKNOWN without any    |
+ *           | 4      | Backlight red                                                |
+ *           | 5      | Backlight green                                              |
+ *           | 6      | Backlight blue                                               |
+ *
+ *           The first change after a quiet period is advertised at once. Further changes are
+ *           advertised at most once per ADV_STATUS_INTERVAL_MS, the state at the end of the
+ *           interval wins, so a fade or a burst of writes costs one advertising data update per
+ *           interval.
+ */
+
+#ifndef ADV_STATUS_H__
+#define ADV_STATUS_H__
+
+#include <stdint.h>
+#include "ble_advdata.h"
+
+#define ADV_STATUS_COMPANY_ID       0xFFFF                           /**< Bluetooth SIG company identifier of the manufacturer specific data. 0xFFFF is reserved for testing, to be replaced by our own once assigned. */
+#define ADV_STATUS_VERSION          1                                /**< Record layout version. */
+#define ADV_STATUS_INTERVAL_MS      2000                             /**< Shortest time between two advertising data updates. */
+#define ADV_STATUS_MINUTES_UNKNOWN  0xFF                             /**< Remaining minutes when none are shown. */
+
+/**@brief Wash states. */
+typedef enum
+{
+    ADV_STATUS_WASH_UNKNOWN = 0,                                     /**< Not set since reset. */
+    ADV_STATUS_WASH_OPEN    = 1,
+    ADV_STATUS_WASH_CLOSED  = 2
+} adv_status_wash_t;
+
+/**@brief Status record. */
+typedef struct
+{
+    uint8_t version;                                                 /**< ADV_STATUS_VERSION. */
+    uint8_t seq;                                                     /**< Sequence number. */
+    uint8_t wash;                                                    /**< Wash state. */
+    uint8_t minutes;                                                 /**< Remaining minutes. */
+    uint8_t rgb[3];                                                  /**< Backlight red, green and blue. */
+} adv_status_record_t;
+
+/**@brief Function for rebuilding the advertising data with the current record. */
+typedef void (*adv_status_update_handler_t)(void);
+
+/**@brief Function for initializing the module.
+ *
+ * @details Requires the app_timer module to be initialized.
+ *
+ * @param[in] update_handler  Called from @ref adv_status_process when the record has changed.
+ */
+void adv_status_init(adv_status_update_handler_t update_handler);
+
+/**@brief Function for getting the manufacturer specific data for ble_advdata_set().
+ *
+ * @param[out] p_manuf_data  Points to the current record, which stays valid until the next
+ *                           update.
+ */
+void adv_status_manuf_data_get(ble_advdata_manuf_data_t * p_manuf_data);
+
+/**@brief Function for setting the wash state. */
+void adv_status_wash_set(adv_status_wash_t wash);
+
+/**@brief Function for setting the remaining minutes, ADV_STATUS_MINUTES_UNKNOWN for none. */
+void adv_status_minutes_set(uint8_t minutes);
+
+/**@brief Function for noting that the backlight color may have changed. */
+void adv_status_touch(void);
+
+/**@brief Function for advertising a changed record when the interval allows. Called from the
+ *        main loop.
+ */
+void adv_status_process(void);
+
+#endif // ADV_STATUS_H__
@@ -11,10 +11,86 @@
  */
 
 #include "ble_nus.h"
+#include "diag.h"
 #include "nordic_common.h"
 #include "ble_srv_common.h"
+#include "app_error.h"
+#include "app_util.h"
 #include <string.h>
 
+/**@brief     Function for dropping all queued notification data.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ */
+static void tx_queue_reset(ble_nus_t * p_nus)
+{
+    diag_add(DIAG_CNT_NUS_TX_DROPPED, (uint16_t)(p_nus->tx_in - p_nus->tx_out));
+
+    p_nus->tx_out  = p_nus->tx_in;
+    p_nus->tx_push = false;
+}
+
+
+/**@brief     Function for sending queued data until the S110 SoftDevice runs out of TX buffers.
+ *
+ * @details   Only full notifications are sent unless a flush has been requested, so a stream of
+ *            small writes still goes out in as few packets as possible.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ */
+static void tx_pump(ble_nus_t * p_nus)
+{
+    uint8_t packet[BLE_NUS_MAX_DATA_LEN];
+
+    for (;;)
+    {
+        ble_gatts_hvx_params_t hvx_params;
+        uint16_t               queued = p_nus->tx_in - p_nus->tx_out;
+        uint16_t               length;
+        uint16_t               i;
+        uint32_t               err_code;
+
+        if (queued == 0)
+        {
+            p_nus->tx_push = false;
+            return;
+        }
+        if ((queued < BLE_NUS_MAX_DATA_LEN) && !p_nus->tx_push)
+        {
+            // Wait for a full notification.
+            return;
+        }
+
+        length = MIN(queued, BLE_NUS_MAX_DATA_LEN);
+        for (i = 0; i < length; i++)
+        {
+            packet[i] = p_nus->tx_queue[(uint16_t)(p_nus->tx_out + i) & (BLE_NUS_TX_QUEUE_SIZE - 1)];
+        }
+
+        memset(&hvx_params, 0, sizeof(hvx_params));
+
+        hvx_params.handle = p_nus->rx_handles.value_handle;
+        hvx_params.p_data = packet;
+        hvx_params.p_len  = &length;
+        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+
+        err_code = sd_ble_gatts_hvx(p_nus->conn_handle, &hvx_params);
+        if (err_code == BLE_ERROR_NO_TX_BUFFERS)
+        {
+            // Sent on the next BLE_EVT_TX_COMPLETE.
+            return;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            // The peer is gone or has disabled notifications, the data has nowhere to go.
+            tx_queue_reset(p_nus);
+            return;
+        }
+        p_nus->tx_out += length;
+    }
+}
+
+
 /**@brief     Function for handling the @ref BLE_GAP_EVT_CONNECTED event from the S110 SoftDevice.
  *
  * @param[in] p_nus     Nordic UART Service structure.
@@ -35,7 +111,48 @@ static void on_connect(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
 static void on_disconnect(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
 {
     UNUSED_PARAMETER(p_ble_evt);
-    p_nus->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_nus->conn_handle             = BLE_CONN_HANDLE_INVALID;
+    p_nus->is_notification_enabled = false;
+
+    tx_queue_reset(p_nus);
+}
+
+
+/**@brief     Function for handling the @ref BLE_GAP_EVT_CONN_SEC_UPDATE event from the S110
+ *            SoftDevice.
+ *
+ * @details   A bonded central does not write the CCCD again after reconnecting, the Device Manager
+ *            restores it with the system attributes once the link is encrypted. It runs first in
+ *            the dispatch, so the CCCD holds the restored value here.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_conn_sec_update(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
+{
+    uint8_t  cccd_value[BLE_CCCD_VALUE_LEN];
+    uint16_t len = sizeof(cccd_value);
+
+    UNUSED_PARAMETER(p_ble_evt);
+
+    if ((sd_ble_gatts_value_get(p_nus->rx_handles.cccd_handle, 0, &len, cccd_value) == NRF_SUCCESS) &&
+        (len == BLE_CCCD_VALUE_LEN))
+    {
+        p_nus->is_notification_enabled = ble_srv_is_notification_enabled(cccd_value);
+    }
+}
+
+
+/**@brief     Function for handling the @ref BLE_EVT_TX_COMPLETE event from the S110 SoftDevice.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_tx_complete(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
+{
+    UNUSED_PARAMETER(p_ble_evt);
+
+    tx_pump(p_nus);
 }
 
 
@@ -66,10 +183,14 @@ static void on_write(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
     else if (
              (p_evt_write->handle == p_nus->tx_handles.value_handle)
              &&
+             (p_evt_write->op == BLE_GATTS_OP_WRITE_CMD)
+             &&
              (p_nus->data_handler != NULL)
             )
     {
-        p_nus->data_handler(p_nus, p_evt_write->data, p_evt_write->len);
+        // Write Commands bypass authorization and get no response, data the handler refuses is
+        // lost. The handler counts it.
+        (void)p_nus->data_handler(p_nus, p_evt_write->data, p_evt_write->len);
     }
     else
     {
@@ -78,6 +199,210 @@ static void on_write(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
 }
 
 
+/**@brief     Function for passing a complete TX value to the application data handler.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_data    Value.
+ * @param[in] length    Value length.
+ *
+ * @return    GATT status to reply to the write with.
+ */
+static uint16_t data_deliver(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length)
+{
+    uint32_t err_code;
+
+    if (p_nus->data_handler == NULL)
+    {
+        return BLE_GATT_STATUS_SUCCESS;
+    }
+
+    err_code = p_nus->data_handler(p_nus, p_data, length);
+    if (err_code == NRF_ERROR_INVALID_DATA)
+    {
+        return BLE_GATT_STATUS_ATTERR_INVALID_PDU;
+    }
+    else if (err_code != NRF_SUCCESS)
+    {
+        return BLE_GATT_STATUS_ATTERR_INSUF_RESOURCES;
+    }
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+
+/**@brief     Function for handling an Execute Write Request.
+ *
+ * @details   The memory block holds the prepared writes as a list of handle, offset, length and
+ *            value bytes, terminated by an invalid handle. With a user memory block and write
+ *            authorization the queued writes are left to the application: only the parts written
+ *            to the TX characteristic are collected, and handed to the data handler as one value,
+ *            so a long write is rendered once. The stored TX value is never used.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ *
+ * @return    GATT status to reply to the Execute Write Request with.
+ */
+static uint16_t on_queued_write_exec(ble_nus_t * p_nus)
+{
+    const uint8_t * p_mem  = p_nus->queued_write_mem;
+    uint16_t        pos    = 0;
+    uint16_t        length = 0;
+
+    if (p_nus->queued_write_block.p_mem == NULL)
+    {
+        // No block has been given, so there is nothing queued.
+        return BLE_GATT_STATUS_SUCCESS;
+    }
+
+    while (pos + BLE_NUS_QUEUED_WRITE_HEADER_LEN <= sizeof(p_nus->queued_write_mem))
+    {
+        uint16_t handle = uint16_decode(&p_mem[pos]);
+        uint16_t offset = uint16_decode(&p_mem[pos + 2]);
+        uint16_t len    = uint16_decode(&p_mem[pos + 4]);
+
+        if (handle == BLE_GATT_HANDLE_INVALID)
+        {
+            break;
+        }
+        pos += BLE_NUS_QUEUED_WRITE_HEADER_LEN;
+
+        if (len > sizeof(p_nus->queued_write_mem) - pos)
+        {
+            return BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+        }
+
+        if (handle == p_nus->tx_handles.value_handle)
+        {
+            if (offset != length)
+            {
+                return BLE_GATT_STATUS_ATTERR_INVALID_OFFSET;
+            }
+            if (offset + len > BLE_NUS_MAX_TX_CHAR_LEN)
+            {
+                return BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+            }
+
+            memcpy(&p_nus->queued_write_value[offset], &p_mem[pos], len);
+            length += len;
+        }
+        pos += len;
+    }
+
+    if (length == 0)
+    {
+        return BLE_GATT_STATUS_SUCCESS;
+    }
+    return data_deliver(p_nus, p_nus->queued_write_value, length);
+}
+
+
+/**@brief     Function for handling the @ref BLE_EVT_USER_MEM_REQUEST event from the S110 SoftDevice.
+ *
+ * @details   Requested on the first Prepare Write Request of a connection.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_user_mem_request(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
+{
+    uint32_t err_code;
+
+    if (p_ble_evt->evt.common_evt.params.user_mem_request.type != BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES)
+    {
+        return;
+    }
+
+    p_nus->queued_write_block.p_mem = p_nus->queued_write_mem;
+    p_nus->queued_write_block.len   = sizeof(p_nus->queued_write_mem);
+
+    err_code = sd_ble_user_mem_reply(p_nus->conn_handle, &p_nus->queued_write_block);
+    if (err_code != NRF_ERROR_INVALID_STATE)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief     Function for handling the @ref BLE_EVT_USER_MEM_RELEASE event from the S110 SoftDevice.
+ *
+ * @details   Sent on disconnect, the block is no longer in use.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_user_mem_release(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
+{
+    if ((p_ble_evt->evt.common_evt.params.user_mem_release.type == BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES) &&
+        (p_ble_evt->evt.common_evt.params.user_mem_release.mem_block.p_mem == p_nus->queued_write_mem))
+    {
+        p_nus->queued_write_block.p_mem = NULL;
+        p_nus->queued_write_block.len   = 0;
+    }
+}
+
+
+/**@brief     Function for handling the @ref BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST event from the S110
+ *            SoftDevice.
+ *
+ * @details   Writes to the TX characteristic are authorized by the application data handler, so
+ *            a write the application cannot buffer is rejected instead of lost. Queued writes are
+ *            authorized when they are executed.
+ *
+ * @param[in] p_nus     Nordic UART Service structure.
+ * @param[in] p_ble_evt Pointer to the event received from BLE stack.
+ */
+static void on_rw_authorize_request(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
+{
+    ble_gatts_evt_rw_authorize_request_t * p_auth_req = &p_ble_evt->evt.gatts_evt.params.authorize_request;
+    ble_gatts_rw_authorize_reply_params_t  auth_reply;
+    uint32_t                               err_code;
+
+    if (
+        (p_auth_req->type != BLE_GATTS_AUTHORIZE_TYPE_WRITE)
+        ||
+        (
+         (p_auth_req->request.write.handle != p_nus->tx_handles.value_handle)
+         &&
+         (p_auth_req->request.write.op != BLE_GATTS_OP_EXEC_WRITE_REQ_NOW)
+         &&
+         (p_auth_req->request.write.op != BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL)
+        )
+       )
+    {
+        // Do Nothing. This event is not relevant to this service.
+        return;
+    }
+
+    memset(&auth_reply, 0, sizeof(auth_reply));
+
+    auth_reply.type                     = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+    auth_reply.params.write.gatt_status = BLE_GATT_STATUS_SUCCESS;
+
+    switch (p_auth_req->request.write.op)
+    {
+        case BLE_GATTS_OP_PREP_WRITE_REQ:
+        case BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL:
+            // Prepared writes collect in the queued write memory block until they are executed.
+            break;
+
+        case BLE_GATTS_OP_EXEC_WRITE_REQ_NOW:
+            auth_reply.params.write.gatt_status = on_queued_write_exec(p_nus);
+            break;
+
+        default:
+            auth_reply.params.write.gatt_status = data_deliver(p_nus,
+                                                               p_auth_req->request.write.data,
+                                                               p_auth_req->request.write.len);
+            break;
+    }
+
+    err_code = sd_ble_gatts_rw_authorize_reply(p_nus->conn_handle, &auth_reply);
+    if (err_code != NRF_ERROR_INVALID_STATE)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
 /**@brief       Function for adding RX characteristic.
  *
  * @param[in]   p_nus        Nordic UART Service structure.
@@ -174,7 +499,7 @@ static uint32_t tx_char_add(ble_nus_t * p_nus, const ble_nus_init_t * p_nus_init
     
     attr_md.vloc                        = BLE_GATTS_VLOC_STACK;
     attr_md.rd_auth                     = 0;
-    attr_md.wr_auth                     = 0;
+    attr_md.wr_auth                     = 1;
     attr_md.vlen                        = 1;
     
     memset(&attr_char_value, 0, sizeof(attr_char_value));
@@ -192,6 +517,61 @@ static uint32_t tx_char_add(ble_nus_t * p_nus, const ble_nus_init_t * p_nus_init
 }
 
 
+/**@brief       Function for adding Diagnostics characteristic.
+ *
+ * @details     The value lives in application memory and is read in place, so reads always
+ *              return the current data without the application updating the attribute.
+ *
+ * @param[in]   p_nus        Nordic UART Service structure.
+ * @param[in]   p_nus_init   Information needed to initialize the service.
+ *
+ * @return      NRF_SUCCESS on success, otherwise an error code.
+ */
+static uint32_t diag_char_add(ble_nus_t * p_nus, const ble_nus_init_t * p_nus_init)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          ble_uuid;
+    ble_gatts_attr_md_t attr_md;
+    
+    memset(&char_md, 0, sizeof(char_md));
+    
+    char_md.char_props.read             = 1;
+    char_md.p_char_user_desc            = NULL;
+    char_md.p_char_pf                   = NULL;
+    char_md.p_user_desc_md              = NULL;
+    char_md.p_cccd_md                   = NULL;
+    char_md.p_sccd_md                   = NULL;
+    
+    ble_uuid.type                       = p_nus->uuid_type;
+    ble_uuid.uuid                       = BLE_UUID_NUS_DIAG_CHARACTERISTIC;
+    
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+    
+    attr_md.vloc                        = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth                     = 0;
+    attr_md.wr_auth                     = 0;
+    attr_md.vlen                        = 0;
+    
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid              = &ble_uuid;
+    attr_char_value.p_attr_md           = &attr_md;
+    attr_char_value.init_len            = p_nus_init->diag_data_len;
+    attr_char_value.init_offs           = 0;
+    attr_char_value.max_len             = p_nus_init->diag_data_len;
+    attr_char_value.p_value             = (uint8_t *)p_nus_init->p_diag_data;
+    
+    return sd_ble_gatts_characteristic_add(p_nus->service_handle,
+                                           &char_md,
+                                           &attr_char_value,
+                                           &p_nus->diag_handles);
+}
+
+
 void ble_nus_on_ble_evt(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
 {
     if ((p_nus == NULL) || (p_ble_evt == NULL))
@@ -209,10 +589,30 @@ void ble_nus_on_ble_evt(ble_nus_t * p_nus, ble_evt_t * p_ble_evt)
             on_disconnect(p_nus, p_ble_evt);
             break;
 
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:
+            on_conn_sec_update(p_nus, p_ble_evt);
+            break;
+
         case BLE_GATTS_EVT_WRITE:
             on_write(p_nus, p_ble_evt);
             break;
 
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+            on_rw_authorize_request(p_nus, p_ble_evt);
+            break;
+
+        case BLE_EVT_USER_MEM_REQUEST:
+            on_user_mem_request(p_nus, p_ble_evt);
+            break;
+
+        case BLE_EVT_USER_MEM_RELEASE:
+            on_user_mem_release(p_nus, p_ble_evt);
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            on_tx_complete(p_nus, p_ble_evt);
+            break;
+
         default:
             // No implementation needed.
             break;
@@ -237,6 +637,9 @@ uint32_t ble_nus_init(ble_nus_t * p_nus, const ble_nus_init_t * p_nus_init)
     // Initialize service structure.
     p_nus->conn_handle              = BLE_CONN_HANDLE_INVALID;
     p_nus->data_handler             = p_nus_init->data_handler;
+    p_nus->tx_in                    = 0;
+    p_nus->tx_out                   = 0;
+    p_nus->tx_push                  = false;
     p_nus->is_notification_enabled  = false;
     
 
@@ -275,6 +678,16 @@ uint32_t ble_nus_init(ble_nus_t * p_nus, const ble_nus_init_t * p_nus_init)
     {
         return err_code;
     }
+
+    // Add Diagnostics Characteristic.
+    if (p_nus_init->p_diag_data != NULL)
+    {
+        err_code = diag_char_add(p_nus, p_nus_init);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
     
     return NRF_SUCCESS;
 }
@@ -308,3 +721,51 @@ uint32_t ble_nus_send_string(ble_nus_t * p_nus, uint8_t * string, uint16_t lengt
     
     return sd_ble_gatts_hvx(p_nus->conn_handle, &hvx_params);
 }
+
+
+uint32_t ble_nus_tx_put(ble_nus_t * p_nus, const uint8_t * p_data, uint16_t length)
+{
+    uint16_t i;
+
+    if (p_nus == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    if ((p_nus->conn_handle == BLE_CONN_HANDLE_INVALID) || (!p_nus->is_notification_enabled))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (length > ble_nus_tx_free(p_nus))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        p_nus->tx_queue[p_nus->tx_in++ & (BLE_NUS_TX_QUEUE_SIZE - 1)] = p_data[i];
+    }
+    diag_high_water(DIAG_HWM_NUS_TX_QUEUE, (uint16_t)(p_nus->tx_in - p_nus->tx_out));
+
+    tx_pump(p_nus);
+    return NRF_SUCCESS;
+}
+
+
+void ble_nus_tx_flush(ble_nus_t * p_nus)
+{
+    if ((p_nus == NULL) || (p_nus->tx_in == p_nus->tx_out))
+    {
+        return;
+    }
+
+    p_nus->tx_push = true;
+    tx_pump(p_nus);
+}
+
+
+uint16_t ble_nus_tx_free(const ble_nus_t * p_nus)
+{
+    return BLE_NUS_TX_QUEUE_SIZE - (uint16_t)(p_nus->tx_in - p_nus->tx_out);
+}
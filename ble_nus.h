@@ -40,17 +40,36 @@
 #define BLE_UUID_NUS_SERVICE            0x0001                       /**< The UUID of the Nordic UART Service. */
 #define BLE_UUID_NUS_TX_CHARACTERISTIC  0x0002                       /**< The UUID of the TX Characteristic. */
 #define BLE_UUID_NUS_RX_CHARACTERISTIC  0x0003                       /**< The UUID of the RX Characteristic. */
+#define BLE_UUID_NUS_DIAG_CHARACTERISTIC 0x0004                      /**< The UUID of the Diagnostics Characteristic. */
 
 #define BLE_NUS_MAX_DATA_LEN            (GATT_MTU_SIZE_DEFAULT - 3)  /**< Maximum length of data (in bytes) that can be transmitted by the Nordic UART service module to the peer. */
 
 #define BLE_NUS_MAX_RX_CHAR_LEN         BLE_NUS_MAX_DATA_LEN         /**< Maximum length of the RX Characteristic (in bytes). */
-#define BLE_NUS_MAX_TX_CHAR_LEN         20                           /**< Maximum length of the TX Characteristic (in bytes). */
+#define BLE_NUS_MAX_TX_CHAR_LEN         128                          /**< Maximum length of the TX Characteristic (in bytes). Writes longer than BLE_NUS_MAX_DATA_LEN use queued (prepare/execute) writes. */
+
+#define BLE_NUS_QUEUED_WRITE_HEADER_LEN 6                            /**< Handle, offset and length in front of each prepared write in the queued write memory block. */
+#define BLE_NUS_PREP_WRITE_MAX_LEN      (GATT_MTU_SIZE_DEFAULT - 5)  /**< Maximum value bytes carried by one Prepare Write Request. */
+#define BLE_NUS_QUEUED_WRITE_MEM_LEN    (BLE_NUS_MAX_TX_CHAR_LEN +                                      \
+                                         ((BLE_NUS_MAX_TX_CHAR_LEN + BLE_NUS_PREP_WRITE_MAX_LEN - 1) /  \
+                                          BLE_NUS_PREP_WRITE_MAX_LEN) * BLE_NUS_QUEUED_WRITE_HEADER_LEN + \
+                                         2)                          /**< Size of the queued write memory block: a full TX value in prepared writes plus the terminating handle. */
+
+#define BLE_NUS_TX_QUEUE_SIZE           256                          /**< Size of the notification queue (in bytes), must be a power of two. */
 
 // Forward declaration of the ble_nus_t type. 
 typedef struct ble_nus_s ble_nus_t;
 
-/**@brief Nordic UART Service event handler type. */
-typedef void (*ble_nus_data_handler_t) (ble_nus_t * p_nus, uint8_t * data, uint16_t length);
+/**@brief Nordic UART Service event handler type.
+ *
+ * @details The handler is called for every write to the TX characteristic before the write is
+ *          accepted. Returning NRF_ERROR_NO_MEM rejects the write with an Insufficient Resources
+ *          error, telling the peer to retry later. NRF_ERROR_INVALID_DATA rejects it with an
+ *          Invalid PDU error. Write Commands get no response, a rejected one is lost.
+ *
+ * @return  NRF_SUCCESS if the data was taken, NRF_ERROR_NO_MEM if it could not be buffered,
+ *          NRF_ERROR_INVALID_DATA if it is malformed.
+ */
+typedef uint32_t (*ble_nus_data_handler_t) (ble_nus_t * p_nus, uint8_t * data, uint16_t length);
 
 /**@brief   Nordic UART Service init structure.
  *
@@ -61,6 +80,8 @@ typedef void (*ble_nus_data_handler_t) (ble_nus_t * p_nus, uint8_t * data, uint1
 typedef struct
 {
     ble_nus_data_handler_t   data_handler;            /**< Event handler to be called for handling received data. */
+    const uint8_t *          p_diag_data;             /**< Value of the read only Diagnostics characteristic, read in place by the SoftDevice. NULL for no characteristic. */
+    uint16_t                 diag_data_len;           /**< Length of p_diag_data. */
 } ble_nus_init_t;
 
 /**@brief   Nordic UART Service structure.
@@ -73,9 +94,17 @@ typedef struct ble_nus_s
     uint16_t                 service_handle;          /**< Handle of Nordic UART Service (as provided by the S110 SoftDevice). */
     ble_gatts_char_handles_t tx_handles;              /**< Handles related to the TX characteristic. (as provided by the S110 SoftDevice)*/
     ble_gatts_char_handles_t rx_handles;              /**< Handles related to the RX characteristic. (as provided by the S110 SoftDevice)*/
+    ble_gatts_char_handles_t diag_handles;            /**< Handles related to the Diagnostics characteristic. (as provided by the S110 SoftDevice)*/
     uint16_t                 conn_handle;             /**< Handle of the current connection (as provided by the S110 SoftDevice). This will be BLE_CONN_HANDLE_INVALID if not in a connection. */
     bool                     is_notification_enabled; /**< Variable to indicate if the peer has enabled notification of the RX characteristic.*/
     ble_nus_data_handler_t   data_handler;            /**< Event handler to be called for handling received data. */
+    ble_user_mem_block_t     queued_write_block;      /**< Memory block given to the S110 SoftDevice for queued writes. */
+    uint8_t                  queued_write_mem[BLE_NUS_QUEUED_WRITE_MEM_LEN]; /**< Prepared writes. Owned by the S110 SoftDevice from the reply to BLE_EVT_USER_MEM_REQUEST until BLE_EVT_USER_MEM_RELEASE, only read here. */
+    uint8_t                  queued_write_value[BLE_NUS_MAX_TX_CHAR_LEN]; /**< TX value put together from the prepared writes on execute. */
+    uint8_t                  tx_queue[BLE_NUS_TX_QUEUE_SIZE]; /**< Data waiting to be sent as RX characteristic notifications. */
+    uint16_t                 tx_in;                   /**< Free running write index of tx_queue. */
+    uint16_t                 tx_out;                  /**< Free running read index of tx_queue. */
+    bool                     tx_push;                 /**< Send the queued data even if it does not fill a notification. */
 } ble_nus_t;
 
 /**@brief       Function for initializing the Nordic UART Service.
@@ -120,6 +149,40 @@ void ble_nus_on_ble_evt(ble_nus_t * p_nus, ble_evt_t * p_ble_evt);
  */
 uint32_t ble_nus_send_string(ble_nus_t * p_nus, uint8_t * string, uint16_t length);
 
+/**@brief       Function for queuing data to be sent to the peer.
+ *
+ * @details     Queued data is sent as RX characteristic notifications of BLE_NUS_MAX_DATA_LEN
+ *              bytes, as many as the S110 SoftDevice has TX buffers for. The rest is sent as TX
+ *              buffers are freed. A remainder shorter than a notification waits for more data or
+ *              for @ref ble_nus_tx_flush.
+ *
+ * @note        Not reentrant with the BLE event handler. Call from the same interrupt priority as
+ *              SoftDevice events are handled at (APP_IRQ_PRIORITY_LOW), or from a critical region.
+ *
+ * @param[in]   p_nus          Pointer to the Nordic UART Service structure.
+ * @param[in]   p_data         Data to be sent.
+ * @param[in]   length         Length of data.
+ *
+ * @return      NRF_SUCCESS if the data has been queued. NRF_ERROR_NO_MEM if it does not fit, in
+ *              which case nothing has been queued. NRF_ERROR_INVALID_STATE if there is no peer
+ *              with notifications enabled. NRF_ERROR_NULL if the pointer p_nus is NULL.
+ */
+uint32_t ble_nus_tx_put(ble_nus_t * p_nus, const uint8_t * p_data, uint16_t length);
+
+/**@brief       Function for sending all queued data, including a last short notification.
+ *
+ * @param[in]   p_nus          Pointer to the Nordic UART Service structure.
+ */
+void ble_nus_tx_flush(ble_nus_t * p_nus);
+
+/**@brief       Function for getting the free space in the notification queue.
+ *
+ * @param[in]   p_nus          Pointer to the Nordic UART Service structure.
+ *
+ * @return      Number of bytes @ref ble_nus_tx_put can take.
+ */
+uint16_t ble_nus_tx_free(const ble_nus_t * p_nus);
+
 #endif // BLE_NUS_H__
 
 /** @} */
@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_conn_params.h"
+#include "conn_adapt.h"
+
+
+#define ADAPT_TIMER_PRESCALER   0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define ADAPT_WINDOW_INTERVAL   APP_TIMER_TICKS(CONN_ADAPT_WINDOW_MS, ADAPT_TIMER_PRESCALER)
+
+static app_timer_id_t           m_timer_id;
+static conn_adapt_init_t        m_sets;
+static bool                     m_connected;
+static bool                     m_idle;                              /**< The idle set has been asked for last. */
+static bool                     m_retry;                             /**< The last request found a procedure in progress, repeated on the next window. */
+static bool                     m_restore;                           /**< The last connection ended in the idle set, the active set is asked for on the next one. */
+static volatile uint8_t         m_writes;                            /**< Writes in the current window. */
+static uint8_t                  m_quiet_windows;                     /**< Windows without writes in a row. */
+
+
+/**@brief Function for asking the central for one of the parameter sets.
+ *
+ * @details Runs from the SoftDevice event handler or the window timer, both at the application
+ *          low interrupt priority.
+ */
+static void params_request(bool idle)
+{
+    uint32_t err_code;
+
+    m_idle  = idle;
+    m_retry = false;
+
+    err_code = ble_conn_params_change_conn_params(idle ? &m_sets.idle_params : &m_sets.active_params);
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        m_retry = true;
+        return;
+    }
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for handling the end of a write counting window. */
+static void window_timeout_handler(void * p_context)
+{
+    uint8_t writes = m_writes;
+
+    UNUSED_PARAMETER(p_context);
+
+    m_writes        = 0;
+    m_quiet_windows = (writes == 0) ? MIN(m_quiet_windows + 1, UINT8_MAX) : 0;
+
+    if (!m_idle && (m_quiet_windows >= CONN_ADAPT_IDLE_WINDOWS))
+    {
+        params_request(true);
+    }
+    else if (m_retry)
+    {
+        params_request(m_idle);
+    }
+}
+
+
+void conn_adapt_init(const conn_adapt_init_t * p_init)
+{
+    uint32_t err_code;
+
+    m_sets = *p_init;
+
+    err_code = app_timer_create(&m_timer_id,
+                                APP_TIMER_MODE_REPEATED,
+                                window_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void conn_adapt_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    uint32_t err_code;
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            // The Connection Parameters module negotiates the active set, the preferred one.
+            m_connected     = true;
+            m_idle          = false;
+            m_retry         = false;
+            m_writes        = 0;
+            m_quiet_windows = 0;
+
+            err_code = app_timer_start(m_timer_id, ADAPT_WINDOW_INTERVAL, NULL);
+            APP_ERROR_CHECK(err_code);
+
+            // The module still holds the idle set of the last connection as the preferred one.
+            if (m_restore)
+            {
+                m_restore = false;
+                params_request(false);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_connected = false;
+
+            err_code = app_timer_stop(m_timer_id);
+            APP_ERROR_CHECK(err_code);
+
+            // The next connection starts from the active set again. The Connection Parameters
+            // module would send the request on the connection handle that has just become
+            // invalid, so it is only made once there is a connection again.
+            if (m_idle)
+            {
+                m_idle    = false;
+                m_restore = true;
+            }
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+void conn_adapt_on_write(void)
+{
+    if (!m_connected)
+    {
+        return;
+    }
+
+    if (m_writes < UINT8_MAX)
+    {
+        m_writes++;
+    }
+    if (m_idle && (m_writes >= CONN_ADAPT_ACTIVE_WRITES))
+    {
+        m_quiet_windows = 0;
+        params_request(false);
+    }
+}
+
+
+bool conn_adapt_is_idle(void)
+{
+    return m_idle;
+}
@@ -0,0 +1,58 @@
+/**@file
+ *
+ * @brief    Connection parameters following the display update rate.
+ *
+ * @details  Sits on top of the ble_conn_params module, which keeps negotiating the parameters it
+ *           was given last. While the display is being updated the short interval of the active
+ *           set is asked for; once it has been left alone, the long interval and slave latency of
+ *           the idle set, so the radio wakes only every interval x (latency + 1) while nothing
+ *           changes.
+ *
+ *           Writes are counted in windows of CONN_ADAPT_WINDOW_MS. The idle set is left on the
+ *           CONN_ADAPT_ACTIVE_WRITES write within one window and only entered again after
+ *           CONN_ADAPT_IDLE_WINDOWS windows without writes, so neither a single write now and then
+ *           nor a short pause in a burst causes a parameter update.
+ */
+
+#ifndef CONN_ADAPT_H__
+#define CONN_ADAPT_H__
+
+#include <stdbool.h>
+#include "ble.h"
+
+#define CONN_ADAPT_WINDOW_MS        1000                             /**< Length of a write counting window. */
+#define CONN_ADAPT_ACTIVE_WRITES    3                                /**< Writes within one window that switch to the active set. */
+#define CONN_ADAPT_IDLE_WINDOWS     5                                /**< Windows without writes that switch to the idle set. */
+
+/**@brief Connection parameter sets. */
+typedef struct
+{
+    ble_gap_conn_params_t active_params;                             /**< Parameters while the display is updated, also the ones the connection starts with. */
+    ble_gap_conn_params_t idle_params;                               /**< Parameters while the display is left alone. */
+} conn_adapt_init_t;
+
+/**@brief Function for initializing the module.
+ *
+ * @details Requires the app_timer and Connection Parameters modules to be initialized.
+ *
+ * @param[in] p_init  Parameter sets, copied.
+ */
+void conn_adapt_init(const conn_adapt_init_t * p_init);
+
+/**@brief Function for handling a S110 SoftDevice event.
+ *
+ * @param[in] p_ble_evt  S110 SoftDevice event.
+ */
+void conn_adapt_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for counting a write that updates the display. */
+void conn_adapt_on_write(void);
+
+/**@brief Function for checking whether the idle set has been asked for last.
+ *
+ * @details The idle set is optional: a central that refuses it keeps the connection in whatever
+ *          parameters it chose.
+ */
+bool conn_adapt_is_idle(void);
+
+#endif // CONN_ADAPT_H__
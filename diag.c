@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <string.h>
+#include "app_util.h"
+#include "app_timer.h"
+#include "diag.h"
+
+
+#define DIAG_TIMER_PRESCALER    0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+
+STATIC_ASSERT(sizeof(diag_data_t) == 4 + (DIAG_HIST_COUNT * DIAG_HIST_BUCKETS * 2) + (DIAG_COUNTER_COUNT * 4));
+
+static diag_data_t m_data;
+
+
+void diag_init(void)
+{
+    memset(&m_data, 0, sizeof(m_data));
+
+    m_data.version      = DIAG_VERSION;
+    m_data.bucket_count = DIAG_HIST_BUCKETS;
+    m_data.tick_hz      = APP_TIMER_CLOCK_FREQ / (DIAG_TIMER_PRESCALER + 1);
+}
+
+
+const diag_data_t * diag_data_get(void)
+{
+    return &m_data;
+}
+
+
+uint32_t diag_ticks(void)
+{
+    uint32_t ticks;
+
+    (void)app_timer_cnt_get(&ticks);
+    return ticks;
+}
+
+
+void diag_record(diag_hist_t hist, uint32_t start_ticks)
+{
+    uint32_t   ticks;
+    uint8_t    bucket = 0;
+    uint16_t * p_bucket;
+
+    (void)app_timer_cnt_diff_compute(diag_ticks(), start_ticks, &ticks);
+
+    // No CLZ on the Cortex-M0, at most DIAG_HIST_BUCKETS shifts.
+    while ((ticks != 0) && (bucket < DIAG_HIST_BUCKETS - 1))
+    {
+        ticks >>= 1;
+        bucket++;
+    }
+
+    p_bucket = &m_data.hist[hist][bucket];
+    if (*p_bucket != UINT16_MAX)
+    {
+        (*p_bucket)++;
+    }
+}
+
+
+void diag_add(diag_counter_t counter, uint32_t value)
+{
+    m_data.counters[counter] += value;
+}
+
+
+void diag_count(diag_counter_t counter)
+{
+    m_data.counters[counter]++;
+}
+
+
+void diag_high_water(diag_counter_t counter, uint32_t level)
+{
+    if (level > m_data.counters[counter])
+    {
+        m_data.counters[counter] = level;
+    }
+}
@@ -0,0 +1,88 @@
+/**@file
+ *
+ * @brief    Display path diagnostics.
+ *
+ * @details  Latency histograms and counters for telling a slow BLE link, a slow render and a slow
+ *           I2C bus apart in the field. Times are RTC1 ticks, taken at write receive, render
+ *           start, every TWI transfer and render complete. Each histogram has log2 buckets:
+ *           bucket 0 counts times under one tick, bucket n times of 2^(n-1) up to 2^n ticks, the
+ *           last bucket everything longer. Buckets saturate instead of wrapping.
+ *
+ *           Recording costs an RTC read and a few increments, no locking: each histogram and
+ *           counter is updated from one interrupt priority.
+ *
+ *           The data is served as is, little endian, as the diagnostics characteristic of the
+ *           Nordic UART Service.
+ */
+
+#ifndef DIAG_H__
+#define DIAG_H__
+
+#include <stdint.h>
+
+#define DIAG_VERSION            1                                    /**< Layout version of @ref diag_data_t. */
+#define DIAG_HIST_BUCKETS       16                                   /**< Buckets per histogram, the last one is open ended. */
+
+/**@brief Histograms. */
+typedef enum
+{
+    DIAG_HIST_QUEUE,                                                 /**< Write receive to render start. */
+    DIAG_HIST_RENDER,                                                /**< Render start to the last transfer of the render. */
+    DIAG_HIST_TWI_XFER,                                              /**< One TWI transfer, START to STOP. */
+    DIAG_HIST_COUNT
+} diag_hist_t;
+
+/**@brief Counters and queue high-water marks. */
+typedef enum
+{
+    DIAG_CNT_WRITES,                                                 /**< Writes accepted for the display. */
+    DIAG_CNT_WRITES_REJECTED,                                        /**< Writes refused, malformed or no room. */
+    DIAG_CNT_RENDERS,                                                /**< Renders completed. */
+    DIAG_CNT_TWI_XFERS,                                              /**< TWI transfers completed. */
+    DIAG_CNT_TWI_NACKS,                                              /**< TWI transfers not acknowledged. */
+    DIAG_CNT_UART_OVERRUNS,                                          /**< UART receive errors, one byte lost each. */
+    DIAG_CNT_UART_DROPPED,                                           /**< UART bytes dropped without a peer to send them to. */
+    DIAG_CNT_NUS_TX_DROPPED,                                         /**< Queued notification bytes dropped on disconnect. */
+    DIAG_HWM_TWI_QUEUE,                                              /**< Most transactions queued at one TWI priority. */
+    DIAG_HWM_DISPLAY_RING,                                           /**< Most bytes used in the display message ring. */
+    DIAG_HWM_UART_RING,                                              /**< Most bytes waiting in the UART receive ring. */
+    DIAG_HWM_NUS_TX_QUEUE,                                           /**< Most bytes waiting in the notification queue. */
+    DIAG_COUNTER_COUNT
+} diag_counter_t;
+
+/**@brief Diagnostics data, the value of the characteristic. */
+typedef struct
+{
+    uint8_t  version;                                                /**< DIAG_VERSION. */
+    uint8_t  bucket_count;                                           /**< DIAG_HIST_BUCKETS. */
+    uint16_t tick_hz;                                                /**< Tick rate of the histogram times. */
+    uint16_t hist[DIAG_HIST_COUNT][DIAG_HIST_BUCKETS];               /**< Histograms, see @ref diag_hist_t. */
+    uint32_t counters[DIAG_COUNTER_COUNT];                           /**< Counters, see @ref diag_counter_t. */
+} diag_data_t;
+
+/**@brief Function for clearing the data. Requires the app_timer module to be initialized. */
+void diag_init(void);
+
+/**@brief Function for getting the data, valid for the lifetime of the application. */
+const diag_data_t * diag_data_get(void);
+
+/**@brief Function for getting a timestamp to pass to @ref diag_record later. */
+uint32_t diag_ticks(void);
+
+/**@brief Function for adding the time since a timestamp to a histogram.
+ *
+ * @param[in] hist         Histogram.
+ * @param[in] start_ticks  Timestamp from @ref diag_ticks.
+ */
+void diag_record(diag_hist_t hist, uint32_t start_ticks);
+
+/**@brief Function for adding to a counter. */
+void diag_add(diag_counter_t counter, uint32_t value);
+
+/**@brief Function for incrementing a counter. */
+void diag_count(diag_counter_t counter);
+
+/**@brief Function for raising a high-water mark to a level, if it is higher. */
+void diag_high_water(diag_counter_t counter, uint32_t level);
+
+#endif // DIAG_H__
@@ -0,0 +1,391 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "rgb_lcd.h"
+#include "rgb_glyph.h"
+#include "rgb_marquee.h"
+#include "rgb_clock.h"
+#include "rgb_bigfont.h"
+#include "rgb_fx.h"
+#include "display_template.h"
+#include "adv_status.h"
+#include "display_proto.h"
+
+
+#define DISPLAY_PROTO_MAX_DEPTH     2                                /**< Batches nested deeper than this are refused. */
+#define DISPLAY_PROTO_FIELD_LEN     3                                /**< Column, row and format of a clock or countdown frame. */
+#define DISPLAY_PROTO_TIME_LEN      4                                /**< Optional time of a clock or countdown frame. */
+#define DISPLAY_PROTO_TEMPLATE_LEN  (1 + LCD_ROWS * LCD_COLS)        /**< Template ID and text of a template frame, the fields follow. */
+
+/**@brief Frame handler. The payload length has been checked against the table entry. */
+typedef void (*display_op_handler_t)(const uint8_t * p_payload, uint8_t length);
+
+/**@brief Opcode table entry. */
+typedef struct
+{
+    display_op_handler_t handler;                                    /**< Handler, NULL for unused opcodes. */
+    uint8_t              min_len;                                    /**< Shortest valid payload. */
+} display_op_entry_t;
+
+static uint32_t proto_frames_run(const uint8_t * p_data, uint16_t length, bool run, uint8_t depth);
+
+
+static void op_write_at(const uint8_t * p_payload, uint8_t length)
+{
+    uint8_t col = p_payload[0];
+    uint8_t row = p_payload[1];
+
+    // Characters past the end of the line are dropped. Legacy text continues after the run.
+    rgb_lcd_write_at(col, row, &p_payload[2], length - 2);
+    if ((col < LCD_DDRAM_LINE_LEN) && (row < LCD_ROWS))
+    {
+        rgb_set_cursor(MIN(col + length - 2, LCD_DDRAM_LINE_LEN - 1), row);
+    }
+}
+
+
+static void op_set_rgb(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+    rgb_lcd_setRGB(p_payload[0], p_payload[1], p_payload[2]);
+}
+
+
+static void op_clear(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(p_payload);
+    UNUSED_PARAMETER(length);
+    // The cleared screen is shown unshifted, like after the clear display instruction.
+    rgb_marquee_stop();
+    rgb_lcd_clear();
+}
+
+
+static void op_set_cursor(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+    rgb_set_cursor(p_payload[0], p_payload[1]);
+}
+
+
+static void op_define_glyph(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+    // IDs outside the run time range are ignored.
+    (void)rgb_glyph_define(p_payload[0], &p_payload[1]);
+}
+
+
+static void op_batch(const uint8_t * p_payload, uint8_t length)
+{
+    // Already checked together with the enclosing frames.
+    (void)proto_frames_run(p_payload, length, true, 0);
+}
+
+
+static void op_write_glyphs(const uint8_t * p_payload, uint8_t length)
+{
+    uint8_t col = p_payload[0];
+    uint8_t row = p_payload[1];
+    uint8_t codes[LCD_DDRAM_LINE_LEN];
+    uint8_t count;
+
+    // Same bounds as WRITE_AT. Glyphs past the end of the line are not loaded at all.
+    if ((col >= LCD_DDRAM_LINE_LEN) || (row >= LCD_ROWS))
+    {
+        return;
+    }
+    count = MIN(length - 2, LCD_DDRAM_LINE_LEN - col);
+
+    // An undefined glyph, or one that finds no free slot, shows as a blank cell.
+    rgb_glyph_codes(&p_payload[2], codes, count, ' ');
+    rgb_lcd_write_at(col, row, codes, count);
+    rgb_set_cursor(MIN(col + count, LCD_DDRAM_LINE_LEN - 1), row);
+}
+
+
+static void op_marquee(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+
+    if (p_payload[0] == 0)
+    {
+        rgb_marquee_stop();
+        return;
+    }
+    rgb_marquee_start(p_payload[0], p_payload[1] * 10, p_payload[2] * 100);
+}
+
+
+static void op_clock(const uint8_t * p_payload, uint8_t length)
+{
+    // A position outside the frame leaves the field and its time as they are.
+    if (rgb_clock_field_set(RGB_CLOCK_FIELD_TIME,
+                            p_payload[0],
+                            p_payload[1],
+                            (rgb_clock_format_t)p_payload[2]) != NRF_SUCCESS)
+    {
+        return;
+    }
+    if (length >= DISPLAY_PROTO_FIELD_LEN + DISPLAY_PROTO_TIME_LEN)
+    {
+        rgb_clock_time_set(uint32_decode(&p_payload[DISPLAY_PROTO_FIELD_LEN]));
+    }
+}
+
+
+static void op_countdown(const uint8_t * p_payload, uint8_t length)
+{
+    // A position outside the frame leaves the field and its time as they are.
+    if (rgb_clock_field_set(RGB_CLOCK_FIELD_COUNTDOWN,
+                            p_payload[0],
+                            p_payload[1],
+                            (rgb_clock_format_t)p_payload[2]) != NRF_SUCCESS)
+    {
+        return;
+    }
+    if (length >= DISPLAY_PROTO_FIELD_LEN + DISPLAY_PROTO_TIME_LEN)
+    {
+        rgb_clock_countdown_set(uint32_decode(&p_payload[DISPLAY_PROTO_FIELD_LEN]));
+    }
+}
+
+
+static void op_write_big(const uint8_t * p_payload, uint8_t length)
+{
+    // Nothing is written if the glyph cache has no slot left for a segment.
+    (void)rgb_bigfont_write(p_payload[0], &p_payload[1], length - 1);
+}
+
+
+static void op_compose(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(p_payload);
+    UNUSED_PARAMETER(length);
+    rgb_lcd_compose();
+}
+
+
+static void op_commit(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(p_payload);
+    UNUSED_PARAMETER(length);
+    rgb_lcd_commit();
+}
+
+
+static void op_set_template(const uint8_t * p_payload, uint8_t length)
+{
+    display_template_t template;
+    uint8_t            fields = MIN((length - DISPLAY_PROTO_TEMPLATE_LEN) / sizeof(display_template_field_t),
+                                    DISPLAY_TEMPLATE_FIELDS);
+
+    memcpy(template.text, &p_payload[1], sizeof(template.text));
+    memset(template.fields, 0, sizeof(template.fields));
+    memcpy(template.fields, &p_payload[DISPLAY_PROTO_TEMPLATE_LEN], fields * sizeof(display_template_field_t));
+
+    // IDs out of range and templates with a field off the screen are ignored.
+    (void)display_template_define(p_payload[0], &template);
+}
+
+
+static void op_template(const uint8_t * p_payload, uint8_t length)
+{
+    // An undefined template leaves the display as it is.
+    (void)display_template_show(p_payload[0], &p_payload[1], length - 1);
+}
+
+
+static void op_blink(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+
+    if (p_payload[0] == 0)
+    {
+        rgb_fx_stop();
+        return;
+    }
+    rgb_fx_blink(p_payload[0] * 100, p_payload[1]);
+}
+
+
+static void op_dim(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+
+    if (p_payload[0] == 0xFF)
+    {
+        rgb_fx_stop();
+        return;
+    }
+    rgb_fx_dim(p_payload[0]);
+}
+
+
+static void op_fade(const uint8_t * p_payload, uint8_t length)
+{
+    UNUSED_PARAMETER(length);
+    rgb_fx_fade(p_payload[0], p_payload[1], p_payload[2], p_payload[3] * 10);
+}
+
+
+/**@brief Opcode dispatch table, indexed by opcode. */
+static const display_op_entry_t m_op_table[DISPLAY_OP_COUNT] =
+{
+    [DISPLAY_OP_WRITE_AT]     = {op_write_at,     2},
+    [DISPLAY_OP_SET_RGB]      = {op_set_rgb,      3},
+    [DISPLAY_OP_CLEAR]        = {op_clear,        0},
+    [DISPLAY_OP_SET_CURSOR]   = {op_set_cursor,   2},
+    [DISPLAY_OP_DEFINE_GLYPH] = {op_define_glyph, 1 + LCD_GLYPH_ROWS},
+    [DISPLAY_OP_BATCH]        = {op_batch,        0},
+    [DISPLAY_OP_WRITE_GLYPHS] = {op_write_glyphs, 2},
+    [DISPLAY_OP_MARQUEE]      = {op_marquee,      3},
+    [DISPLAY_OP_CLOCK]        = {op_clock,        DISPLAY_PROTO_FIELD_LEN},
+    [DISPLAY_OP_COUNTDOWN]    = {op_countdown,    DISPLAY_PROTO_FIELD_LEN},
+    [DISPLAY_OP_WRITE_BIG]    = {op_write_big,    1},
+    [DISPLAY_OP_COMPOSE]      = {op_compose,      0},
+    [DISPLAY_OP_COMMIT]       = {op_commit,       0},
+    [DISPLAY_OP_SET_TEMPLATE] = {op_set_template, DISPLAY_PROTO_TEMPLATE_LEN},
+    [DISPLAY_OP_TEMPLATE]     = {op_template,     1},
+    [DISPLAY_OP_BLINK]        = {op_blink,        2},
+    [DISPLAY_OP_DIM]          = {op_dim,          1},
+    [DISPLAY_OP_FADE]         = {op_fade,         4},
+};
+
+
+/**@brief Function for walking a list of frames.
+ *
+ * @param[in] p_data  First frame.
+ * @param[in] length  Length of all frames.
+ * @param[in] run     If true, the frames are run, otherwise they are checked including the
+ *                    frames of nested batches.
+ * @param[in] depth   Batch nesting level of the list, only used for checking.
+ */
+static uint32_t proto_frames_run(const uint8_t * p_data, uint16_t length, bool run, uint8_t depth)
+{
+    uint16_t pos = 0;
+
+    while (pos < length)
+    {
+        const display_op_entry_t * p_entry;
+        uint8_t                    op;
+        uint8_t                    len;
+
+        if (length - pos < DISPLAY_PROTO_FRAME_HEADER)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        op   = p_data[pos];
+        len  = p_data[pos + 1];
+        pos += DISPLAY_PROTO_FRAME_HEADER;
+
+        if ((op >= DISPLAY_OP_COUNT) || (m_op_table[op].handler == NULL) || (len > length - pos))
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        p_entry = &m_op_table[op];
+        if (len < p_entry->min_len)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+
+        if ((op == DISPLAY_OP_BATCH) && !run)
+        {
+            uint32_t err_code;
+
+            if (depth >= DISPLAY_PROTO_MAX_DEPTH)
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+            err_code = proto_frames_run(&p_data[pos], len, false, depth + 1);
+            if (err_code != NRF_SUCCESS)
+            {
+                return err_code;
+            }
+        }
+
+        if (run)
+        {
+            p_entry->handler(&p_data[pos], len);
+        }
+        pos += len;
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for interpreting legacy data (text and control bytes 1-7) on the display. */
+static void proto_legacy_run(const uint8_t * p_data, uint16_t length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        // Hand runs of text to the driver in one go, bytes 1-7 are control codes.
+        int run = 0;
+        while ((i + run < length) && ((p_data[i + run] == 0) || (p_data[i + run] > 7)))
+        {
+            run++;
+        }
+        if (run > 0)
+        {
+            rgb_lcd_write_buf(&p_data[i], run);
+            i += run;
+            if (i >= length)
+            {
+                break;
+            }
+        }
+
+        if (p_data[i] == 1) {
+            rgb_marquee_stop();
+            rgb_lcd_clear();
+        } else if (p_data[i] == 2) {
+            rgb_set_cursor(0, 0);
+        } else if (p_data[i] == 3) {
+            rgb_set_cursor(0, 1);
+        } else if (p_data[i] == 4) {
+            rgb_lcd_setColor(0);
+        } else if (p_data[i] == 5) {
+            rgb_lcd_setColor(1);
+        } else if (p_data[i] == 6) {
+            rgb_lcd_wash_open();
+            adv_status_wash_set(ADV_STATUS_WASH_OPEN);
+        } else if (p_data[i] == 7) {
+            rgb_lcd_wash_closed();
+            adv_status_wash_set(ADV_STATUS_WASH_CLOSED);
+        }
+    }
+}
+
+
+uint32_t display_proto_check(const uint8_t * p_data, uint16_t length)
+{
+    if ((length == 0) || (p_data[0] != DISPLAY_PROTO_VERSION))
+    {
+        return NRF_SUCCESS;
+    }
+    return proto_frames_run(&p_data[1], length - 1, false, 0);
+}
+
+
+uint32_t display_proto_process(const uint8_t * p_data, uint16_t length)
+{
+    uint32_t err_code;
+
+    if ((length == 0) || (p_data[0] != DISPLAY_PROTO_VERSION))
+    {
+        proto_legacy_run(p_data, length);
+        return NRF_SUCCESS;
+    }
+
+    // A write is run completely or not at all.
+    err_code = proto_frames_run(&p_data[1], length - 1, false, 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    return proto_frames_run(&p_data[1], length - 1, true, 0);
+}
@@ -0,0 +1,112 @@
+/**@file
+ *
+ * @brief    Display command protocol.
+ *
+ * @details  A write to the NUS TX characteristic is either a framed command list or legacy text.
+ *
+ *           A framed write starts with @ref DISPLAY_PROTO_VERSION, followed by any number of
+ *           frames. Each frame is an opcode byte, a length byte and that many payload bytes:
+ *
+ *           | Opcode                    | Payload                                       |
+ *           |---------------------------|-----------------------------------------------|
+ *           | DISPLAY_OP_WRITE_AT       | column, row, characters up to the line end    |
+ *           | DISPLAY_OP_SET_RGB        | red, green, blue                              |
+ *           | DISPLAY_OP_CLEAR          | -                                             |
+ *           | DISPLAY_OP_SET_CURSOR     | column, row                                   |
+ *           | DISPLAY_OP_DEFINE_GLYPH   | glyph ID (RGB_GLYPH_CLIENT_FIRST...), rows    |
+ *           | DISPLAY_OP_BATCH          | frames, run as one command                    |
+ *           | DISPLAY_OP_WRITE_GLYPHS   | column, row, glyph IDs                        |
+ *           | DISPLAY_OP_MARQUEE        | width (0 stops), step (10 ms), pause (100 ms) |
+ *           | DISPLAY_OP_CLOCK          | column, row, format, [time of day (s)]        |
+ *           | DISPLAY_OP_COUNTDOWN      | column, row, format, [time to cycle end (s)]  |
+ *           | DISPLAY_OP_WRITE_BIG      | column, characters ('0'-'9', ':', ' ')        |
+ *           | DISPLAY_OP_COMPOSE        | -                                             |
+ *           | DISPLAY_OP_COMMIT         | -                                             |
+ *           | DISPLAY_OP_SET_TEMPLATE   | template ID, 2 lines of text, fields          |
+ *           | DISPLAY_OP_TEMPLATE       | template ID, packed field values              |
+ *           | DISPLAY_OP_BLINK          | period (100 ms, 0 stops), duty (255 is on)    |
+ *           | DISPLAY_OP_DIM            | level (255 stops dimming and blinking)        |
+ *           | DISPLAY_OP_FADE           | red, green, blue, time (10 ms)                |
+ *
+ *           A clear, framed or legacy, also stops the marquee.
+ *
+ *           Text and glyph writes at a position outside the frame are ignored, runs are clipped
+ *           at the end of the DDRAM line. Glyphs that cannot be loaded show as blank cells, see
+ *           rgb_glyph.h.
+ *
+ *           The clock and countdown fields are drawn by the firmware from then on, see
+ *           rgb_clock.h for the formats (0 removes the field). Times are 32-bit little endian;
+ *           without one, the field is only moved or restyled. Big characters span both lines,
+ *           see rgb_bigfont.h.
+ *
+ *           Between DISPLAY_OP_COMPOSE and DISPLAY_OP_COMMIT, framed and legacy writes only draw
+ *           into the frame; the commit shows the result at once. A disconnect commits.
+ *
+ *           A template is LCD_COLS characters per line followed by up to DISPLAY_TEMPLATE_FIELDS
+ *           fields of column, row, width and format each, see display_template.h.
+ *
+ *           Blink and dim run in the backlight driver, a fade is stepped by the firmware, see
+ *           rgb_fx.h.
+ *
+ *           Any other write is legacy data: text, with bytes 1-7 as control codes (1 clear,
+ *           2/3 cursor to line 1/2, 4/5 white/red backlight, 6/7 wash open/closed).
+ */
+
+#ifndef DISPLAY_PROTO_H__
+#define DISPLAY_PROTO_H__
+
+#include <stdint.h>
+
+#define DISPLAY_PROTO_VERSION       0xF1                             /**< First byte of a framed write, protocol version 1. */
+#define DISPLAY_PROTO_FRAME_HEADER  2                                /**< Bytes used by the opcode and length of each frame. */
+
+/**@brief Frame opcodes. */
+typedef enum
+{
+    DISPLAY_OP_WRITE_AT     = 0x01,
+    DISPLAY_OP_SET_RGB      = 0x02,
+    DISPLAY_OP_CLEAR        = 0x03,
+    DISPLAY_OP_SET_CURSOR   = 0x04,
+    DISPLAY_OP_DEFINE_GLYPH = 0x05,
+    DISPLAY_OP_BATCH        = 0x06,
+    DISPLAY_OP_WRITE_GLYPHS = 0x07,
+    DISPLAY_OP_MARQUEE      = 0x08,
+    DISPLAY_OP_CLOCK        = 0x09,
+    DISPLAY_OP_COUNTDOWN    = 0x0A,
+    DISPLAY_OP_WRITE_BIG    = 0x0B,
+    DISPLAY_OP_COMPOSE      = 0x0C,
+    DISPLAY_OP_COMMIT       = 0x0D,
+    DISPLAY_OP_SET_TEMPLATE = 0x0E,
+    DISPLAY_OP_TEMPLATE     = 0x0F,
+    DISPLAY_OP_BLINK        = 0x10,
+    DISPLAY_OP_DIM          = 0x11,
+    DISPLAY_OP_FADE         = 0x12,
+    DISPLAY_OP_COUNT                                                 /**< Number of opcodes, not an opcode. */
+} display_op_t;
+
+/**@brief Function for checking a write before it is accepted.
+ *
+ * @details Cheap enough for the BLE event handler, so malformed frames are refused to the peer
+ *          instead of being dropped later. Legacy writes are always valid.
+ *
+ * @param[in] p_data  Write data.
+ * @param[in] length  Write length.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_INVALID_DATA for an unknown opcode, a truncated frame or a
+ *         payload too short for its opcode.
+ */
+uint32_t display_proto_check(const uint8_t * p_data, uint16_t length);
+
+/**@brief Function for running a write on the display.
+ *
+ * @details Only updates the LCD driver frame and backlight, the caller flushes.
+ *
+ * @param[in] p_data  Write data.
+ * @param[in] length  Write length.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_INVALID_DATA if a frame is malformed, in which case nothing
+ *         has been run.
+ */
+uint32_t display_proto_process(const uint8_t * p_data, uint16_t length);
+
+#endif // DISPLAY_PROTO_H__
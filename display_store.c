@@ -0,0 +1,285 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "crc16.h"
+#include "pstorage.h"
+#include "rgb_lcd.h"
+#include "display_store.h"
+
+
+#define STORE_TIMER_PRESCALER   0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define STORE_BLOCK_SIZE        256                                  /**< Size of one journal slot, divides the flash page size. */
+#define STORE_VERSION           1                                    /**< Record layout version, records of other versions are ignored. */
+#define STORE_SEQ_ERASED        0xFFFFFFFF                           /**< Sequence number of an erased slot. */
+#define STORE_SLOTS_PER_PAGE    (PSTORAGE_FLASH_PAGE_SIZE / STORE_BLOCK_SIZE)
+#define STORE_SLOT_COUNT        (PSTORAGE_DISPLAY_STORE_PAGES * STORE_SLOTS_PER_PAGE)
+
+/**@brief Journal record. */
+typedef struct
+{
+    uint32_t        seq;                                             /**< Sequence number, higher is newer. */
+    uint16_t        version;                                         /**< STORE_VERSION. */
+    uint16_t        crc;                                             /**< CRC16 of state. */
+    rgb_lcd_state_t state;                                           /**< Display contents. */
+} display_store_record_t;
+
+STATIC_ASSERT(sizeof(display_store_record_t) <= STORE_BLOCK_SIZE);
+STATIC_ASSERT(sizeof(display_store_record_t) % sizeof(uint32_t) == 0);
+
+static pstorage_handle_t              m_base;                        /**< First journal slot. */
+static app_timer_id_t                 m_timer_id;
+static bool                           m_timer_running;
+static volatile bool                  m_write_due;                   /**< Set when the interval has expired or a flush has been requested. */
+static volatile bool                  m_write_pending;               /**< Set while pstorage is writing m_record. */
+static display_store_record_t         m_record;                      /**< Record being written, must not change until pstorage is done. */
+static const display_store_record_t * m_p_last;                      /**< Last record in flash, NULL if none or if its write failed. */
+static const display_store_record_t * m_p_restored;                  /**< Record found at boot. */
+static uint16_t                       m_next_slot;                   /**< Slot the next record goes to. */
+static uint32_t                       m_next_seq;                    /**< Sequence number of the next record. */
+
+
+static void slot_handle_get(uint16_t slot, pstorage_handle_t * p_handle)
+{
+    uint32_t err_code;
+
+    err_code = pstorage_block_identifier_get(&m_base, slot, p_handle);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for reading a journal slot, flash is memory mapped. */
+static const display_store_record_t * slot_record(uint16_t slot)
+{
+    pstorage_handle_t handle;
+
+    slot_handle_get(slot, &handle);
+    return (const display_store_record_t *)handle.block_id;
+}
+
+
+static bool record_is_valid(const display_store_record_t * p_record)
+{
+    return (p_record->seq != STORE_SEQ_ERASED) &&
+           (p_record->version == STORE_VERSION) &&
+           (p_record->crc == crc16_compute((const uint8_t *)&p_record->state,
+                                           sizeof(p_record->state),
+                                           NULL));
+}
+
+
+static bool slot_is_erased(uint16_t slot)
+{
+    const uint32_t * p_word = (const uint32_t *)slot_record(slot);
+    uint16_t         i;
+
+    for (i = 0; i < STORE_BLOCK_SIZE / sizeof(uint32_t); i++)
+    {
+        if (p_word[i] != PSTORAGE_FLASH_EMPTY_MASK)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**@brief Function for getting a slot ready to be written.
+ *
+ * @details Slots are used in turn. Entering a page erases it if needed; the newest record is
+ *          always on the page before, so it survives. A used slot in the middle of a page (left
+ *          by an interrupted erase) is skipped by moving on to the next page.
+ *
+ * @return Slot to write.
+ */
+static uint16_t slot_prepare(void)
+{
+    uint16_t slot = m_next_slot;
+    uint16_t first;
+    uint16_t i;
+    bool     erased = true;
+
+    if ((slot % STORE_SLOTS_PER_PAGE != 0) && !slot_is_erased(slot))
+    {
+        slot = ((slot / STORE_SLOTS_PER_PAGE + 1) * STORE_SLOTS_PER_PAGE) % STORE_SLOT_COUNT;
+    }
+
+    if (slot % STORE_SLOTS_PER_PAGE == 0)
+    {
+        first = slot;
+        for (i = first; i < first + STORE_SLOTS_PER_PAGE; i++)
+        {
+            erased = erased && slot_is_erased(i);
+        }
+
+        if (!erased)
+        {
+            pstorage_handle_t handle;
+            uint32_t          err_code;
+
+            slot_handle_get(first, &handle);
+            err_code = pstorage_clear(&handle, PSTORAGE_FLASH_PAGE_SIZE);
+            APP_ERROR_CHECK(err_code);
+        }
+    }
+    return slot;
+}
+
+
+/**@brief Function for handling pstorage events.
+ *
+ * @details The main loop wakes up on the flash event and writes again if something changed in
+ *          the meantime. A failed erase or write leaves no valid record of the contents, so they
+ *          are written again even if they do not change any more.
+ */
+static void store_pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                      uint8_t             op_code,
+                                      uint32_t            result,
+                                      uint8_t           * p_data,
+                                      uint32_t            data_len)
+{
+    UNUSED_PARAMETER(p_handle);
+    UNUSED_PARAMETER(p_data);
+    UNUSED_PARAMETER(data_len);
+
+    if (result != NRF_SUCCESS)
+    {
+        // Written again on the next wake-up, to the next slot.
+        m_p_last    = NULL;
+        m_write_due = true;
+    }
+    if (op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        m_write_pending = false;
+    }
+}
+
+
+/**@brief Function for handling the coalescing timer timeout. */
+static void store_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_write_due = true;
+}
+
+
+void display_store_init(void)
+{
+    pstorage_module_param_t param;
+    uint32_t                err_code;
+    uint16_t                slot;
+
+    param.cb          = store_pstorage_cb_handler;
+    param.block_size  = STORE_BLOCK_SIZE;
+    param.block_count = STORE_SLOT_COUNT;
+
+    err_code = pstorage_register(&param, &m_base);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_create(&m_timer_id, APP_TIMER_MODE_SINGLE_SHOT, store_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    m_p_restored = NULL;
+    m_next_slot  = 0;
+    m_next_seq   = 0;
+
+    for (slot = 0; slot < STORE_SLOT_COUNT; slot++)
+    {
+        const display_store_record_t * p_record = slot_record(slot);
+
+        if (record_is_valid(p_record) && ((m_p_restored == NULL) || (p_record->seq > m_p_restored->seq)))
+        {
+            m_p_restored = p_record;
+            m_next_slot  = (slot + 1) % STORE_SLOT_COUNT;
+            m_next_seq   = p_record->seq + 1;
+        }
+    }
+    m_p_last = m_p_restored;
+}
+
+
+const rgb_lcd_state_t * display_store_restored(void)
+{
+    return (m_p_restored != NULL) ? &m_p_restored->state : NULL;
+}
+
+
+void display_store_touch(void)
+{
+    uint32_t err_code;
+
+    if (m_timer_running || m_write_due)
+    {
+        return;
+    }
+
+    err_code = app_timer_start(m_timer_id,
+                               APP_TIMER_TICKS(DISPLAY_STORE_INTERVAL_MS, STORE_TIMER_PRESCALER),
+                               NULL);
+    APP_ERROR_CHECK(err_code);
+    m_timer_running = true;
+}
+
+
+void display_store_flush(void)
+{
+    uint32_t err_code;
+
+    if (m_timer_running)
+    {
+        err_code = app_timer_stop(m_timer_id);
+        APP_ERROR_CHECK(err_code);
+    }
+    m_write_due = true;
+    display_store_process();
+}
+
+
+bool display_store_is_idle(void)
+{
+    return !m_write_due && !m_write_pending;
+}
+
+
+void display_store_process(void)
+{
+    uint16_t slot;
+    uint32_t err_code;
+
+    if (!m_write_due || m_write_pending || rgb_lcd_is_composing())
+    {
+        // A write still in progress holds m_record, and a frame being composed may be half
+        // drawn. The next wake-up retries.
+        return;
+    }
+    m_write_due     = false;
+    m_timer_running = false;
+
+    rgb_lcd_state_get(&m_record.state);
+    if ((m_p_last != NULL) && (memcmp(&m_record.state, &m_p_last->state, sizeof(m_record.state)) == 0))
+    {
+        return;
+    }
+
+    m_record.seq     = m_next_seq;
+    m_record.version = STORE_VERSION;
+    m_record.crc     = crc16_compute((const uint8_t *)&m_record.state, sizeof(m_record.state), NULL);
+
+    slot = slot_prepare();
+    {
+        pstorage_handle_t handle;
+
+        slot_handle_get(slot, &handle);
+        m_write_pending = true;
+        err_code = pstorage_store(&handle, (uint8_t *)&m_record, sizeof(m_record), 0);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    m_p_last    = slot_record(slot);
+    m_next_slot = (slot + 1) % STORE_SLOT_COUNT;
+    m_next_seq++;
+}
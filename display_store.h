@@ -0,0 +1,47 @@
+/**@file
+ *
+ * @brief    Flash journal of the display contents.
+ *
+ * @details  The frame, backlight color and user defined characters are appended to a journal in
+ *           the pstorage area as records carrying a sequence number and a CRC. Records go to the
+ *           journal slots in turn, so writes and page erases are spread evenly over all
+ *           PSTORAGE_DISPLAY_STORE_PAGES pages. The valid record with the highest sequence
+ *           number is the one restored at boot.
+ *
+ *           Changes are coalesced: the first change starts a timer, and when it expires the
+ *           current contents are written once, if they differ from the last record.
+ */
+
+#ifndef DISPLAY_STORE_H__
+#define DISPLAY_STORE_H__
+
+#include <stdbool.h>
+#include "rgb_lcd.h"
+
+#define DISPLAY_STORE_INTERVAL_MS   10000                            /**< Time from the first change to the record write, at most one write per interval. */
+
+/**@brief Function for initializing the journal and finding the last record.
+ *
+ * @details Requires the app_timer and pstorage modules to be initialized.
+ */
+void display_store_init(void);
+
+/**@brief Function for getting the contents of the last record.
+ *
+ * @return Display contents in flash, NULL if the journal is empty.
+ */
+const rgb_lcd_state_t * display_store_restored(void);
+
+/**@brief Function for noting that the display contents may have changed. */
+void display_store_touch(void);
+
+/**@brief Function for writing changed contents now instead of when the interval expires. */
+void display_store_flush(void);
+
+/**@brief Function for checking if no record write is due or in progress. */
+bool display_store_is_idle(void);
+
+/**@brief Function for writing a due record. Called from the main loop. */
+void display_store_process(void);
+
+#endif // DISPLAY_STORE_H__
@@ -0,0 +1,282 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "crc16.h"
+#include "pstorage.h"
+#include "rgb_lcd.h"
+#include "display_template.h"
+
+
+#define TEMPLATE_VERSION        1                                    /**< Table layout version, a table of another version is ignored. */
+#define TEMPLATE_NUMBER_MAX_LEN 5                                    /**< Digits of the largest UINT16 value. */
+#define TEMPLATE_OVERFLOW       '#'                                  /**< Fills a field too narrow for its number. */
+
+/**@brief Table, as kept in flash. */
+typedef struct
+{
+    uint16_t           version;                                      /**< TEMPLATE_VERSION. */
+    uint16_t           crc;                                          /**< CRC16 of the rest of the table. */
+    uint32_t           defined;                                      /**< Bit mask of the defined templates. */
+    display_template_t templates[DISPLAY_TEMPLATE_COUNT];
+} template_table_t;
+
+STATIC_ASSERT(sizeof(template_table_t) % sizeof(uint32_t) == 0);
+
+static pstorage_handle_t m_base;
+static template_table_t  m_table;                                    /**< Table in use, also the data pstorage writes. */
+static bool              m_write_due;                                /**< The table differs from the one in flash. */
+static volatile bool     m_write_pending;                            /**< Set while pstorage is clearing or writing the page. */
+
+
+static uint16_t table_crc(const template_table_t * p_table)
+{
+    return crc16_compute((const uint8_t *)&p_table->defined,
+                         sizeof(*p_table) - offsetof(template_table_t, defined),
+                         NULL);
+}
+
+
+static void template_pstorage_cb_handler(pstorage_handle_t * p_handle,
+                                         uint8_t             op_code,
+                                         uint32_t            result,
+                                         uint8_t           * p_data,
+                                         uint32_t            data_len)
+{
+    UNUSED_PARAMETER(p_handle);
+    UNUSED_PARAMETER(p_data);
+    UNUSED_PARAMETER(data_len);
+
+    if (result != NRF_SUCCESS)
+    {
+        // Written again on the next wake-up.
+        m_write_due = true;
+    }
+    if (op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        m_write_pending = false;
+    }
+}
+
+
+/**@brief Function for putting a number in decimal.
+ *
+ * @param[out] p_text  At least TEMPLATE_NUMBER_MAX_LEN characters.
+ *
+ * @return Number of digits.
+ */
+static uint8_t template_number_put(uint16_t value, uint8_t * p_text)
+{
+    uint8_t digits[TEMPLATE_NUMBER_MAX_LEN];
+    uint8_t count = 0;
+    uint8_t i;
+
+    do
+    {
+        digits[count++] = '0' + value % 10;
+        value          /= 10;
+    } while (value != 0);
+
+    for (i = 0; i < count; i++)
+    {
+        p_text[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+
+/**@brief Function for formatting the next packed value into a field.
+ *
+ * @param[in]     p_field   Field.
+ * @param[in]     width     Cells of the field on the display.
+ * @param[in]     p_values  Packed values.
+ * @param[in]     length    Length of the values.
+ * @param[in,out] p_pos     Offset of the value, moved past it.
+ * @param[out]    p_text    width characters.
+ */
+static void template_field_format(const display_template_field_t * p_field,
+                                  uint8_t                          width,
+                                  const uint8_t                  * p_values,
+                                  uint8_t                          length,
+                                  uint8_t                        * p_pos,
+                                  uint8_t                        * p_text)
+{
+    uint8_t value[LCD_COLS];
+    uint8_t value_len = 0;
+    uint8_t pad       = ' ';
+    bool    right     = (p_field->format & (DISPLAY_TEMPLATE_ALIGN_RIGHT | DISPLAY_TEMPLATE_ZERO_PAD)) != 0;
+    uint8_t pos       = *p_pos;
+
+    switch (p_field->format & DISPLAY_TEMPLATE_TYPE_MASK)
+    {
+        case DISPLAY_TEMPLATE_TEXT:
+            if (pos < length)
+            {
+                value_len = MIN(p_values[pos], length - pos - 1);
+                *p_pos    = pos + 1 + value_len;
+                value_len = MIN(value_len, width);
+                memcpy(value, &p_values[pos + 1], value_len);
+            }
+            break;
+
+        case DISPLAY_TEMPLATE_UINT8:
+            if (pos + 1 <= length)
+            {
+                value_len = template_number_put(p_values[pos], value);
+                *p_pos    = pos + 1;
+            }
+            break;
+
+        case DISPLAY_TEMPLATE_UINT16:
+            if (pos + 2 <= length)
+            {
+                value_len = template_number_put(uint16_decode(&p_values[pos]), value);
+                *p_pos    = pos + 2;
+            }
+            break;
+
+        default:
+            // Unknown types take no value and stay blank.
+            break;
+    }
+
+    if (value_len > width)
+    {
+        // Only numbers get here, text has been cut to the field.
+        memset(p_text, TEMPLATE_OVERFLOW, width);
+        return;
+    }
+    if ((value_len > 0) && (p_field->format & DISPLAY_TEMPLATE_ZERO_PAD))
+    {
+        pad = '0';
+    }
+
+    memset(p_text, pad, width);
+    memcpy(right ? &p_text[width - value_len] : p_text, value, value_len);
+}
+
+
+void display_template_init(void)
+{
+    pstorage_module_param_t param;
+    pstorage_handle_t       handle;
+    uint32_t                err_code;
+
+    param.cb          = template_pstorage_cb_handler;
+    // One block, pstorage refuses a table larger than a flash page.
+    param.block_size  = sizeof(template_table_t);
+    param.block_count = 1;
+
+    err_code = pstorage_register(&param, &m_base);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = pstorage_block_identifier_get(&m_base, 0, &handle);
+    APP_ERROR_CHECK(err_code);
+
+    // Flash is memory mapped. An erased or torn table leaves every template undefined.
+    memcpy(&m_table, (const template_table_t *)handle.block_id, sizeof(m_table));
+    if ((m_table.version != TEMPLATE_VERSION) || (m_table.crc != table_crc(&m_table)))
+    {
+        memset(&m_table, 0, sizeof(m_table));
+    }
+    m_write_due = false;
+}
+
+
+uint32_t display_template_define(uint8_t id, const display_template_t * p_template)
+{
+    uint8_t i;
+
+    if (id >= DISPLAY_TEMPLATE_COUNT)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // A field off the screen would have to be skipped with its value unknown, so the values of
+    // the fields after it could not be found.
+    for (i = 0; i < DISPLAY_TEMPLATE_FIELDS; i++)
+    {
+        const display_template_field_t * p_field = &p_template->fields[i];
+
+        if ((p_field->width != 0) && ((p_field->col >= LCD_COLS) || (p_field->row >= LCD_ROWS)))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
+
+    m_table.templates[id] = *p_template;
+    m_table.defined      |= 1UL << id;
+    m_write_due           = true;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t display_template_show(uint8_t id, const uint8_t * p_values, uint8_t length)
+{
+    const display_template_t * p_template;
+    uint8_t                    screen[LCD_ROWS][LCD_COLS];
+    uint8_t                    pos = 0;
+    uint8_t                    width;
+    uint8_t                    row;
+    uint8_t                    i;
+
+    if ((id >= DISPLAY_TEMPLATE_COUNT) || !(m_table.defined & (1UL << id)))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    p_template = &m_table.templates[id];
+
+    // The screen is put together first, so cells that keep their value are left alone.
+    memcpy(screen, p_template->text, sizeof(screen));
+    for (i = 0; i < DISPLAY_TEMPLATE_FIELDS; i++)
+    {
+        const display_template_field_t * p_field = &p_template->fields[i];
+
+        // Unused fields take no value. Fields off the screen are refused by display_template_define.
+        if ((p_field->width == 0) || (p_field->col >= LCD_COLS) || (p_field->row >= LCD_ROWS))
+        {
+            continue;
+        }
+        width = MIN(p_field->width, LCD_COLS - p_field->col);
+        template_field_format(p_field, width, p_values, length, &pos, &screen[p_field->row][p_field->col]);
+    }
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        rgb_lcd_write_at(0, row, screen[row], LCD_COLS);
+    }
+    return NRF_SUCCESS;
+}
+
+
+void display_template_process(void)
+{
+    uint32_t err_code;
+
+    if (!m_write_due || m_write_pending)
+    {
+        return;
+    }
+    m_write_due = false;
+
+    // pstorage reads m_table when the write executes. A change in between is written again by
+    // the next pass, its CRC keeps a torn table from being used after a reset.
+    m_table.version = TEMPLATE_VERSION;
+    m_table.crc     = table_crc(&m_table);
+
+    m_write_pending = true;
+    err_code = pstorage_clear(&m_base, sizeof(m_table));
+    APP_ERROR_CHECK(err_code);
+    err_code = pstorage_store(&m_base, (uint8_t *)&m_table, sizeof(m_table), 0);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+bool display_template_is_idle(void)
+{
+    return !m_write_due && !m_write_pending;
+}
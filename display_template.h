@@ -0,0 +1,96 @@
+/**@file
+ *
+ * @brief    Screen templates kept in flash and rendered by ID.
+ *
+ * @details  A template is a full screen of fixed text with up to DISPLAY_TEMPLATE_FIELDS fields
+ *           written over it. The client defines a template once; from then on a screen update
+ *           is the template ID and the packed field values, e.g. 5 bytes for "Done in 12 min"
+ *           instead of the whole text.
+ *
+ *           Values are packed in field order, each as its field type says:
+ *
+ *           | Type                      | Value                                         |
+ *           |---------------------------|-----------------------------------------------|
+ *           | DISPLAY_TEMPLATE_TEXT     | length, characters                            |
+ *           | DISPLAY_TEMPLATE_UINT8    | 1 byte                                        |
+ *           | DISPLAY_TEMPLATE_UINT16   | 2 bytes, little endian                        |
+ *
+ *           Fields without a value are blank. A number wider than its field shows as '#'s.
+ *
+ *           The screen is put together from the template and the values, then written with
+ *           @ref rgb_lcd_write_at, so only the cells that changed go to the display. The table
+ *           is kept in RAM and written to its flash page after every change.
+ */
+
+#ifndef DISPLAY_TEMPLATE_H__
+#define DISPLAY_TEMPLATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rgb_lcd.h"
+
+#define DISPLAY_TEMPLATE_COUNT          8                            /**< Number of template IDs, 0 based. */
+#define DISPLAY_TEMPLATE_FIELDS         4                            /**< Fields per template. */
+
+#define DISPLAY_TEMPLATE_TYPE_MASK      0x0F                         /**< Bits of the field format holding the @ref display_template_type_t. */
+#define DISPLAY_TEMPLATE_ALIGN_RIGHT    0x80                         /**< Field format flag, the value is right aligned. */
+#define DISPLAY_TEMPLATE_ZERO_PAD       0x40                         /**< Field format flag, a number is right aligned and padded with zeros. */
+
+/**@brief Field value types. */
+typedef enum
+{
+    DISPLAY_TEMPLATE_TEXT   = 0,
+    DISPLAY_TEMPLATE_UINT8  = 1,
+    DISPLAY_TEMPLATE_UINT16 = 2
+} display_template_type_t;
+
+/**@brief Field. */
+typedef struct
+{
+    uint8_t col;                                                     /**< Column of the first cell, 0 based, below LCD_COLS. */
+    uint8_t row;                                                     /**< Line, 0 based, below LCD_ROWS. */
+    uint8_t width;                                                   /**< Cells, 0 for an unused field. */
+    uint8_t format;                                                  /**< Value type or-ed with the format flags. */
+} display_template_field_t;
+
+/**@brief Template. */
+typedef struct
+{
+    uint8_t                  text[LCD_ROWS][LCD_COLS];               /**< Fixed text, line by line. */
+    display_template_field_t fields[DISPLAY_TEMPLATE_FIELDS];        /**< Fields, in the order of their values. */
+} display_template_t;
+
+/**@brief Function for initializing the module and reading the templates from flash.
+ *
+ * @details Requires the pstorage module to be initialized. Registers before the other pstorage
+ *          users, so their pages stay where they were before templates were added.
+ */
+void display_template_init(void);
+
+/**@brief Function for defining or redefining a template.
+ *
+ * @param[in] id          Template ID, below DISPLAY_TEMPLATE_COUNT.
+ * @param[in] p_template  Template, copied.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_INVALID_PARAM for an ID out of range or a used field (width
+ *         above 0) that starts off the screen. The template is left as it was in that case.
+ */
+uint32_t display_template_define(uint8_t id, const display_template_t * p_template);
+
+/**@brief Function for rendering a template into the frame.
+ *
+ * @param[in] id        Template ID.
+ * @param[in] p_values  Packed field values.
+ * @param[in] length    Length of the values.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NOT_FOUND for an undefined template.
+ */
+uint32_t display_template_show(uint8_t id, const uint8_t * p_values, uint8_t length);
+
+/**@brief Function for writing a changed table to flash. Called from the main loop. */
+void display_template_process(void);
+
+/**@brief Function for checking if the table in flash is up to date. */
+bool display_template_is_idle(void);
+
+#endif // DISPLAY_TEMPLATE_H__
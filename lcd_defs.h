@@ -18,7 +18,17 @@
 
 #define REG_MODE1       0x00
 #define REG_MODE2       0x01
+#define REG_PWM3        0x05
+#define REG_GRPPWM      0x06
+#define REG_GRPFREQ     0x07
 #define REG_OUTPUT      0x08
+#define REG_COUNT       0x09        // registers mirrored by the driver
+
+// control register flags
+#define RGB_AUTO_INCREMENT 0x80     // AI2: register address increments after each data byte
+#define RGB_MODE2_DMBLNK 0x20       // group control: 0 = dimming, 1 = blinking
+#define RGB_LEDOUT_PWM 0xAA         // all outputs driven by their PWMx register
+#define RGB_LEDOUT_PWM_GROUP 0xFF   // all outputs driven by PWMx and GRPPWM
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
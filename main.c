@@ -3,6 +3,7 @@
 #include "nordic_common.h"
 #include "nrf.h"
 #include "nrf51_bitfields.h"
+#include "nrf_delay.h"
 #include "ble_hci.h"
 #include "ble_advdata.h"
 #include "ble_conn_params.h"
@@ -10,15 +11,28 @@
 #include "app_timer.h"
 #include "app_button.h"
 #include "ble_nus.h"
-#include "simple_uart.h"
 #include "boards.h"
 #include "ble_error_log.h"
 #include "ble_debug_assert_handler.h"
 #include "app_util_platform.h"
 #include "app_gpiote.h"
 #include "app_trace.h"
-#include "twi_master.h"
+#include "twi_async.h"
 #include "lcd_defs.h"
+#include "rgb_lcd.h"
+#include "msg_ring.h"
+#include "rgb_fx.h"
+#include "display_proto.h"
+#include "uart_ring.h"
+#include "rgb_marquee.h"
+#include "display_store.h"
+#include "pstorage.h"
+#include "device_manager.h"
+#include "diag.h"
+#include "conn_adapt.h"
+#include "adv_status.h"
+#include "rgb_clock.h"
+#include "display_template.h"
 
 
 #define IS_SRVC_CHANGED_CHARACT_PRESENT 0                                           /**< Include or not the service_changed characteristic. if not enabled,
@@ -28,16 +42,26 @@
 
 #define APP_ADV_INTERVAL                64                                          /**< The advertising interval (in units of 0.625 ms. This value corresponds to 40 ms).*/
 #define APP_ADV_TIMEOUT_IN_SECONDS      180                                         /**< The advertising timeout (in units of seconds). */
+#define APP_ADV_WHITELIST_INTERVAL      32                                          /**< The advertising interval for whitelist advertising (in units of 0.625 ms. This value corresponds to 20 ms). */
+#define APP_ADV_WHITELIST_TIMEOUT       30                                          /**< The duration of whitelist advertising (in units of seconds). */
+#define APP_ADV_SLOW_INTERVAL           1636                                        /**< The advertising interval for slow advertising (in units of 0.625 ms. This value corresponds to 1022.5 ms). */
+#ifndef APP_ADV_SLOW_TIMEOUT
+#define APP_ADV_SLOW_TIMEOUT            0                                           /**< The duration of slow advertising (in units of seconds), 0 advertises until a central connects
+                                                                                      and keeps the display on, otherwise the device powers off after it. */
+#endif
 
 #define APP_TIMER_PRESCALER             0                                           /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS            2                                           /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS            11                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE         4                                           /**< Size of timer operation queues. */
 
-#define MIN_CONN_INTERVAL               16                                          /**< Minimum acceptable connection interval (20 ms),
+#define MIN_CONN_INTERVAL               12                                          /**< Minimum acceptable connection interval while the display is updated (15 ms),
                                                                                       Connection interval uses 1.25 ms units. */
-#define MAX_CONN_INTERVAL               60                                          /**< Maximum acceptable connection interval (75 ms),
+#define MAX_CONN_INTERVAL               24                                          /**< Maximum acceptable connection interval while the display is updated (30 ms),
                                                                                       Connection interval uses 1.25 ms units. */
-#define SLAVE_LATENCY                   0                                           /**< slave latency. */
+#define SLAVE_LATENCY                   0                                           /**< slave latency while the display is updated. */
+#define IDLE_MIN_CONN_INTERVAL          80                                          /**< Minimum acceptable connection interval while the display is left alone (100 ms). */
+#define IDLE_MAX_CONN_INTERVAL          160                                         /**< Maximum acceptable connection interval while the display is left alone (200 ms). */
+#define IDLE_SLAVE_LATENCY              4                                           /**< slave latency while the display is left alone, at most 1 s between radio events. */
 #define CONN_SUP_TIMEOUT                400                                         /**< Connection supervisory timeout (4 seconds), Supervision Timeout uses 10 ms units. */
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  /**< Time from initiating event (connect or start of notification)
                                                                                       to first time sd_ble_gap_conn_param_update is called (5 seconds). */
@@ -74,11 +98,45 @@
 
 #define ACTION_BUTTON_PIN                0
 #define WAKEUP_BUTTON_PIN                1
+#define BOND_DELETE_ALL_BUTTON_PIN       ACTION_BUTTON_PIN                           /**< Held at reset, deletes all bonds. Not the wakeup button, which is held to wake from system off. */
+
+#define DISPLAY_RING_SIZE                512                                         /**< Size of the display message ring (in bytes), must be a power of two. */
+#define DISPLAY_RING_RESERVE             8                                           /**< Ring space kept free for connection state messages when accepting NUS data. */
+
+#define UART_BAUDRATE                    UART_BAUDRATE_BAUDRATE_Baud38400            /**< UART baud rate. */
+
+/**@brief Messages passed from the SoftDevice event handler to the display task. */
+typedef enum
+{
+    DISPLAY_MSG_NUS_DATA,                                                            /**< Payload written to the NUS TX characteristic. */
+    DISPLAY_MSG_CONNECTED,                                                           /**< A central has connected. */
+    DISPLAY_MSG_DISCONNECTED,                                                        /**< The central has disconnected. */
+    DISPLAY_MSG_SLEEP                                                                /**< Advertising timed out, show the sleep screen and power off. */
+} display_msg_type_t;
+
+/**@brief Advertising stages, each one started when the previous one times out. */
+typedef enum
+{
+    BLE_NO_ADV,                                                                      /**< No advertising running. */
+    BLE_DIRECTED_ADV,                                                                /**< High duty cycle directed advertising to the bonded central. */
+    BLE_FAST_ADV_WHITELIST,                                                          /**< Fast advertising, connections from the bonded central only. */
+    BLE_FAST_ADV,                                                                    /**< Fast open advertising, while there is no bonded central. */
+    BLE_SLOW_ADV                                                                     /**< Slow open advertising. */
+} ble_advertising_mode_t;
 
 
-static ble_gap_sec_params_t             m_sec_params;                               /**< Security requirements for this application. */
 static uint16_t                         m_conn_handle = BLE_CONN_HANDLE_INVALID;    /**< Handle of the current connection. */
+static ble_advertising_mode_t           m_advertising_mode = BLE_NO_ADV;            /**< Advertising stage running. */
+static uint8_t                          m_adv_flags;                                /**< AD flags of the advertising data, kept for status updates. */
+static dm_application_instance_t        m_app_handle;                               /**< Application identifier allocated by the Device Manager. */
+static dm_handle_t                      m_bonded_peer_handle;                       /**< Bond of the central of the last connection, target of directed advertising. */
 static ble_nus_t                        m_nus;                                      /**< Structure to identify the Nordic UART Service. */
+static msg_ring_t                       m_display_ring;                             /**< Messages from the SoftDevice event handler to the display task. */
+static uint8_t                          m_display_ring_buf[DISPLAY_RING_SIZE];      /**< Storage for m_display_ring. */
+static volatile bool                    m_rx_pending;                               /**< A write is waiting in m_display_ring since m_rx_ticks. */
+static uint32_t                         m_rx_ticks;                                 /**< Receive time of the oldest write not yet rendered. */
+static bool                             m_render_active;                            /**< Display transfers of a render are in progress since m_render_ticks. */
+static uint32_t                         m_render_ticks;                             /**< Start time of the active render. */
 
 
 /**@brief     Error handler function, which is called when an error has occurred.
@@ -92,14 +150,6 @@ static ble_nus_t                        m_nus;
  */
 
 
-void rgb_lcd_default();
-void rgb_lcd_connected();
-void rgb_lcd_error();
-void rgb_lcd_sleep();
-void rgb_lcd_wash_open();
-void rgb_lcd_wash_closed();
-
-
 void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
 {
     for (;;) {
@@ -206,21 +256,29 @@ static void gap_params_init(void)
  *
  * @details Encodes the required advertising data and passes it to the stack.
  *          Also builds a structure to be passed to the stack when starting advertising.
+ *          The advertising data carries the status record of the adv_status module.
+ *
+ * @param[in] flags  AD flags, general discoverable for open advertising, not discoverable for
+ *                   advertising to the bonded central only.
  */
-static void advertising_init(void)
+static void advertising_init(uint8_t flags)
 {
-    uint32_t      err_code;
-    ble_advdata_t advdata;
-    ble_advdata_t scanrsp;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
+    uint32_t                 err_code;
+    ble_advdata_t            advdata;
+    ble_advdata_t            scanrsp;
+    ble_advdata_manuf_data_t manuf_data;
     
     ble_uuid_t adv_uuids[] = {{BLE_UUID_NUS_SERVICE, m_nus.uuid_type}};
 
+    m_adv_flags = flags;
+    adv_status_manuf_data_get(&manuf_data);
+
     memset(&advdata, 0, sizeof(advdata));
     advdata.name_type               = BLE_ADVDATA_FULL_NAME;
     advdata.include_appearance      = false;
-    advdata.flags.size              = sizeof(flags);
-    advdata.flags.p_data            = &flags;
+    advdata.flags.size              = sizeof(m_adv_flags);
+    advdata.flags.p_data            = &m_adv_flags;
+    advdata.p_manuf_specific_data   = &manuf_data;
 
     memset(&scanrsp, 0, sizeof(scanrsp));
     scanrsp.uuids_complete.uuid_cnt = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
@@ -231,16 +289,44 @@ static void advertising_init(void)
 }
 
 
+/**@brief Function for putting a changed status record in the advertising data, the running
+ *        advertising stage keeps going with it.
+ *
+ * @details Runs from the main loop, while advertising_start() sets the flags of the next stage
+ *          from the BLE event handler. The critical region keeps that from happening between
+ *          reading m_adv_flags and setting the data, which would advertise the new stage with
+ *          the flags of the old one.
+ */
+static void adv_status_update(void)
+{
+    CRITICAL_REGION_ENTER();
+    advertising_init(m_adv_flags);
+    CRITICAL_REGION_EXIT();
+}
+
+
 /**@brief    Function for handling the data from the Nordic UART Service.
  *
- * @details  This function will process the data received from the Nordic UART BLE Service and send
- *           it to the UART module.
+ * @details  This function will queue the data received from the Nordic UART BLE Service for the
+ *           display task.
  */
 /**@snippet [Handling the data received over BLE] */
-void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length);
+uint32_t nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length);
 /**@snippet [Handling the data received over BLE] */
 
 
+/**@brief   Function for passing a connection state message to the display task.
+ *
+ * @details Called from the SoftDevice event handler. NUS data never fills the last
+ *          DISPLAY_RING_RESERVE bytes of the ring, so these messages always fit.
+ */
+static void display_post(display_msg_type_t type)
+{
+    uint32_t err_code = msg_ring_put(&m_display_ring, type, NULL, 0);
+    APP_ERROR_CHECK(err_code);
+}
+
+
 /**@brief Function for initializing services that will be used by the application.
  */
 static void services_init(void)
@@ -250,24 +336,90 @@ static void services_init(void)
     
     memset(&nus_init, 0, sizeof(nus_init));
 
-    nus_init.data_handler = nus_data_handler;
+    nus_init.data_handler  = nus_data_handler;
+    nus_init.p_diag_data   = (const uint8_t *)diag_data_get();
+    nus_init.diag_data_len = sizeof(diag_data_t);
     
     err_code = ble_nus_init(&m_nus, &nus_init);
     APP_ERROR_CHECK(err_code);
 }
 
 
-/**@brief Function for initializing security parameters.
+/**@brief Function for handling the Device Manager events.
+ *
+ * @details The central of a connection becomes the target of directed advertising once it has
+ *          bonded, or encrypted the link with its bond.
+ *
+ * @param[in] p_handle      Device the event is about.
+ * @param[in] p_event       Device Manager event.
+ * @param[in] event_result  Result of the procedure the event reports.
+ */
+static api_result_t device_manager_evt_handler(dm_handle_t const * p_handle,
+                                               dm_event_t const  * p_event,
+                                               api_result_t        event_result)
+{
+    switch (p_event->event_id)
+    {
+        case DM_EVT_CONNECTION:
+            (void)dm_handle_initialize(&m_bonded_peer_handle);
+            break;
+
+        case DM_EVT_SECURITY_SETUP_COMPLETE:
+        case DM_EVT_LINK_SECURED:
+            // A central that fails to pair stays unbonded and may try again.
+            if (event_result == NRF_SUCCESS)
+            {
+                m_bonded_peer_handle = *p_handle;
+            }
+            break;
+
+        default:
+            APP_ERROR_CHECK(event_result);
+            break;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for initializing the Device Manager.
+ *
+ * @details Bonds and the system attributes of each bonded central are kept in flash, so a central
+ *          that reconnects after a reset only has to encrypt the link to get its notifications
+ *          back. Holding the bond delete button at reset deletes all bonds.
+ *
+ *          Called after storage_init(), which initializes pstorage and lets the templates and
+ *          the display store take the first pages, and after buttons_init(), which enables the
+ *          button pull-up.
  */
-static void sec_params_init(void)
+static void device_manager_init(void)
 {
-    m_sec_params.timeout      = SEC_PARAM_TIMEOUT;
-    m_sec_params.bond         = SEC_PARAM_BOND;
-    m_sec_params.mitm         = SEC_PARAM_MITM;
-    m_sec_params.io_caps      = SEC_PARAM_IO_CAPABILITIES;
-    m_sec_params.oob          = SEC_PARAM_OOB;  
-    m_sec_params.min_key_size = SEC_PARAM_MIN_KEY_SIZE;
-    m_sec_params.max_key_size = SEC_PARAM_MAX_KEY_SIZE;
+    uint32_t               err_code;
+    dm_init_param_t        init_data;
+    dm_application_param_t register_param;
+
+    init_data.clear_persistent_data = (nrf_gpio_pin_read(BOND_DELETE_ALL_BUTTON_PIN) == 0);
+
+    err_code = dm_init(&init_data);
+    APP_ERROR_CHECK(err_code);
+
+    memset(&register_param.sec_param, 0, sizeof(ble_gap_sec_params_t));
+
+    register_param.sec_param.timeout      = SEC_PARAM_TIMEOUT;
+    register_param.sec_param.bond         = SEC_PARAM_BOND;
+    register_param.sec_param.mitm         = SEC_PARAM_MITM;
+    register_param.sec_param.io_caps      = SEC_PARAM_IO_CAPABILITIES;
+    register_param.sec_param.oob          = SEC_PARAM_OOB;
+    register_param.sec_param.min_key_size = SEC_PARAM_MIN_KEY_SIZE;
+    register_param.sec_param.max_key_size = SEC_PARAM_MAX_KEY_SIZE;
+    register_param.evt_handler            = device_manager_evt_handler;
+    register_param.service_type           = DM_PROTOCOL_CNTXT_GATT_SRVR_ID;
+
+    err_code = dm_register(&m_app_handle, &register_param);
+    APP_ERROR_CHECK(err_code);
+
+    // The central of the last connection before the reset is not known.
+    (void)dm_handle_initialize(&m_bonded_peer_handle);
 }
 
 
@@ -276,9 +428,10 @@ static void sec_params_init(void)
  * @details     This function will be called for all events in the Connection Parameters Module
  *              which are passed to the application.
  *
- * @note        All this function does is to disconnect. This could have been done by simply setting
- *              the disconnect_on_fail config parameter, but instead we use the event handler
- *              mechanism to demonstrate its use.
+ * @note        The Connection Parameters Module also negotiates the parameter sets conn_adapt
+ *              picks for the display write rate. When a negotiation fails, the link is dropped
+ *              only if the active set was refused. A central refusing the optional idle set keeps
+ *              the connection, so disconnect_on_fail cannot be used.
  *
  * @param[in]   p_evt   Event received from the Connection Parameters Module.
  */
@@ -286,7 +439,8 @@ static void on_conn_params_evt(ble_conn_params_evt_t * p_evt)
 {
     uint32_t err_code;
     
-    if(p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED)
+    // A central refusing the idle parameters keeps the connection as it is.
+    if((p_evt->evt_type == BLE_CONN_PARAMS_EVT_FAILED) && !conn_adapt_is_idle())
     {
         err_code = sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_CONN_INTERVAL_UNACCEPTABLE);
         APP_ERROR_CHECK(err_code);
@@ -310,6 +464,7 @@ static void conn_params_init(void)
 {
     uint32_t               err_code;
     ble_conn_params_init_t cp_init;
+    conn_adapt_init_t      adapt_init;
     
     memset(&cp_init, 0, sizeof(cp_init));
 
@@ -324,106 +479,193 @@ static void conn_params_init(void)
     
     err_code = ble_conn_params_init(&cp_init);
     APP_ERROR_CHECK(err_code);
+
+    memset(&adapt_init, 0, sizeof(adapt_init));
+
+    adapt_init.active_params.min_conn_interval = MIN_CONN_INTERVAL;
+    adapt_init.active_params.max_conn_interval = MAX_CONN_INTERVAL;
+    adapt_init.active_params.slave_latency     = SLAVE_LATENCY;
+    adapt_init.active_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+    adapt_init.idle_params.min_conn_interval   = IDLE_MIN_CONN_INTERVAL;
+    adapt_init.idle_params.max_conn_interval   = IDLE_MAX_CONN_INTERVAL;
+    adapt_init.idle_params.slave_latency       = IDLE_SLAVE_LATENCY;
+    adapt_init.idle_params.conn_sup_timeout    = CONN_SUP_TIMEOUT;
+
+    conn_adapt_init(&adapt_init);
 }
 
 
-/**@brief Function for starting advertising.
+/**@brief Function for clearing the advertising stage LEDs. */
+static void advertising_leds_clear(void)
+{
+    nrf_gpio_pin_clear(ADVERTISING_LED_PIN_NO);
+    nrf_gpio_pin_clear(ADV_DIRECTED_LED_PIN_NO);
+    nrf_gpio_pin_clear(ADV_WHITELIST_LED_PIN_NO);
+    nrf_gpio_pin_clear(ADV_INTERVAL_SLOW_LED_PIN_NO);
+}
+
+
+/**@brief Function for starting an advertising stage.
+ *
+ * @details Directed advertising needs the central of the last connection to be bonded, else the
+ *          whitelist stage starts. That takes every bonded central, without any it is replaced by
+ *          fast open advertising.
+ *
+ * @param[in] mode  Stage to start.
  */
-static void advertising_start(void)
+static void advertising_start(ble_advertising_mode_t mode)
 {
     uint32_t             err_code;
     ble_gap_adv_params_t adv_params;
+    ble_gap_addr_t       peer_addr;
+    ble_gap_whitelist_t  whitelist;
+    ble_gap_addr_t *     p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+    ble_gap_irk_t *      p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
     
-    // Start advertising
+    if ((mode == BLE_DIRECTED_ADV) && (dm_peer_addr_get(&m_bonded_peer_handle, &peer_addr) != NRF_SUCCESS))
+    {
+        mode = BLE_FAST_ADV_WHITELIST;
+    }
+    if (mode == BLE_FAST_ADV_WHITELIST)
+    {
+        // A central with an IRK is taken by it, it may connect from a resolvable private address.
+        whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+        whitelist.irk_count  = BLE_GAP_WHITELIST_IRK_MAX_COUNT;
+        whitelist.pp_addrs   = p_whitelist_addr;
+        whitelist.pp_irks    = p_whitelist_irk;
+
+        err_code = dm_whitelist_create(&m_app_handle, &whitelist);
+        APP_ERROR_CHECK(err_code);
+
+        if ((whitelist.addr_count == 0) && (whitelist.irk_count == 0))
+        {
+            mode = BLE_FAST_ADV;
+        }
+    }
+
+    // Initialize advertising parameters with default values
     memset(&adv_params, 0, sizeof(adv_params));
     
     adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
     adv_params.p_peer_addr = NULL;
     adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-    adv_params.interval    = APP_ADV_INTERVAL;
-    adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
+    adv_params.p_whitelist = NULL;
+
+    advertising_leds_clear();
+
+    switch (mode)
+    {
+        case BLE_DIRECTED_ADV:
+            // High duty cycle, the SoftDevice ends it after 1.28 s.
+            adv_params.type        = BLE_GAP_ADV_TYPE_ADV_DIRECT_IND;
+            adv_params.p_peer_addr = &peer_addr;
+            adv_params.timeout     = 0;
+
+            nrf_gpio_pin_set(ADV_DIRECTED_LED_PIN_NO);
+            break;
+
+        case BLE_FAST_ADV_WHITELIST:
+            advertising_init(BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED);
+
+            adv_params.fp          = BLE_GAP_ADV_FP_FILTER_CONNREQ;
+            adv_params.p_whitelist = &whitelist;
+            adv_params.interval    = APP_ADV_WHITELIST_INTERVAL;
+            adv_params.timeout     = APP_ADV_WHITELIST_TIMEOUT;
+
+            nrf_gpio_pin_set(ADV_WHITELIST_LED_PIN_NO);
+            break;
+
+        case BLE_FAST_ADV:
+            advertising_init(BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE);
+
+            adv_params.interval    = APP_ADV_INTERVAL;
+            adv_params.timeout     = APP_ADV_TIMEOUT_IN_SECONDS;
+            break;
+
+        case BLE_SLOW_ADV:
+            advertising_init(BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE);
+
+            adv_params.interval    = APP_ADV_SLOW_INTERVAL;
+            adv_params.timeout     = APP_ADV_SLOW_TIMEOUT;
+
+            nrf_gpio_pin_set(ADV_INTERVAL_SLOW_LED_PIN_NO);
+            break;
+
+        default:
+            // No implementation needed.
+            return;
+    }
 
     err_code = sd_ble_gap_adv_start(&adv_params);
     APP_ERROR_CHECK(err_code);
 
+    m_advertising_mode = mode;
     nrf_gpio_pin_set(ADVERTISING_LED_PIN_NO);
 }
 
 
+/**@brief Function for handling the end of an advertising stage.
+ *
+ * @details Directed advertising falls back to whitelist advertising, every other stage to slow
+ *          open advertising. The device only powers off when slow advertising has a timeout.
+ */
+static void advertising_timeout(void)
+{
+    ble_advertising_mode_t mode = m_advertising_mode;
+
+    advertising_leds_clear();
+    m_advertising_mode = BLE_NO_ADV;
+
+    switch (mode)
+    {
+        case BLE_DIRECTED_ADV:
+            advertising_start(BLE_FAST_ADV_WHITELIST);
+            break;
+
+        case BLE_FAST_ADV_WHITELIST:
+        case BLE_FAST_ADV:
+            advertising_start(BLE_SLOW_ADV);
+            break;
+
+        default:
+            // The display task powers off once the sleep screen is out.
+            display_post(DISPLAY_MSG_SLEEP);
+            break;
+    }
+}
+
+
 /**@brief       Function for the Application's S110 SoftDevice event handler.
  *
  * @param[in]   p_ble_evt   S110 SoftDevice event.
  */
 static void on_ble_evt(ble_evt_t * p_ble_evt)
 {
-    uint32_t                         err_code;
-    static ble_gap_evt_auth_status_t m_auth_status;
-    ble_gap_enc_info_t *             p_enc_info;
-    
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
-            rgb_lcd_connected();
+            display_post(DISPLAY_MSG_CONNECTED);
             nrf_gpio_pin_set(CONNECTED_LED_PIN_NO);
-            nrf_gpio_pin_clear(ADVERTISING_LED_PIN_NO);
-            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            advertising_leds_clear();
+            m_advertising_mode = BLE_NO_ADV;
+            m_conn_handle      = p_ble_evt->evt.gap_evt.conn_handle;
 
             break;
             
         case BLE_GAP_EVT_DISCONNECTED:
-            rgb_lcd_default();
+            display_post(DISPLAY_MSG_DISCONNECTED);
             nrf_gpio_pin_clear(CONNECTED_LED_PIN_NO);
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
 
-            advertising_start();
+            // A bonded central that lost the link is back within the directed stage.
+            advertising_start(BLE_DIRECTED_ADV);
 
             break;
-            
-        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
-            err_code = sd_ble_gap_sec_params_reply(m_conn_handle, 
-                                                   BLE_GAP_SEC_STATUS_SUCCESS, 
-                                                   &m_sec_params);
-            APP_ERROR_CHECK(err_code);
-            break;
-            
-        case BLE_GATTS_EVT_SYS_ATTR_MISSING:
-            err_code = sd_ble_gatts_sys_attr_set(m_conn_handle, NULL, 0);
-            APP_ERROR_CHECK(err_code);
-            break;
-
-        case BLE_GAP_EVT_AUTH_STATUS:
-            m_auth_status = p_ble_evt->evt.gap_evt.params.auth_status;
-            break;
-            
-        case BLE_GAP_EVT_SEC_INFO_REQUEST:
-            p_enc_info = &m_auth_status.periph_keys.enc_info;
-            if (p_enc_info->div == p_ble_evt->evt.gap_evt.params.sec_info_request.div)
-            {
-                err_code = sd_ble_gap_sec_info_reply(m_conn_handle, p_enc_info, NULL);
-                APP_ERROR_CHECK(err_code);
-            }
-            else
-            {
-                // No keys found for this device
-                err_code = sd_ble_gap_sec_info_reply(m_conn_handle, NULL, NULL);
-                APP_ERROR_CHECK(err_code);
-            }
-            break;
 
         case BLE_GAP_EVT_TIMEOUT:
             if (p_ble_evt->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT)
             { 
-                rgb_lcd_sleep();
-                nrf_gpio_pin_clear(ADVERTISING_LED_PIN_NO);
-
-                // Configure buttons with sense level low as wakeup source.
-                nrf_gpio_cfg_sense_input(WAKEUP_BUTTON_PIN,
-                                         BUTTON_PULL,
-                                         NRF_GPIO_PIN_SENSE_LOW);
-                
-                // Go to system-off mode (this function will not return; wakeup will cause a reset)
-                err_code = sd_power_system_off();    
-                APP_ERROR_CHECK(err_code);
+                advertising_timeout();
             }
             break;
 
@@ -444,12 +686,28 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
  */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
+    // First, the system attributes it restores are seen by the services.
+    dm_ble_evt_handler(p_ble_evt);
     ble_conn_params_on_ble_evt(p_ble_evt);
+    conn_adapt_on_ble_evt(p_ble_evt);
     ble_nus_on_ble_evt(&m_nus, p_ble_evt);
     on_ble_evt(p_ble_evt);
 }
 
 
+/**@brief   Function for dispatching a system event to interested modules.
+ *
+ * @details This function is called from the System event interrupt handler after a system
+ *          event has been received.
+ *
+ * @param[in]   sys_evt   System event.
+ */
+static void sys_evt_dispatch(uint32_t sys_evt)
+{
+    pstorage_sys_event_handler(sys_evt);
+}
+
+
 /**@brief   Function for the S110 SoftDevice initialization.
  *
  * @details This function initializes the S110 SoftDevice and the BLE event interrupt.
@@ -471,6 +729,23 @@ static void ble_stack_init(void)
     // Subscribe for BLE events.
     err_code = softdevice_ble_evt_handler_set(ble_evt_dispatch);
     APP_ERROR_CHECK(err_code);
+
+    // Subscribe for system events.
+    err_code = softdevice_sys_evt_handler_set(sys_evt_dispatch);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief   Function for initializing persistent storage and finding the saved templates and
+ *          display contents.
+ */
+static void storage_init(void)
+{
+    uint32_t err_code = pstorage_init();
+    APP_ERROR_CHECK(err_code);
+
+    display_template_init();
+    display_store_init();
 }
 
 
@@ -485,8 +760,19 @@ static void button_event_handler(uint8_t pin_no, uint8_t button_action)
 
 
                 static char *data_array = "swag\r\n";
-                uint32_t err_code = ble_nus_send_string(&m_nus, data_array, strlen(data_array));
-                if (err_code != NRF_ERROR_INVALID_STATE)
+                uint32_t err_code;
+
+                // Queued behind the UART data like a line of its own, see uart_process().
+                CRITICAL_REGION_ENTER();
+                err_code = ble_nus_tx_put(&m_nus, (uint8_t *)data_array, strlen(data_array));
+                if (err_code == NRF_SUCCESS)
+                {
+                    ble_nus_tx_flush(&m_nus);
+                }
+                CRITICAL_REGION_EXIT();
+
+                // Dropped if the queue is full or no peer has notifications enabled.
+                if ((err_code != NRF_ERROR_NO_MEM) && (err_code != NRF_ERROR_INVALID_STATE))
                 {
                     APP_ERROR_CHECK(err_code);
                 }
@@ -536,277 +822,281 @@ static void power_manage(void)
 static void uart_init(void)
 {
     /**@snippet [UART Initialization] */
-    simple_uart_config(RTS_PIN_NUMBER, TX_PIN_NUMBER, CTS_PIN_NUMBER, RX_PIN_NUMBER, false);
-    
-    NRF_UART0->INTENSET = UART_INTENSET_RXDRDY_Enabled << UART_INTENSET_RXDRDY_Pos;
-    
-    NVIC_SetPriority(UART0_IRQn, APP_IRQ_PRIORITY_LOW);
-    NVIC_EnableIRQ(UART0_IRQn);
+    uint32_t err_code = uart_ring_init(RTS_PIN_NUMBER,
+                                       TX_PIN_NUMBER,
+                                       CTS_PIN_NUMBER,
+                                       RX_PIN_NUMBER,
+                                       UART_BAUDRATE,
+                                       true);
+    APP_ERROR_CHECK(err_code);
     /**@snippet [UART Initialization] */
 }
 
 
-/**@brief   Function for handling UART interrupts.
+/**@brief   Function for the UART task.
  *
- * @details This function will receive a single character from the UART and append it to a string.
- *          The string will be be sent over BLE when the last character received was a 'new line'
- *          i.e '\n' (hex 0x0D) or if the string has reached a length of @ref NUS_MAX_DATA_LENGTH.
+ * @details Runs from the main loop. Moves received UART data to the Nordic UART Service
+ *          notification queue in batches, and flushes the queue when a batch contains a 'new line'
+ *          i.e '\n' (hex 0x0A) or the sender has gone quiet. While the queue is full the data stays in the UART ring; once that
+ *          fills up, hardware flow control stops the sender. The next BLE_EVT_TX_COMPLETE wakes
+ *          the main loop to continue.
  */
-void UART0_IRQHandler(void)
+static void uart_process(void)
 {
-    static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
-    static uint8_t index = 0;
-    uint32_t err_code;
+    uint8_t data[BLE_NUS_MAX_DATA_LEN];
 
     /**@snippet [Handling the data received over UART] */
+    while (uart_ring_rx_ready())
+    {
+        uint16_t space;
+        uint16_t length;
+        uint32_t err_code;
 
-    data_array[index] = simple_uart_get();
-    index++;
+        CRITICAL_REGION_ENTER();
+        space = ble_nus_tx_free(&m_nus);
+        CRITICAL_REGION_EXIT();
 
-    if ((data_array[index - 1] == '\n') || (index >= (BLE_NUS_MAX_DATA_LEN - 1)))
-    {
-        err_code = ble_nus_send_string(&m_nus, data_array, index + 1);
-        if (err_code != NRF_ERROR_INVALID_STATE)
+        if (space == 0)
         {
-            APP_ERROR_CHECK(err_code);
+            return;
         }
-        
-        index = 0;
-    }
-
-    /**@snippet [Handling the data received over UART] */
-}
-
-
-
 
+        length = uart_ring_read(data, MIN(space, sizeof(data)));
 
+        // The queue is shared with the BLE event handler.
+        CRITICAL_REGION_ENTER();
+        err_code = ble_nus_tx_put(&m_nus, data, length);
+        if ((err_code == NRF_SUCCESS) &&
+            ((memchr(data, '\n', length) != NULL) || uart_ring_rx_idle()))
+        {
+            ble_nus_tx_flush(&m_nus);
+        }
+        CRITICAL_REGION_EXIT();
 
-void rgb_lcd_command(uint8_t value)
-{
-    unsigned char dta[2] = {0x80, value};
-    twi_master_transfer (LCD_ADDRESS, dta, 2, true);
+        // Without a peer with notifications enabled the data is dropped.
+        if (err_code != NRF_SUCCESS)
+        {
+            diag_add(DIAG_CNT_UART_DROPPED, length);
+        }
+    }
+    /**@snippet [Handling the data received over UART] */
 }
 
-// send data
-size_t rgb_lcd_write(uint8_t value)
-{
-
-    unsigned char dta[2] = {0x40, value};
-// ardunio:    i2c_send_byteS(dta, 2);
-    twi_master_transfer (LCD_ADDRESS, dta, 2, true);
-    return 1; // assume sucess
-}
 
-void rgb_lcd_setReg(unsigned char addr, unsigned char value)
+void twi_init()
 {
-    unsigned char dta[2] = {addr, value};
-    twi_master_transfer (RGB_ADDRESS, dta, 2, true);
-//    Wire.beginTransmission(RGB_ADDRESS); // transmit to device #4
-//    Wire.write(addr);
-//    Wire.write(dta);
-//    Wire.endTransmission();    // stop transmitting
-}
+    uint32_t err_code = twi_async_init();
+    APP_ERROR_CHECK(err_code);
 
-void rgb_lcd_setRGB(unsigned char r, unsigned char g, unsigned char b)
-{
-    rgb_lcd_setReg(REG_RED,   r);
-    rgb_lcd_setReg(REG_GREEN, g);
-    rgb_lcd_setReg(REG_BLUE,  b);
+    rgb_lcd_begin(display_store_restored());
+    rgb_fx_init();
+    rgb_marquee_init();
+    rgb_clock_init();
 }
 
-const unsigned char color_define[4][3] =
-{
-    {255, 255, 255},             // white
-    {255, 0,   0},               // red
-    {0,   255, 0},               // green
-    {0,   0,   255},             // blue
-    {0,   255, 255},             // yellow
-};
-
-void rgb_lcd_setColor(unsigned char color)
+uint32_t nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length)
 {
-    if(color > 3)return ;
-    rgb_lcd_setRGB(color_define[color][0], color_define[color][1], color_define[color][2]);
-}
-
+    uint32_t err_code;
 
-uint8_t _displayfunction;
-uint8_t _displaycontrol;
-uint8_t _displaymode;
+    nrf_gpio_pin_toggle(CONNECTED_LED_PIN_NO);
 
-uint8_t _initialized;
+    err_code = display_proto_check(p_data, length);
+    if (err_code != NRF_SUCCESS)
+    {
+        diag_count(DIAG_CNT_WRITES_REJECTED);
+        return err_code;
+    }
 
-uint8_t _numlines,_currline;
+    // Reject what does not fit, the peer gets an error response and can retry.
+    if ((length > UINT8_MAX) ||
+        (msg_ring_free(&m_display_ring) < MSG_RING_HEADER_LEN + length + DISPLAY_RING_RESERVE))
+    {
+        diag_count(DIAG_CNT_WRITES_REJECTED);
+        return NRF_ERROR_NO_MEM;
+    }
+    err_code = msg_ring_put(&m_display_ring, DISPLAY_MSG_NUS_DATA, p_data, length);
+    if (err_code != NRF_SUCCESS)
+    {
+        diag_count(DIAG_CNT_WRITES_REJECTED);
+        return err_code;
+    }
 
-void rgb_lcd_display()
-{
-    _displaycontrol |= LCD_DISPLAYON;
-    rgb_lcd_command(LCD_DISPLAYCONTROL | _displaycontrol);
+    diag_count(DIAG_CNT_WRITES);
+    conn_adapt_on_write();
+    diag_high_water(DIAG_HWM_DISPLAY_RING, sizeof(m_display_ring_buf) - msg_ring_free(&m_display_ring));
+    if (!m_rx_pending)
+    {
+        m_rx_ticks   = diag_ticks();
+        m_rx_pending = true;
+    }
+    return NRF_SUCCESS;
 }
 
-void rgb_lcd_clear()
-{
-    rgb_lcd_command(LCD_CLEARDISPLAY);
-}
 
-void rgb_lcd_home()
+/**@brief  Function for entering system-off mode once the display transfers are done. */
+static void display_sleep(void)
 {
-    rgb_lcd_command(LCD_RETURNHOME);
-    nrf_delay_ms(2);
-}
+    uint32_t err_code;
 
-void rgb_set_cursor(uint8_t col, uint8_t row)
-{
-    col = (row == 0 ? col | 0x80 : col | 0xc0);
-    unsigned char dta[2] = {0x80, col};
-    twi_master_transfer (LCD_ADDRESS, dta, 2, true);
-}
+    // Save the screen before it is replaced by the sleep screen, it is shown again on wakeup. The
+    // record is only taken once an earlier one still being written is done, so wait for both
+    // before the sleep screen goes into the frame.
+    rgb_lcd_commit();
+    display_store_flush();
+    while (!display_store_is_idle())
+    {
+        power_manage();
+        display_store_process();
+    }
 
+    rgb_marquee_stop();
+    rgb_lcd_sleep();
+    while (!rgb_lcd_is_idle() || !display_template_is_idle())
+    {
+        // Let the sleep screen reach the display and the templates reach flash.
+        power_manage();
+        rgb_lcd_flush();
+        display_template_process();
+    }
 
-void rgb_lcd_default()
-{
-    rgb_lcd_setRGB(0, 232, 181);
-}
-void rgb_lcd_connected()
-{
-    rgb_lcd_setRGB(0, 232, 181);
-    rgb_lcd_clear();
-}
-void rgb_lcd_sleep()
-{
-    rgb_lcd_setRGB(230, 0, 233);
-    rgb_lcd_clear();
-    rgb_lcd_write('z');
-    rgb_lcd_write('Z');
-    rgb_lcd_write('z');
-    rgb_lcd_write('Z');
-}
-void rgb_lcd_error()
-{
-    rgb_lcd_setRGB(232, 207, 0);
-    rgb_lcd_clear();
-    rgb_lcd_write('E');
-    rgb_lcd_write('R');
-    rgb_lcd_write('R');
-}
+    // Configure buttons with sense level low as wakeup source.
+    nrf_gpio_cfg_sense_input(WAKEUP_BUTTON_PIN,
+                             BUTTON_PULL,
+                             NRF_GPIO_PIN_SENSE_LOW);
 
-void rgb_lcd_wash_open()
-{
-    rgb_lcd_setRGB(71, 233, 0);
+    // Go to system-off mode (this function will not return; wakeup will cause a reset)
+    err_code = sd_power_system_off();
+    APP_ERROR_CHECK(err_code);
 }
 
-void rgb_lcd_wash_closed()
-{
-    rgb_lcd_setRGB(233, 0, 0);
-}
 
-void rgb_lcd_begin()
+/**@brief   Function for starting the latency measurement of a render, on its first write.
+ *
+ * @details Writes arriving while a render is in progress are part of the next one, their queue
+ *          time runs until they are drained.
+ */
+static void display_render_start(void)
 {
-    _displayfunction = LCD_2LINE;
-    nrf_delay_ms(50);
-    rgb_lcd_command(LCD_FUNCTIONSET | _displayfunction);
-    nrf_delay_ms(5);
-    rgb_lcd_command(LCD_FUNCTIONSET | _displayfunction);
-    nrf_delay_ms(2);
-    rgb_lcd_command(LCD_FUNCTIONSET | _displayfunction);
-    rgb_lcd_command(LCD_FUNCTIONSET | _displayfunction);
-
-    _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
-    rgb_lcd_display();
-
-    rgb_lcd_clear();
-    nrf_delay_ms(2);
-
-    _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-    rgb_lcd_command(LCD_ENTRYMODESET | _displaymode);
-
-    rgb_lcd_setReg(0, 0);
-    rgb_lcd_setReg(1, 0);
-    rgb_lcd_setReg(0x08, 0xAA);
-
-    nrf_delay_ms(1);
-    rgb_lcd_default();
-
-    nrf_delay_ms(1);
+    if (m_render_active)
+    {
+        return;
+    }
+    m_render_active = true;
+    m_render_ticks  = diag_ticks();
 
-    rgb_lcd_write('O');
-    rgb_lcd_write('K');
+    // m_rx_pending is set by the SoftDevice event handler.
+    CRITICAL_REGION_ENTER();
+    if (m_rx_pending)
+    {
+        diag_record(DIAG_HIST_QUEUE, m_rx_ticks);
+        m_rx_pending = false;
+    }
+    CRITICAL_REGION_EXIT();
 }
 
 
-void rgb_lcd_print()
+/**@brief  Function for ending the latency measurement of a render once its transfers are done. */
+static void display_render_check(void)
 {
-
+    if (m_render_active && rgb_lcd_is_idle())
+    {
+        diag_record(DIAG_HIST_RENDER, m_render_ticks);
+        diag_count(DIAG_CNT_RENDERS);
+        m_render_active = false;
+    }
 }
 
 
-
-void twi_init()
+/**@brief   Function for the display task.
+ *
+ * @details Runs from the main loop. Drains the display message ring, then pushes all resulting
+ *          changes to the display in one flush.
+ */
+static void display_process(void)
 {
-    if (!twi_master_init()) {
-        APP_ERROR_CHECK(1);
-    }
+    uint8_t type;
+    uint8_t length;
+    uint8_t data[UINT8_MAX];
 
+    while (msg_ring_get(&m_display_ring, &type, data, &length) == NRF_SUCCESS)
+    {
+        switch (type)
+        {
+            case DISPLAY_MSG_NUS_DATA:
+                display_render_start();
+                (void)display_proto_process(data, length);
+                display_store_touch();
+                adv_status_touch();
+                break;
 
-    char data[1];
-    data[0] = LCD_DISPLAYON;
+            case DISPLAY_MSG_CONNECTED:
+                rgb_marquee_stop();
+                rgb_lcd_connected();
+                adv_status_touch();
+                break;
 
-    rgb_lcd_begin();
+            case DISPLAY_MSG_DISCONNECTED:
+                // A composition the client has not committed would hold the display forever.
+                rgb_lcd_commit();
+                rgb_lcd_default();
+                adv_status_touch();
+                break;
 
-   // nrf_gpio_pin_set(CONNECTED_LED_PIN_NO);
-}
+            case DISPLAY_MSG_SLEEP:
+                display_sleep();
+                break;
 
-void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length)
-{
-    nrf_gpio_pin_toggle(CONNECTED_LED_PIN_NO);
-    for (int i = 0; i < length; i++)
-    {
-        if (p_data[i] == 1) {
-            rgb_lcd_clear();
-        } else if (p_data[i] == 2) {
-            rgb_set_cursor(0, 0);
-        } else if (p_data[i] == 3) {
-            rgb_set_cursor(0, 1);
-        } else if (p_data[i] == 4) {
-            rgb_lcd_setColor(0);
-        } else if (p_data[i] == 5) {
-            rgb_lcd_setColor(1);
-        } else if (p_data[i] == 6) {
-            rgb_lcd_wash_open();
-        } else if (p_data[i] == 7) {
-            rgb_lcd_wash_closed();
-        } else {
-            rgb_lcd_write(p_data[i]);
+            default:
+                // No implementation needed.
+                break;
         }
     }
+
+    rgb_fx_process();
+    rgb_marquee_process();
+    rgb_clock_process();
+    rgb_lcd_flush();
+    display_store_process();
+    display_template_process();
+    adv_status_process();
+    display_render_check();
 }
 
 /**@brief  Application main function.
  */
 int main(void)
 {
+    uint32_t err_code;
+
     // Initialize
+    err_code = msg_ring_init(&m_display_ring, m_display_ring_buf, sizeof(m_display_ring_buf));
+    APP_ERROR_CHECK(err_code);
+
     app_trace_init();
     leds_init();
     timers_init();
+    diag_init();
     gpiote_init();
     buttons_init();
     uart_init();
     ble_stack_init();
+    storage_init();
+    device_manager_init();
     gap_params_init();
     services_init();
-    advertising_init();
+    adv_status_init(adv_status_update);
+    advertising_init(BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE);
     conn_params_init();
-    sec_params_init();
     twi_init();
 
-    advertising_start();
+    advertising_start(BLE_DIRECTED_ADV);
 
     // Enter main loop
     for (;;)
     {
-         power_manage();
+        uart_process();
+        display_process();
+        power_manage();
         //simple_uart_put('L');
         //simple_uart_put('X');
     }
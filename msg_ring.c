@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "nrf.h"
+#include "msg_ring.h"
+
+
+/**@brief Function for copying into the ring, wrapping at the end of the buffer. */
+static void ring_write(msg_ring_t * p_ring, uint16_t pos, const uint8_t * p_data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        p_ring->p_buf[(pos + i) & p_ring->size_mask] = p_data[i];
+    }
+}
+
+
+/**@brief Function for copying out of the ring, wrapping at the end of the buffer. */
+static void ring_read(const msg_ring_t * p_ring, uint16_t pos, uint8_t * p_data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        p_data[i] = p_ring->p_buf[(pos + i) & p_ring->size_mask];
+    }
+}
+
+
+uint32_t msg_ring_init(msg_ring_t * p_ring, uint8_t * p_buf, uint16_t size)
+{
+    if (!IS_POWER_OF_TWO(size))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    p_ring->p_buf     = p_buf;
+    p_ring->size_mask = size - 1;
+    p_ring->write_pos = 0;
+    p_ring->read_pos  = 0;
+
+    return NRF_SUCCESS;
+}
+
+
+uint16_t msg_ring_free(const msg_ring_t * p_ring)
+{
+    return (uint16_t)(p_ring->size_mask + 1 - (uint16_t)(p_ring->write_pos - p_ring->read_pos));
+}
+
+
+uint32_t msg_ring_put(msg_ring_t * p_ring, uint8_t type, const uint8_t * p_data, uint8_t length)
+{
+    uint16_t pos = p_ring->write_pos;
+    uint8_t  header[MSG_RING_HEADER_LEN];
+
+    if (msg_ring_free(p_ring) < MSG_RING_HEADER_LEN + length)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    header[0] = type;
+    header[1] = length;
+    ring_write(p_ring, pos, header, MSG_RING_HEADER_LEN);
+    ring_write(p_ring, pos + MSG_RING_HEADER_LEN, p_data, length);
+
+    // Publish the message only after its bytes are in place. The index is volatile but the bytes
+    // are not, the barrier keeps the compiler and the core from moving their stores past it.
+    __DMB();
+    p_ring->write_pos = pos + MSG_RING_HEADER_LEN + length;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t msg_ring_get(msg_ring_t * p_ring, uint8_t * p_type, uint8_t * p_data, uint8_t * p_length)
+{
+    uint16_t pos = p_ring->read_pos;
+    uint8_t  header[MSG_RING_HEADER_LEN];
+
+    if (pos == p_ring->write_pos)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    // Read the bytes only after the index that published them.
+    __DMB();
+
+    ring_read(p_ring, pos, header, MSG_RING_HEADER_LEN);
+    ring_read(p_ring, pos + MSG_RING_HEADER_LEN, p_data, header[1]);
+    *p_type   = header[0];
+    *p_length = header[1];
+
+    // Release the space only after the payload has been copied out.
+    __DMB();
+    p_ring->read_pos = pos + MSG_RING_HEADER_LEN + header[1];
+
+    return NRF_SUCCESS;
+}
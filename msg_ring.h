@@ -0,0 +1,64 @@
+/**@file
+ *
+ * @brief    Lock-free single-producer/single-consumer message ring.
+ *
+ * @details  Messages are stored back to back in a power-of-two sized byte buffer, each one as a
+ *           type byte, a length byte and the payload. The producer only writes the write index
+ *           and the consumer only writes the read index, so one context (e.g. the SoftDevice
+ *           event handler) can put while another (e.g. the main loop) gets without a critical
+ *           region.
+ */
+
+#ifndef MSG_RING_H__
+#define MSG_RING_H__
+
+#include <stdint.h>
+
+#define MSG_RING_HEADER_LEN     2                                    /**< Bytes used by the type and length of each message. */
+
+/**@brief Message ring instance. */
+typedef struct
+{
+    uint8_t *         p_buf;                                         /**< Message storage. */
+    uint16_t          size_mask;                                     /**< Size of p_buf minus one. */
+    volatile uint16_t write_pos;                                     /**< Free running write index, only changed by the producer. */
+    volatile uint16_t read_pos;                                      /**< Free running read index, only changed by the consumer. */
+} msg_ring_t;
+
+/**@brief Function for initializing a message ring.
+ *
+ * @param[out] p_ring  Ring instance.
+ * @param[in]  p_buf   Storage, must stay valid while the ring is used.
+ * @param[in]  size    Size of p_buf in bytes, a power of two.
+ *
+ * @return  NRF_SUCCESS, or NRF_ERROR_INVALID_LENGTH if size is not a power of two.
+ */
+uint32_t msg_ring_init(msg_ring_t * p_ring, uint8_t * p_buf, uint16_t size);
+
+/**@brief Function for getting the number of free bytes, headers included. */
+uint16_t msg_ring_free(const msg_ring_t * p_ring);
+
+/**@brief Function for putting a message into the ring (producer side).
+ *
+ * @param[in] p_ring  Ring instance.
+ * @param[in] type    Application defined message type.
+ * @param[in] p_data  Payload, may be NULL if length is 0.
+ * @param[in] length  Payload length.
+ *
+ * @return  NRF_SUCCESS, or NRF_ERROR_NO_MEM if the message does not fit. Nothing is written in
+ *          that case.
+ */
+uint32_t msg_ring_put(msg_ring_t * p_ring, uint8_t type, const uint8_t * p_data, uint8_t length);
+
+/**@brief Function for taking the oldest message out of the ring (consumer side).
+ *
+ * @param[in]     p_ring    Ring instance.
+ * @param[out]    p_type    Message type.
+ * @param[out]    p_data    Buffer for the payload, at least 255 bytes or the largest message put.
+ * @param[out]    p_length  Payload length.
+ *
+ * @return  NRF_SUCCESS, or NRF_ERROR_NOT_FOUND if the ring is empty.
+ */
+uint32_t msg_ring_get(msg_ring_t * p_ring, uint8_t * p_type, uint8_t * p_data, uint8_t * p_length);
+
+#endif // MSG_RING_H__
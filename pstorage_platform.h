@@ -30,10 +30,16 @@
         : NRF_FICR->CODESIZE)
 
 
-#define PSTORAGE_MAX_APPLICATIONS   1                                                           /**< Maximum number of applications that can be registered with the module, configurable based on system requirements. */
+#define PSTORAGE_MAX_APPLICATIONS   3                                                           /**< Maximum number of applications that can be registered with the module, configurable based on system requirements. */
 #define PSTORAGE_MIN_BLOCK_SIZE     0x0010                                                      /**< Minimum size of block that can be registered with the module. Should be configured based on system requirements, recommendation is not have this value to be at least size of word. */
 
-#define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_MAX_APPLICATIONS - 1) \
+#define PSTORAGE_DISPLAY_TEMPLATE_PAGES 1                                                       /**< Flash page for the screen templates, registered first so the pages after it stay where they were. */
+#define PSTORAGE_DISPLAY_STORE_PAGES 2                                                          /**< Flash pages the display journal is wear leveled across. */
+#define PSTORAGE_DEVICE_MANAGER_PAGES 1                                                         /**< Flash page for the bonds and system attributes of the Device Manager. */
+#define PSTORAGE_DATA_PAGES         (PSTORAGE_DISPLAY_TEMPLATE_PAGES + PSTORAGE_DISPLAY_STORE_PAGES \
+                                    + PSTORAGE_DEVICE_MANAGER_PAGES)                            /**< Flash pages for all registered applications, in the order they register. */
+
+#define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_DATA_PAGES - 1)       \
                                     * PSTORAGE_FLASH_PAGE_SIZE)                                 /**< Start address for persistent data, configurable according to system requirements. */
 #define PSTORAGE_DATA_END_ADDR      ((PSTORAGE_FLASH_PAGE_END - 1) * PSTORAGE_FLASH_PAGE_SIZE)  /**< End address for persistent data, configurable according to system requirements. */
 #define PSTORAGE_SWAP_ADDR          PSTORAGE_DATA_END_ADDR                                      /**< Top-most page is used as swap area for clear and update. */
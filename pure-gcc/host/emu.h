@@ -0,0 +1,172 @@
+/**@file
+ *
+ * @brief    Host emulator of the display firmware.
+ *
+ * @details  The firmware sources are compiled unchanged against the stand-in SDK headers in
+ *           include/ and run on a virtual clock. Time only advances while the firmware sleeps in
+ *           sd_app_evt_wait(), busy waits, or spins on a critical region; everything else costs
+ *           no virtual time.
+ *
+ *           Peripherals are modeled at register level (TWI0, UART0). Their hardware events run
+ *           whenever time passes and pend interrupts; an interrupt handler, like any event with
+ *           an interrupt priority, only runs outside critical regions and when it preempts the
+ *           code running now, the same way the NVIC would.
+ */
+
+#ifndef EMU_H__
+#define EMU_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define EMU_NS_PER_US           1000ULL                              /**< Virtual clock resolution is 1 ns. */
+#define EMU_NS_PER_MS           1000000ULL
+#define EMU_NS_PER_S            1000000000ULL
+#define EMU_TIME_NEVER          UINT64_MAX                           /**< Time of an event that is not scheduled. */
+
+#define EMU_PRIO_HW             0                                    /**< Peripheral hardware, runs whatever the CPU does and pends interrupts. */
+#define EMU_PRIO_HIGH           1                                    /**< APP_IRQ_PRIORITY_HIGH: TWI0 and UART0. */
+#define EMU_PRIO_LOW            3                                    /**< APP_IRQ_PRIORITY_LOW: SoftDevice events and app_timer. */
+#define EMU_PRIO_THREAD         4                                    /**< Main loop. */
+
+/**@brief Timed event handler type, called at the priority of the event. */
+typedef void (*emu_event_handler_t)(void * p_context);
+
+/**@brief Timed event, owned by the model that schedules it. */
+typedef struct emu_event_s
+{
+    uint64_t              time_ns;                                   /**< Time the event is due. */
+    uint8_t               prio;                                      /**< Interrupt priority the handler runs at. */
+    emu_event_handler_t   handler;
+    void *                p_context;
+    bool                  pending;                                   /**< Set while the event is in the queue. */
+    struct emu_event_s *  p_next;
+} emu_event_t;
+
+/**@brief I2C slave model. */
+typedef struct
+{
+    uint8_t     address;                                             /**< 7-bit slave address. */
+    const char * p_name;
+    void        (*start)(void);                                      /**< START condition with the slave address. */
+    void        (*write)(uint8_t data);                              /**< Byte received and acknowledged. */
+    void        (*stop)(void);                                       /**< STOP condition. */
+} emu_i2c_device_t;
+
+/**@brief Bus counters, see emu_twi_stats_get(). */
+typedef struct
+{
+    uint32_t    transfers;                                           /**< START conditions. */
+    uint32_t    stops;                                               /**< STOP conditions. */
+    uint32_t    bytes;                                               /**< Bytes on the bus, including address bytes. */
+    uint32_t    nacks;                                               /**< Transfers to an address without a slave. */
+    uint64_t    scl_cycles;                                          /**< SCL periods the bus was busy. */
+    uint64_t    busy_ns;                                             /**< Time the bus was busy. */
+    uint64_t    last_stop_ns;                                        /**< Time of the last STOP condition. */
+} emu_twi_stats_t;
+
+/**@brief LCD controller counters, see emu_lcd_stats_get(). */
+typedef struct
+{
+    uint32_t    instructions;
+    uint32_t    data_writes;                                         /**< DDRAM and CGRAM writes. */
+    uint32_t    busy_violations;                                     /**< Bytes received while the controller was still executing. */
+    uint64_t    osc_cycles;                                          /**< Controller oscillator cycles spent executing. */
+} emu_lcd_stats_t;
+
+/* emu_main.c */
+extern bool     g_emu_verbose;                                       /**< Log every bus byte and BLE event. */
+extern bool     g_emu_bench;                                         /**< Benchmark run, see emu_bench.c. */
+uint64_t        emu_now(void);
+void            emu_event_schedule(emu_event_t * p_event, uint64_t time_ns);
+void            emu_event_cancel(emu_event_t * p_event);
+void            emu_irq_enter(uint8_t prio, uint8_t * p_saved);
+void            emu_irq_exit(uint8_t saved);
+bool            emu_irq_enabled(int irqn);
+bool            emu_irq_allowed(uint8_t prio);
+void            emu_run(uint64_t until_ns);
+void            emu_log(const char * p_fmt, ...) __attribute__((format(printf, 1, 2)));
+void            emu_fail(const char * p_fmt, ...) __attribute__((format(printf, 1, 2)));
+void            emu_finish(void) __attribute__((noreturn));
+void            emu_power_off(void) __attribute__((noreturn));
+
+/* emu_twi.c */
+/**@brief Bus faults, see emu_twi_stall(). */
+typedef enum
+{
+    EMU_TWI_STALL_NONE,
+    EMU_TWI_STALL_SCL,                                               /**< A slave holds SCL low until the fault is lifted. */
+    EMU_TWI_STALL_SDA                                                /**< A slave holds SDA low until the master clocks SCL 9 times by GPIO. */
+} emu_twi_stall_t;
+
+void            emu_twi_poll(void);
+void            emu_twi_stall(emu_twi_stall_t stall);
+void            emu_twi_gpio_written(void);
+void            emu_twi_force_khz(uint32_t khz);
+uint32_t        emu_twi_khz(void);
+void            emu_twi_stats_get(emu_twi_stats_t * p_stats);
+bool            emu_twi_is_idle(void);
+
+/* emu_hd44780.c */
+extern const emu_i2c_device_t g_emu_lcd;
+void            emu_lcd_cells(uint8_t row, uint8_t * p_cells);
+void            emu_lcd_row(uint8_t row, char * p_text);
+void            emu_lcd_glyph(uint8_t code, uint8_t * p_rows);
+void            emu_lcd_stats_get(emu_lcd_stats_t * p_stats);
+
+/* emu_pca9633.c */
+extern const emu_i2c_device_t g_emu_rgb;
+void            emu_rgb_color(uint8_t * p_rgb);
+uint8_t         emu_rgb_reg(uint8_t addr);
+bool            emu_rgb_reg_find(const char * p_name, uint8_t * p_addr);
+uint32_t        emu_rgb_reg_writes(void);
+
+/* emu_uart.c */
+void            emu_uart_poll(void);
+void            emu_uart_rx(const uint8_t * p_data, size_t length);
+uint32_t        emu_uart_rx_count(void);
+
+/* emu_flash.c */
+void            emu_flash_init(const char * p_path);
+void            emu_flash_save(void);
+void            emu_flash_stats(uint32_t * p_writes, uint32_t * p_erases);
+void            emu_flash_hold(bool hold);
+
+/* emu_timer.c */
+uint32_t        emu_rtc_counter(void);
+
+/* emu_sd.c */
+void            emu_sd_sys_evt_dispatch(uint32_t evt_id);
+bool            emu_ble_connect(uint32_t interval_ms);
+bool            emu_ble_disconnect(void);
+bool            emu_ble_cccd_write(uint16_t uuid, bool notify);
+bool            emu_ble_write(uint16_t uuid, const uint8_t * p_data, uint16_t length);
+bool            emu_ble_write_cmd(uint16_t uuid, const uint8_t * p_data, uint16_t length);
+uint16_t        emu_ble_write_status(void);
+bool            emu_ble_read(uint16_t uuid, uint8_t * p_data, uint16_t * p_length);
+size_t          emu_ble_notified(uint8_t * p_data, size_t max_length);
+bool            emu_ble_is_advertising(void);
+bool            emu_ble_adv_params(uint8_t * p_type, uint8_t * p_fp, uint16_t * p_interval);
+bool            emu_ble_pair(void);
+bool            emu_ble_encrypt(void);
+bool            emu_ble_conn_params(uint16_t * p_interval, uint16_t * p_slave_latency);
+void            emu_ble_stats(uint32_t * p_writes, uint32_t * p_notifications, uint32_t * p_notified_bytes, uint32_t * p_radio_events);
+const uint8_t * emu_ble_adv_data(uint8_t * p_length);
+bool            emu_sd_is_off(void);
+
+/* emu_bench.c */
+void            emu_stack_init(void);
+void            emu_stack_irq_enter(void);
+void            emu_stack_irq_exit(void);
+uint32_t        emu_stack_peak(void);
+bool            emu_bench_baseline_load(const char * p_path);
+void            emu_bench_begin(const char * p_name);
+void            emu_bench_end(void);
+
+/* emu_script.c */
+bool            emu_script_open(const char * p_path);
+uint64_t        emu_script_due(void);
+void            emu_script_step(void);
+
+#endif // EMU_H__
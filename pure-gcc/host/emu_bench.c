@@ -0,0 +1,296 @@
+/**@file
+ *
+ * @brief    Render benchmarks and firmware stack use.
+ *
+ * @details  A trace marks a workload with "bench <name>" ... "bench_end". Its bus bytes, START
+ *           and STOP conditions, latency (workload start to the last STOP), peak firmware stack
+ *           and LCD busy violations are printed as one line, which is also the baseline format:
+ *
+ *               bench full_redraw 100 bytes=41 starts=3 stops=3 us=2071 stack=1344 busy=0
+ *
+ *           With a baseline (-B), every metric larger than its baseline value fails the run. A
+ *           busy violation fails it in any case, whatever the baseline says.
+ *
+ *           Stack use is measured with -finstrument-functions on the firmware objects: every
+ *           firmware function entry reports its stack pointer. Emulator frames between an
+ *           interrupt and the firmware handler are left out, each interrupt adds the Cortex-M0
+ *           exception frame. These are host frames, so the numbers compare builds with each
+ *           other, not with the RAM of the chip.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emu.h"
+
+
+#define BENCH_NAME_MAX          32
+#define BENCH_BASELINE_MAX      32                                   /**< Baseline lines kept. */
+#define STACK_SHADOW_DEPTH      512                                  /**< Active firmware calls followed. */
+#define STACK_SEGMENT_MAX       8                                    /**< Thread level and nested interrupts. */
+#define STACK_EXCEPTION_FRAME   32                                   /**< Registers the Cortex-M0 stacks on interrupt entry. */
+
+/**@brief Benchmark metrics, in the order they are printed. */
+enum
+{
+    BENCH_BYTES,
+    BENCH_STARTS,
+    BENCH_STOPS,
+    BENCH_US,
+    BENCH_STACK,
+    BENCH_BUSY,
+    BENCH_METRIC_COUNT
+};
+
+typedef struct
+{
+    char     name[BENCH_NAME_MAX];
+    uint32_t khz;
+    uint64_t metrics[BENCH_METRIC_COUNT];
+} bench_result_t;
+
+/**@brief Firmware code running at one interrupt level. */
+typedef struct
+{
+    uint32_t  prior;                                                 /**< Firmware stack in use by the levels it preempted. */
+    uintptr_t entry_base;                                            /**< Stack pointer at the firmware entry running now. */
+    uint32_t  shadow_start;                                          /**< First m_shadow entry of this level. */
+} stack_segment_t;
+
+static const char *    m_metric_names[BENCH_METRIC_COUNT] = {"bytes", "starts", "stops", "us", "stack", "busy"};
+
+static bench_result_t  m_baseline[BENCH_BASELINE_MAX];
+static uint32_t        m_baseline_count;
+
+static bool            m_bench_active;
+static char            m_bench_name[BENCH_NAME_MAX];
+static uint64_t        m_bench_start_ns;
+static emu_twi_stats_t m_bench_twi;
+static emu_lcd_stats_t m_bench_lcd;
+
+static uintptr_t       m_shadow[STACK_SHADOW_DEPTH];                 /**< Stack pointers of the active firmware calls. */
+static uint32_t        m_shadow_depth;
+static stack_segment_t m_segments[STACK_SEGMENT_MAX];
+static uint32_t        m_segment_count;
+static uint32_t        m_stack_peak;                                 /**< Since the start or the last emu_bench_begin(). */
+static uint32_t        m_stack_peak_total;                           /**< Since the start. */
+
+
+/**@brief Function for getting the firmware stack in use at the innermost active call. */
+static uint32_t stack_in_use(void)
+{
+    stack_segment_t * p_seg = &m_segments[m_segment_count - 1];
+
+    if (m_shadow_depth == p_seg->shadow_start)
+    {
+        return p_seg->prior;
+    }
+    return p_seg->prior + (uint32_t)(p_seg->entry_base - m_shadow[m_shadow_depth - 1]);
+}
+
+
+void __cyg_profile_func_enter(void * p_func, void * p_call_site)
+{
+    stack_segment_t * p_seg;
+    uintptr_t         sp = (uintptr_t)__builtin_frame_address(0);
+    uint32_t          in_use;
+
+    (void)p_func;
+    (void)p_call_site;
+
+    if ((m_segment_count == 0) || (m_shadow_depth == STACK_SHADOW_DEPTH))
+    {
+        return;
+    }
+    p_seg = &m_segments[m_segment_count - 1];
+    if (m_shadow_depth == p_seg->shadow_start)
+    {
+        // Called from the emulator: the caller frame is the top of the firmware stack. The
+        // build has frame pointers everywhere (-O0), so the caller frame address is reliable.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wframe-address"
+        p_seg->entry_base = (uintptr_t)__builtin_frame_address(1) + 2 * sizeof(void *);
+#pragma GCC diagnostic pop
+    }
+    m_shadow[m_shadow_depth++] = sp;
+
+    in_use             = stack_in_use();
+    m_stack_peak       = (in_use > m_stack_peak) ? in_use : m_stack_peak;
+    m_stack_peak_total = (in_use > m_stack_peak_total) ? in_use : m_stack_peak_total;
+}
+
+
+void __cyg_profile_func_exit(void * p_func, void * p_call_site)
+{
+    (void)p_func;
+    (void)p_call_site;
+
+    if ((m_segment_count != 0) && (m_shadow_depth > m_segments[m_segment_count - 1].shadow_start))
+    {
+        m_shadow_depth--;
+    }
+}
+
+
+void emu_stack_init(void)
+{
+    m_segment_count = 1;
+    m_shadow_depth  = 0;
+    memset(&m_segments[0], 0, sizeof(m_segments[0]));
+}
+
+
+void emu_stack_irq_enter(void)
+{
+    stack_segment_t * p_seg;
+
+    if ((m_segment_count == 0) || (m_segment_count == STACK_SEGMENT_MAX))
+    {
+        return;
+    }
+    p_seg               = &m_segments[m_segment_count];
+    p_seg->prior        = stack_in_use() + STACK_EXCEPTION_FRAME;
+    p_seg->entry_base   = 0;
+    p_seg->shadow_start = m_shadow_depth;
+    m_segment_count++;
+}
+
+
+void emu_stack_irq_exit(void)
+{
+    if (m_segment_count > 1)
+    {
+        m_shadow_depth = m_segments[--m_segment_count].shadow_start;
+    }
+}
+
+
+uint32_t emu_stack_peak(void)
+{
+    return m_stack_peak_total;
+}
+
+
+bool emu_bench_baseline_load(const char * p_path)
+{
+    FILE * p_file = fopen(p_path, "r");
+    char   line[256];
+
+    if (p_file == NULL)
+    {
+        perror(p_path);
+        return false;
+    }
+    while ((fgets(line, sizeof(line), p_file) != NULL) && (m_baseline_count < BENCH_BASELINE_MAX))
+    {
+        bench_result_t * p_result = &m_baseline[m_baseline_count];
+        unsigned long long values[BENCH_METRIC_COUNT];
+        unsigned int       khz;
+        uint32_t           i;
+
+        if (sscanf(line, "bench %31s %u bytes=%llu starts=%llu stops=%llu us=%llu stack=%llu busy=%llu",
+                   p_result->name, &khz, &values[BENCH_BYTES], &values[BENCH_STARTS], &values[BENCH_STOPS],
+                   &values[BENCH_US], &values[BENCH_STACK], &values[BENCH_BUSY]) != 2 + BENCH_METRIC_COUNT)
+        {
+            // Comments and blank lines.
+            continue;
+        }
+        p_result->khz = khz;
+        for (i = 0; i < BENCH_METRIC_COUNT; i++)
+        {
+            p_result->metrics[i] = values[i];
+        }
+        m_baseline_count++;
+    }
+    fclose(p_file);
+    return true;
+}
+
+
+void emu_bench_begin(const char * p_name)
+{
+    snprintf(m_bench_name, sizeof(m_bench_name), "%s", p_name);
+    m_bench_active   = true;
+    m_bench_start_ns = emu_now();
+    m_stack_peak     = 0;
+    emu_twi_stats_get(&m_bench_twi);
+    emu_lcd_stats_get(&m_bench_lcd);
+}
+
+
+static const bench_result_t * baseline_find(const bench_result_t * p_result)
+{
+    uint32_t i;
+
+    for (i = 0; i < m_baseline_count; i++)
+    {
+        if ((strcmp(m_baseline[i].name, p_result->name) == 0) && (m_baseline[i].khz == p_result->khz))
+        {
+            return &m_baseline[i];
+        }
+    }
+    return NULL;
+}
+
+
+void emu_bench_end(void)
+{
+    emu_twi_stats_t        twi;
+    emu_lcd_stats_t        lcd;
+    bench_result_t         result;
+    const bench_result_t * p_base;
+    uint32_t               i;
+
+    if (!m_bench_active)
+    {
+        emu_fail("bench_end without bench");
+        return;
+    }
+    m_bench_active = false;
+
+    emu_twi_stats_get(&twi);
+    emu_lcd_stats_get(&lcd);
+
+    memset(&result, 0, sizeof(result));
+    memcpy(result.name, m_bench_name, sizeof(result.name));
+    result.khz                   = emu_twi_khz();
+    result.metrics[BENCH_BYTES]  = twi.bytes - m_bench_twi.bytes;
+    result.metrics[BENCH_STARTS] = twi.transfers - m_bench_twi.transfers;
+    result.metrics[BENCH_STOPS]  = twi.stops - m_bench_twi.stops;
+    result.metrics[BENCH_US]     = (twi.last_stop_ns > m_bench_start_ns) ?
+                                   (twi.last_stop_ns - m_bench_start_ns) / EMU_NS_PER_US : 0;
+    result.metrics[BENCH_STACK]  = m_stack_peak;
+    result.metrics[BENCH_BUSY]   = lcd.busy_violations - m_bench_lcd.busy_violations;
+
+    printf("bench %s %u", result.name, result.khz);
+    for (i = 0; i < BENCH_METRIC_COUNT; i++)
+    {
+        printf(" %s=%llu", m_metric_names[i], (unsigned long long)result.metrics[i]);
+    }
+    putchar('\n');
+
+    if (!g_emu_bench)
+    {
+        return;
+    }
+    if (result.metrics[BENCH_BUSY] != 0)
+    {
+        emu_fail("bench %s at %u kHz: %llu LCD busy violations", result.name, result.khz,
+                 (unsigned long long)result.metrics[BENCH_BUSY]);
+    }
+    p_base = baseline_find(&result);
+    if (p_base == NULL)
+    {
+        printf("bench %s %u: no baseline\n", result.name, result.khz);
+        return;
+    }
+    for (i = 0; i < BENCH_METRIC_COUNT; i++)
+    {
+        if (result.metrics[i] > p_base->metrics[i])
+        {
+            emu_fail("bench %s at %u kHz: %s %llu, baseline %llu", result.name, result.khz, m_metric_names[i],
+                     (unsigned long long)result.metrics[i], (unsigned long long)p_base->metrics[i]);
+        }
+    }
+}
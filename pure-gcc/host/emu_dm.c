@@ -0,0 +1,403 @@
+#include <stdint.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "ble.h"
+#include "pstorage.h"
+#include "device_manager.h"
+#include "emu.h"
+
+
+#define DM_RECORD_VALID         0x444D4231                           /**< State of a used bond record, erased flash for a free one. */
+#define DM_SYS_ATTR_SIZE        (DM_GATT_CCCD_COUNT * 6 + 2)         /**< Room for the system attributes, sized like the SDK does. */
+
+/**@brief Bond record, one pstorage block each. */
+typedef struct
+{
+    uint32_t           state;                                        /**< DM_RECORD_VALID for a bonded central. */
+    ble_gap_addr_t     addr;                                         /**< Identity address, or the connection address without one. */
+    uint8_t            irk_valid;
+    ble_gap_irk_t      irk;
+    ble_gap_enc_info_t enc_info;                                     /**< Keys the central encrypts with. */
+    uint16_t           sys_attr_len;
+    uint8_t            sys_attr[DM_SYS_ATTR_SIZE];                   /**< CCCD values from the end of the last secured connection. */
+} dm_record_t;
+
+/**@brief The one connection. */
+typedef struct
+{
+    uint16_t           conn_handle;
+    ble_gap_addr_t     peer_addr;
+    uint8_t            device_id;                                    /**< Record of the central, DM_INVALID_ID while not bonded. */
+    bool               secured;                                      /**< Paired or encrypted with the bond keys. */
+} dm_conn_t;
+
+static dm_record_t       m_records[DEVICE_MANAGER_MAX_BONDS];        /**< RAM copy of the flash blocks, stored as a whole. */
+static pstorage_handle_t m_storage;
+static dm_event_cb_t     m_evt_handler;
+static ble_gap_sec_params_t m_sec_param;
+static dm_conn_t         m_conn = {BLE_CONN_HANDLE_INVALID, {0}, DM_INVALID_ID, false};
+static uint8_t           m_stored_device_id;                         /**< Record of the last store, for its event. */
+
+
+static void evt_notify(uint8_t event_id, uint8_t device_id, api_result_t result)
+{
+    dm_handle_t handle;
+    dm_event_t  event;
+
+    if (m_evt_handler == NULL)
+    {
+        return;
+    }
+    (void)dm_handle_initialize(&handle);
+    handle.appl_id       = 0;
+    handle.connection_id = 0;
+    handle.device_id     = device_id;
+
+    memset(&event, 0, sizeof(event));
+    event.event_id = event_id;
+    (void)m_evt_handler(&handle, &event, result);
+}
+
+
+static void storage_cb(pstorage_handle_t * p_handle, uint8_t op_code, uint32_t result, uint8_t * p_data, uint32_t data_len)
+{
+    (void)p_handle;
+    (void)p_data;
+    (void)data_len;
+
+    // A failed erase before a store is reported like the store.
+    if ((op_code == PSTORAGE_STORE_OP_CODE) || (result != NRF_SUCCESS))
+    {
+        evt_notify(DM_EVT_DEVICE_CONTEXT_STORED, m_stored_device_id, result);
+    }
+}
+
+
+/**@brief Function for writing the bond table, erasing the page first like an update in the SDK. */
+static uint32_t records_store(uint8_t device_id)
+{
+    uint32_t err_code;
+
+    m_stored_device_id = device_id;
+
+    err_code = pstorage_clear(&m_storage, sizeof(m_records));
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    return pstorage_store(&m_storage, (uint8_t *)m_records, sizeof(m_records), 0);
+}
+
+
+static uint8_t record_find(const ble_gap_addr_t * p_addr)
+{
+    uint8_t i;
+
+    for (i = 0; i < DEVICE_MANAGER_MAX_BONDS; i++)
+    {
+        if ((m_records[i].state == DM_RECORD_VALID) &&
+            (memcmp(&m_records[i].addr, p_addr, sizeof(*p_addr)) == 0))
+        {
+            return i;
+        }
+    }
+    return DM_INVALID_ID;
+}
+
+
+static uint8_t record_free(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < DEVICE_MANAGER_MAX_BONDS; i++)
+    {
+        if (m_records[i].state != DM_RECORD_VALID)
+        {
+            return i;
+        }
+    }
+    return DM_INVALID_ID;
+}
+
+
+/**@brief Function for giving the SoftDevice the stored system attributes of the central. */
+static void sys_attr_apply(void)
+{
+    dm_record_t * p_record;
+    uint32_t      err_code;
+
+    if ((m_conn.device_id == DM_INVALID_ID) || !m_conn.secured)
+    {
+        err_code = sd_ble_gatts_sys_attr_set(m_conn.conn_handle, NULL, 0);
+    }
+    else
+    {
+        p_record = &m_records[m_conn.device_id];
+        err_code = sd_ble_gatts_sys_attr_set(m_conn.conn_handle,
+                                             (p_record->sys_attr_len != 0) ? p_record->sys_attr : NULL,
+                                             p_record->sys_attr_len);
+        emu_log("dm    system attributes of bond %u applied, %u bytes", m_conn.device_id, p_record->sys_attr_len);
+    }
+    if (err_code != NRF_SUCCESS)
+    {
+        emu_fail("device manager: sd_ble_gatts_sys_attr_set failed with 0x%X", err_code);
+    }
+}
+
+
+static void on_auth_status(const ble_gap_evt_auth_status_t * p_status)
+{
+    dm_record_t * p_record;
+    uint8_t       device_id;
+    uint32_t      err_code;
+    uint16_t      len = DM_SYS_ATTR_SIZE;
+
+    if (p_status->auth_status != BLE_GAP_SEC_STATUS_SUCCESS)
+    {
+        evt_notify(DM_EVT_SECURITY_SETUP_COMPLETE, m_conn.device_id, p_status->auth_status);
+        return;
+    }
+    m_conn.secured = true;
+
+    if (!p_status->periph_kex.ltk)
+    {
+        // Paired without bonding, nothing to keep.
+        evt_notify(DM_EVT_SECURITY_SETUP_COMPLETE, m_conn.device_id, NRF_SUCCESS);
+        return;
+    }
+
+    device_id = record_find(p_status->central_kex.address ? &p_status->central_keys.id_info : &m_conn.peer_addr);
+    if (device_id == DM_INVALID_ID)
+    {
+        device_id = record_free();
+    }
+    if (device_id == DM_INVALID_ID)
+    {
+        evt_notify(DM_EVT_SECURITY_SETUP_COMPLETE, DM_INVALID_ID, NRF_ERROR_NO_MEM);
+        return;
+    }
+
+    p_record            = &m_records[device_id];
+    memset(p_record, 0, sizeof(*p_record));
+    p_record->state     = DM_RECORD_VALID;
+    p_record->addr      = p_status->central_kex.address ? p_status->central_keys.id_info : m_conn.peer_addr;
+    p_record->irk_valid = p_status->central_kex.irk;
+    p_record->irk       = p_status->central_keys.irk;
+    p_record->enc_info  = p_status->periph_keys.enc_info;
+    if (sd_ble_gatts_sys_attr_get(m_conn.conn_handle, p_record->sys_attr, &len) == NRF_SUCCESS)
+    {
+        p_record->sys_attr_len = len;
+    }
+    m_conn.device_id = device_id;
+
+    emu_log("dm    bond %u stored", device_id);
+    err_code = records_store(device_id);
+    evt_notify(DM_EVT_SECURITY_SETUP_COMPLETE, device_id, err_code);
+}
+
+
+static void on_disconnected(void)
+{
+    dm_record_t * p_record;
+    uint8_t       sys_attr[DM_SYS_ATTR_SIZE];
+    uint16_t      len = sizeof(sys_attr);
+
+    if ((m_conn.device_id != DM_INVALID_ID) && m_conn.secured &&
+        (sd_ble_gatts_sys_attr_get(m_conn.conn_handle, sys_attr, &len) == NRF_SUCCESS))
+    {
+        p_record = &m_records[m_conn.device_id];
+        if ((len != p_record->sys_attr_len) || (memcmp(sys_attr, p_record->sys_attr, len) != 0))
+        {
+            memcpy(p_record->sys_attr, sys_attr, len);
+            p_record->sys_attr_len = len;
+
+            emu_log("dm    system attributes of bond %u changed, stored", m_conn.device_id);
+            if (records_store(m_conn.device_id) != NRF_SUCCESS)
+            {
+                emu_fail("device manager: cannot store the system attributes");
+            }
+        }
+    }
+    evt_notify(DM_EVT_DISCONNECTION, m_conn.device_id, NRF_SUCCESS);
+
+    m_conn.conn_handle = BLE_CONN_HANDLE_INVALID;
+    m_conn.device_id   = DM_INVALID_ID;
+    m_conn.secured     = false;
+}
+
+
+api_result_t dm_init(dm_init_param_t const * p_init_param)
+{
+    pstorage_module_param_t param;
+    uint32_t                err_code;
+
+    if (p_init_param == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    param.cb          = storage_cb;
+    param.block_size  = sizeof(dm_record_t);
+    param.block_count = DEVICE_MANAGER_MAX_BONDS;
+    err_code = pstorage_register(&param, &m_storage);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (p_init_param->clear_persistent_data)
+    {
+        emu_log("dm    all bonds deleted");
+        memset(m_records, 0xFF, sizeof(m_records));
+        return pstorage_clear(&m_storage, sizeof(m_records));
+    }
+    return pstorage_load((uint8_t *)m_records, &m_storage, sizeof(m_records), 0);
+}
+
+
+api_result_t dm_register(dm_application_instance_t * p_appl_instance, dm_application_param_t const * p_appl_param)
+{
+    if ((p_appl_instance == NULL) || (p_appl_param == NULL) || (p_appl_param->evt_handler == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_evt_handler != NULL)
+    {
+        // DEVICE_MANAGER_MAX_APPLICATIONS is 1.
+        return NRF_ERROR_NO_MEM;
+    }
+    m_evt_handler    = p_appl_param->evt_handler;
+    m_sec_param      = p_appl_param->sec_param;
+    *p_appl_instance = 0;
+    return NRF_SUCCESS;
+}
+
+
+void dm_ble_evt_handler(ble_evt_t * p_ble_evt)
+{
+    const ble_gap_evt_t * p_gap_evt = &p_ble_evt->evt.gap_evt;
+    dm_record_t *         p_record;
+    uint32_t              err_code;
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn.conn_handle = p_gap_evt->conn_handle;
+            m_conn.peer_addr   = p_gap_evt->params.connected.peer_addr;
+            m_conn.device_id   = record_find(&m_conn.peer_addr);
+            m_conn.secured     = false;
+            evt_notify(DM_EVT_CONNECTION, m_conn.device_id, NRF_SUCCESS);
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            on_disconnected();
+            break;
+
+        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:
+            err_code = sd_ble_gap_sec_params_reply(m_conn.conn_handle, BLE_GAP_SEC_STATUS_SUCCESS, &m_sec_param);
+            evt_notify(DM_EVT_SECURITY_SETUP, m_conn.device_id, err_code);
+            break;
+
+        case BLE_GAP_EVT_AUTH_STATUS:
+            on_auth_status(&p_gap_evt->params.auth_status);
+            break;
+
+        case BLE_GAP_EVT_SEC_INFO_REQUEST:
+            p_record = (m_conn.device_id != DM_INVALID_ID) ? &m_records[m_conn.device_id] : NULL;
+            if ((p_record != NULL) && (p_record->enc_info.div == p_gap_evt->params.sec_info_request.div))
+            {
+                err_code = sd_ble_gap_sec_info_reply(m_conn.conn_handle, &p_record->enc_info, NULL);
+            }
+            else
+            {
+                // No keys found for this device.
+                err_code = sd_ble_gap_sec_info_reply(m_conn.conn_handle, NULL, NULL);
+            }
+            if (err_code != NRF_SUCCESS)
+            {
+                emu_fail("device manager: sd_ble_gap_sec_info_reply failed with 0x%X", err_code);
+            }
+            break;
+
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:
+            m_conn.secured = true;
+            sys_attr_apply();
+            evt_notify(DM_EVT_LINK_SECURED, m_conn.device_id, NRF_SUCCESS);
+            break;
+
+        case BLE_GATTS_EVT_SYS_ATTR_MISSING:
+            sys_attr_apply();
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+api_result_t dm_handle_initialize(dm_handle_t * p_handle)
+{
+    if (p_handle == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    p_handle->appl_id       = DM_INVALID_ID;
+    p_handle->connection_id = DM_INVALID_ID;
+    p_handle->device_id     = DM_INVALID_ID;
+    p_handle->service_id    = DM_PROTOCOL_CNTXT_GATT_SRVR_ID;
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Whitelist of every bond, by IRK when the central gave one and by address otherwise.
+ *
+ * @details addr_count and irk_count give the room in pp_addrs and pp_irks on entry.
+ */
+api_result_t dm_whitelist_create(dm_application_instance_t const * p_handle, ble_gap_whitelist_t * p_whitelist)
+{
+    uint8_t addr_max;
+    uint8_t irk_max;
+    uint8_t i;
+
+    if ((p_handle == NULL) || (p_whitelist == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    addr_max = p_whitelist->addr_count;
+    irk_max  = p_whitelist->irk_count;
+    p_whitelist->addr_count = 0;
+    p_whitelist->irk_count  = 0;
+
+    for (i = 0; i < DEVICE_MANAGER_MAX_BONDS; i++)
+    {
+        if (m_records[i].state != DM_RECORD_VALID)
+        {
+            continue;
+        }
+        if (m_records[i].irk_valid && (p_whitelist->irk_count < irk_max))
+        {
+            p_whitelist->pp_irks[p_whitelist->irk_count++] = &m_records[i].irk;
+        }
+        else if (!m_records[i].irk_valid && (p_whitelist->addr_count < addr_max))
+        {
+            p_whitelist->pp_addrs[p_whitelist->addr_count++] = &m_records[i].addr;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+api_result_t dm_peer_addr_get(dm_handle_t const * p_handle, ble_gap_addr_t * p_addr)
+{
+    if ((p_handle == NULL) || (p_addr == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((p_handle->device_id >= DEVICE_MANAGER_MAX_BONDS) ||
+        (m_records[p_handle->device_id].state != DM_RECORD_VALID))
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    *p_addr = m_records[p_handle->device_id].addr;
+    return NRF_SUCCESS;
+}
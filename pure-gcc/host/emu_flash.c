@@ -0,0 +1,388 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_soc.h"
+#include "pstorage.h"
+#include "app_util.h"
+#include "emu.h"
+
+
+#define FLASH_WORD_WRITE_NS     (46 * EMU_NS_PER_US)                 /**< Time to write one word. */
+#define FLASH_PAGE_ERASE_NS     (22 * EMU_NS_PER_MS)                 /**< Time to erase one page. */
+#define FLASH_EMPTY             0xFF
+
+/**@brief Registered pstorage module. */
+typedef struct
+{
+    pstorage_ntf_cb_t cb;
+    pstorage_size_t   block_size;
+    pstorage_size_t   block_count;
+    uint32_t          base;                                          /**< Address of the first block. */
+} flash_module_t;
+
+/**@brief Queued flash operation. */
+typedef struct
+{
+    uint8_t           op_code;                                       /**< PSTORAGE_STORE_OP_CODE or PSTORAGE_CLEAR_OP_CODE. */
+    pstorage_handle_t handle;
+    uint8_t *         p_src;                                         /**< Data to write, read when the write executes, like the SDK does. */
+    pstorage_size_t   size;
+    pstorage_size_t   offset;
+} flash_op_t;
+
+static uint8_t *      mp_flash;                                      /**< Data pages and swap page, mapped at their nRF51 address. */
+static uint32_t       m_flash_start;
+static uint32_t       m_flash_size;
+static const char *   mp_path;                                       /**< File the flash contents are kept in between runs, NULL for none. */
+
+static flash_module_t m_modules[PSTORAGE_MAX_APPLICATIONS];
+static uint32_t       m_module_count;
+static uint32_t       m_next_free;                                   /**< First address not yet given to a module. */
+static flash_op_t     m_ops[PSTORAGE_CMD_QUEUE_SIZE];
+static uint32_t       m_op_count;                                    /**< Queued operations, the first one is executing unless held. */
+static bool           m_hold;                                        /**< Operations wait in the queue, see emu_flash_hold(). */
+static uint32_t       m_writes;
+static uint32_t       m_erases;
+
+static void flash_done_handler(void * p_context);
+static void flash_sys_evt_handler(void * p_context);
+
+static emu_event_t    m_done_event =                                 /**< Flash controller finishes the operation. */
+{
+    .prio    = EMU_PRIO_HW,
+    .handler = flash_done_handler,
+};
+
+static emu_event_t    m_sys_event =                                  /**< SoftDevice reports the end of the operation. */
+{
+    .prio    = EMU_PRIO_LOW,
+    .handler = flash_sys_evt_handler,
+};
+
+
+void emu_flash_init(const char * p_path)
+{
+    FILE *   p_file;
+    uint32_t host_page = (uint32_t)sysconf(_SC_PAGESIZE);
+    uint32_t map_start;
+    uint8_t * p_map;
+
+    m_flash_start = PSTORAGE_DATA_START_ADDR;
+    m_flash_size  = PSTORAGE_SWAP_ADDR + PSTORAGE_FLASH_PAGE_SIZE - m_flash_start;
+
+    // The firmware turns flash addresses into pointers, so the pages have to be at their address.
+    // nRF51 pages are smaller than host pages, map from the host page they start in.
+    map_start = m_flash_start - (m_flash_start % host_page);
+    p_map     = mmap((void *)(uintptr_t)map_start, m_flash_start + m_flash_size - map_start,
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p_map != (uint8_t *)(uintptr_t)map_start)
+    {
+        fprintf(stderr, "cannot map the emulated flash at 0x%08X\n", m_flash_start);
+        exit(EXIT_FAILURE);
+    }
+    mp_flash = p_map + (m_flash_start - map_start);
+    memset(mp_flash, FLASH_EMPTY, m_flash_size);
+
+    mp_path = p_path;
+    if ((mp_path != NULL) && ((p_file = fopen(mp_path, "rb")) != NULL))
+    {
+        if (fread(mp_flash, 1, m_flash_size, p_file) != m_flash_size)
+        {
+            fprintf(stderr, "%s: not a flash image of %u bytes, starting erased\n", mp_path, m_flash_size);
+            memset(mp_flash, FLASH_EMPTY, m_flash_size);
+        }
+        fclose(p_file);
+    }
+}
+
+
+void emu_flash_save(void)
+{
+    FILE * p_file;
+
+    if ((mp_path == NULL) || (mp_flash == NULL))
+    {
+        return;
+    }
+    p_file = fopen(mp_path, "wb");
+    if ((p_file == NULL) || (fwrite(mp_flash, 1, m_flash_size, p_file) != m_flash_size))
+    {
+        fprintf(stderr, "%s: cannot save the flash image\n", mp_path);
+    }
+    if (p_file != NULL)
+    {
+        fclose(p_file);
+    }
+}
+
+
+void emu_flash_stats(uint32_t * p_writes, uint32_t * p_erases)
+{
+    *p_writes = m_writes;
+    *p_erases = m_erases;
+}
+
+
+static uint8_t * flash_ptr(uint32_t address)
+{
+    return &mp_flash[address - m_flash_start];
+}
+
+
+/**@brief Function for starting the first queued operation on the flash controller. */
+static void op_start(void)
+{
+    flash_op_t * p_op = &m_ops[0];
+    uint64_t     duration;
+
+    if (m_hold)
+    {
+        return;
+    }
+    if (p_op->op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        duration = (p_op->size / sizeof(uint32_t)) * FLASH_WORD_WRITE_NS;
+    }
+    else
+    {
+        duration = CEIL_DIV(p_op->size, PSTORAGE_FLASH_PAGE_SIZE) * FLASH_PAGE_ERASE_NS;
+    }
+    emu_event_schedule(&m_done_event, emu_now() + duration);
+}
+
+
+void emu_flash_hold(bool hold)
+{
+    // Like a SoftDevice that finds no radio gap for the flash access for a long time.
+    m_hold = hold;
+    if (!m_hold && (m_op_count != 0) && !m_done_event.pending)
+    {
+        op_start();
+    }
+}
+
+
+static void flash_done_handler(void * p_context)
+{
+    flash_op_t * p_op = &m_ops[0];
+    uint32_t     address;
+    uint32_t     i;
+
+    (void)p_context;
+
+    if (p_op->op_code == PSTORAGE_STORE_OP_CODE)
+    {
+        uint8_t * p_dest = flash_ptr(p_op->handle.block_id + p_op->offset);
+
+        emu_log("flash write %u bytes at 0x%08X", p_op->size, p_op->handle.block_id + p_op->offset);
+        for (i = 0; i < p_op->size; i++)
+        {
+            if ((p_op->p_src[i] & ~p_dest[i]) != 0)
+            {
+                emu_fail("flash write at 0x%08X over data that is not erased",
+                         p_op->handle.block_id + p_op->offset + i);
+                break;
+            }
+        }
+        for (i = 0; i < p_op->size; i++)
+        {
+            // Writing can only clear bits.
+            p_dest[i] &= p_op->p_src[i];
+        }
+        m_writes++;
+    }
+    else
+    {
+        for (address = p_op->handle.block_id - (p_op->handle.block_id % PSTORAGE_FLASH_PAGE_SIZE);
+             address < p_op->handle.block_id + p_op->size;
+             address += PSTORAGE_FLASH_PAGE_SIZE)
+        {
+            emu_log("flash erase page 0x%08X", address);
+            memset(flash_ptr(address), FLASH_EMPTY, PSTORAGE_FLASH_PAGE_SIZE);
+            m_erases++;
+        }
+    }
+    emu_event_schedule(&m_sys_event, emu_now());
+}
+
+
+static void flash_sys_evt_handler(void * p_context)
+{
+    (void)p_context;
+    emu_sd_sys_evt_dispatch(NRF_EVT_FLASH_OPERATION_SUCCESS);
+}
+
+
+void pstorage_sys_event_handler(uint32_t sys_evt)
+{
+    flash_op_t op;
+
+    if ((m_op_count == 0) || m_done_event.pending ||
+        ((sys_evt != NRF_EVT_FLASH_OPERATION_SUCCESS) && (sys_evt != NRF_EVT_FLASH_OPERATION_ERROR)))
+    {
+        return;
+    }
+
+    op = m_ops[0];
+    memmove(&m_ops[0], &m_ops[1], (--m_op_count) * sizeof(m_ops[0]));
+    if (m_op_count != 0)
+    {
+        op_start();
+    }
+
+    m_modules[op.handle.module_id].cb(&op.handle,
+                                      op.op_code,
+                                      (sys_evt == NRF_EVT_FLASH_OPERATION_SUCCESS) ? NRF_SUCCESS : NRF_ERROR_INTERNAL,
+                                      op.p_src,
+                                      op.size);
+}
+
+
+uint32_t pstorage_init(void)
+{
+    m_module_count = 0;
+    m_op_count     = 0;
+    m_next_free    = PSTORAGE_DATA_START_ADDR;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t pstorage_register(pstorage_module_param_t * p_module_param, pstorage_handle_t * p_block_id)
+{
+    flash_module_t * p_module;
+    uint32_t         size;
+
+    if ((p_module_param == NULL) || (p_block_id == NULL) || (p_module_param->cb == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((p_module_param->block_size < PSTORAGE_MIN_BLOCK_SIZE) ||
+        (p_module_param->block_size > PSTORAGE_MAX_BLOCK_SIZE) ||
+        (p_module_param->block_count == 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // Modules start on a page boundary, like in the SDK.
+    size = CEIL_DIV(p_module_param->block_size * p_module_param->block_count, PSTORAGE_FLASH_PAGE_SIZE)
+         * PSTORAGE_FLASH_PAGE_SIZE;
+    if ((m_module_count == PSTORAGE_MAX_APPLICATIONS) || (m_next_free + size > PSTORAGE_DATA_END_ADDR))
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_module              = &m_modules[m_module_count];
+    p_module->cb          = p_module_param->cb;
+    p_module->block_size  = p_module_param->block_size;
+    p_module->block_count = p_module_param->block_count;
+    p_module->base        = m_next_free;
+
+    p_block_id->module_id = m_module_count++;
+    p_block_id->block_id  = p_module->base;
+    m_next_free          += size;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t pstorage_block_identifier_get(pstorage_handle_t * p_base_id, pstorage_size_t block_num, pstorage_handle_t * p_block_id)
+{
+    flash_module_t * p_module;
+
+    if ((p_base_id == NULL) || (p_block_id == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_base_id->module_id >= m_module_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_module = &m_modules[p_base_id->module_id];
+    if (block_num >= p_module->block_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_block_id->module_id = p_base_id->module_id;
+    p_block_id->block_id  = p_module->base + block_num * p_module->block_size;
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for checking an access lies within the module and queuing it. */
+static uint32_t op_queue(uint8_t op_code, pstorage_handle_t * p_handle, uint8_t * p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+    flash_module_t * p_module;
+    flash_op_t *     p_op;
+
+    if (p_handle == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_handle->module_id >= m_module_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_module = &m_modules[p_handle->module_id];
+    if ((p_handle->block_id < p_module->base) ||
+        (p_handle->block_id + offset + size > p_module->base + p_module->block_size * p_module->block_count) ||
+        ((offset % sizeof(uint32_t)) != 0) || ((size % sizeof(uint32_t)) != 0) || (size == 0))
+    {
+        return NRF_ERROR_INVALID_ADDR;
+    }
+    if (m_op_count == PSTORAGE_CMD_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_op          = &m_ops[m_op_count++];
+    p_op->op_code = op_code;
+    p_op->handle  = *p_handle;
+    p_op->p_src   = p_src;
+    p_op->size    = size;
+    p_op->offset  = offset;
+    if (m_op_count == 1)
+    {
+        op_start();
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t pstorage_store(pstorage_handle_t * p_dest, uint8_t * p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+    if (p_src == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    return op_queue(PSTORAGE_STORE_OP_CODE, p_dest, p_src, size, offset);
+}
+
+
+uint32_t pstorage_clear(pstorage_handle_t * p_base_id, pstorage_size_t size)
+{
+    return op_queue(PSTORAGE_CLEAR_OP_CODE, p_base_id, NULL, size, 0);
+}
+
+
+uint32_t pstorage_load(uint8_t * p_dest, pstorage_handle_t * p_src, pstorage_size_t size, pstorage_size_t offset)
+{
+    if ((p_dest == NULL) || (p_src == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    memcpy(p_dest, flash_ptr(p_src->block_id + offset), size);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t pstorage_access_status_get(uint32_t * p_count)
+{
+    *p_count = m_op_count;
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,321 @@
+#include <stdint.h>
+#include <string.h>
+#include "lcd_defs.h"
+#include "rgb_lcd.h"
+#include "emu.h"
+
+
+#define HD44780_OSC_HZ          270000                               /**< Nominal oscillator clock, execution times scale with it. */
+#define HD44780_CYCLES_FAST     10                                   /**< Oscillator cycles for most instructions (37 us). */
+#define HD44780_CYCLES_WRITE    11                                   /**< Oscillator cycles for a RAM write (37 us + 4 us address update). */
+#define HD44780_CYCLES_SLOW     410                                  /**< Oscillator cycles for clear display and return home (1.52 ms). */
+#define HD44780_POWER_ON_NS     (40 * EMU_NS_PER_MS)                 /**< Time from power on until instructions are accepted. */
+#define HD44780_DDRAM_SIZE      0x80
+#define HD44780_CGRAM_SIZE      0x40
+#define HD44780_LINE_LEN        40                                   /**< DDRAM cells per line in 2-line mode. */
+#define HD44780_LINE2_ADDR      0x40
+
+#define CONTROL_CO              0x80                                 /**< Control byte: another control byte follows the next byte. */
+#define CONTROL_RS              0x40                                 /**< Control byte: the following bytes are data, not instructions. */
+
+static uint8_t  m_ddram[HD44780_DDRAM_SIZE];
+static uint8_t  m_cgram[HD44780_CGRAM_SIZE];
+static uint8_t  m_ac;                                                /**< Address counter. */
+static bool     m_ac_cgram;                                          /**< Set if the address counter points into CGRAM. */
+static uint8_t  m_entry = LCD_ENTRYLEFT;                             /**< Entry mode flags. */
+static uint8_t  m_control;                                           /**< Display control flags, display off after reset. */
+static uint8_t  m_function;                                          /**< Function set flags. */
+static uint8_t  m_shift;                                             /**< Display shift, in cells to the left. */
+static uint64_t m_busy_until;                                        /**< Time the running instruction completes. */
+static bool     m_powered;                                           /**< Set once the power-on reset contents have been set up. */
+
+static bool     m_expect_control;                                    /**< Next byte of the transfer is a control byte. */
+static bool     m_single;                                            /**< Only one byte follows the last control byte. */
+static bool     m_rs;                                                /**< Register select of the last control byte. */
+
+static emu_lcd_stats_t m_stats;
+
+
+/**@brief Function for setting up the power-on reset state, DDRAM blank and CGRAM random. */
+static void power_on(void)
+{
+    uint8_t i;
+
+    if (m_powered)
+    {
+        return;
+    }
+    m_powered = true;
+
+    memset(m_ddram, ' ', sizeof(m_ddram));
+    for (i = 0; i < sizeof(m_cgram); i++)
+    {
+        m_cgram[i] = (i & 1) ? 0x15 : 0x0A;
+    }
+}
+
+
+static bool two_line(void)
+{
+    return (m_function & LCD_2LINE) != 0;
+}
+
+
+/**@brief Function for moving the address counter one cell the way the controller does. */
+static void ac_step(bool increment)
+{
+    if (m_ac_cgram)
+    {
+        m_ac = (m_ac + (increment ? 1 : -1)) & (HD44780_CGRAM_SIZE - 1);
+    }
+    else if (two_line())
+    {
+        if (increment)
+        {
+            m_ac = (m_ac == HD44780_LINE_LEN - 1) ? HD44780_LINE2_ADDR
+                 : (m_ac == HD44780_LINE2_ADDR + HD44780_LINE_LEN - 1) ? 0 : m_ac + 1;
+        }
+        else
+        {
+            m_ac = (m_ac == 0) ? HD44780_LINE2_ADDR + HD44780_LINE_LEN - 1
+                 : (m_ac == HD44780_LINE2_ADDR) ? HD44780_LINE_LEN - 1 : m_ac - 1;
+        }
+    }
+    else
+    {
+        m_ac = increment ? ((m_ac + 1) % (2 * HD44780_LINE_LEN))
+                         : ((m_ac + 2 * HD44780_LINE_LEN - 1) % (2 * HD44780_LINE_LEN));
+    }
+}
+
+
+static void shift_step(bool right)
+{
+    // Shifting the display right moves the visible window left over DDRAM.
+    m_shift = (m_shift + (right ? HD44780_LINE_LEN - 1 : 1)) % HD44780_LINE_LEN;
+}
+
+
+/**@brief Function for executing an instruction.
+ *
+ * @return Oscillator cycles the instruction takes.
+ */
+static uint32_t instruction(uint8_t value)
+{
+    if (value & LCD_SETDDRAMADDR)
+    {
+        m_ac       = value & 0x7F;
+        m_ac_cgram = false;
+        emu_log("lcd   set DDRAM address 0x%02X", m_ac);
+    }
+    else if (value & LCD_SETCGRAMADDR)
+    {
+        m_ac       = value & 0x3F;
+        m_ac_cgram = true;
+        emu_log("lcd   set CGRAM address 0x%02X", m_ac);
+    }
+    else if (value & LCD_FUNCTIONSET)
+    {
+        m_function = value;
+        emu_log("lcd   function set 0x%02X", value);
+    }
+    else if (value & LCD_CURSORSHIFT)
+    {
+        if (value & LCD_DISPLAYMOVE)
+        {
+            shift_step((value & LCD_MOVERIGHT) != 0);
+            emu_log("lcd   display shift %s, window at %u", (value & LCD_MOVERIGHT) ? "right" : "left", m_shift);
+        }
+        else
+        {
+            ac_step((value & LCD_MOVERIGHT) != 0);
+            emu_log("lcd   cursor shift %s", (value & LCD_MOVERIGHT) ? "right" : "left");
+        }
+    }
+    else if (value & LCD_DISPLAYCONTROL)
+    {
+        m_control = value;
+        emu_log("lcd   display control 0x%02X", value);
+    }
+    else if (value & LCD_ENTRYMODESET)
+    {
+        m_entry = value;
+        emu_log("lcd   entry mode 0x%02X", value);
+    }
+    else if (value & LCD_RETURNHOME)
+    {
+        m_ac       = 0;
+        m_ac_cgram = false;
+        m_shift    = 0;
+        emu_log("lcd   return home");
+        return HD44780_CYCLES_SLOW;
+    }
+    else if (value & LCD_CLEARDISPLAY)
+    {
+        memset(m_ddram, ' ', sizeof(m_ddram));
+        m_ac       = 0;
+        m_ac_cgram = false;
+        m_shift    = 0;
+        m_entry   |= LCD_ENTRYLEFT;
+        emu_log("lcd   clear display");
+        return HD44780_CYCLES_SLOW;
+    }
+    else
+    {
+        emu_log("lcd   nop");
+    }
+    return HD44780_CYCLES_FAST;
+}
+
+
+/**@brief Function for writing a data byte at the address counter. */
+static uint32_t data_write(uint8_t value)
+{
+    if (m_ac_cgram)
+    {
+        emu_log("lcd   data 0x%02X -> CGRAM 0x%02X", value, m_ac);
+        m_cgram[m_ac] = value & LCD_GLYPH_ROW_MASK;
+    }
+    else
+    {
+        emu_log("lcd   data 0x%02X '%c' -> DDRAM 0x%02X", value,
+                ((value >= 0x20) && (value < 0x7F)) ? value : '?', m_ac);
+        m_ddram[m_ac & (HD44780_DDRAM_SIZE - 1)] = value;
+    }
+
+    ac_step((m_entry & LCD_ENTRYLEFT) != 0);
+    if (!m_ac_cgram && (m_entry & LCD_ENTRYSHIFTINCREMENT))
+    {
+        shift_step((m_entry & LCD_ENTRYLEFT) == 0);
+    }
+    return HD44780_CYCLES_WRITE;
+}
+
+
+/**@brief Function for handling an instruction or data byte, checking the controller is ready. */
+static void execute(bool rs, uint8_t value)
+{
+    uint64_t now = emu_now();
+    uint32_t cycles;
+
+    if (now < HD44780_POWER_ON_NS)
+    {
+        m_stats.busy_violations++;
+        emu_fail("lcd %s 0x%02X sent %.3f ms after power on, before the controller is ready",
+                 rs ? "data" : "instruction", value, (double)now / EMU_NS_PER_MS);
+    }
+    else if (now < m_busy_until)
+    {
+        m_stats.busy_violations++;
+        emu_fail("lcd %s 0x%02X sent while the controller is busy for another %.1f us",
+                 rs ? "data" : "instruction", value, (double)(m_busy_until - now) / EMU_NS_PER_US);
+    }
+
+    if (rs)
+    {
+        m_stats.data_writes++;
+        cycles = data_write(value);
+    }
+    else
+    {
+        m_stats.instructions++;
+        cycles = instruction(value);
+    }
+    m_stats.osc_cycles += cycles;
+    m_busy_until        = now + cycles * EMU_NS_PER_S / HD44780_OSC_HZ;
+}
+
+
+static void lcd_start(void)
+{
+    power_on();
+    m_expect_control = true;
+}
+
+
+static void lcd_write(uint8_t data)
+{
+    if (m_expect_control)
+    {
+        m_single         = (data & CONTROL_CO) != 0;
+        m_rs             = (data & CONTROL_RS) != 0;
+        m_expect_control = false;
+        return;
+    }
+
+    execute(m_rs, data);
+    if (m_single)
+    {
+        m_expect_control = true;
+    }
+}
+
+
+static void lcd_stop(void)
+{
+}
+
+
+const emu_i2c_device_t g_emu_lcd =
+{
+    .address = LCD_ADDRESS >> 1,
+    .p_name  = "LCD",
+    .start   = lcd_start,
+    .write   = lcd_write,
+    .stop    = lcd_stop,
+};
+
+
+void emu_lcd_cells(uint8_t row, uint8_t * p_cells)
+{
+    uint8_t col;
+
+    power_on();
+    for (col = 0; col < LCD_COLS; col++)
+    {
+        uint8_t offset = (col + m_shift) % HD44780_LINE_LEN;
+
+        if (!(m_control & LCD_DISPLAYON))
+        {
+            p_cells[col] = ' ';
+        }
+        else if (two_line())
+        {
+            p_cells[col] = m_ddram[row * HD44780_LINE2_ADDR + offset];
+        }
+        else
+        {
+            p_cells[col] = (row == 0) ? m_ddram[offset] : ' ';
+        }
+    }
+}
+
+
+void emu_lcd_row(uint8_t row, char * p_text)
+{
+    uint8_t cells[LCD_COLS];
+    uint8_t col;
+
+    emu_lcd_cells(row, cells);
+    for (col = 0; col < LCD_COLS; col++)
+    {
+        uint8_t c = cells[col];
+
+        // User defined characters show as '#', anything else outside ASCII as '?'.
+        p_text[col] = (c < 2 * LCD_GLYPH_COUNT) ? '#' : ((c >= 0x20) && (c < 0x7F)) ? (char)c : '?';
+    }
+    p_text[LCD_COLS] = '\0';
+}
+
+
+void emu_lcd_glyph(uint8_t code, uint8_t * p_rows)
+{
+    power_on();
+    memcpy(p_rows, &m_cgram[(code % LCD_GLYPH_COUNT) * LCD_GLYPH_ROWS], LCD_GLYPH_ROWS);
+}
+
+
+void emu_lcd_stats_get(emu_lcd_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
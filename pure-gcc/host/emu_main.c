@@ -0,0 +1,530 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "nrf.h"
+#include "nrf_error.h"
+#include "nrf_soc.h"
+#include "nrf_delay.h"
+#include "app_util_platform.h"
+#include "rgb_lcd.h"
+#include "emu.h"
+
+
+#define EMU_CRITICAL_REGION_NS  (1 * EMU_NS_PER_US)                  /**< Virtual time charged per critical region, about one SVC round trip; lets a spin on a full queue make progress. */
+#define EMU_IRQ_COUNT           32
+
+int firmware_main(void);                                             /**< main() of main.c, renamed by the Makefile. */
+
+NRF_UART_Type    host_nrf_uart0;
+NRF_TWI_Type     host_nrf_twi0;
+NRF_RTC_Type     host_nrf_rtc1;
+NRF_GPIO_Type    host_nrf_gpio;
+NRF_FICR_Type    host_nrf_ficr = {.CODEPAGESIZE = 1024, .CODESIZE = 256};
+NRF_UICR_Type    host_nrf_uicr = {.BOOTLOADERADDR = 0xFFFFFFFF};
+
+bool             g_emu_verbose;
+bool             g_emu_bench;
+
+static uint64_t      m_now;                                          /**< Virtual time. */
+static emu_event_t * mp_events;                                      /**< Pending events, sorted by time. */
+static uint8_t       m_level = EMU_PRIO_THREAD;                      /**< Priority of the code running now. */
+static uint32_t      m_critical_depth;                               /**< Critical region nesting. */
+static bool          m_wake;                                         /**< Set by every interrupt, cleared by sd_app_evt_wait(). */
+static bool          m_irq_enabled[EMU_IRQ_COUNT];
+static uint32_t      m_failures;
+static uint32_t      m_wakeups;
+static uint64_t      m_cpu_ns;                                       /**< Host time spent running the main loop. */
+static uint64_t      m_cpu_max_ns;                                   /**< Longest single main loop pass. */
+static uint64_t      m_cpu_start;
+
+
+static uint64_t host_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * EMU_NS_PER_S + (uint64_t)ts.tv_nsec;
+}
+
+
+static void clock_set(uint64_t time_ns)
+{
+    if (time_ns > m_now)
+    {
+        m_now = time_ns;
+    }
+    *(uint32_t *)&host_nrf_rtc1.COUNTER = emu_rtc_counter();          // Read-only for the firmware.
+}
+
+
+uint64_t emu_now(void)
+{
+    return m_now;
+}
+
+
+void emu_event_schedule(emu_event_t * p_event, uint64_t time_ns)
+{
+    emu_event_t ** pp_link = &mp_events;
+
+    emu_event_cancel(p_event);
+
+    // Events due at the same time run in the order they were scheduled.
+    while ((*pp_link != NULL) && ((*pp_link)->time_ns <= time_ns))
+    {
+        pp_link = &(*pp_link)->p_next;
+    }
+    p_event->time_ns = time_ns;
+    p_event->pending = true;
+    p_event->p_next  = *pp_link;
+    *pp_link         = p_event;
+}
+
+
+void emu_event_cancel(emu_event_t * p_event)
+{
+    emu_event_t ** pp_link = &mp_events;
+
+    if (!p_event->pending)
+    {
+        return;
+    }
+    while (*pp_link != p_event)
+    {
+        pp_link = &(*pp_link)->p_next;
+    }
+    *pp_link         = p_event->p_next;
+    p_event->pending = false;
+}
+
+
+void emu_irq_enter(uint8_t prio, uint8_t * p_saved)
+{
+    *p_saved = m_level;
+    m_level  = prio;
+    m_wake   = true;
+    emu_stack_irq_enter();
+}
+
+
+void emu_irq_exit(uint8_t saved)
+{
+    emu_stack_irq_exit();
+    m_level = saved;
+}
+
+
+bool emu_irq_enabled(int irqn)
+{
+    return (irqn >= 0) && (irqn < EMU_IRQ_COUNT) && m_irq_enabled[irqn];
+}
+
+
+bool emu_irq_allowed(uint8_t prio)
+{
+    return (m_critical_depth == 0) && (prio < m_level);
+}
+
+
+/**@brief Function for letting the peripheral models see registers the firmware has written and
+ *        deliver pending interrupts.
+ */
+static void peripherals_poll(void)
+{
+    emu_twi_poll();
+    emu_uart_poll();
+}
+
+
+/**@brief Function for finding the first due event that may run now: hardware events always,
+ *        handlers only if they preempt the running code.
+ */
+static emu_event_t * event_runnable(uint64_t until_ns)
+{
+    emu_event_t * p_event;
+
+    for (p_event = mp_events; (p_event != NULL) && (p_event->time_ns <= until_ns); p_event = p_event->p_next)
+    {
+        if ((p_event->prio == EMU_PRIO_HW) || emu_irq_allowed(p_event->prio))
+        {
+            return p_event;
+        }
+    }
+    return NULL;
+}
+
+
+void emu_run(uint64_t until_ns)
+{
+    emu_event_t * p_event;
+
+    while ((p_event = event_runnable(until_ns)) != NULL)
+    {
+        uint8_t saved;
+
+        emu_event_cancel(p_event);
+        clock_set(p_event->time_ns);
+
+        if (p_event->prio == EMU_PRIO_HW)
+        {
+            p_event->handler(p_event->p_context);
+            continue;
+        }
+
+        emu_irq_enter(p_event->prio, &saved);
+        p_event->handler(p_event->p_context);
+        emu_irq_exit(saved);
+
+        // Interrupts pended by the hardware while the handler ran.
+        peripherals_poll();
+    }
+    clock_set(until_ns);
+}
+
+
+static void log_prefix(void)
+{
+    printf("%10.3f ms  ", (double)m_now / EMU_NS_PER_MS);
+}
+
+
+void emu_log(const char * p_fmt, ...)
+{
+    va_list args;
+
+    if (!g_emu_verbose)
+    {
+        return;
+    }
+    log_prefix();
+    va_start(args, p_fmt);
+    vprintf(p_fmt, args);
+    va_end(args);
+    putchar('\n');
+}
+
+
+void emu_fail(const char * p_fmt, ...)
+{
+    va_list args;
+
+    m_failures++;
+    log_prefix();
+    printf("FAIL: ");
+    va_start(args, p_fmt);
+    vprintf(p_fmt, args);
+    va_end(args);
+    putchar('\n');
+}
+
+
+static void report(void)
+{
+    emu_twi_stats_t twi;
+    emu_lcd_stats_t lcd;
+    uint8_t         rgb[3];
+    uint32_t        ble_writes;
+    uint32_t        notifications;
+    uint32_t        notified_bytes;
+    uint32_t        radio_events;
+    uint32_t        flash_writes;
+    uint32_t        flash_erases;
+    char            text[LCD_COLS + 1];
+
+    emu_twi_stats_get(&twi);
+    emu_lcd_stats_get(&lcd);
+    emu_rgb_color(rgb);
+    emu_ble_stats(&ble_writes, &notifications, &notified_bytes, &radio_events);
+    emu_flash_stats(&flash_writes, &flash_erases);
+
+    printf("--- emulator report ---\n");
+    printf("virtual time   %.3f ms, %u wake-ups\n", (double)m_now / EMU_NS_PER_MS, m_wakeups);
+    printf("i2c            %u kHz, %u transfers, %u stops, %u bytes, %u nacks, %llu scl cycles, busy %.3f ms\n",
+           emu_twi_khz(), twi.transfers, twi.stops, twi.bytes, twi.nacks,
+           (unsigned long long)twi.scl_cycles, (double)twi.busy_ns / EMU_NS_PER_MS);
+    printf("lcd            %u instructions, %u data writes, %u busy violations, %llu osc cycles\n",
+           lcd.instructions, lcd.data_writes, lcd.busy_violations, (unsigned long long)lcd.osc_cycles);
+    printf("rgb            %u register writes, color %u %u %u\n", emu_rgb_reg_writes(), rgb[0], rgb[1], rgb[2]);
+    printf("ble            %u writes, %u notifications (%u bytes), %u radio events\n",
+           ble_writes, notifications, notified_bytes, radio_events);
+    printf("uart           %u bytes received\n", emu_uart_rx_count());
+    printf("flash          %u writes, %u erases\n", flash_writes, flash_erases);
+    printf("host cpu       %.3f ms in the firmware, longest wake-up %.3f ms\n",
+           (double)m_cpu_ns / EMU_NS_PER_MS, (double)m_cpu_max_ns / EMU_NS_PER_MS);
+    printf("stack          %u bytes peak (host frames)\n", emu_stack_peak());
+    emu_lcd_row(0, text);
+    printf("screen         |%s|\n", text);
+    emu_lcd_row(1, text);
+    printf("               |%s|\n", text);
+    printf("result         %s (%u failures)\n", (m_failures == 0) ? "PASS" : "FAIL", m_failures);
+}
+
+
+void emu_finish(void)
+{
+    report();
+    emu_flash_save();
+    fflush(stdout);
+    exit((m_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+void emu_app_error(uint32_t error_code, uint32_t line_num, const char * p_file_name)
+{
+    emu_fail("app error 0x%X at %s:%u", error_code, p_file_name, line_num);
+    emu_finish();
+}
+
+
+/**@brief Function for advancing to the next event or trace command while the CPU sleeps. */
+static void sleep_step(void)
+{
+    uint64_t next = (mp_events != NULL) ? mp_events->time_ns : EMU_TIME_NEVER;
+    uint64_t due  = emu_script_due();
+
+    // Events due at the same time as the command go first, so it sees their outcome.
+    if ((due != EMU_TIME_NEVER) && (due < next))
+    {
+        clock_set(due);
+        emu_script_step();
+        return;
+    }
+    // The run ends with the trace, a connected or advertising device has events forever.
+    if ((next == EMU_TIME_NEVER) || (due == EMU_TIME_NEVER))
+    {
+        emu_finish();
+    }
+    emu_run(next);
+}
+
+
+/**@brief Function for running the rest of the trace with the CPU and peripherals off. */
+void emu_power_off(void)
+{
+    uint64_t due;
+
+    while (mp_events != NULL)
+    {
+        emu_event_cancel(mp_events);
+    }
+    while ((due = emu_script_due()) != EMU_TIME_NEVER)
+    {
+        clock_set(due);
+        emu_script_step();
+    }
+    emu_finish();
+}
+
+
+uint32_t sd_app_evt_wait(void)
+{
+    uint64_t pass_ns = host_clock_ns() - m_cpu_start;
+
+    m_cpu_ns    += pass_ns;
+    m_cpu_max_ns = (pass_ns > m_cpu_max_ns) ? pass_ns : m_cpu_max_ns;
+
+    if (m_level != EMU_PRIO_THREAD)
+    {
+        emu_fail("sd_app_evt_wait() called from an interrupt");
+        emu_finish();
+    }
+
+    peripherals_poll();
+    while (!m_wake)
+    {
+        sleep_step();
+    }
+    m_wake = false;
+    m_wakeups++;
+
+    m_cpu_start = host_clock_ns();
+    return NRF_SUCCESS;
+}
+
+
+void critical_region_enter(void)
+{
+    m_critical_depth++;
+}
+
+
+void critical_region_exit(void)
+{
+    if (--m_critical_depth == 0)
+    {
+        peripherals_poll();
+        emu_run(m_now + EMU_CRITICAL_REGION_NS);
+    }
+}
+
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+    *p_is_nested_critical_region = (m_critical_depth != 0);
+    critical_region_enter();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    (void)is_nested_critical_region;
+    critical_region_exit();
+    return NRF_SUCCESS;
+}
+
+
+void nrf_delay_us(uint32_t volatile number_of_us)
+{
+    peripherals_poll();
+    emu_run(m_now + number_of_us * EMU_NS_PER_US);
+}
+
+
+void nrf_delay_ms(uint32_t volatile number_of_ms)
+{
+    nrf_delay_us(number_of_ms * 1000);
+}
+
+
+void NVIC_SetPriority(IRQn_Type irqn, uint32_t priority)
+{
+    (void)irqn;
+    (void)priority;
+}
+
+
+void NVIC_EnableIRQ(IRQn_Type irqn)
+{
+    m_irq_enabled[irqn] = true;
+}
+
+
+void NVIC_DisableIRQ(IRQn_Type irqn)
+{
+    m_irq_enabled[irqn] = false;
+}
+
+
+void NVIC_ClearPendingIRQ(IRQn_Type irqn)
+{
+    (void)irqn;
+}
+
+
+void NVIC_SetPendingIRQ(IRQn_Type irqn)
+{
+    (void)irqn;
+}
+
+
+void NVIC_SystemReset(void)
+{
+    emu_fail("system reset");
+    emu_finish();
+}
+
+
+uint32_t sd_nvic_SetPriority(uint32_t irqn, uint32_t priority)
+{
+    NVIC_SetPriority((IRQn_Type)irqn, priority);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_nvic_EnableIRQ(uint32_t irqn)
+{
+    NVIC_EnableIRQ((IRQn_Type)irqn);
+    return NRF_SUCCESS;
+}
+
+
+void __WFE(void)
+{
+}
+
+
+void __SEV(void)
+{
+}
+
+
+void __DMB(void)
+{
+    __sync_synchronize();
+}
+
+
+void __disable_irq(void)
+{
+    critical_region_enter();
+}
+
+
+void __enable_irq(void)
+{
+    critical_region_exit();
+}
+
+
+static void usage(const char * p_name)
+{
+    fprintf(stderr,
+            "usage: %s [-v] [-k khz] [-f flash.bin] [-B baseline] trace\n"
+            "  -v        log every bus byte and BLE event\n"
+            "  -k khz    run the I2C bus at this clock instead of the TWI0 FREQUENCY register\n"
+            "  -f file   load and save the data flash pages, to test restore across resets\n"
+            "  -B file   benchmark run, fail if a workload does worse than its line in file\n",
+            p_name);
+    exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char * argv[])
+{
+    const char * p_flash = NULL;
+    int          opt;
+
+    while ((opt = getopt(argc, argv, "vk:f:B:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'v':
+                g_emu_verbose = true;
+                break;
+
+            case 'k':
+                emu_twi_force_khz((uint32_t)atoi(optarg));
+                break;
+
+            case 'f':
+                p_flash = optarg;
+                break;
+
+            case 'B':
+                g_emu_bench = true;
+                if (!emu_bench_baseline_load(optarg))
+                {
+                    usage(argv[0]);
+                }
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+    if ((optind + 1 != argc) || !emu_script_open(argv[optind]))
+    {
+        usage(argv[0]);
+    }
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    emu_flash_init(p_flash);
+
+    emu_stack_init();
+    m_cpu_start = host_clock_ns();
+    return firmware_main();
+}
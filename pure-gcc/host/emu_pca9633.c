@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <string.h>
+#include "lcd_defs.h"
+#include "emu.h"
+
+
+#define PCA9633_REG_COUNT       13                                   /**< MODE1 to ALLCALLADR. */
+#define PCA9633_MODE1_SLEEP     0x10                                 /**< Oscillator off, all outputs off. */
+#define PCA9633_CONTROL_AI_MASK 0xE0                                 /**< Auto-increment flags of the control register. */
+#define PCA9633_CONTROL_REG     0x0F                                 /**< Register pointer of the control register. */
+
+/**@brief Registers after power on. */
+static const uint8_t m_reset_regs[PCA9633_REG_COUNT] =
+{
+    0x11, 0x05, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xE2, 0xE4, 0xE8, 0xE0
+};
+
+static const char * const m_reg_names[PCA9633_REG_COUNT] =
+{
+    "MODE1", "MODE2", "PWM0", "PWM1", "PWM2", "PWM3", "GRPPWM", "GRPFREQ", "LEDOUT",
+    "SUBADR1", "SUBADR2", "SUBADR3", "ALLCALLADR"
+};
+
+static uint8_t  m_regs[PCA9633_REG_COUNT];
+static bool     m_powered;
+static bool     m_expect_control;                                    /**< Next byte of the transfer is the control register. */
+static uint8_t  m_pointer;                                           /**< Register the next data byte goes to. */
+static uint8_t  m_auto_increment;                                    /**< Auto-increment flags of the last control register write. */
+static uint32_t m_reg_writes;
+
+
+static void power_on(void)
+{
+    if (!m_powered)
+    {
+        m_powered = true;
+        memcpy(m_regs, m_reset_regs, sizeof(m_regs));
+    }
+}
+
+
+/**@brief Function for advancing the register pointer as selected by the AI2..AI0 flags. */
+static void pointer_advance(void)
+{
+    uint8_t first;
+    uint8_t last;
+
+    switch (m_auto_increment)
+    {
+        case 0x80:
+            first = REG_MODE1;
+            last  = PCA9633_REG_COUNT - 1;
+            break;
+
+        case 0xA0:
+            first = REG_BLUE;
+            last  = REG_PWM3;
+            break;
+
+        case 0xC0:
+            first = REG_GRPPWM;
+            last  = REG_GRPFREQ;
+            break;
+
+        case 0xE0:
+            first = REG_BLUE;
+            last  = REG_GRPFREQ;
+            break;
+
+        default:
+            // No auto-increment, all data goes to the same register.
+            return;
+    }
+    m_pointer = ((m_pointer >= last) || (m_pointer < first)) ? first : m_pointer + 1;
+}
+
+
+static void rgb_start(void)
+{
+    power_on();
+    m_expect_control = true;
+}
+
+
+static void rgb_write(uint8_t data)
+{
+    if (m_expect_control)
+    {
+        m_expect_control = false;
+        m_auto_increment = data & PCA9633_CONTROL_AI_MASK;
+        m_pointer        = data & PCA9633_CONTROL_REG;
+        return;
+    }
+
+    if (m_pointer < PCA9633_REG_COUNT)
+    {
+        emu_log("rgb   %s = 0x%02X", m_reg_names[m_pointer], data);
+        m_regs[m_pointer] = data;
+        m_reg_writes++;
+    }
+    else
+    {
+        emu_fail("rgb write 0x%02X to reserved register 0x%02X", data, m_pointer);
+    }
+    pointer_advance();
+}
+
+
+static void rgb_stop(void)
+{
+}
+
+
+const emu_i2c_device_t g_emu_rgb =
+{
+    .address = RGB_ADDRESS >> 1,
+    .p_name  = "RGB",
+    .start   = rgb_start,
+    .write   = rgb_write,
+    .stop    = rgb_stop,
+};
+
+
+/**@brief Function for getting the brightness of one output from its LEDOUT state. */
+static uint8_t output_level(uint8_t led)
+{
+    uint8_t state = (m_regs[REG_OUTPUT] >> (2 * led)) & 0x03;
+
+    if (m_regs[REG_MODE1] & PCA9633_MODE1_SLEEP)
+    {
+        return 0;
+    }
+    switch (state)
+    {
+        case 0x01:
+            return 0xFF;
+
+        case 0x02:
+            return m_regs[REG_BLUE + led];
+
+        case 0x03:
+            // Group blinking switches the output on and off, report it as on.
+            if (m_regs[REG_MODE2] & RGB_MODE2_DMBLNK)
+            {
+                return m_regs[REG_BLUE + led];
+            }
+            return (uint8_t)((m_regs[REG_BLUE + led] * m_regs[REG_GRPPWM]) / 256);
+
+        default:
+            return 0;
+    }
+}
+
+
+void emu_rgb_color(uint8_t * p_rgb)
+{
+    power_on();
+    p_rgb[0] = output_level(REG_RED - REG_BLUE);
+    p_rgb[1] = output_level(REG_GREEN - REG_BLUE);
+    p_rgb[2] = output_level(0);
+}
+
+
+uint8_t emu_rgb_reg(uint8_t addr)
+{
+    power_on();
+    return (addr < PCA9633_REG_COUNT) ? m_regs[addr] : 0;
+}
+
+
+bool emu_rgb_reg_find(const char * p_name, uint8_t * p_addr)
+{
+    uint8_t i;
+
+    for (i = 0; i < PCA9633_REG_COUNT; i++)
+    {
+        if (strcmp(p_name, m_reg_names[i]) == 0)
+        {
+            *p_addr = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+uint32_t emu_rgb_reg_writes(void)
+{
+    return m_reg_writes;
+}
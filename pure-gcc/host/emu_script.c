@@ -0,0 +1,863 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ble_nus.h"
+#include "rgb_lcd.h"
+#include "emu.h"
+
+
+#define SCRIPT_LINE_MAX         1024
+#define SCRIPT_DATA_MAX         512                                  /**< Longest string or byte list of a command. */
+#define SCRIPT_CONN_INTERVAL_MS 30                                   /**< Connection interval when connect gives none. */
+
+/**@brief Trace command. */
+typedef struct
+{
+    const char * p_name;
+    bool         needs_cpu;                                          /**< Talks to the firmware, not possible after system off. */
+    bool         (*handler)(char * p_args);
+} script_cmd_t;
+
+static FILE *   mp_file;
+static uint32_t m_line;
+static uint64_t m_due = EMU_TIME_NEVER;
+static uint32_t m_bus_bytes;                                         /**< Bus bytes at the last expect_bus. */
+
+
+static void fail(const char * p_what)
+{
+    emu_fail("trace line %u: %s", m_line, p_what);
+}
+
+
+static char * skip_space(char * p)
+{
+    while (isspace((unsigned char)*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+
+/**@brief Function for parsing a quoted string with C escapes (\n, \", \\, \xNN). */
+static bool string_parse(char ** pp, uint8_t * p_data, uint16_t * p_length)
+{
+    char *   p      = skip_space(*pp);
+    uint16_t length = 0;
+
+    if (*p++ != '"')
+    {
+        return false;
+    }
+    while (*p != '"')
+    {
+        uint8_t c = (uint8_t)*p++;
+
+        if (c == '\0' || length == SCRIPT_DATA_MAX)
+        {
+            return false;
+        }
+        if (c == '\\')
+        {
+            c = (uint8_t)*p++;
+            switch (c)
+            {
+                case 'n':
+                    c = '\n';
+                    break;
+
+                case 'r':
+                    c = '\r';
+                    break;
+
+                case 'x':
+                {
+                    char hex[3] = {p[0], (p[0] != '\0') ? p[1] : '\0', '\0'};
+                    char * end;
+
+                    c  = (uint8_t)strtoul(hex, &end, 16);
+                    if (end != &hex[2])
+                    {
+                        return false;
+                    }
+                    p += 2;
+                    break;
+                }
+
+                case '\\':
+                case '"':
+                    break;
+
+                default:
+                    return false;
+            }
+        }
+        p_data[length++] = c;
+    }
+    *pp       = p + 1;
+    *p_length = length;
+    return true;
+}
+
+
+static bool number_parse(char ** pp, int base, uint32_t * p_value)
+{
+    char * p   = skip_space(*pp);
+    char * end;
+
+    *p_value = (uint32_t)strtoul(p, &end, base);
+    if (end == p)
+    {
+        return false;
+    }
+    *pp = end;
+    return true;
+}
+
+
+/**@brief Function for checking that only a comment is left on the line. */
+static bool line_end(char * p)
+{
+    p = skip_space(p);
+    return (*p == '\0') || (*p == '#');
+}
+
+
+static bool cmd_wait(char * p_args)
+{
+    char * end;
+    double ms = strtod(p_args, &end);
+
+    if ((end == p_args) || !line_end(end) || (ms < 0))
+    {
+        return false;
+    }
+    m_due = emu_now() + (uint64_t)(ms * EMU_NS_PER_MS);
+    return true;
+}
+
+
+static bool cmd_connect(char * p_args)
+{
+    uint32_t interval_ms = SCRIPT_CONN_INTERVAL_MS;
+
+    if (!line_end(p_args) && !number_parse(&p_args, 0, &interval_ms))
+    {
+        return false;
+    }
+    if (!emu_ble_connect(interval_ms))
+    {
+        fail("connect: not advertising, or not to this central");
+    }
+    return true;
+}
+
+
+static bool cmd_disconnect(char * p_args)
+{
+    if (!emu_ble_disconnect())
+    {
+        fail("disconnect: not connected");
+    }
+    return line_end(p_args);
+}
+
+
+static bool cmd_pair(char * p_args)
+{
+    if (!line_end(p_args))
+    {
+        return false;
+    }
+    if (!emu_ble_pair())
+    {
+        fail("pair: not connected or already pairing");
+    }
+    return true;
+}
+
+
+static bool cmd_encrypt(char * p_args)
+{
+    if (!line_end(p_args))
+    {
+        return false;
+    }
+    if (!emu_ble_encrypt())
+    {
+        fail("encrypt: not connected or security procedure in progress");
+    }
+    return true;
+}
+
+
+static bool cmd_notify(char * p_args)
+{
+    bool on;
+
+    p_args = skip_space(p_args);
+    if (strncmp(p_args, "on", 2) == 0)
+    {
+        on = true;
+    }
+    else if (strncmp(p_args, "off", 3) == 0)
+    {
+        on = false;
+    }
+    else
+    {
+        return false;
+    }
+    if (!emu_ble_cccd_write(BLE_UUID_NUS_RX_CHARACTERISTIC, on))
+    {
+        fail("notify: not connected");
+    }
+    return true;
+}
+
+
+static void nus_write(const uint8_t * p_data, uint16_t length)
+{
+    if (!emu_ble_write(BLE_UUID_NUS_TX_CHARACTERISTIC, p_data, length))
+    {
+        fail("write: not connected");
+    }
+}
+
+
+/**@brief Parse hex bytes up to the end of the line. */
+static bool bytes_parse(char * p_args, uint8_t * p_data, uint16_t max_length, uint16_t * p_length)
+{
+    uint32_t value;
+
+    *p_length = 0;
+    while (!line_end(p_args))
+    {
+        if ((*p_length == max_length) || !number_parse(&p_args, 16, &value) || (value > 0xFF))
+        {
+            return false;
+        }
+        p_data[(*p_length)++] = (uint8_t)value;
+    }
+    return true;
+}
+
+
+static bool cmd_write(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint16_t length;
+
+    if (!bytes_parse(p_args, data, sizeof(data), &length))
+    {
+        return false;
+    }
+    nus_write(data, length);
+    return true;
+}
+
+
+static bool cmd_write_cmd(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint16_t length;
+
+    if (!bytes_parse(p_args, data, sizeof(data), &length))
+    {
+        return false;
+    }
+    if (!emu_ble_write_cmd(BLE_UUID_NUS_TX_CHARACTERISTIC, data, length))
+    {
+        fail("write_cmd: not connected or too long");
+    }
+    return true;
+}
+
+
+static bool cmd_text(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint16_t length;
+
+    if (!string_parse(&p_args, data, &length) || !line_end(p_args))
+    {
+        return false;
+    }
+    nus_write(data, length);
+    return true;
+}
+
+
+static bool cmd_expect_status(char * p_args)
+{
+    uint32_t status;
+
+    if (!number_parse(&p_args, 16, &status) || !line_end(p_args))
+    {
+        return false;
+    }
+    if (emu_ble_write_status() != status)
+    {
+        emu_fail("trace line %u: write status 0x%04X, expected 0x%04X", m_line, emu_ble_write_status(), status);
+    }
+    return true;
+}
+
+
+static bool cmd_uart(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint16_t length;
+
+    if (!string_parse(&p_args, data, &length) || !line_end(p_args))
+    {
+        return false;
+    }
+    emu_uart_rx(data, length);
+    return true;
+}
+
+
+static bool cmd_expect(char * p_args)
+{
+    uint8_t  expected[SCRIPT_DATA_MAX];
+    uint8_t  cells[LCD_COLS];
+    uint16_t length;
+    uint32_t row;
+    char     text[LCD_COLS + 1];
+
+    if (!number_parse(&p_args, 10, &row) || (row >= LCD_ROWS) ||
+        !string_parse(&p_args, expected, &length) || (length > LCD_COLS) || !line_end(p_args))
+    {
+        return false;
+    }
+    memset(&expected[length], ' ', LCD_COLS - length);
+
+    emu_lcd_cells((uint8_t)row, cells);
+    if (memcmp(cells, expected, LCD_COLS) != 0)
+    {
+        emu_lcd_row((uint8_t)row, text);
+        emu_fail("trace line %u: row %u is |%s|, expected |%.*s|", m_line, row, text, LCD_COLS, (char *)expected);
+    }
+    return true;
+}
+
+
+static bool cmd_expect_rgb(char * p_args)
+{
+    uint32_t expected[3];
+    uint8_t  rgb[3];
+    uint8_t  i;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (!number_parse(&p_args, 0, &expected[i]))
+        {
+            return false;
+        }
+    }
+    if (!line_end(p_args))
+    {
+        return false;
+    }
+
+    emu_rgb_color(rgb);
+    if ((rgb[0] != expected[0]) || (rgb[1] != expected[1]) || (rgb[2] != expected[2]))
+    {
+        emu_fail("trace line %u: color %u %u %u, expected %u %u %u",
+                 m_line, rgb[0], rgb[1], rgb[2], expected[0], expected[1], expected[2]);
+    }
+    return true;
+}
+
+
+/**@brief Function for checking a backlight driver register by its data sheet name, e.g. GRPPWM. */
+static bool cmd_expect_rgb_reg(char * p_args)
+{
+    char     name[16];
+    uint8_t  length = 0;
+    uint8_t  addr;
+    uint32_t expected;
+    uint8_t  value;
+
+    p_args = skip_space(p_args);
+    while (isalnum((unsigned char)*p_args) && (length < sizeof(name) - 1))
+    {
+        name[length++] = *p_args++;
+    }
+    name[length] = '\0';
+    if (!emu_rgb_reg_find(name, &addr) || !number_parse(&p_args, 0, &expected) ||
+        !line_end(p_args))
+    {
+        return false;
+    }
+
+    value = emu_rgb_reg(addr);
+    if (value != expected)
+    {
+        emu_fail("trace line %u: %s is 0x%02X, expected 0x%02X", m_line, name, value, expected);
+    }
+    return true;
+}
+
+
+static bool cmd_expect_conn(char * p_args)
+{
+    uint32_t interval_ms;
+    uint32_t slave_latency;
+    uint16_t interval;
+    uint16_t latency;
+
+    if (!number_parse(&p_args, 0, &interval_ms) || !number_parse(&p_args, 0, &slave_latency) ||
+        !line_end(p_args))
+    {
+        return false;
+    }
+
+    if (!emu_ble_conn_params(&interval, &latency))
+    {
+        fail("expect_conn: not connected");
+    }
+    else if ((interval * 125 != interval_ms * 100) || (latency != slave_latency))
+    {
+        emu_fail("trace line %u: connection interval %.2f ms, slave latency %u, expected %u ms, %u",
+                 m_line, interval * 1.25, latency, interval_ms, slave_latency);
+    }
+    return true;
+}
+
+
+/**@brief "expect_adv off|directed|whitelist|open [interval ms]". */
+static bool cmd_expect_adv(char * p_args)
+{
+    static const char * names[] = {"off", "directed", "whitelist", "open"};
+    char *              p_name  = skip_space(p_args);
+    size_t              length  = strcspn(p_name, " \t\r\n#");
+    uint32_t            interval_ms;
+    bool                check_interval;
+    uint8_t             type;
+    uint8_t             fp;
+    uint16_t            interval;
+    uint8_t             expected;
+    uint8_t             actual;
+
+    for (expected = 0; expected < sizeof(names) / sizeof(names[0]); expected++)
+    {
+        if ((strlen(names[expected]) == length) && (strncmp(p_name, names[expected], length) == 0))
+        {
+            break;
+        }
+    }
+    p_args         = p_name + length;
+    check_interval = !line_end(p_args);
+    if ((expected == sizeof(names) / sizeof(names[0])) || (check_interval && !number_parse(&p_args, 0, &interval_ms)) ||
+        !line_end(p_args))
+    {
+        return false;
+    }
+
+    if (!emu_ble_adv_params(&type, &fp, &interval))
+    {
+        actual = 0;
+    }
+    else if (type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND)
+    {
+        actual = 1;
+    }
+    else
+    {
+        actual = (fp == BLE_GAP_ADV_FP_ANY) ? 3 : 2;
+    }
+
+    if (actual != expected)
+    {
+        emu_fail("trace line %u: advertising %s, expected %s", m_line, names[actual], names[expected]);
+    }
+    else if (check_interval && (interval * 625 / 1000 != interval_ms))
+    {
+        emu_fail("trace line %u: advertising interval %u ms, expected %u ms",
+                 m_line, interval * 625 / 1000, interval_ms);
+    }
+    return true;
+}
+
+
+static bool cmd_expect_notify(char * p_args)
+{
+    uint8_t  expected[SCRIPT_DATA_MAX];
+    uint8_t  received[SCRIPT_DATA_MAX];
+    uint16_t length;
+    size_t   received_len;
+
+    if (!string_parse(&p_args, expected, &length) || !line_end(p_args))
+    {
+        return false;
+    }
+    received_len = emu_ble_notified(received, length);
+    if ((received_len != length) || (memcmp(received, expected, length) != 0))
+    {
+        emu_fail("trace line %u: notified \"%.*s\", expected \"%.*s\"",
+                 m_line, (int)received_len, (char *)received, length, (char *)expected);
+    }
+    return true;
+}
+
+
+static bool cmd_expect_glyph(char * p_args)
+{
+    uint32_t code;
+    uint32_t expected[8];
+    uint8_t  rows[8];
+    uint8_t  i;
+
+    if (!number_parse(&p_args, 0, &code) || (code > 7))
+    {
+        return false;
+    }
+    for (i = 0; i < 8; i++)
+    {
+        if (!number_parse(&p_args, 16, &expected[i]))
+        {
+            return false;
+        }
+    }
+    if (!line_end(p_args))
+    {
+        return false;
+    }
+
+    emu_lcd_glyph((uint8_t)code, rows);
+    for (i = 0; i < 8; i++)
+    {
+        if (rows[i] != expected[i])
+        {
+            emu_fail("trace line %u: glyph %u row %u is %02X, expected %02X", m_line, code, i, rows[i], expected[i]);
+            break;
+        }
+    }
+    return true;
+}
+
+
+/**@brief "expect_bus <bytes>": bytes on the bus since the last expect_bus or the start. */
+static bool cmd_expect_bus(char * p_args)
+{
+    emu_twi_stats_t stats;
+    uint32_t        expected;
+
+    if (!number_parse(&p_args, 0, &expected) || !line_end(p_args))
+    {
+        return false;
+    }
+
+    emu_twi_stats_get(&stats);
+    if (stats.bytes - m_bus_bytes != expected)
+    {
+        emu_fail("trace line %u: %u bytes on the bus, expected %u", m_line, stats.bytes - m_bus_bytes, expected);
+    }
+    m_bus_bytes = stats.bytes;
+    return true;
+}
+
+
+/**@brief Function for checking an AD structure of the advertising data: type, then data bytes. */
+static bool cmd_expect_adv_field(char * p_args)
+{
+    uint8_t         data[SCRIPT_DATA_MAX];
+    uint16_t        length = 0;
+    uint32_t        type;
+    uint32_t        value;
+    const uint8_t * p_adv;
+    uint8_t         adv_len;
+    uint8_t         pos;
+    uint8_t         i;
+
+    if (!number_parse(&p_args, 16, &type) || (type > 0xFF))
+    {
+        return false;
+    }
+    while (!line_end(p_args))
+    {
+        if ((length == sizeof(data)) || !number_parse(&p_args, 16, &value) || (value > 0xFF))
+        {
+            return false;
+        }
+        data[length++] = (uint8_t)value;
+    }
+
+    p_adv = emu_ble_adv_data(&adv_len);
+    for (pos = 0; (pos + 1 < adv_len) && (p_adv[pos] != 0); pos += p_adv[pos] + 1)
+    {
+        if (p_adv[pos + 1] != type)
+        {
+            continue;
+        }
+        if ((p_adv[pos] - 1 != length) || (memcmp(&p_adv[pos + 2], data, length) != 0))
+        {
+            emu_fail("trace line %u: advertising data field 0x%02X differs", m_line, type);
+            printf("  advertised:");
+            for (i = 0; i < p_adv[pos] - 1; i++)
+            {
+                printf(" %02X", p_adv[pos + 2 + i]);
+            }
+            putchar('\n');
+        }
+        return true;
+    }
+    emu_fail("trace line %u: no field 0x%02X in the advertising data", m_line, type);
+    return true;
+}
+
+
+static bool cmd_read(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint16_t length = sizeof(data);
+    uint32_t uuid;
+    uint16_t i;
+
+    if (!number_parse(&p_args, 16, &uuid) || !line_end(p_args))
+    {
+        return false;
+    }
+    if (!emu_ble_read((uint16_t)uuid, data, &length))
+    {
+        fail("read: not connected or no such characteristic");
+        return true;
+    }
+    printf("read 0x%04X:", uuid);
+    for (i = 0; i < length; i++)
+    {
+        printf(" %02X", data[i]);
+    }
+    putchar('\n');
+    return true;
+}
+
+
+/**@brief "expect_read <uuid> <offset> <bytes>": bytes of a characteristic value, from the offset. */
+static bool cmd_expect_read(char * p_args)
+{
+    uint8_t  data[SCRIPT_DATA_MAX];
+    uint8_t  expected[SCRIPT_DATA_MAX];
+    uint16_t length = sizeof(data);
+    uint16_t expected_length;
+    uint32_t uuid;
+    uint32_t offset;
+    uint16_t i;
+
+    if (!number_parse(&p_args, 16, &uuid) || !number_parse(&p_args, 0, &offset) ||
+        !bytes_parse(p_args, expected, sizeof(expected), &expected_length))
+    {
+        return false;
+    }
+    if (!emu_ble_read((uint16_t)uuid, data, &length))
+    {
+        fail("expect_read: not connected or no such characteristic");
+        return true;
+    }
+    if (offset + expected_length > length)
+    {
+        emu_fail("trace line %u: value of 0x%04X is %u bytes, expected at least %u",
+                 m_line, uuid, length, offset + expected_length);
+        return true;
+    }
+    for (i = 0; i < expected_length; i++)
+    {
+        if (data[offset + i] != expected[i])
+        {
+            emu_fail("trace line %u: byte %u of 0x%04X is %02X, expected %02X",
+                     m_line, offset + i, uuid, data[offset + i], expected[i]);
+            break;
+        }
+    }
+    return true;
+}
+
+
+static bool cmd_bench(char * p_args)
+{
+    char * p_name = skip_space(p_args);
+    size_t length = strcspn(p_name, " \t\r\n#");
+
+    if ((length == 0) || !line_end(p_name + length))
+    {
+        return false;
+    }
+    p_name[length] = '\0';
+    emu_bench_begin(p_name);
+    return true;
+}
+
+
+static bool cmd_bench_end(char * p_args)
+{
+    emu_bench_end();
+    return line_end(p_args);
+}
+
+
+/**@brief Function for hanging the bus: a slave holds SCL low (twi_stall scl) or SDA low until
+ *        the bus is cleared (twi_stall sda), twi_stall off lifts either.
+ */
+static bool cmd_twi_stall(char * p_args)
+{
+    static const char * names[] = {"off", "scl", "sda"};
+    char *              p_name  = skip_space(p_args);
+    uint8_t             i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        size_t length = strlen(names[i]);
+
+        if ((strncmp(p_name, names[i], length) == 0) && line_end(p_name + length))
+        {
+            emu_twi_stall((emu_twi_stall_t)i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for holding flash operations back (flash_hold on) and letting them run again
+ *        (flash_hold off).
+ */
+static bool cmd_flash_hold(char * p_args)
+{
+    bool on;
+
+    p_args = skip_space(p_args);
+    if (strncmp(p_args, "on", 2) == 0)
+    {
+        on = true;
+    }
+    else if (strncmp(p_args, "off", 3) == 0)
+    {
+        on = false;
+    }
+    else
+    {
+        return false;
+    }
+    emu_flash_hold(on);
+    return true;
+}
+
+
+static bool cmd_show(char * p_args)
+{
+    char    text[LCD_COLS + 1];
+    uint8_t rgb[3];
+    uint8_t row;
+
+    emu_rgb_color(rgb);
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        emu_lcd_row(row, text);
+        printf("%10.3f ms  |%s|\n", (double)emu_now() / EMU_NS_PER_MS, text);
+    }
+    printf("%10.3f ms  color %u %u %u\n", (double)emu_now() / EMU_NS_PER_MS, rgb[0], rgb[1], rgb[2]);
+    return line_end(p_args);
+}
+
+
+static const script_cmd_t m_cmds[] =
+{
+    {"wait",             false, cmd_wait},
+    {"connect",          true,  cmd_connect},
+    {"disconnect",       true,  cmd_disconnect},
+    {"pair",             true,  cmd_pair},
+    {"encrypt",          true,  cmd_encrypt},
+    {"notify",           true,  cmd_notify},
+    {"write",            true,  cmd_write},
+    {"write_cmd",        true,  cmd_write_cmd},
+    {"text",             true,  cmd_text},
+    {"expect_status",    false, cmd_expect_status},
+    {"uart",             true,  cmd_uart},
+    {"expect",           false, cmd_expect},
+    {"expect_rgb",       false, cmd_expect_rgb},
+    {"expect_rgb_reg",   false, cmd_expect_rgb_reg},
+    {"expect_conn",      false, cmd_expect_conn},
+    {"expect_adv",       false, cmd_expect_adv},
+    {"expect_adv_field", false, cmd_expect_adv_field},
+    {"expect_notify",    false, cmd_expect_notify},
+    {"expect_glyph",     false, cmd_expect_glyph},
+    {"expect_bus",       false, cmd_expect_bus},
+    {"read",             true,  cmd_read},
+    {"expect_read",      true,  cmd_expect_read},
+    {"flash_hold",       false, cmd_flash_hold},
+    {"twi_stall",        false, cmd_twi_stall},
+    {"show",             false, cmd_show},
+    {"bench",            false, cmd_bench},
+    {"bench_end",        false, cmd_bench_end},
+};
+
+
+bool emu_script_open(const char * p_path)
+{
+    mp_file = fopen(p_path, "r");
+    if (mp_file == NULL)
+    {
+        perror(p_path);
+        return false;
+    }
+    m_due = 0;
+    return true;
+}
+
+
+uint64_t emu_script_due(void)
+{
+    return m_due;
+}
+
+
+/**@brief Function for running the next command of the trace. Every command returns to the
+ *        emulator, so the firmware sees its effect before the next one.
+ */
+void emu_script_step(void)
+{
+    char   line[SCRIPT_LINE_MAX];
+    char * p;
+    size_t length;
+    size_t i;
+
+    for (;;)
+    {
+        if (fgets(line, sizeof(line), mp_file) == NULL)
+        {
+            fclose(mp_file);
+            m_due = EMU_TIME_NEVER;
+            return;
+        }
+        m_line++;
+
+        p = skip_space(line);
+        if (!line_end(p))
+        {
+            break;
+        }
+    }
+
+    length = strcspn(p, " \t\r\n");
+    m_due  = emu_now();
+    for (i = 0; i < sizeof(m_cmds) / sizeof(m_cmds[0]); i++)
+    {
+        if ((strlen(m_cmds[i].p_name) == length) && (strncmp(m_cmds[i].p_name, p, length) == 0))
+        {
+            if (m_cmds[i].needs_cpu && emu_sd_is_off())
+            {
+                fail("the device is off");
+            }
+            else if (!m_cmds[i].handler(p + length))
+            {
+                fail("bad arguments");
+            }
+            return;
+        }
+    }
+    fail("unknown command");
+}
@@ -0,0 +1,1626 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf_gpio.h"
+#include "nrf_soc.h"
+#include "ble.h"
+#include "ble_hci.h"
+#include "ble_advdata.h"
+#include "ble_conn_params.h"
+#include "ble_srv_common.h"
+#include "softdevice_handler.h"
+#include "app_button.h"
+#include "app_gpiote.h"
+#include "app_timer.h"
+#include "app_trace.h"
+#include "app_util.h"
+#include "crc16.h"
+#include "emu.h"
+
+
+#define SD_ATTR_MAX             24                                   /**< Attributes the table holds. */
+#define SD_ATTR_VALUE_MAX       512                                  /**< Longest attribute value. */
+#define SD_VS_UUID_MAX          4                                    /**< Vendor specific base UUIDs. */
+#define SD_TX_BUFFERS           7                                    /**< Notifications the SoftDevice can buffer. */
+#define SD_TX_PER_EVENT         6                                    /**< Notifications sent per connection event. */
+#define SD_ATT_MTU              GATT_MTU_SIZE_DEFAULT
+#define SD_ACTION_QUEUE_SIZE    16
+#define SD_NOTIFIED_SIZE        1024                                 /**< Notification bytes the client keeps for the trace. */
+#define SD_CONN_HANDLE          0
+#define SD_DIRECTED_ADV_NS      (1280 * EMU_NS_PER_MS)               /**< Length of high duty cycle directed advertising. */
+#define SD_BOND_DIV             0x2A5C                               /**< Key diversifier of the bond the central makes. */
+
+/**@brief Attribute of the GATT table. */
+typedef struct
+{
+    uint16_t  handle;
+    uint16_t  uuid;
+    uint8_t   uuid_type;
+    bool      is_cccd;
+    bool      notify;                                                /**< Characteristic value with the notify property. */
+    bool      write;                                                 /**< Characteristic value the client may write. */
+    bool      write_cmd;                                             /**< Characteristic value with the write without response property. */
+    bool      wr_auth;
+    uint8_t   vloc;
+    uint16_t  max_len;
+    uint16_t  len;
+    uint8_t * p_value;                                               /**< Value, in the application (BLE_GATTS_VLOC_USER) or in value. */
+    uint8_t   value[SD_ATTR_VALUE_MAX];
+} sd_attr_t;
+
+/**@brief Work the SoftDevice does on behalf of the peer, delivered as BLE events in order. */
+typedef enum
+{
+    SD_ACTION_EVT,                                                   /**< Pass a prepared event to the application. */
+    SD_ACTION_WRITE,                                                 /**< Perform a client write, short or queued. */
+    SD_ACTION_WRITE_CMD                                              /**< Perform a client Write Command. */
+} sd_action_type_t;
+
+typedef struct
+{
+    sd_action_type_t type;
+    uint16_t         attr;                                           /**< Index of the attribute to write. */
+    uint16_t         length;
+    union
+    {
+        ble_evt_t    evt;
+        uint8_t      data[SD_ATTR_VALUE_MAX];
+    } u;
+} sd_action_t;
+
+static ble_evt_handler_t    m_ble_evt_handler;
+static sys_evt_handler_t    m_sys_evt_handler;
+
+static sd_attr_t            m_attrs[SD_ATTR_MAX];
+static uint16_t             m_attr_count;
+static ble_uuid128_t        m_vs_uuids[SD_VS_UUID_MAX];
+static uint8_t              m_vs_uuid_count;
+
+static bool                 m_advertising;
+static uint8_t              m_adv_type;
+static uint8_t              m_adv_fp;
+static uint16_t             m_adv_interval;                          /**< In 0.625 ms units. */
+static ble_gap_addr_t       m_adv_peer;                              /**< Target of directed advertising. */
+static ble_gap_addr_t       m_wl_addrs[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+static uint8_t              m_wl_addr_count;
+static ble_gap_irk_t        m_wl_irks[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
+static uint8_t              m_wl_irk_count;
+static bool                 m_pairing;                               /**< The central has asked to pair, waiting for the security parameters. */
+static bool                 m_encrypting;                            /**< The central has started encryption, waiting for the keys. */
+static uint8_t              m_adv_data[BLE_GAP_ADV_MAX_SIZE];
+static uint8_t              m_adv_len;
+static bool                 m_connected;
+static bool                 m_conn_seen;                             /**< There has been a connection, its CCCD values stay readable until the next one. */
+static uint16_t             m_conn_interval;                         /**< In 1.25 ms units. */
+static uint16_t             m_slave_latency;
+static uint16_t             m_latency_skipped;                       /**< Connection events skipped since the last one attended. */
+static const ble_user_mem_block_t * mp_user_mem;                     /**< Queued write memory given by the application. */
+static bool                 m_user_mem_asked;
+static uint8_t              m_tx_in_flight;                          /**< Notifications in SoftDevice buffers. */
+static bool                 m_off;
+
+static bool                 m_auth_pending;                          /**< An authorize request is waiting for its reply. */
+static uint16_t             m_auth_status;
+static uint16_t             m_write_status;                          /**< GATT status of the last client write. */
+
+static sd_action_t          m_actions[SD_ACTION_QUEUE_SIZE];
+static uint8_t              m_action_in;
+static uint8_t              m_action_out;
+
+static uint8_t              m_notified[SD_NOTIFIED_SIZE];
+static size_t               m_notified_len;
+static uint32_t             m_writes;
+static uint32_t             m_notifications;
+static uint32_t             m_notified_bytes;
+static uint32_t             m_radio_events;                          /**< Connection events the peripheral attended. */
+
+static void action_handler(void * p_context);
+static void conn_event_handler(void * p_context);
+static void adv_timeout_handler(void * p_context);
+
+static emu_event_t          m_action_event =                         /**< SoftDevice event interrupt (SWI2). */
+{
+    .prio    = EMU_PRIO_LOW,
+    .handler = action_handler,
+};
+
+static emu_event_t          m_conn_event =                           /**< Radio connection event. */
+{
+    .prio    = EMU_PRIO_HW,
+    .handler = conn_event_handler,
+};
+
+static emu_event_t          m_adv_timeout_event =
+{
+    .prio    = EMU_PRIO_HW,
+    .handler = adv_timeout_handler,
+};
+
+
+static const char * evt_name(uint16_t evt_id)
+{
+    switch (evt_id)
+    {
+        case BLE_EVT_TX_COMPLETE:                return "TX_COMPLETE";
+        case BLE_EVT_USER_MEM_REQUEST:           return "USER_MEM_REQUEST";
+        case BLE_EVT_USER_MEM_RELEASE:           return "USER_MEM_RELEASE";
+        case BLE_GAP_EVT_CONNECTED:              return "CONNECTED";
+        case BLE_GAP_EVT_DISCONNECTED:           return "DISCONNECTED";
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:      return "CONN_PARAM_UPDATE";
+        case BLE_GAP_EVT_TIMEOUT:                return "TIMEOUT";
+        case BLE_GAP_EVT_SEC_PARAMS_REQUEST:     return "SEC_PARAMS_REQUEST";
+        case BLE_GAP_EVT_SEC_INFO_REQUEST:       return "SEC_INFO_REQUEST";
+        case BLE_GAP_EVT_AUTH_STATUS:            return "AUTH_STATUS";
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:        return "CONN_SEC_UPDATE";
+        case BLE_GATTS_EVT_WRITE:                return "WRITE";
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST: return "RW_AUTHORIZE_REQUEST";
+        case BLE_GATTS_EVT_SYS_ATTR_MISSING:     return "SYS_ATTR_MISSING";
+        default:                                 return "event";
+    }
+}
+
+
+/**@brief Function for passing an event to the application, at the SoftDevice interrupt priority. */
+static void evt_deliver(ble_evt_t * p_evt)
+{
+    emu_log("ble   %s", evt_name(p_evt->header.evt_id));
+    if (m_ble_evt_handler != NULL)
+    {
+        m_ble_evt_handler(p_evt);
+    }
+}
+
+
+static sd_action_t * action_alloc(sd_action_type_t type)
+{
+    sd_action_t * p_action;
+
+    if ((uint8_t)(m_action_in - m_action_out) == SD_ACTION_QUEUE_SIZE)
+    {
+        emu_fail("SoftDevice event queue overflow");
+        emu_finish();
+    }
+    p_action = &m_actions[m_action_in % SD_ACTION_QUEUE_SIZE];
+    memset(p_action, 0, sizeof(*p_action));
+    p_action->type = type;
+    return p_action;
+}
+
+
+static void action_commit(void)
+{
+    m_action_in++;
+    if (!m_action_event.pending)
+    {
+        emu_event_schedule(&m_action_event, emu_now());
+    }
+}
+
+
+static ble_evt_t * evt_alloc(uint16_t evt_id)
+{
+    sd_action_t * p_action = action_alloc(SD_ACTION_EVT);
+
+    p_action->u.evt.header.evt_id          = evt_id;
+    p_action->u.evt.evt.gap_evt.conn_handle = m_connected ? SD_CONN_HANDLE : BLE_CONN_HANDLE_INVALID;
+    return &p_action->u.evt;
+}
+
+
+static sd_attr_t * attr_find(uint16_t uuid, bool cccd)
+{
+    uint16_t i;
+
+    for (i = 0; i < m_attr_count; i++)
+    {
+        if ((m_attrs[i].uuid == uuid) && (m_attrs[i].is_cccd == cccd))
+        {
+            return &m_attrs[i];
+        }
+    }
+    return NULL;
+}
+
+
+static sd_attr_t * attr_by_handle(uint16_t handle)
+{
+    return ((handle != 0) && (handle <= m_attr_count)) ? &m_attrs[handle - 1] : NULL;
+}
+
+
+/**@brief Function for sending an authorize request for a write and waiting for the reply.
+ *
+ * @return GATT status the application replied with.
+ */
+static uint16_t write_authorize(uint8_t op, uint16_t handle, uint16_t offset, const uint8_t * p_data, uint16_t length)
+{
+    uint8_t                          buf[sizeof(ble_evt_t) + SD_ATTR_VALUE_MAX];
+    ble_evt_t *                      p_evt = (ble_evt_t *)buf;
+    ble_gatts_evt_rw_authorize_request_t * p_req = &p_evt->evt.gatts_evt.params.authorize_request;
+
+    memset(buf, 0, sizeof(ble_evt_t));
+    p_evt->header.evt_id            = BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST;
+    p_evt->evt.gatts_evt.conn_handle = SD_CONN_HANDLE;
+    p_req->type                     = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+    p_req->request.write.op         = op;
+    p_req->request.write.handle     = handle;
+    p_req->request.write.offset     = offset;
+    p_req->request.write.len        = length;
+    if (length != 0)
+    {
+        memcpy(p_req->request.write.data, p_data, length);
+    }
+
+    m_auth_pending = true;
+    m_auth_status  = BLE_GATT_STATUS_SUCCESS;
+    evt_deliver(p_evt);
+    if (m_auth_pending)
+    {
+        m_auth_pending = false;
+        emu_fail("no reply to the authorize request for handle 0x%04X", handle);
+        return BLE_GATT_STATUS_ATTERR_INSUF_RESOURCES;
+    }
+    return m_auth_status;
+}
+
+
+static void attr_value_store(sd_attr_t * p_attr, const uint8_t * p_data, uint16_t length)
+{
+    memcpy(p_attr->p_value, p_data, length);
+    p_attr->len = length;
+}
+
+
+/**@brief Function for performing a Write Request that fits one ATT PDU. */
+static uint16_t write_short(sd_attr_t * p_attr, const uint8_t * p_data, uint16_t length)
+{
+    uint8_t     buf[sizeof(ble_evt_t) + SD_ATTR_VALUE_MAX];
+    ble_evt_t * p_evt = (ble_evt_t *)buf;
+    uint16_t    status;
+
+    if (p_attr->wr_auth)
+    {
+        status = write_authorize(BLE_GATTS_OP_WRITE_REQ, p_attr->handle, 0, p_data, length);
+        if (status == BLE_GATT_STATUS_SUCCESS)
+        {
+            attr_value_store(p_attr, p_data, length);
+        }
+        return status;
+    }
+
+    attr_value_store(p_attr, p_data, length);
+
+    memset(buf, 0, sizeof(ble_evt_t));
+    p_evt->header.evt_id                   = BLE_GATTS_EVT_WRITE;
+    p_evt->evt.gatts_evt.conn_handle        = SD_CONN_HANDLE;
+    p_evt->evt.gatts_evt.params.write.handle = p_attr->handle;
+    p_evt->evt.gatts_evt.params.write.op     = BLE_GATTS_OP_WRITE_REQ;
+    p_evt->evt.gatts_evt.params.write.len    = length;
+    memcpy(p_evt->evt.gatts_evt.params.write.data, p_data, length);
+    evt_deliver(p_evt);
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+
+/**@brief Write Command: no authorization and no response, the value is stored and reported. */
+static void write_cmd(sd_attr_t * p_attr, const uint8_t * p_data, uint16_t length)
+{
+    uint8_t     buf[sizeof(ble_evt_t) + SD_ATTR_VALUE_MAX];
+    ble_evt_t * p_evt = (ble_evt_t *)buf;
+
+    attr_value_store(p_attr, p_data, length);
+
+    memset(buf, 0, sizeof(ble_evt_t));
+    p_evt->header.evt_id                   = BLE_GATTS_EVT_WRITE;
+    p_evt->evt.gatts_evt.conn_handle        = SD_CONN_HANDLE;
+    p_evt->evt.gatts_evt.params.write.handle = p_attr->handle;
+    p_evt->evt.gatts_evt.params.write.op     = BLE_GATTS_OP_WRITE_CMD;
+    p_evt->evt.gatts_evt.params.write.len    = length;
+    memcpy(p_evt->evt.gatts_evt.params.write.data, p_data, length);
+    evt_deliver(p_evt);
+}
+
+
+/**@brief Function for applying the prepared writes in the queued write memory block, as the
+ *        SoftDevice does after the Execute Write Request has been authorized. The block still
+ *        belongs to the SoftDevice, so headers the application has changed show up here.
+ */
+static void queued_writes_apply(void)
+{
+    const uint8_t * p_mem = mp_user_mem->p_mem;
+    uint16_t        pos   = 0;
+
+    while (pos + 6 <= mp_user_mem->len)
+    {
+        uint16_t    handle = uint16_decode(&p_mem[pos]);
+        uint16_t    offset = uint16_decode(&p_mem[pos + 2]);
+        uint16_t    part   = uint16_decode(&p_mem[pos + 4]);
+        sd_attr_t * p_attr = attr_by_handle(handle);
+
+        if (handle == BLE_GATT_HANDLE_INVALID)
+        {
+            return;
+        }
+        if ((p_attr == NULL) || (offset + part > p_attr->max_len) || (pos + 6 + part > mp_user_mem->len))
+        {
+            emu_fail("queued write of %u bytes at %u to handle 0x%04X, the memory block has been changed",
+                     part, offset, handle);
+            return;
+        }
+        memcpy(&p_attr->p_value[offset], &p_mem[pos + 6], part);
+        p_attr->len = MAX(p_attr->len, offset + part);
+        pos        += 6 + part;
+    }
+}
+
+
+/**@brief Function for performing a long write as Prepare Write Requests and an Execute Write
+ *        Request, collected in the queued write memory block of the application.
+ */
+static uint16_t write_queued(sd_attr_t * p_attr, const uint8_t * p_data, uint16_t length)
+{
+    uint16_t offset;
+    uint16_t pos    = 0;
+    uint16_t status = BLE_GATT_STATUS_SUCCESS;
+
+    if (!m_user_mem_asked)
+    {
+        ble_evt_t evt;
+
+        memset(&evt, 0, sizeof(evt));
+        evt.header.evt_id                                 = BLE_EVT_USER_MEM_REQUEST;
+        evt.evt.common_evt.conn_handle                    = SD_CONN_HANDLE;
+        evt.evt.common_evt.params.user_mem_request.type   = BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES;
+        m_user_mem_asked                                  = true;
+        evt_deliver(&evt);
+    }
+    if ((mp_user_mem == NULL) || (mp_user_mem->p_mem == NULL))
+    {
+        return BLE_GATT_STATUS_ATTERR_PREPARE_QUEUE_FULL;
+    }
+
+    for (offset = 0; offset < length; offset += SD_ATT_MTU - 5)
+    {
+        uint16_t part = MIN(length - offset, SD_ATT_MTU - 5);
+
+        if (pos + 6 + part > mp_user_mem->len)
+        {
+            status = BLE_GATT_STATUS_ATTERR_PREPARE_QUEUE_FULL;
+            break;
+        }
+        if (p_attr->wr_auth)
+        {
+            status = write_authorize(BLE_GATTS_OP_PREP_WRITE_REQ, p_attr->handle, offset, &p_data[offset], part);
+            if (status != BLE_GATT_STATUS_SUCCESS)
+            {
+                break;
+            }
+        }
+        pos += uint16_encode(p_attr->handle, &mp_user_mem->p_mem[pos]);
+        pos += uint16_encode(offset, &mp_user_mem->p_mem[pos]);
+        pos += uint16_encode(part, &mp_user_mem->p_mem[pos]);
+        memcpy(&mp_user_mem->p_mem[pos], &p_data[offset], part);
+        pos += part;
+    }
+    if (pos + 2 <= mp_user_mem->len)
+    {
+        (void)uint16_encode(BLE_GATT_HANDLE_INVALID, &mp_user_mem->p_mem[pos]);
+    }
+
+    if (status != BLE_GATT_STATUS_SUCCESS)
+    {
+        // The peer cancels the queue.
+        (void)write_authorize(BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL, BLE_GATT_HANDLE_INVALID, 0, NULL, 0);
+        return status;
+    }
+
+    status = write_authorize(BLE_GATTS_OP_EXEC_WRITE_REQ_NOW, BLE_GATT_HANDLE_INVALID, 0, NULL, 0);
+    if (status == BLE_GATT_STATUS_SUCCESS)
+    {
+        p_attr->len = 0;
+        queued_writes_apply();
+    }
+    return status;
+}
+
+
+static void action_handler(void * p_context)
+{
+    sd_action_t * p_action = &m_actions[m_action_out % SD_ACTION_QUEUE_SIZE];
+
+    (void)p_context;
+
+    if (p_action->type == SD_ACTION_EVT)
+    {
+        evt_deliver(&p_action->u.evt);
+    }
+    else if (m_connected && (p_action->type == SD_ACTION_WRITE_CMD))
+    {
+        sd_attr_t * p_attr = &m_attrs[p_action->attr];
+
+        m_writes++;
+        write_cmd(p_attr, p_action->u.data, p_action->length);
+        emu_log("ble   write command of %u bytes to 0x%04X", p_action->length, p_attr->handle);
+    }
+    else if (m_connected)
+    {
+        sd_attr_t * p_attr = &m_attrs[p_action->attr];
+
+        m_writes++;
+        if (p_action->length > p_attr->max_len)
+        {
+            m_write_status = BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+        }
+        else if (p_action->length <= SD_ATT_MTU - 3)
+        {
+            m_write_status = write_short(p_attr, p_action->u.data, p_action->length);
+        }
+        else
+        {
+            m_write_status = write_queued(p_attr, p_action->u.data, p_action->length);
+        }
+        emu_log("ble   write of %u bytes to 0x%04X: status 0x%04X", p_action->length, p_attr->handle, m_write_status);
+    }
+
+    m_action_out++;
+    if (m_action_out != m_action_in)
+    {
+        emu_event_schedule(&m_action_event, emu_now());
+    }
+}
+
+
+static uint64_t conn_interval_ns(void)
+{
+    return (uint64_t)m_conn_interval * 1250 * EMU_NS_PER_US;
+}
+
+
+static void conn_event_handler(void * p_context)
+{
+    (void)p_context;
+
+    // With slave latency the peripheral sleeps through events unless it has data to send.
+    if ((m_tx_in_flight != 0) || (m_latency_skipped >= m_slave_latency))
+    {
+        m_radio_events++;
+        m_latency_skipped = 0;
+    }
+    else
+    {
+        m_latency_skipped++;
+    }
+
+    if (m_tx_in_flight != 0)
+    {
+        ble_evt_t * p_evt = evt_alloc(BLE_EVT_TX_COMPLETE);
+        uint8_t     count = MIN(m_tx_in_flight, SD_TX_PER_EVENT);
+
+        m_tx_in_flight                           -= count;
+        p_evt->evt.common_evt.params.tx_complete.count = count;
+        action_commit();
+    }
+    emu_event_schedule(&m_conn_event, emu_now() + conn_interval_ns());
+}
+
+
+static void adv_timeout_handler(void * p_context)
+{
+    ble_evt_t * p_evt;
+
+    (void)p_context;
+
+    m_advertising = false;
+    p_evt         = evt_alloc(BLE_GAP_EVT_TIMEOUT);
+    p_evt->evt.gap_evt.params.timeout.src = BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT;
+    action_commit();
+}
+
+
+static void link_down(uint8_t reason)
+{
+    ble_evt_t * p_evt = evt_alloc(BLE_GAP_EVT_DISCONNECTED);
+
+    p_evt->evt.gap_evt.params.disconnected.reason = reason;
+    action_commit();
+
+    if (mp_user_mem != NULL)
+    {
+        p_evt = evt_alloc(BLE_EVT_USER_MEM_RELEASE);
+        p_evt->evt.common_evt.params.user_mem_release.type      = BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES;
+        p_evt->evt.common_evt.params.user_mem_release.mem_block = *mp_user_mem;
+        action_commit();
+    }
+
+    m_connected      = false;
+    m_pairing        = false;
+    m_encrypting     = false;
+    mp_user_mem      = NULL;
+    m_user_mem_asked = false;
+    m_tx_in_flight   = 0;
+    emu_event_cancel(&m_conn_event);
+}
+
+
+/* Peer side, driven by the trace. */
+
+/**@brief The central, at its identity address, with the keys it distributes when bonding. */
+static const ble_gap_addr_t m_central_addr =
+{
+    .addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC,
+    .addr      = {0x3C, 0x5A, 0x0B, 0x1E, 0x77, 0xC4},
+};
+
+static const ble_gap_irk_t  m_central_irk =
+{
+    .irk = {0x61, 0x2E, 0x9D, 0x04, 0xB8, 0x73, 0x15, 0xCA, 0x3F, 0x80, 0x5E, 0xD2, 0x47, 0x19, 0xA6, 0x0B},
+};
+
+
+/**@brief Function for checking whether the advertising lets the central connect.
+ *
+ * @param[out] p_irk_match  Set when the central is on the whitelist by its IRK.
+ */
+static bool adv_accepts_central(bool * p_irk_match)
+{
+    uint8_t i;
+
+    *p_irk_match = false;
+
+    if (m_adv_type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND)
+    {
+        return memcmp(&m_adv_peer, &m_central_addr, sizeof(m_central_addr)) == 0;
+    }
+    if ((m_adv_fp != BLE_GAP_ADV_FP_FILTER_CONNREQ) && (m_adv_fp != BLE_GAP_ADV_FP_FILTER_BOTH))
+    {
+        return true;
+    }
+    for (i = 0; i < m_wl_addr_count; i++)
+    {
+        if (memcmp(&m_wl_addrs[i], &m_central_addr, sizeof(m_central_addr)) == 0)
+        {
+            return true;
+        }
+    }
+    for (i = 0; i < m_wl_irk_count; i++)
+    {
+        if (memcmp(&m_wl_irks[i], &m_central_irk, sizeof(m_central_irk)) == 0)
+        {
+            *p_irk_match = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool emu_ble_connect(uint32_t interval_ms)
+{
+    ble_evt_t * p_evt;
+    uint16_t    i;
+    bool        irk_match;
+
+    if (m_connected || !m_advertising || !adv_accepts_central(&irk_match))
+    {
+        return false;
+    }
+
+    emu_event_cancel(&m_adv_timeout_event);
+    m_advertising   = false;
+    m_conn_interval     = (uint16_t)(interval_ms * 1000 / 1250);
+    m_slave_latency     = 0;
+    m_latency_skipped   = 0;
+    for (i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].is_cccd)
+        {
+            memset(m_attrs[i].value, 0, 2);
+        }
+    }
+
+    p_evt = evt_alloc(BLE_GAP_EVT_CONNECTED);
+    m_connected = true;
+    m_conn_seen = true;
+    p_evt->evt.gap_evt.conn_handle                                     = SD_CONN_HANDLE;
+    p_evt->evt.gap_evt.params.connected.peer_addr                      = m_central_addr;
+    p_evt->evt.gap_evt.params.connected.irk_match                      = irk_match;
+    p_evt->evt.gap_evt.params.connected.conn_params.min_conn_interval  = m_conn_interval;
+    p_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval  = m_conn_interval;
+    p_evt->evt.gap_evt.params.connected.conn_params.conn_sup_timeout   = 400;
+    action_commit();
+
+    emu_event_schedule(&m_conn_event, emu_now() + conn_interval_ns());
+    return true;
+}
+
+
+bool emu_ble_disconnect(void)
+{
+    if (!m_connected)
+    {
+        return false;
+    }
+    link_down(BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    return true;
+}
+
+
+bool emu_ble_pair(void)
+{
+    ble_evt_t * p_evt;
+
+    if (!m_connected || m_pairing)
+    {
+        return false;
+    }
+    p_evt = evt_alloc(BLE_GAP_EVT_SEC_PARAMS_REQUEST);
+    p_evt->evt.gap_evt.params.sec_params_request.peer_params.bond         = 1;
+    p_evt->evt.gap_evt.params.sec_params_request.peer_params.io_caps      = BLE_GAP_IO_CAPS_NONE;
+    p_evt->evt.gap_evt.params.sec_params_request.peer_params.min_key_size = 7;
+    p_evt->evt.gap_evt.params.sec_params_request.peer_params.max_key_size = 16;
+    action_commit();
+    m_pairing = true;
+    return true;
+}
+
+
+bool emu_ble_encrypt(void)
+{
+    ble_evt_t * p_evt;
+
+    if (!m_connected || m_pairing || m_encrypting)
+    {
+        return false;
+    }
+    // The central starts encryption with the keys it kept from bonding, the peripheral looks
+    // them up by the diversifier.
+    p_evt = evt_alloc(BLE_GAP_EVT_SEC_INFO_REQUEST);
+    p_evt->evt.gap_evt.params.sec_info_request.peer_addr = m_central_addr;
+    p_evt->evt.gap_evt.params.sec_info_request.div       = SD_BOND_DIV;
+    p_evt->evt.gap_evt.params.sec_info_request.enc_info  = 1;
+    action_commit();
+    m_encrypting = true;
+    return true;
+}
+
+
+bool emu_ble_cccd_write(uint16_t uuid, bool notify)
+{
+    sd_attr_t * p_cccd = attr_find(uuid, true);
+    ble_evt_t * p_evt;
+
+    if (!m_connected || (p_cccd == NULL))
+    {
+        return false;
+    }
+
+    p_cccd->value[0] = notify ? 0x01 : 0x00;
+    p_cccd->value[1] = 0x00;
+
+    p_evt = evt_alloc(BLE_GATTS_EVT_WRITE);
+    p_evt->evt.gatts_evt.params.write.handle = p_cccd->handle;
+    p_evt->evt.gatts_evt.params.write.op     = BLE_GATTS_OP_WRITE_REQ;
+    p_evt->evt.gatts_evt.params.write.len    = 1;
+    p_evt->evt.gatts_evt.params.write.data[0] = p_cccd->value[0];
+    action_commit();
+
+    // The event only has room for one value byte; the second CCCD byte is always 0.
+    p_evt->evt.gatts_evt.params.write.len = 2;
+    return true;
+}
+
+
+bool emu_ble_write(uint16_t uuid, const uint8_t * p_data, uint16_t length)
+{
+    sd_attr_t *   p_attr = attr_find(uuid, false);
+    sd_action_t * p_action;
+
+    if (!m_connected || (p_attr == NULL) || !p_attr->write || (length > SD_ATTR_VALUE_MAX))
+    {
+        return false;
+    }
+
+    p_action         = action_alloc(SD_ACTION_WRITE);
+    p_action->attr   = (uint16_t)(p_attr - m_attrs);
+    p_action->length = length;
+    memcpy(p_action->u.data, p_data, length);
+    action_commit();
+    return true;
+}
+
+
+bool emu_ble_write_cmd(uint16_t uuid, const uint8_t * p_data, uint16_t length)
+{
+    sd_attr_t *   p_attr = attr_find(uuid, false);
+    sd_action_t * p_action;
+
+    // A Write Command fits one packet, there is no queued form.
+    if (!m_connected || (p_attr == NULL) || !p_attr->write_cmd ||
+        (length > SD_ATT_MTU - 3) || (length > p_attr->max_len))
+    {
+        return false;
+    }
+
+    p_action         = action_alloc(SD_ACTION_WRITE_CMD);
+    p_action->attr   = (uint16_t)(p_attr - m_attrs);
+    p_action->length = length;
+    memcpy(p_action->u.data, p_data, length);
+    action_commit();
+    return true;
+}
+
+
+uint16_t emu_ble_write_status(void)
+{
+    return m_write_status;
+}
+
+
+bool emu_ble_read(uint16_t uuid, uint8_t * p_data, uint16_t * p_length)
+{
+    sd_attr_t * p_attr = attr_find(uuid, false);
+
+    if (!m_connected || (p_attr == NULL))
+    {
+        return false;
+    }
+    *p_length = MIN(*p_length, p_attr->len);
+    memcpy(p_data, p_attr->p_value, *p_length);
+    return true;
+}
+
+
+size_t emu_ble_notified(uint8_t * p_data, size_t max_length)
+{
+    size_t length = MIN(max_length, m_notified_len);
+
+    memcpy(p_data, m_notified, length);
+    memmove(m_notified, &m_notified[length], m_notified_len - length);
+    m_notified_len -= length;
+    return length;
+}
+
+
+bool emu_ble_is_advertising(void)
+{
+    return m_advertising;
+}
+
+
+bool emu_ble_adv_params(uint8_t * p_type, uint8_t * p_fp, uint16_t * p_interval)
+{
+    *p_type     = m_adv_type;
+    *p_fp       = m_adv_fp;
+    *p_interval = m_adv_interval;
+    return m_advertising;
+}
+
+
+bool emu_ble_conn_params(uint16_t * p_interval, uint16_t * p_slave_latency)
+{
+    *p_interval      = m_conn_interval;
+    *p_slave_latency = m_slave_latency;
+    return m_connected;
+}
+
+
+const uint8_t * emu_ble_adv_data(uint8_t * p_length)
+{
+    *p_length = m_adv_len;
+    return m_adv_data;
+}
+
+
+void emu_ble_stats(uint32_t * p_writes, uint32_t * p_notifications, uint32_t * p_notified_bytes, uint32_t * p_radio_events)
+{
+    *p_writes         = m_writes;
+    *p_notifications  = m_notifications;
+    *p_notified_bytes = m_notified_bytes;
+    *p_radio_events   = m_radio_events;
+}
+
+
+bool emu_sd_is_off(void)
+{
+    return m_off;
+}
+
+
+void emu_sd_sys_evt_dispatch(uint32_t evt_id)
+{
+    if (m_sys_evt_handler != NULL)
+    {
+        m_sys_evt_handler(evt_id);
+    }
+}
+
+
+/* SoftDevice handler library. */
+
+uint32_t softdevice_handler_init(uint32_t clock_source, void * p_evt_buffer, uint16_t evt_buffer_size, void * evt_schedule_func)
+{
+    (void)clock_source;
+    (void)p_evt_buffer;
+    (void)evt_buffer_size;
+    (void)evt_schedule_func;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler)
+{
+    m_ble_evt_handler = ble_evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler)
+{
+    m_sys_evt_handler = sys_evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+/* S110 SVCs. */
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params)
+{
+    (void)p_ble_enable_params;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    if (m_vs_uuid_count == SD_VS_UUID_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_vs_uuids[m_vs_uuid_count] = *p_vs_uuid;
+    *p_uuid_type                = BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count++;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count)
+{
+    *p_count = SD_TX_BUFFERS;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_user_mem_reply(uint16_t conn_handle, ble_user_mem_block_t const * p_block)
+{
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    mp_user_mem = p_block;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_write_perm, uint8_t const * p_dev_name, uint16_t len)
+{
+    (void)p_write_perm;
+    emu_log("ble   device name \"%.*s\"", len, p_dev_name);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_conn_params)
+{
+    (void)p_conn_params;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen)
+{
+    (void)p_sr_data;
+
+    if ((dlen > BLE_GAP_ADV_MAX_SIZE) || (srdlen > BLE_GAP_ADV_MAX_SIZE))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if ((dlen != m_adv_len) || (memcmp(m_adv_data, p_data, dlen) != 0))
+    {
+        emu_log("ble   advertising data, %u bytes", dlen);
+    }
+    memcpy(m_adv_data, p_data, dlen);
+    m_adv_len = dlen;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const * p_adv_params)
+{
+    const ble_gap_whitelist_t * p_whitelist = p_adv_params->p_whitelist;
+    bool                        filtered    = (p_adv_params->fp != BLE_GAP_ADV_FP_ANY);
+    uint8_t                     i;
+
+    if (m_advertising || m_connected)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (((p_adv_params->type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND) && (p_adv_params->p_peer_addr == NULL)) ||
+        (filtered && ((p_whitelist == NULL) || (p_whitelist->addr_count + p_whitelist->irk_count == 0) ||
+                      (p_whitelist->addr_count > BLE_GAP_WHITELIST_ADDR_MAX_COUNT) ||
+                      (p_whitelist->irk_count > BLE_GAP_WHITELIST_IRK_MAX_COUNT))))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_advertising   = true;
+    m_adv_type      = p_adv_params->type;
+    m_adv_fp        = p_adv_params->fp;
+    m_adv_interval  = p_adv_params->interval;
+    m_wl_addr_count = filtered ? p_whitelist->addr_count : 0;
+    m_wl_irk_count  = filtered ? p_whitelist->irk_count : 0;
+    for (i = 0; i < m_wl_addr_count; i++)
+    {
+        m_wl_addrs[i] = *p_whitelist->pp_addrs[i];
+    }
+    for (i = 0; i < m_wl_irk_count; i++)
+    {
+        m_wl_irks[i] = *p_whitelist->pp_irks[i];
+    }
+
+    if (m_adv_type == BLE_GAP_ADV_TYPE_ADV_DIRECT_IND)
+    {
+        m_adv_peer = *p_adv_params->p_peer_addr;
+        emu_log("ble   directed advertising");
+        emu_event_schedule(&m_adv_timeout_event, emu_now() + SD_DIRECTED_ADV_NS);
+        return NRF_SUCCESS;
+    }
+
+    emu_log("ble   advertising%s, interval %u ms, timeout %u s", filtered ? " with whitelist" : "",
+            p_adv_params->interval * 625 / 1000, p_adv_params->timeout);
+    if (p_adv_params->timeout != 0)
+    {
+        emu_event_schedule(&m_adv_timeout_event, emu_now() + p_adv_params->timeout * EMU_NS_PER_S);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_adv_stop(void)
+{
+    if (!m_advertising)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_advertising = false;
+    emu_event_cancel(&m_adv_timeout_event);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    ble_evt_t * p_evt;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    // The central grants the shortest interval asked for.
+    m_conn_interval   = p_conn_params->min_conn_interval;
+    m_slave_latency   = p_conn_params->slave_latency;
+    m_latency_skipped = 0;
+    emu_log("ble   connection interval %.2f ms, slave latency %u", m_conn_interval * 1.25, m_slave_latency);
+    p_evt           = evt_alloc(BLE_GAP_EVT_CONN_PARAM_UPDATE);
+    p_evt->evt.gap_evt.params.conn_param_update.conn_params                   = *p_conn_params;
+    p_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval = m_conn_interval;
+    action_commit();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code)
+{
+    (void)hci_status_code;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    link_down(BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status, ble_gap_sec_params_t const * p_sec_params)
+{
+    ble_evt_t *                 p_evt;
+    ble_gap_evt_auth_status_t * p_status;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (!m_pairing)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_pairing = false;
+
+    // Just Works pairing, the central distributes its identity when both sides bond.
+    p_evt    = evt_alloc(BLE_GAP_EVT_AUTH_STATUS);
+    p_status = &p_evt->evt.gap_evt.params.auth_status;
+    if ((sec_status != BLE_GAP_SEC_STATUS_SUCCESS) || (p_sec_params == NULL))
+    {
+        p_status->auth_status = BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP;
+        action_commit();
+        return NRF_SUCCESS;
+    }
+    p_status->auth_status          = BLE_GAP_SEC_STATUS_SUCCESS;
+    p_status->sm1_levels.lv2       = 1;
+    if (p_sec_params->bond)
+    {
+        p_status->periph_kex.ltk                  = 1;
+        p_status->periph_keys.enc_info.ltk_len    = 16;
+        p_status->periph_keys.enc_info.div        = SD_BOND_DIV;
+        p_status->central_kex.irk                 = 1;
+        p_status->central_kex.address             = 1;
+        p_status->central_keys.irk                = m_central_irk;
+        p_status->central_keys.id_info            = m_central_addr;
+    }
+    emu_log("ble   paired%s", p_sec_params->bond ? " and bonded" : "");
+    action_commit();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, ble_gap_enc_info_t const * p_enc_info, void const * p_sign_info)
+{
+    ble_evt_t * p_evt;
+
+    (void)p_sign_info;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (!m_encrypting)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_encrypting = false;
+
+    if ((p_enc_info == NULL) || (p_enc_info->div != SD_BOND_DIV) || (p_enc_info->ltk_len != 16))
+    {
+        // The central gets "key missing" and stays unencrypted.
+        emu_log("ble   no keys for the central, link stays unencrypted");
+        return NRF_SUCCESS;
+    }
+
+    p_evt = evt_alloc(BLE_GAP_EVT_CONN_SEC_UPDATE);
+    p_evt->evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.sm  = 1;
+    p_evt->evt.gap_evt.params.conn_sec_update.conn_sec.sec_mode.lv  = 2;
+    p_evt->evt.gap_evt.params.conn_sec_update.conn_sec.encr_key_size = p_enc_info->ltk_len;
+    emu_log("ble   link encrypted with the bond keys");
+    action_commit();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    sd_attr_t * p_attr;
+
+    (void)type;
+
+    if (m_attr_count == SD_ATTR_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    p_attr            = &m_attrs[m_attr_count++];
+    p_attr->handle    = m_attr_count;
+    p_attr->uuid      = p_uuid->uuid;
+    p_attr->uuid_type = p_uuid->type;
+    *p_handle         = p_attr->handle;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md, ble_gatts_attr_t const * p_attr_char_value, ble_gatts_char_handles_t * p_handles)
+{
+    bool        cccd = p_char_md->char_props.notify || p_char_md->char_props.indicate;
+    sd_attr_t * p_attr;
+
+    (void)service_handle;
+
+    // Declaration, value and the optional CCCD.
+    if (m_attr_count + (cccd ? 3 : 2) > SD_ATTR_MAX)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    if ((p_attr_char_value->max_len > SD_ATTR_VALUE_MAX) || (p_attr_char_value->init_len > p_attr_char_value->max_len))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    memset(p_handles, 0, sizeof(*p_handles));
+
+    p_attr         = &m_attrs[m_attr_count++];
+    p_attr->handle = m_attr_count;
+
+    p_attr            = &m_attrs[m_attr_count++];
+    p_attr->handle    = m_attr_count;
+    p_attr->uuid      = p_attr_char_value->p_uuid->uuid;
+    p_attr->uuid_type = p_attr_char_value->p_uuid->type;
+    p_attr->notify    = p_char_md->char_props.notify;
+    p_attr->write     = p_char_md->char_props.write || p_char_md->char_props.write_wo_resp;
+    p_attr->write_cmd = p_char_md->char_props.write_wo_resp;
+    p_attr->wr_auth   = p_attr_char_value->p_attr_md->wr_auth;
+    p_attr->vloc      = p_attr_char_value->p_attr_md->vloc;
+    p_attr->max_len   = p_attr_char_value->max_len;
+    p_attr->len       = p_attr_char_value->init_len;
+    p_attr->p_value   = (p_attr->vloc == BLE_GATTS_VLOC_USER) ? p_attr_char_value->p_value : p_attr->value;
+    if ((p_attr->vloc != BLE_GATTS_VLOC_USER) && (p_attr_char_value->p_value != NULL))
+    {
+        memcpy(p_attr->value, p_attr_char_value->p_value, p_attr->len);
+    }
+    p_handles->value_handle = p_attr->handle;
+
+    if (cccd)
+    {
+        sd_attr_t * p_cccd = &m_attrs[m_attr_count++];
+
+        p_cccd->handle         = m_attr_count;
+        p_cccd->uuid           = p_attr->uuid;
+        p_cccd->is_cccd        = true;
+        p_cccd->max_len        = 2;
+        p_cccd->len            = 2;
+        p_cccd->p_value        = p_cccd->value;
+        p_handles->cccd_handle = p_cccd->handle;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle, ble_gatts_rw_authorize_reply_params_t const * p_rw_authorize_reply_params)
+{
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE) || !m_auth_pending)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_auth_pending = false;
+    m_auth_status  = p_rw_authorize_reply_params->params.write.gatt_status;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    sd_attr_t * p_attr = attr_by_handle(p_hvx_params->handle);
+    sd_attr_t * p_cccd = attr_by_handle(p_hvx_params->handle + 1);
+    uint16_t    length = *p_hvx_params->p_len;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_attr == NULL) || !p_attr->notify || (p_cccd == NULL) || !p_cccd->is_cccd)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((p_cccd->value[0] & 0x01) == 0)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (length > SD_ATT_MTU - 3)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if (m_tx_in_flight == SD_TX_BUFFERS)
+    {
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+
+    m_tx_in_flight++;
+    m_notifications++;
+    m_notified_bytes += length;
+    attr_value_store(p_attr, p_hvx_params->p_data, length);
+    if (length <= sizeof(m_notified) - m_notified_len)
+    {
+        memcpy(&m_notified[m_notified_len], p_hvx_params->p_data, length);
+        m_notified_len += length;
+    }
+    emu_log("ble   notification of %u bytes", length);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief System attributes are the CCCD values, as handle and value pairs. */
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const * p_sys_attr_data, uint16_t len)
+{
+    uint16_t pos;
+
+    if (!m_connected || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    for (pos = 0; (p_sys_attr_data != NULL) && (pos + 4 <= len); pos += 4)
+    {
+        sd_attr_t * p_cccd = attr_by_handle(uint16_decode(&p_sys_attr_data[pos]));
+
+        if ((p_cccd == NULL) || !p_cccd->is_cccd)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+        memcpy(p_cccd->value, &p_sys_attr_data[pos + 2], 2);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t conn_handle, uint8_t * p_sys_attr_data, uint16_t * p_len)
+{
+    uint16_t pos = 0;
+    uint16_t i;
+
+    // Also after the disconnection, for storing them on BLE_GAP_EVT_DISCONNECTED.
+    if (!m_conn_seen || (conn_handle != SD_CONN_HANDLE))
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    for (i = 0; i < m_attr_count; i++)
+    {
+        if (m_attrs[i].is_cccd)
+        {
+            if ((p_sys_attr_data != NULL) && (pos + 4 > *p_len))
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+            if (p_sys_attr_data != NULL)
+            {
+                (void)uint16_encode(m_attrs[i].handle, &p_sys_attr_data[pos]);
+                memcpy(&p_sys_attr_data[pos + 2], m_attrs[i].value, 2);
+            }
+            pos += 4;
+        }
+    }
+    *p_len = pos;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_set(uint16_t handle, uint16_t offset, uint16_t * const p_len, uint8_t const * const p_value)
+{
+    sd_attr_t * p_attr = attr_by_handle(handle);
+
+    if ((p_attr == NULL) || (p_attr->p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (offset + *p_len > p_attr->max_len)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (p_value != NULL)
+    {
+        memmove(&p_attr->p_value[offset], p_value, *p_len);
+    }
+    p_attr->len = offset + *p_len;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_ble_gatts_value_get(uint16_t handle, uint16_t offset, uint16_t * const p_len, uint8_t * const p_data)
+{
+    sd_attr_t * p_attr = attr_by_handle(handle);
+
+    if ((p_attr == NULL) || (p_attr->p_value == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (offset > p_attr->len)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    *p_len = MIN(*p_len, p_attr->len - offset);
+    memcpy(p_data, &p_attr->p_value[offset], *p_len);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t sd_power_system_off(void)
+{
+    emu_log("system off");
+    m_off = true;
+    emu_power_off();
+}
+
+
+/* SDK libraries. */
+
+static uint8_t adv_field_put(uint8_t * p_buf, uint8_t pos, uint8_t type, const uint8_t * p_data, uint8_t length)
+{
+    if (pos + 2 + length > BLE_GAP_ADV_MAX_SIZE)
+    {
+        return BLE_GAP_ADV_MAX_SIZE + 1;
+    }
+    p_buf[pos]     = length + 1;
+    p_buf[pos + 1] = type;
+    memcpy(&p_buf[pos + 2], p_data, length);
+    return pos + 2 + length;
+}
+
+
+static uint8_t adv_encode(const ble_advdata_t * p_advdata, uint8_t * p_buf)
+{
+    static const char name[] = "Hans Wurst";
+    uint8_t           pos    = 0;
+    uint8_t           field[BLE_GAP_ADV_MAX_SIZE];
+    uint16_t          i;
+
+    if (p_advdata->flags.size != 0)
+    {
+        pos = adv_field_put(p_buf, pos, 0x01, p_advdata->flags.p_data, (uint8_t)p_advdata->flags.size);
+    }
+    if ((p_advdata->name_type != BLE_ADVDATA_NO_NAME) && (pos <= BLE_GAP_ADV_MAX_SIZE))
+    {
+        uint8_t length = sizeof(name) - 1;
+        uint8_t type   = 0x09;
+
+        if ((p_advdata->name_type == BLE_ADVDATA_SHORT_NAME) && (p_advdata->short_name_len < length))
+        {
+            length = p_advdata->short_name_len;
+            type   = 0x08;
+        }
+        pos = adv_field_put(p_buf, pos, type, (const uint8_t *)name, length);
+    }
+    for (i = 0; (i < p_advdata->uuids_complete.uuid_cnt) && (pos <= BLE_GAP_ADV_MAX_SIZE); i++)
+    {
+        const ble_uuid_t * p_uuid = &p_advdata->uuids_complete.p_uuids[i];
+
+        if (p_uuid->type == BLE_UUID_TYPE_BLE)
+        {
+            (void)uint16_encode(p_uuid->uuid, field);
+            pos = adv_field_put(p_buf, pos, 0x03, field, 2);
+        }
+        else
+        {
+            memcpy(field, m_vs_uuids[p_uuid->type - BLE_UUID_TYPE_VENDOR_BEGIN].uuid128, 16);
+            (void)uint16_encode(p_uuid->uuid, &field[12]);
+            pos = adv_field_put(p_buf, pos, 0x07, field, 16);
+        }
+    }
+    if ((p_advdata->p_manuf_specific_data != NULL) && (pos <= BLE_GAP_ADV_MAX_SIZE))
+    {
+        const ble_advdata_manuf_data_t * p_manuf = p_advdata->p_manuf_specific_data;
+
+        if (p_manuf->data.size > sizeof(field) - 2)
+        {
+            return BLE_GAP_ADV_MAX_SIZE + 1;
+        }
+        (void)uint16_encode(p_manuf->company_identifier, field);
+        memcpy(&field[2], p_manuf->data.p_data, p_manuf->data.size);
+        pos = adv_field_put(p_buf, pos, 0xFF, field, (uint8_t)(p_manuf->data.size + 2));
+    }
+    return pos;
+}
+
+
+uint32_t ble_advdata_set(const ble_advdata_t * p_advdata, const ble_advdata_t * p_srdata)
+{
+    uint8_t adv[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t sr[BLE_GAP_ADV_MAX_SIZE];
+    uint8_t adv_len = 0;
+    uint8_t sr_len  = 0;
+
+    if (p_advdata != NULL)
+    {
+        adv_len = adv_encode(p_advdata, adv);
+    }
+    if (p_srdata != NULL)
+    {
+        sr_len = adv_encode(p_srdata, sr);
+    }
+    if ((adv_len > BLE_GAP_ADV_MAX_SIZE) || (sr_len > BLE_GAP_ADV_MAX_SIZE))
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    return sd_ble_gap_adv_data_set(adv, adv_len, sr, sr_len);
+}
+
+
+/**@brief Timeout handler of the timers the SDK modules below create, they never run here. */
+static void sdk_timeout_handler(void * p_context)
+{
+    (void)p_context;
+}
+
+
+uint32_t ble_conn_params_init(const ble_conn_params_init_t * p_init)
+{
+    app_timer_id_t timer_id;
+
+    (void)p_init;
+
+    // The SDK module creates its update timer, so it counts against APP_TIMER_MAX_TIMERS.
+    return app_timer_create(&timer_id, APP_TIMER_MODE_SINGLE_SHOT, sdk_timeout_handler);
+}
+
+
+uint32_t ble_conn_params_stop(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t * new_params)
+{
+    uint32_t err_code;
+
+    // Like the SDK module: the parameters become the preferred ones and, unless the interval of
+    // the last connection is within them, are asked for on its handle. The module does not check
+    // for a connection, without one the handle is BLE_CONN_HANDLE_INVALID.
+    err_code = sd_ble_gap_ppcp_set(new_params);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    if ((m_conn_interval >= new_params->min_conn_interval) &&
+        (m_conn_interval <= new_params->max_conn_interval))
+    {
+        return NRF_SUCCESS;
+    }
+    return sd_ble_gap_conn_param_update(m_connected ? SD_CONN_HANDLE : BLE_CONN_HANDLE_INVALID, new_params);
+}
+
+
+void ble_conn_params_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    (void)p_ble_evt;
+}
+
+
+bool ble_srv_is_notification_enabled(uint8_t * p_encoded_data)
+{
+    return (p_encoded_data[0] & 0x01) != 0;
+}
+
+
+uint32_t app_button_init(app_button_cfg_t * p_buttons, uint8_t button_count, uint32_t detection_delay, void * evt_schedule_func)
+{
+    app_timer_id_t timer_id;
+    uint8_t        i;
+
+    (void)detection_delay;
+    (void)evt_schedule_func;
+
+    for (i = 0; i < button_count; i++)
+    {
+        nrf_gpio_cfg_input(p_buttons[i].pin_no, p_buttons[i].pull_cfg);
+    }
+
+    // The SDK module creates its detection delay timer.
+    return app_timer_create(&timer_id, APP_TIMER_MODE_SINGLE_SHOT, sdk_timeout_handler);
+}
+
+
+uint32_t app_button_enable(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_button_disable(void)
+{
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_gpiote_init(uint8_t max_users, void * p_buffer)
+{
+    (void)max_users;
+    (void)p_buffer;
+    return NRF_SUCCESS;
+}
+
+
+void app_trace_init(void)
+{
+}
+
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc)
+{
+    uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+    uint32_t i;
+
+    // CRC-16-CCITT, the same as the SDK.
+    for (i = 0; i < size; i++)
+    {
+        crc  = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+}
+
+
+void nrf_gpio_range_cfg_output(uint32_t pin_range_start, uint32_t pin_range_end)
+{
+    for (; pin_range_start <= pin_range_end; pin_range_start++)
+    {
+        nrf_gpio_cfg_output(pin_range_start);
+    }
+}
+
+
+void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+    NRF_GPIO->DIR |= (1UL << pin_number);
+}
+
+
+/**@brief Nothing drives the inputs, they read the level of their pull resistor. */
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config)
+{
+    uint32_t * p_in = (uint32_t *)&NRF_GPIO->IN;                    // Read-only for the firmware.
+
+    NRF_GPIO->DIR &= ~(1UL << pin_number);
+    if (pull_config == NRF_GPIO_PIN_PULLUP)
+    {
+        *p_in |= (1UL << pin_number);
+    }
+    else
+    {
+        *p_in &= ~(1UL << pin_number);
+    }
+}
+
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config, nrf_gpio_pin_sense_t sense_config)
+{
+    (void)sense_config;
+    nrf_gpio_cfg_input(pin_number, pull_config);
+}
+
+
+void nrf_gpio_pin_set(uint32_t pin_number)
+{
+    NRF_GPIO->OUT |= (1UL << pin_number);
+    emu_twi_gpio_written();
+}
+
+
+void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+    NRF_GPIO->OUT &= ~(1UL << pin_number);
+    emu_twi_gpio_written();
+}
+
+
+void nrf_gpio_pin_toggle(uint32_t pin_number)
+{
+    NRF_GPIO->OUT ^= (1UL << pin_number);
+    emu_twi_gpio_written();
+}
+
+
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value)
+{
+    if (value)
+    {
+        nrf_gpio_pin_set(pin_number);
+    }
+    else
+    {
+        nrf_gpio_pin_clear(pin_number);
+    }
+}
+
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number)
+{
+    return (NRF_GPIO->IN >> pin_number) & 1UL;
+}
@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "nrf_error.h"
+#include "app_timer.h"
+#include "emu.h"
+
+
+#define TIMER_MAX               16                                   /**< Timers the emulator can hold, APP_TIMER_INIT may ask for fewer. */
+#define RTC_COUNTER_MASK        0x00FFFFFF                           /**< RTC1 is a 24-bit counter. */
+
+/**@brief app_timer instance, one virtual time event each. */
+typedef struct
+{
+    bool                        created;
+    app_timer_mode_t            mode;
+    app_timer_timeout_handler_t handler;
+    void *                      p_context;
+    uint32_t                    period_ticks;                        /**< Repeat interval of a repeated timer. */
+    uint64_t                    expiry_tick;                         /**< RTC tick the timer expires at, not wrapped. */
+    emu_event_t                 event;
+} emu_timer_t;
+
+static emu_timer_t m_timers[TIMER_MAX];
+static uint8_t     m_max_timers;
+static uint32_t    m_prescaler;
+
+
+static uint64_t tick_now(void)
+{
+    return emu_now() * APP_TIMER_CLOCK_FREQ / (m_prescaler + 1) / EMU_NS_PER_S;
+}
+
+
+static uint64_t tick_to_ns(uint64_t tick)
+{
+    // Rounded up, so the timer never fires before its tick.
+    uint64_t scale = EMU_NS_PER_S * (m_prescaler + 1);
+
+    return (tick * scale + APP_TIMER_CLOCK_FREQ - 1) / APP_TIMER_CLOCK_FREQ;
+}
+
+
+uint32_t emu_rtc_counter(void)
+{
+    return (uint32_t)tick_now() & RTC_COUNTER_MASK;
+}
+
+
+static void timer_expired(void * p_context)
+{
+    emu_timer_t * p_timer = p_context;
+
+    if (p_timer->mode == APP_TIMER_MODE_REPEATED)
+    {
+        p_timer->expiry_tick += p_timer->period_ticks;
+        emu_event_schedule(&p_timer->event, tick_to_ns(p_timer->expiry_tick));
+    }
+    p_timer->handler(p_timer->p_context);
+}
+
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t max_timers, uint8_t op_queues_size, void * p_buffer, void * evt_schedule_func)
+{
+    (void)op_queues_size;
+    (void)p_buffer;
+    (void)evt_schedule_func;
+
+    if (max_timers > TIMER_MAX)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_prescaler  = prescaler;
+    m_max_timers = max_timers;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_create(app_timer_id_t * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler)
+{
+    uint8_t i;
+
+    if (timeout_handler == NULL)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    for (i = 0; i < m_max_timers; i++)
+    {
+        if (!m_timers[i].created)
+        {
+            m_timers[i].created         = true;
+            m_timers[i].mode            = mode;
+            m_timers[i].handler         = timeout_handler;
+            m_timers[i].event.prio      = EMU_PRIO_LOW;
+            m_timers[i].event.handler   = timer_expired;
+            m_timers[i].event.p_context = &m_timers[i];
+            *p_timer_id                 = i;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+    emu_timer_t * p_timer;
+
+    if ((timer_id >= m_max_timers) || !m_timers[timer_id].created ||
+        (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS) || (timeout_ticks > RTC_COUNTER_MASK))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_timer               = &m_timers[timer_id];
+    p_timer->p_context    = p_context;
+    p_timer->period_ticks = timeout_ticks;
+    p_timer->expiry_tick  = tick_now() + timeout_ticks;
+    emu_event_schedule(&p_timer->event, tick_to_ns(p_timer->expiry_tick));
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    if ((timer_id >= m_max_timers) || !m_timers[timer_id].created)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    emu_event_cancel(&m_timers[timer_id].event);
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+    *p_ticks = emu_rtc_counter();
+    return NRF_SUCCESS;
+}
+
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & RTC_COUNTER_MASK;
+    return NRF_SUCCESS;
+}
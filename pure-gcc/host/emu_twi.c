@@ -0,0 +1,332 @@
+#include <stdint.h>
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "emu.h"
+
+
+#define TWI_ENABLED             (TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos)
+#define TWI_TXD_EMPTY           0xFFFFFFFF                           /**< TXD value while the peripheral waits for the next byte; any byte the firmware writes differs from it. */
+#define TWI_SCL_PER_START       1                                    /**< SCL periods taken by a START condition. */
+#define TWI_SCL_PER_BYTE        9                                    /**< SCL periods per byte, 8 data bits and the acknowledge. */
+#define TWI_SCL_PER_STOP        1                                    /**< SCL periods taken by a STOP condition. */
+
+void SPI0_TWI0_IRQHandler(void);
+
+/**@brief Bus state. */
+typedef enum
+{
+    TWI_STATE_IDLE,
+    TWI_STATE_SENDING,                                               /**< A byte is being shifted out. */
+    TWI_STATE_WAITING,                                               /**< TXDSENT or ERROR raised, SCL held low until the firmware writes TXD or STOP. */
+    TWI_STATE_STOPPING                                               /**< STOP condition on the bus. */
+} twi_state_t;
+
+static const emu_i2c_device_t * const m_devices[] = {&g_emu_lcd, &g_emu_rgb};
+
+static twi_state_t              m_state;
+static emu_twi_stall_t          m_stall;                             /**< Bus fault set by the trace. */
+static bool                     m_hung;                              /**< The byte being shifted out waits for the fault to be lifted. */
+static uint32_t                 m_scl_out = 1;                       /**< SCL level last driven by GPIO. */
+static uint8_t                  m_clear_pulses;                      /**< SCL pulses driven by GPIO while SDA is held low. */
+static const emu_i2c_device_t * mp_device;                           /**< Addressed slave, NULL if nobody acknowledged. */
+static uint8_t                  m_byte;                              /**< Byte being shifted out. */
+static uint64_t                 m_start_ns;                          /**< Time of the START condition of the transfer. */
+static uint32_t                 m_forced_khz;                        /**< Bus clock given on the command line, 0 to follow the FREQUENCY register. */
+static emu_twi_stats_t          m_stats;
+
+static void twi_event_handler(void * p_context);
+
+static emu_event_t              m_event =                            /**< End of the byte, START or STOP condition on the bus. */
+{
+    .prio    = EMU_PRIO_HW,
+    .handler = twi_event_handler,
+};
+
+
+uint32_t emu_twi_khz(void)
+{
+    if (m_forced_khz != 0)
+    {
+        return m_forced_khz;
+    }
+    switch (NRF_TWI0->FREQUENCY >> TWI_FREQUENCY_FREQUENCY_Pos)
+    {
+        case TWI_FREQUENCY_FREQUENCY_K250:
+            return 250;
+
+        case TWI_FREQUENCY_FREQUENCY_K400:
+            return 400;
+
+        default:
+            return 100;
+    }
+}
+
+
+void emu_twi_force_khz(uint32_t khz)
+{
+    m_forced_khz = khz;
+}
+
+
+void emu_twi_stats_get(emu_twi_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+
+bool emu_twi_is_idle(void)
+{
+    return (m_state == TWI_STATE_IDLE) && (NRF_TWI0->TASKS_STARTTX == 0);
+}
+
+
+/**@brief Function for setting the SDA input level: high through the pull-up, unless the master
+ *        or a slave pulls it low.
+ */
+static void sda_in_update(void)
+{
+    uint32_t * p_in = (uint32_t *)&NRF_GPIO->IN;                    // Read-only for the firmware.
+    uint32_t   mask = 1UL << NRF_TWI0->PSELSDA;
+
+    if ((m_stall == EMU_TWI_STALL_SDA) || !(NRF_GPIO->OUT & mask))
+    {
+        *p_in &= ~mask;
+    }
+    else
+    {
+        *p_in |= mask;
+    }
+}
+
+
+/**@brief Function for occupying the bus for a number of SCL periods and scheduling the end. */
+static void bus_hold(uint32_t scl_periods)
+{
+    m_stats.scl_cycles += scl_periods;
+    emu_event_schedule(&m_event, emu_now() + scl_periods * (EMU_NS_PER_S / 1000) / emu_twi_khz());
+}
+
+
+/**@brief Function for calling the interrupt handler for pending enabled events, if the NVIC lets
+ *        it run now.
+ *
+ * @return true if the handler ran.
+ */
+static bool irq_deliver(void)
+{
+    uint32_t pending = (NRF_TWI0->EVENTS_TXDSENT ? TWI_INTENSET_TXDSENT_Msk : 0)
+                     | (NRF_TWI0->EVENTS_STOPPED ? TWI_INTENSET_STOPPED_Msk : 0)
+                     | (NRF_TWI0->EVENTS_ERROR   ? TWI_INTENSET_ERROR_Msk   : 0);
+    uint8_t  saved;
+
+    if (((pending & NRF_TWI0->INTEN) == 0) ||
+        !emu_irq_enabled(SPI0_TWI0_IRQn) ||
+        !emu_irq_allowed(EMU_PRIO_HIGH))
+    {
+        return false;
+    }
+
+    emu_irq_enter(EMU_PRIO_HIGH, &saved);
+    SPI0_TWI0_IRQHandler();
+    emu_irq_exit(saved);
+
+    // A handler that leaves its events set would be called forever.
+    return (NRF_TWI0->EVENTS_TXDSENT == 0) && (NRF_TWI0->EVENTS_STOPPED == 0) && (NRF_TWI0->EVENTS_ERROR == 0);
+}
+
+
+static void transfer_start(void)
+{
+    uint32_t address = NRF_TWI0->ADDRESS;
+    uint8_t  i;
+
+    m_stats.transfers++;
+    m_stats.bytes++;
+    m_start_ns = emu_now();
+    mp_device  = NULL;
+    for (i = 0; i < sizeof(m_devices) / sizeof(m_devices[0]); i++)
+    {
+        if (m_devices[i]->address == address)
+        {
+            mp_device = m_devices[i];
+        }
+    }
+
+    emu_log("i2c START 0x%02X %s", address, (mp_device != NULL) ? mp_device->p_name : "(no slave)");
+    if (mp_device != NULL)
+    {
+        mp_device->start();
+    }
+
+    m_byte  = (uint8_t)NRF_TWI0->TXD;
+    m_state = TWI_STATE_SENDING;
+    if (mp_device == NULL)
+    {
+        // The address is not acknowledged, the first data byte never goes out.
+        bus_hold(TWI_SCL_PER_START + TWI_SCL_PER_BYTE);
+    }
+    else
+    {
+        bus_hold(TWI_SCL_PER_START + 2 * TWI_SCL_PER_BYTE);
+    }
+}
+
+
+static void transfer_stop(void)
+{
+    m_state = TWI_STATE_STOPPING;
+    bus_hold(TWI_SCL_PER_STOP);
+}
+
+
+/**@brief Function for dropping the transfer when the firmware disables TWI0 in the middle of it. */
+static void transfer_abort(void)
+{
+    emu_event_cancel(&m_event);
+    m_state          = TWI_STATE_IDLE;
+    m_hung           = false;
+    m_stats.busy_ns += emu_now() - m_start_ns;
+    emu_log("i2c transfer aborted");
+}
+
+
+void emu_twi_stall(emu_twi_stall_t stall)
+{
+    m_stall        = stall;
+    m_clear_pulses = 0;
+    sda_in_update();
+    if ((stall == EMU_TWI_STALL_NONE) && m_hung)
+    {
+        // The byte goes on where it was held.
+        m_hung = false;
+        bus_hold(TWI_SCL_PER_BYTE);
+    }
+}
+
+
+void emu_twi_gpio_written(void)
+{
+    uint32_t scl = (NRF_GPIO->OUT >> NRF_TWI0->PSELSCL) & 1;
+
+    if ((NRF_TWI0->ENABLE == TWI_ENABLED) ||
+        !((NRF_GPIO->PIN_CNF[NRF_TWI0->PSELSCL] >> GPIO_PIN_CNF_DIR_Pos) & GPIO_PIN_CNF_DIR_Output))
+    {
+        // The pins belong to TWI0, or are not driven as the bus at all.
+        return;
+    }
+
+    if ((m_stall == EMU_TWI_STALL_SDA) && scl && !m_scl_out && (++m_clear_pulses == TWI_SCL_PER_BYTE))
+    {
+        m_stall = EMU_TWI_STALL_NONE;
+        emu_log("i2c bus cleared, SDA released");
+    }
+    m_scl_out = scl;
+    sda_in_update();
+}
+
+
+/**@brief Function for starting the tasks the firmware has triggered. */
+static void tasks_run(void)
+{
+    if (NRF_TWI0->ENABLE != TWI_ENABLED)
+    {
+        if (m_state != TWI_STATE_IDLE)
+        {
+            transfer_abort();
+        }
+        NRF_TWI0->TASKS_STARTTX = 0;
+        NRF_TWI0->TASKS_STOP    = 0;
+        return;
+    }
+
+    switch (m_state)
+    {
+        case TWI_STATE_IDLE:
+            if (NRF_TWI0->TASKS_STARTTX != 0)
+            {
+                NRF_TWI0->TASKS_STARTTX = 0;
+                transfer_start();
+            }
+            break;
+
+        case TWI_STATE_WAITING:
+            if (NRF_TWI0->TASKS_STOP != 0)
+            {
+                NRF_TWI0->TASKS_STOP = 0;
+                transfer_stop();
+            }
+            else if (NRF_TWI0->TXD != TWI_TXD_EMPTY)
+            {
+                m_byte  = (uint8_t)NRF_TWI0->TXD;
+                m_state = TWI_STATE_SENDING;
+                bus_hold(TWI_SCL_PER_BYTE);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void emu_twi_poll(void)
+{
+    do
+    {
+        NRF_TWI0->INTEN   |= NRF_TWI0->INTENSET;
+        NRF_TWI0->INTEN   &= ~NRF_TWI0->INTENCLR;
+        NRF_TWI0->INTENSET = 0;
+        NRF_TWI0->INTENCLR = 0;
+
+        tasks_run();
+    } while (irq_deliver());
+}
+
+
+/**@brief Function for handling the end of a bus phase. */
+static void twi_event_handler(void * p_context)
+{
+    (void)p_context;
+
+    if ((m_state == TWI_STATE_SENDING) && (m_stall != EMU_TWI_STALL_NONE))
+    {
+        if (!m_hung)
+        {
+            m_hung = true;
+            emu_log("i2c hung, %s held low", (m_stall == EMU_TWI_STALL_SCL) ? "SCL" : "SDA");
+        }
+        return;
+    }
+    if (m_state == TWI_STATE_SENDING)
+    {
+        m_state       = TWI_STATE_WAITING;
+        NRF_TWI0->TXD = TWI_TXD_EMPTY;
+        if (mp_device == NULL)
+        {
+            m_stats.nacks++;
+            NRF_TWI0->ERRORSRC    |= TWI_ERRORSRC_ANACK_Msk;
+            NRF_TWI0->EVENTS_ERROR = 1;
+        }
+        else
+        {
+            m_stats.bytes++;
+            mp_device->write(m_byte);
+            NRF_TWI0->EVENTS_TXDSENT = 1;
+        }
+    }
+    else if (m_state == TWI_STATE_STOPPING)
+    {
+        m_state = TWI_STATE_IDLE;
+        m_stats.stops++;
+        m_stats.busy_ns     += emu_now() - m_start_ns;
+        m_stats.last_stop_ns = emu_now();
+        if (mp_device != NULL)
+        {
+            mp_device->stop();
+        }
+        emu_log("i2c STOP");
+        NRF_TWI0->EVENTS_STOPPED = 1;
+    }
+    emu_twi_poll();
+}
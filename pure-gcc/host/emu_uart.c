@@ -0,0 +1,155 @@
+#include <stdint.h>
+#include <string.h>
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "emu.h"
+
+
+#define UART_RX_FIFO_SIZE       6                                    /**< Bytes the RX FIFO holds, including the one in RXD. */
+#define UART_RX_RTS_LEVEL       2                                    /**< With flow control the sender stops once this many bytes wait (room for 4 in flight). */
+#define UART_BITS_PER_BYTE      10                                   /**< Start bit, 8 data bits, stop bit. */
+#define UART_INPUT_SIZE         4096                                 /**< Bytes the trace can queue for sending. */
+
+void UART0_IRQHandler(void);
+
+static uint8_t  m_input[UART_INPUT_SIZE];                            /**< Bytes the peer has still to send. */
+static size_t   m_input_len;
+static size_t   m_input_pos;
+static uint8_t  m_fifo[UART_RX_FIFO_SIZE];
+static uint8_t  m_fifo_count;                                        /**< Bytes in the FIFO, not counting RXD. */
+static bool     m_rxd_full;                                          /**< RXD holds a byte not yet taken by the firmware. */
+static uint32_t m_rx_count;                                          /**< Bytes taken by the firmware. */
+
+static void uart_rx_handler(void * p_context);
+
+static emu_event_t m_rx_event =                                      /**< End of the byte on the RXD line. */
+{
+    .prio    = EMU_PRIO_HW,
+    .handler = uart_rx_handler,
+};
+
+
+static uint64_t byte_time_ns(void)
+{
+    // BAUDRATE is the baud rate scaled by 2^32 / 16 MHz.
+    uint64_t baud = ((uint64_t)NRF_UART0->BAUDRATE * 16000000ULL) >> 32;
+
+    return UART_BITS_PER_BYTE * EMU_NS_PER_S / ((baud != 0) ? baud : 1);
+}
+
+
+static bool flow_control(void)
+{
+    return (NRF_UART0->CONFIG & (UART_CONFIG_HWFC_Enabled << UART_CONFIG_HWFC_Pos)) != 0;
+}
+
+
+/**@brief Function for letting the peer send the next byte if RTS allows it. */
+static void sender_resume(void)
+{
+    uint8_t waiting = m_fifo_count + (m_rxd_full ? 1 : 0);
+
+    if (m_rx_event.pending || (m_input_pos == m_input_len))
+    {
+        return;
+    }
+    if (flow_control() && (waiting >= UART_RX_RTS_LEVEL))
+    {
+        return;
+    }
+    emu_event_schedule(&m_rx_event, emu_now() + byte_time_ns());
+}
+
+
+void emu_uart_poll(void)
+{
+    NRF_UART0->INTEN   |= NRF_UART0->INTENSET;
+    NRF_UART0->INTEN   &= ~NRF_UART0->INTENCLR;
+    NRF_UART0->INTENSET = 0;
+    NRF_UART0->INTENCLR = 0;
+
+    for (;;)
+    {
+        uint8_t saved;
+
+        if (m_rxd_full && (NRF_UART0->EVENTS_RXDRDY == 0))
+        {
+            // Cleared by the interrupt handler, which has read RXD.
+            m_rxd_full = false;
+            m_rx_count++;
+        }
+        if (!m_rxd_full && (m_fifo_count != 0))
+        {
+            // RXD is read-only for the firmware.
+            *(uint32_t *)&NRF_UART0->RXD = m_fifo[0];
+            NRF_UART0->EVENTS_RXDRDY     = 1;
+            m_rxd_full                   = true;
+            memmove(m_fifo, &m_fifo[1], --m_fifo_count);
+        }
+
+        if (!m_rxd_full ||
+            !emu_irq_allowed(EMU_PRIO_HIGH) ||
+            !emu_irq_enabled(UART0_IRQn) ||
+            ((NRF_UART0->INTEN & UART_INTENSET_RXDRDY_Msk) == 0))
+        {
+            break;
+        }
+
+        emu_irq_enter(EMU_PRIO_HIGH, &saved);
+        UART0_IRQHandler();
+        emu_irq_exit(saved);
+
+        NRF_UART0->INTEN   &= ~NRF_UART0->INTENCLR;
+        NRF_UART0->INTENCLR = 0;
+        if (NRF_UART0->EVENTS_RXDRDY != 0)
+        {
+            // Left pending, e.g. because the ring is full.
+            break;
+        }
+    }
+    sender_resume();
+}
+
+
+static void uart_rx_handler(void * p_context)
+{
+    uint8_t data = m_input[m_input_pos++];
+
+    (void)p_context;
+
+    if (m_fifo_count + (m_rxd_full ? 1 : 0) >= UART_RX_FIFO_SIZE)
+    {
+        emu_log("uart  overrun, 0x%02X lost", data);
+        NRF_UART0->ERRORSRC    |= 0x01;
+        NRF_UART0->EVENTS_ERROR = 1;
+    }
+    else
+    {
+        m_fifo[m_fifo_count++] = data;
+    }
+    emu_uart_poll();
+}
+
+
+void emu_uart_rx(const uint8_t * p_data, size_t length)
+{
+    if (m_input_pos == m_input_len)
+    {
+        m_input_pos = 0;
+        m_input_len = 0;
+    }
+    if (length > sizeof(m_input) - m_input_len)
+    {
+        emu_fail("uart input too long");
+        length = sizeof(m_input) - m_input_len;
+    }
+    memcpy(&m_input[m_input_len], p_data, length);
+    m_input_len += length;
+    sender_resume();
+}
+
+
+uint32_t emu_uart_rx_count(void)
+{
+    return m_rx_count;
+}
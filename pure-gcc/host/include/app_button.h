@@ -0,0 +1,19 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_BUTTON_H__
+#define APP_BUTTON_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_gpio.h"
+#include "app_error.h"
+#define APP_BUTTON_PUSH 1
+#define APP_BUTTON_RELEASE 0
+#define APP_BUTTON_ACTIVE_HIGH 1
+#define APP_BUTTON_ACTIVE_LOW 0
+typedef void (*app_button_handler_t)(uint8_t pin_no, uint8_t button_action);
+typedef struct { uint8_t pin_no; uint8_t active_state; nrf_gpio_pin_pull_t pull_cfg; app_button_handler_t button_handler; } app_button_cfg_t;
+uint32_t app_button_init(app_button_cfg_t * p_buttons, uint8_t button_count, uint32_t detection_delay, void * evt_schedule_func);
+#define APP_BUTTON_INIT(BUTTONS, BUTTON_COUNT, DETECTION_DELAY, USE_SCHEDULER) do { APP_ERROR_CHECK(app_button_init((BUTTONS), (BUTTON_COUNT), (DETECTION_DELAY), 0)); } while (0)
+uint32_t app_button_enable(void);
+uint32_t app_button_disable(void);
+#endif
@@ -0,0 +1,13 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+#include <stdint.h>
+#include "nrf_error.h"
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name);
+/* The firmware handler blinks the LEDs forever; the emulator reports the error and stops instead. */
+void emu_app_error(uint32_t error_code, uint32_t line_num, const char * p_file_name);
+#define APP_ERROR_HANDLER(ERR_CODE) do { emu_app_error((ERR_CODE), __LINE__, __FILE__); } while (0)
+#define APP_ERROR_CHECK(ERR_CODE) do { const uint32_t LOCAL_ERR_CODE = (ERR_CODE); if (LOCAL_ERR_CODE != NRF_SUCCESS) { APP_ERROR_HANDLER(LOCAL_ERR_CODE); } } while (0)
+#define APP_ERROR_CHECK_BOOL(BOOLEAN_VALUE) do { const uint32_t LOCAL_BOOLEAN_VALUE = (BOOLEAN_VALUE); if (!LOCAL_BOOLEAN_VALUE) { APP_ERROR_HANDLER(0); } } while (0)
+#endif
@@ -0,0 +1,9 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_GPIOTE_H__
+#define APP_GPIOTE_H__
+#include <stdint.h>
+#include "app_error.h"
+uint32_t app_gpiote_init(uint8_t max_users, void * p_buffer);
+#define APP_GPIOTE_INIT(MAX_USERS) do { APP_ERROR_CHECK(app_gpiote_init((MAX_USERS), 0)); } while (0)
+#endif
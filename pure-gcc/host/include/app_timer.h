@@ -0,0 +1,22 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_error.h"
+#include "app_util.h"
+#define APP_TIMER_CLOCK_FREQ 32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+#define APP_TIMER_TICKS(MS, PRESCALER) ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ, ((PRESCALER) + 1) * 1000))
+typedef uint32_t app_timer_id_t;
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+typedef enum { APP_TIMER_MODE_SINGLE_SHOT, APP_TIMER_MODE_REPEATED } app_timer_mode_t;
+uint32_t app_timer_init(uint32_t prescaler, uint8_t max_timers, uint8_t op_queues_size, void * p_buffer, void * evt_schedule_func);
+#define APP_TIMER_INIT(PRESCALER, MAX_TIMERS, OP_QUEUES_SIZE, USE_SCHEDULER) do { APP_ERROR_CHECK(app_timer_init((PRESCALER), (MAX_TIMERS), (OP_QUEUES_SIZE) + 1, 0, 0)); } while (0)
+uint32_t app_timer_create(app_timer_id_t * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(uint32_t * p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff);
+#endif
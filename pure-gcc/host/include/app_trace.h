@@ -0,0 +1,7 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_TRACE_H__
+#define APP_TRACE_H__
+void app_trace_init(void);
+#define app_trace_log(...)
+#endif
@@ -0,0 +1,17 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+#include <stdint.h>
+#include <stdbool.h>
+#define ROUNDED_DIV(A, B) (((A) + ((B) / 2)) / (B))
+#define CEIL_DIV(A, B) (((A) - 1) / (B) + 1)
+#define IS_POWER_OF_TWO(A) (((A) != 0) && ((((A) - 1) & (A)) == 0))
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+enum { UNIT_0_625_MS = 625, UNIT_1_25_MS = 1250, UNIT_10_MS = 10000 };
+static __inline uint16_t uint16_decode(const uint8_t * p) { return (uint16_t)(p[0] | ((uint16_t)p[1] << 8)); }
+static __inline uint32_t uint32_decode(const uint8_t * p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+static __inline uint8_t uint16_encode(uint16_t v, uint8_t * p) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); return 2; }
+static __inline uint8_t uint32_encode(uint32_t v, uint8_t * p) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24); return 4; }
+#define STATIC_ASSERT(EXPR) typedef char static_assert_type_##__LINE__[(EXPR) ? 1 : -1] __attribute__((unused))
+#endif
@@ -0,0 +1,13 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+#include <stdint.h>
+#include "nrf.h"
+#define APP_IRQ_PRIORITY_HIGH 1
+#define APP_IRQ_PRIORITY_LOW  3
+void critical_region_enter(void);
+void critical_region_exit(void);
+#define CRITICAL_REGION_ENTER() critical_region_enter()
+#define CRITICAL_REGION_EXIT()  critical_region_exit()
+#endif
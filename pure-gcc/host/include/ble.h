@@ -0,0 +1,186 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BLE_H__
+#define BLE_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+
+#define BLE_CONN_HANDLE_INVALID 0xFFFF
+#define BLE_GATT_HANDLE_INVALID 0x0000
+#define GATT_MTU_SIZE_DEFAULT 23
+#define BLE_ERROR_NO_TX_BUFFERS (0x3000 + 0x004)
+#define BLE_ERROR_GATTS_SYS_ATTR_MISSING (0x3400 + 0x001)
+#define BLE_ERROR_INVALID_CONN_HANDLE (0x3000 + 0x001)
+#define BLE_ERROR_GAP_UUID_LIST_MISMATCH (0x3200)
+
+#define BLE_UUID_TYPE_BLE 0x01
+#define BLE_UUID_TYPE_VENDOR_BEGIN 0x02
+typedef struct { uint16_t uuid; uint8_t type; } ble_uuid_t;
+typedef struct { uint8_t uuid128[16]; } ble_uuid128_t;
+
+/* GAP */
+#define BLE_GAP_ADDR_LEN 6
+#define BLE_GAP_ADDR_TYPE_PUBLIC 0x00
+#define BLE_GAP_ADDR_TYPE_RANDOM_STATIC 0x01
+#define BLE_GAP_ADDR_TYPE_RANDOM_PRIVATE_RESOLVABLE 0x02
+typedef struct { uint8_t addr_type; uint8_t addr[BLE_GAP_ADDR_LEN]; } ble_gap_addr_t;
+typedef struct { uint8_t irk[16]; } ble_gap_irk_t;
+#define BLE_GAP_WHITELIST_ADDR_MAX_COUNT 8
+#define BLE_GAP_WHITELIST_IRK_MAX_COUNT 8
+typedef struct { ble_gap_addr_t ** pp_addrs; uint8_t addr_count; ble_gap_irk_t ** pp_irks; uint8_t irk_count; } ble_gap_whitelist_t;
+#define BLE_GAP_ADV_TYPE_ADV_IND 0x00
+#define BLE_GAP_ADV_TYPE_ADV_DIRECT_IND 0x01
+#define BLE_GAP_ADV_TYPE_ADV_SCAN_IND 0x02
+#define BLE_GAP_ADV_TYPE_ADV_NONCONN_IND 0x03
+#define BLE_GAP_ADV_FP_ANY 0x00
+#define BLE_GAP_ADV_FP_FILTER_SCANREQ 0x01
+#define BLE_GAP_ADV_FP_FILTER_CONNREQ 0x02
+#define BLE_GAP_ADV_FP_FILTER_BOTH 0x03
+#define BLE_GAP_ADV_FLAG_LE_LIMITED_DISC_MODE 0x01
+#define BLE_GAP_ADV_FLAG_LE_GENERAL_DISC_MODE 0x02
+#define BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED 0x04
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE (0x01 | 0x04)
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE (0x02 | 0x04)
+#define BLE_GAP_ADV_INTERVAL_MIN 0x0020
+#define BLE_GAP_ADV_INTERVAL_MAX 0x4000
+#define BLE_GAP_ADV_MAX_SIZE 31
+typedef struct {
+    uint8_t type; ble_gap_addr_t * p_peer_addr; uint8_t fp; ble_gap_whitelist_t * p_whitelist;
+    uint16_t interval; uint16_t timeout; struct { uint8_t channel_37_off:1; uint8_t channel_38_off:1; uint8_t channel_39_off:1; } channel_mask;
+} ble_gap_adv_params_t;
+typedef struct { uint16_t min_conn_interval; uint16_t max_conn_interval; uint16_t slave_latency; uint16_t conn_sup_timeout; } ble_gap_conn_params_t;
+typedef struct { uint8_t sm:4; uint8_t lv:4; } ble_gap_conn_sec_mode_t;
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr) do {(ptr)->sm = 1; (ptr)->lv = 1;} while(0)
+#define BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(ptr) do {(ptr)->sm = 0; (ptr)->lv = 0;} while(0)
+#define BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(ptr) do {(ptr)->sm = 1; (ptr)->lv = 2;} while(0)
+#define BLE_GAP_IO_CAPS_NONE 0x03
+#define BLE_GAP_SEC_STATUS_SUCCESS 0x00
+#define BLE_GAP_SEC_STATUS_PAIRING_NOT_SUPP 0x85
+#define BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT 0x00
+#define BLE_GAP_TIMEOUT_SRC_SECURITY_REQUEST 0x01
+typedef struct { uint16_t timeout; uint8_t bond:1; uint8_t mitm:1; uint8_t io_caps:3; uint8_t oob:1; uint8_t min_key_size; uint8_t max_key_size; } ble_gap_sec_params_t;
+typedef struct { uint8_t ltk[16]; uint8_t auth:1; uint8_t ltk_len:7; uint16_t div; } ble_gap_enc_info_t;
+typedef struct { uint8_t lv1:1; uint8_t lv2:1; uint8_t lv3:1; } ble_gap_sec_levels_t;
+typedef struct { uint8_t ltk:1; uint8_t ediv_rand:1; uint8_t irk:1; uint8_t address:1; uint8_t csrk:1; } ble_gap_sec_keys_t;
+typedef struct {
+    uint8_t auth_status; uint8_t error_src; ble_gap_sec_levels_t sm1_levels; ble_gap_sec_levels_t sm2_levels;
+    ble_gap_sec_keys_t periph_kex; ble_gap_sec_keys_t central_kex;
+    struct { ble_gap_enc_info_t enc_info; } periph_keys;
+    struct { ble_gap_irk_t irk; ble_gap_addr_t id_info; } central_keys;
+} ble_gap_evt_auth_status_t;
+typedef struct { ble_gap_addr_t peer_addr; uint8_t irk_match:1; uint8_t irk_match_idx:7; ble_gap_conn_params_t conn_params; } ble_gap_evt_connected_t;
+typedef struct { uint8_t reason; } ble_gap_evt_disconnected_t;
+typedef struct { ble_gap_conn_params_t conn_params; } ble_gap_evt_conn_param_update_t;
+typedef struct { ble_gap_addr_t peer_addr; uint16_t div; uint8_t enc_info:1; uint8_t id_info:1; uint8_t sign_info:1; } ble_gap_evt_sec_info_request_t;
+typedef struct { uint8_t src; } ble_gap_evt_timeout_t;
+typedef struct { ble_gap_conn_sec_mode_t sec_mode; uint8_t encr_key_size; } ble_gap_conn_sec_t;
+typedef struct { ble_gap_conn_sec_t conn_sec; } ble_gap_evt_conn_sec_update_t;
+typedef struct { ble_gap_sec_params_t peer_params; } ble_gap_evt_sec_params_request_t;
+typedef struct {
+    uint16_t conn_handle;
+    union {
+        ble_gap_evt_connected_t connected; ble_gap_evt_disconnected_t disconnected;
+        ble_gap_evt_conn_param_update_t conn_param_update; ble_gap_evt_sec_params_request_t sec_params_request;
+        ble_gap_evt_sec_info_request_t sec_info_request; ble_gap_evt_auth_status_t auth_status; ble_gap_evt_timeout_t timeout;
+        ble_gap_evt_conn_sec_update_t conn_sec_update;
+    } params;
+} ble_gap_evt_t;
+
+/* GATT / GATTS */
+typedef struct { uint16_t value_handle; uint16_t user_desc_handle; uint16_t cccd_handle; uint16_t sccd_handle; } ble_gatts_char_handles_t;
+typedef struct { uint8_t broadcast:1; uint8_t read:1; uint8_t write_wo_resp:1; uint8_t write:1; uint8_t notify:1; uint8_t indicate:1; uint8_t auth_signed_wr:1; } ble_gatt_char_props_t;
+typedef struct { uint8_t reliable_wr:1; uint8_t wr_aux:1; } ble_gatt_char_ext_props_t;
+typedef struct { uint8_t format; int8_t exponent; uint16_t unit; uint8_t name_space; uint16_t desc; } ble_gatts_char_pf_t;
+#define BLE_GATTS_VLOC_INVALID 0x00
+#define BLE_GATTS_VLOC_STACK 0x01
+#define BLE_GATTS_VLOC_USER 0x02
+typedef struct { ble_gap_conn_sec_mode_t read_perm; ble_gap_conn_sec_mode_t write_perm; uint8_t vlen:1; uint8_t vloc:2; uint8_t rd_auth:1; uint8_t wr_auth:1; } ble_gatts_attr_md_t;
+typedef struct { ble_uuid_t * p_uuid; ble_gatts_attr_md_t * p_attr_md; uint16_t init_len; uint16_t init_offs; uint16_t max_len; uint8_t * p_value; } ble_gatts_attr_t;
+typedef struct {
+    ble_gatt_char_props_t char_props; ble_gatt_char_ext_props_t char_ext_props; uint8_t * p_char_user_desc; uint16_t char_user_desc_max_size; uint16_t char_user_desc_size;
+    ble_gatts_char_pf_t * p_char_pf; ble_gatts_attr_md_t * p_user_desc_md; ble_gatts_attr_md_t * p_cccd_md; ble_gatts_attr_md_t * p_sccd_md;
+} ble_gatts_char_md_t;
+#define BLE_GATTS_SRVC_TYPE_PRIMARY 0x01
+#define BLE_GATT_HVX_NOTIFICATION 0x01
+#define BLE_GATT_HVX_INDICATION 0x02
+typedef struct { uint16_t handle; uint8_t type; uint16_t offset; uint16_t * p_len; uint8_t * p_data; } ble_gatts_hvx_params_t;
+#define BLE_GATTS_OP_INVALID 0x00
+#define BLE_GATTS_OP_WRITE_REQ 0x01
+#define BLE_GATTS_OP_WRITE_CMD 0x02
+#define BLE_GATTS_OP_SIGN_WRITE_CMD 0x03
+#define BLE_GATTS_OP_PREP_WRITE_REQ 0x04
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_CANCEL 0x05
+#define BLE_GATTS_OP_EXEC_WRITE_REQ_NOW 0x06
+typedef struct { uint16_t handle; uint8_t op; ble_uuid_t uuid; uint16_t offset; uint16_t len; uint8_t data[1]; } ble_gatts_evt_write_t;
+typedef struct { uint8_t hint; } ble_gatts_evt_sys_attr_missing_t;
+#define BLE_GATTS_AUTHORIZE_TYPE_INVALID 0x00
+#define BLE_GATTS_AUTHORIZE_TYPE_READ 0x01
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE 0x02
+typedef struct { uint16_t handle; ble_uuid_t uuid; uint16_t offset; } ble_gatts_evt_read_t;
+typedef struct { uint8_t type; union { ble_gatts_evt_read_t read; ble_gatts_evt_write_t write; } request; } ble_gatts_evt_rw_authorize_request_t;
+typedef struct { uint16_t gatt_status; } ble_gatts_read_authorize_params_t_hdr;
+typedef struct { uint16_t gatt_status; uint16_t len; uint16_t offset; uint8_t * p_data; } ble_gatts_read_authorize_params_t;
+typedef struct { uint16_t gatt_status; } ble_gatts_write_authorize_params_t;
+typedef struct { uint8_t type; union { ble_gatts_read_authorize_params_t read; ble_gatts_write_authorize_params_t write; } params; } ble_gatts_rw_authorize_reply_params_t;
+#define BLE_GATT_STATUS_SUCCESS 0x0000
+#define BLE_GATT_STATUS_ATTERR_INVALID_HANDLE 0x0101
+#define BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED 0x0103
+#define BLE_GATT_STATUS_ATTERR_INVALID_PDU 0x0104
+#define BLE_GATT_STATUS_ATTERR_INVALID_OFFSET 0x0107
+#define BLE_GATT_STATUS_ATTERR_PREPARE_QUEUE_FULL 0x0109
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH 0x010D
+#define BLE_GATT_STATUS_ATTERR_INSUF_RESOURCES 0x0111
+typedef struct { uint16_t conn_handle; union { ble_gatts_evt_write_t write; ble_gatts_evt_rw_authorize_request_t authorize_request; ble_gatts_evt_sys_attr_missing_t sys_attr_missing; } params; } ble_gatts_evt_t;
+
+/* Common */
+#define BLE_EVT_BASE 0x01
+#define BLE_GAP_EVT_BASE 0x10
+#define BLE_GATTC_EVT_BASE 0x30
+#define BLE_GATTS_EVT_BASE 0x50
+enum { BLE_EVT_TX_COMPLETE = BLE_EVT_BASE, BLE_EVT_USER_MEM_REQUEST, BLE_EVT_USER_MEM_RELEASE };
+enum { BLE_GAP_EVT_CONNECTED = BLE_GAP_EVT_BASE, BLE_GAP_EVT_DISCONNECTED, BLE_GAP_EVT_CONN_PARAM_UPDATE, BLE_GAP_EVT_SEC_PARAMS_REQUEST,
+       BLE_GAP_EVT_SEC_INFO_REQUEST, BLE_GAP_EVT_PASSKEY_DISPLAY, BLE_GAP_EVT_AUTH_KEY_REQUEST, BLE_GAP_EVT_AUTH_STATUS,
+       BLE_GAP_EVT_CONN_SEC_UPDATE, BLE_GAP_EVT_TIMEOUT, BLE_GAP_EVT_RSSI_CHANGED, BLE_GAP_EVT_ADV_REPORT, BLE_GAP_EVT_SEC_REQUEST };
+enum { BLE_GATTS_EVT_WRITE = BLE_GATTS_EVT_BASE, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST, BLE_GATTS_EVT_SYS_ATTR_MISSING, BLE_GATTS_EVT_HVC,
+       BLE_GATTS_EVT_SC_CONFIRM, BLE_GATTS_EVT_TIMEOUT };
+#define BLE_USER_MEM_TYPE_INVALID 0x00
+#define BLE_USER_MEM_TYPE_GATTS_QUEUED_WRITES 0x01
+typedef struct { uint8_t * p_mem; uint16_t len; } ble_user_mem_block_t;
+typedef struct { uint8_t type; } ble_evt_user_mem_request_t;
+typedef struct { uint8_t type; ble_user_mem_block_t mem_block; } ble_evt_user_mem_release_t;
+typedef struct { uint8_t count; } ble_evt_tx_complete_t;
+typedef struct {
+    uint16_t conn_handle;
+    union { ble_evt_tx_complete_t tx_complete; ble_evt_user_mem_request_t user_mem_request; ble_evt_user_mem_release_t user_mem_release; } params;
+} ble_common_evt_t;
+typedef struct { uint16_t evt_id; uint16_t evt_len; } ble_evt_hdr_t;
+typedef struct {
+    ble_evt_hdr_t header;
+    union { ble_common_evt_t common_evt; ble_gap_evt_t gap_evt; ble_gatts_evt_t gatts_evt; } evt;
+} ble_evt_t;
+typedef struct { uint8_t service_changed:1; } ble_gatts_enable_params_t;
+typedef struct { ble_gatts_enable_params_t gatts_enable_params; } ble_enable_params_t;
+
+uint32_t sd_ble_enable(ble_enable_params_t * p_ble_enable_params);
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type);
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count);
+uint32_t sd_ble_user_mem_reply(uint16_t conn_handle, ble_user_mem_block_t const * p_block);
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const * p_write_perm, uint8_t const * p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const * p_conn_params);
+uint32_t sd_ble_gap_adv_data_set(uint8_t const * p_data, uint8_t dlen, uint8_t const * p_sr_data, uint8_t srdlen);
+uint32_t sd_ble_gap_adv_start(ble_gap_adv_params_t const * p_adv_params);
+uint32_t sd_ble_gap_adv_stop(void);
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+uint32_t sd_ble_gap_sec_params_reply(uint16_t conn_handle, uint8_t sec_status, ble_gap_sec_params_t const * p_sec_params);
+uint32_t sd_ble_gap_sec_info_reply(uint16_t conn_handle, ble_gap_enc_info_t const * p_enc_info, void const * p_sign_info);
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle);
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md, ble_gatts_attr_t const * p_attr_char_value, ble_gatts_char_handles_t * p_handles);
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle, ble_gatts_rw_authorize_reply_params_t const * p_rw_authorize_reply_params);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params);
+uint32_t sd_ble_gatts_sys_attr_set(uint16_t conn_handle, uint8_t const * p_sys_attr_data, uint16_t len);
+uint32_t sd_ble_gatts_sys_attr_get(uint16_t conn_handle, uint8_t * p_sys_attr_data, uint16_t * p_len);
+uint32_t sd_ble_gatts_value_set(uint16_t handle, uint16_t offset, uint16_t * const p_len, uint8_t const * const p_value);
+uint32_t sd_ble_gatts_value_get(uint16_t handle, uint16_t offset, uint16_t * const p_len, uint8_t * const p_data);
+#endif
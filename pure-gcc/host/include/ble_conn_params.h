@@ -0,0 +1,21 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BLE_CONN_PARAMS_H__
+#define BLE_CONN_PARAMS_H__
+#include <stdint.h>
+#include "ble.h"
+#include "ble_srv_common.h"
+typedef enum { BLE_CONN_PARAMS_EVT_FAILED, BLE_CONN_PARAMS_EVT_SUCCEEDED } ble_conn_params_evt_type_t;
+typedef struct { ble_conn_params_evt_type_t evt_type; } ble_conn_params_evt_t;
+typedef void (*ble_conn_params_evt_handler_t) (ble_conn_params_evt_t * p_evt);
+typedef void (*ble_srv_error_handler_t) (uint32_t nrf_error);
+typedef struct {
+    ble_gap_conn_params_t * p_conn_params; uint32_t first_conn_params_update_delay; uint32_t next_conn_params_update_delay;
+    uint8_t max_conn_params_update_count; uint16_t start_on_notify_cccd_handle; bool disconnect_on_fail;
+    ble_conn_params_evt_handler_t evt_handler; ble_srv_error_handler_t error_handler;
+} ble_conn_params_init_t;
+uint32_t ble_conn_params_init(const ble_conn_params_init_t * p_init);
+uint32_t ble_conn_params_stop(void);
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t * new_params);
+void ble_conn_params_on_ble_evt(ble_evt_t * p_ble_evt);
+#endif
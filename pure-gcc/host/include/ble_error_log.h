@@ -0,0 +1,5 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BLE_ERROR_LOG_H__
+#define BLE_ERROR_LOG_H__
+#endif
@@ -0,0 +1,8 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BLE_HCI_H__
+#define BLE_HCI_H__
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION 0x13
+#define BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION 0x16
+#define BLE_HCI_CONN_INTERVAL_UNACCEPTABLE 0x3B
+#endif
@@ -0,0 +1,10 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BLE_SRV_COMMON_H__
+#define BLE_SRV_COMMON_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#define BLE_CCCD_VALUE_LEN 2
+bool ble_srv_is_notification_enabled(uint8_t * p_encoded_data);
+#endif
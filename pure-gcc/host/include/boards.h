@@ -0,0 +1,12 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef BOARDS_H
+#define BOARDS_H
+#include "nrf_gpio.h"
+#define RX_PIN_NUMBER  11
+#define TX_PIN_NUMBER  9
+#define CTS_PIN_NUMBER 10
+#define RTS_PIN_NUMBER 8
+#define HWFC           false
+#define BUTTON_PULL    NRF_GPIO_PIN_PULLUP
+#endif
@@ -0,0 +1,35 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef DEVICE_MANAGER_H__
+#define DEVICE_MANAGER_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "device_manager_cnfg.h"
+#define DM_INVALID_ID 0xFF
+#define DM_PROTOCOL_CNTXT_NONE 0x00
+#define DM_PROTOCOL_CNTXT_GATT_SRVR_ID 0x01
+#define DM_EVT_CONNECTION 0x11
+#define DM_EVT_DISCONNECTION 0x12
+#define DM_EVT_SECURITY_SETUP 0x13
+#define DM_EVT_SECURITY_SETUP_COMPLETE 0x14
+#define DM_EVT_LINK_SECURED 0x15
+#define DM_EVT_SECURITY_SETUP_REFRESH 0x16
+#define DM_EVT_DEVICE_CONTEXT_LOADED 0x21
+#define DM_EVT_DEVICE_CONTEXT_STORED 0x22
+#define DM_EVT_DEVICE_CONTEXT_DELETED 0x23
+typedef uint32_t api_result_t;
+typedef uint8_t dm_application_instance_t;
+typedef struct { uint8_t appl_id; uint8_t connection_id; uint8_t device_id; uint8_t service_id; } dm_handle_t;
+typedef union { ble_gap_evt_t * p_gap_param; } dm_event_param_t;
+typedef struct { uint8_t event_id; dm_event_param_t event_param; uint16_t event_paramlen; } dm_event_t;
+typedef api_result_t (*dm_event_cb_t)(dm_handle_t const * p_handle, dm_event_t const * p_event, api_result_t event_result);
+typedef struct { bool clear_persistent_data; } dm_init_param_t;
+typedef struct { dm_event_cb_t evt_handler; uint8_t service_type; ble_gap_sec_params_t sec_param; } dm_application_param_t;
+api_result_t dm_init(dm_init_param_t const * p_init_param);
+api_result_t dm_register(dm_application_instance_t * p_appl_instance, dm_application_param_t const * p_appl_param);
+void dm_ble_evt_handler(ble_evt_t * p_ble_evt);
+api_result_t dm_handle_initialize(dm_handle_t * p_handle);
+api_result_t dm_whitelist_create(dm_application_instance_t const * p_handle, ble_gap_whitelist_t * p_whitelist);
+api_result_t dm_peer_addr_get(dm_handle_t const * p_handle, ble_gap_addr_t * p_addr);
+#endif
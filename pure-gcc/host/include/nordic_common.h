@@ -0,0 +1,11 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NORDIC_COMMON_H__
+#define NORDIC_COMMON_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#define UNUSED_PARAMETER(X) ((void)(X))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
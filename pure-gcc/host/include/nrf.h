@@ -0,0 +1,66 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NRF_H
+#define NRF_H
+#include <stdint.h>
+#define __I  volatile const
+#define __O  volatile
+#define __IO volatile
+typedef enum {
+  POWER_CLOCK_IRQn = 0, RADIO_IRQn = 1, UART0_IRQn = 2, SPI0_TWI0_IRQn = 3, SPI1_TWI1_IRQn = 4,
+  GPIOTE_IRQn = 6, ADC_IRQn = 7, TIMER0_IRQn = 8, TIMER1_IRQn = 9, TIMER2_IRQn = 10,
+  RTC0_IRQn = 11, TEMP_IRQn = 12, RNG_IRQn = 13, ECB_IRQn = 14, CCM_AAR_IRQn = 15,
+  WDT_IRQn = 16, RTC1_IRQn = 17, QDEC_IRQn = 18, LPCOMP_IRQn = 19, SWI0_IRQn = 20,
+  SWI1_IRQn = 21, SWI2_IRQn = 22, SWI3_IRQn = 23, SWI4_IRQn = 24, SWI5_IRQn = 25
+} IRQn_Type;
+typedef struct {
+  __O uint32_t TASKS_STARTRX; __O uint32_t TASKS_STOPRX; __O uint32_t TASKS_STARTTX; __O uint32_t TASKS_STOPTX;
+  __IO uint32_t EVENTS_CTS; __IO uint32_t EVENTS_NCTS; __IO uint32_t EVENTS_RXDRDY; __IO uint32_t EVENTS_TXDRDY;
+  __IO uint32_t EVENTS_ERROR; __IO uint32_t EVENTS_RXTO;
+  __IO uint32_t INTEN; __IO uint32_t INTENSET; __IO uint32_t INTENCLR; __IO uint32_t ERRORSRC;
+  __IO uint32_t ENABLE; __IO uint32_t PSELRTS; __IO uint32_t PSELTXD; __IO uint32_t PSELCTS; __IO uint32_t PSELRXD;
+  __I uint32_t RXD; __O uint32_t TXD; __IO uint32_t BAUDRATE; __IO uint32_t CONFIG;
+} NRF_UART_Type;
+typedef struct {
+  __O uint32_t TASKS_STARTRX; __O uint32_t TASKS_STARTTX; __O uint32_t TASKS_STOP; __O uint32_t TASKS_SUSPEND; __O uint32_t TASKS_RESUME;
+  __IO uint32_t EVENTS_STOPPED; __IO uint32_t EVENTS_RXDREADY; __IO uint32_t EVENTS_TXDSENT; __IO uint32_t EVENTS_ERROR; __IO uint32_t EVENTS_BB;
+  __IO uint32_t SHORTS; __IO uint32_t INTEN; __IO uint32_t INTENSET; __IO uint32_t INTENCLR; __IO uint32_t ERRORSRC;
+  __IO uint32_t ENABLE; __IO uint32_t PSELSCL; __IO uint32_t PSELSDA; __I uint32_t RXD; __IO uint32_t TXD;
+  __IO uint32_t FREQUENCY; __IO uint32_t ADDRESS; __IO uint32_t POWER;
+} NRF_TWI_Type;
+typedef struct {
+  __O uint32_t TASKS_START; __O uint32_t TASKS_STOP; __O uint32_t TASKS_CLEAR; __O uint32_t TASKS_TRIGOVRFLW;
+  __IO uint32_t EVENTS_TICK; __IO uint32_t EVENTS_OVRFLW; __IO uint32_t EVENTS_COMPARE[4];
+  __IO uint32_t INTENSET; __IO uint32_t INTENCLR; __IO uint32_t EVTEN; __IO uint32_t EVTENSET; __IO uint32_t EVTENCLR;
+  __I uint32_t COUNTER; __IO uint32_t PRESCALER; __IO uint32_t CC[4]; __IO uint32_t POWER;
+} NRF_RTC_Type;
+typedef struct {
+  __IO uint32_t OUT; __IO uint32_t OUTSET; __IO uint32_t OUTCLR; __I uint32_t IN; __IO uint32_t DIR;
+  __IO uint32_t DIRSET; __IO uint32_t DIRCLR; __IO uint32_t PIN_CNF[32];
+} NRF_GPIO_Type;
+typedef struct { __I uint32_t CODEPAGESIZE; __I uint32_t CODESIZE; __I uint32_t DEVICEADDR[2]; } NRF_FICR_Type;
+typedef struct { __IO uint32_t CLENR0; __IO uint32_t RBPCONF; __IO uint32_t XTALFREQ; __I uint32_t FWID; __IO uint32_t BOOTLOADERADDR; } NRF_UICR_Type;
+extern NRF_UART_Type host_nrf_uart0;
+extern NRF_TWI_Type  host_nrf_twi0;
+extern NRF_RTC_Type  host_nrf_rtc1;
+extern NRF_GPIO_Type host_nrf_gpio;
+extern NRF_FICR_Type host_nrf_ficr;
+extern NRF_UICR_Type host_nrf_uicr;
+#define NRF_UART0 (&host_nrf_uart0)
+#define NRF_TWI0  (&host_nrf_twi0)
+#define NRF_RTC1  (&host_nrf_rtc1)
+#define NRF_GPIO  (&host_nrf_gpio)
+#define NRF_FICR  (&host_nrf_ficr)
+#define NRF_UICR  (&host_nrf_uicr)
+void NVIC_SetPriority(IRQn_Type irqn, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type irqn);
+void NVIC_DisableIRQ(IRQn_Type irqn);
+void NVIC_ClearPendingIRQ(IRQn_Type irqn);
+void NVIC_SetPendingIRQ(IRQn_Type irqn);
+void NVIC_SystemReset(void);
+void __WFE(void);
+void __SEV(void);
+void __DMB(void);
+void __disable_irq(void);
+void __enable_irq(void);
+#endif
@@ -0,0 +1,59 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NRF51_BITFIELDS_H
+#define NRF51_BITFIELDS_H
+#define UART_INTENSET_RXDRDY_Pos (2UL)
+#define UART_INTENSET_RXDRDY_Enabled (1UL)
+#define UART_INTENSET_RXDRDY_Msk (0x1UL << UART_INTENSET_RXDRDY_Pos)
+#define UART_INTENCLR_RXDRDY_Pos (2UL)
+#define UART_INTENCLR_RXDRDY_Msk (0x1UL << UART_INTENCLR_RXDRDY_Pos)
+#define UART_INTENCLR_RXDRDY_Clear (1UL)
+#define UART_INTENSET_ERROR_Pos (9UL)
+#define UART_INTENSET_ERROR_Msk (0x1UL << UART_INTENSET_ERROR_Pos)
+#define UART_INTENSET_ERROR_Enabled (1UL)
+#define UART_INTENSET_RXTO_Pos (17UL)
+#define UART_INTENSET_RXTO_Msk (0x1UL << UART_INTENSET_RXTO_Pos)
+#define UART_INTENSET_RXTO_Enabled (1UL)
+#define UART_ENABLE_ENABLE_Pos (0UL)
+#define UART_ENABLE_ENABLE_Enabled (0x04UL)
+#define UART_CONFIG_HWFC_Pos (0UL)
+#define UART_CONFIG_HWFC_Enabled (1UL)
+#define UART_BAUDRATE_BAUDRATE_Pos (0UL)
+#define UART_BAUDRATE_BAUDRATE_Baud38400 (0x009D5000UL)
+#define UART_BAUDRATE_BAUDRATE_Baud115200 (0x01D7E000UL)
+#define TWI_INTENSET_STOPPED_Pos (1UL)
+#define TWI_INTENSET_STOPPED_Msk (0x1UL << TWI_INTENSET_STOPPED_Pos)
+#define TWI_INTENSET_STOPPED_Enabled (1UL)
+#define TWI_INTENSET_TXDSENT_Pos (7UL)
+#define TWI_INTENSET_TXDSENT_Msk (0x1UL << TWI_INTENSET_TXDSENT_Pos)
+#define TWI_INTENSET_TXDSENT_Enabled (1UL)
+#define TWI_INTENSET_ERROR_Pos (9UL)
+#define TWI_INTENSET_ERROR_Msk (0x1UL << TWI_INTENSET_ERROR_Pos)
+#define TWI_INTENSET_ERROR_Enabled (1UL)
+#define TWI_ERRORSRC_ANACK_Pos (1UL)
+#define TWI_ERRORSRC_ANACK_Msk (0x1UL << TWI_ERRORSRC_ANACK_Pos)
+#define TWI_ERRORSRC_DNACK_Pos (2UL)
+#define TWI_ERRORSRC_DNACK_Msk (0x1UL << TWI_ERRORSRC_DNACK_Pos)
+#define TWI_ERRORSRC_OVERRUN_Pos (0UL)
+#define TWI_ERRORSRC_OVERRUN_Msk (0x1UL << TWI_ERRORSRC_OVERRUN_Pos)
+#define TWI_ENABLE_ENABLE_Pos (0UL)
+#define TWI_ENABLE_ENABLE_Disabled (0x00UL)
+#define TWI_ENABLE_ENABLE_Enabled (0x05UL)
+#define TWI_FREQUENCY_FREQUENCY_Pos (0UL)
+#define TWI_FREQUENCY_FREQUENCY_K100 (0x01980000UL)
+#define TWI_FREQUENCY_FREQUENCY_K250 (0x04000000UL)
+#define TWI_FREQUENCY_FREQUENCY_K400 (0x06680000UL)
+#define TWI_SHORTS_BB_SUSPEND_Pos (0UL)
+#define TWI_SHORTS_BB_STOP_Pos (1UL)
+#define GPIO_PIN_CNF_DIR_Pos (0UL)
+#define GPIO_PIN_CNF_DIR_Input (0UL)
+#define GPIO_PIN_CNF_DIR_Output (1UL)
+#define GPIO_PIN_CNF_INPUT_Pos (1UL)
+#define GPIO_PIN_CNF_INPUT_Connect (0UL)
+#define GPIO_PIN_CNF_PULL_Pos (2UL)
+#define GPIO_PIN_CNF_PULL_Pullup (3UL)
+#define GPIO_PIN_CNF_DRIVE_Pos (8UL)
+#define GPIO_PIN_CNF_DRIVE_S0D1 (6UL)
+#define GPIO_PIN_CNF_SENSE_Pos (16UL)
+#define GPIO_PIN_CNF_SENSE_Disabled (0UL)
+#endif
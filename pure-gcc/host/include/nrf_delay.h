@@ -0,0 +1,8 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+#include <stdint.h>
+void nrf_delay_us(uint32_t volatile number_of_us);
+void nrf_delay_ms(uint32_t volatile number_of_ms);
+#endif
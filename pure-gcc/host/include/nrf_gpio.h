@@ -0,0 +1,18 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+#include <stdint.h>
+#include "nrf.h"
+typedef enum { NRF_GPIO_PIN_NOPULL = 0, NRF_GPIO_PIN_PULLDOWN = 1, NRF_GPIO_PIN_PULLUP = 3 } nrf_gpio_pin_pull_t;
+typedef enum { NRF_GPIO_PIN_NOSENSE = 0, NRF_GPIO_PIN_SENSE_LOW = 3, NRF_GPIO_PIN_SENSE_HIGH = 2 } nrf_gpio_pin_sense_t;
+void nrf_gpio_range_cfg_output(uint32_t pin_range_start, uint32_t pin_range_end);
+void nrf_gpio_cfg_output(uint32_t pin_number);
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config);
+void nrf_gpio_cfg_sense_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config, nrf_gpio_pin_sense_t sense_config);
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+void nrf_gpio_pin_toggle(uint32_t pin_number);
+void nrf_gpio_pin_write(uint32_t pin_number, uint32_t value);
+uint32_t nrf_gpio_pin_read(uint32_t pin_number);
+#endif
@@ -0,0 +1,13 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef NRF_SOC_H__
+#define NRF_SOC_H__
+#include <stdint.h>
+enum { NRF_EVT_HFCLKSTARTED, NRF_EVT_POWER_FAILURE_WARNING, NRF_EVT_FLASH_OPERATION_SUCCESS, NRF_EVT_FLASH_OPERATION_ERROR };
+uint32_t sd_app_evt_wait(void);
+uint32_t sd_power_system_off(void);
+uint32_t sd_nvic_SetPriority(uint32_t irqn, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(uint32_t irqn);
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
+#endif
@@ -0,0 +1,17 @@
+/* Host build stand-in for the nRF51 SDK / S110 header of the same name, declares only what the
+ * firmware uses. Implemented by the emulator sources in the parent directory. */
+#ifndef SOFTDEVICE_HANDLER_H__
+#define SOFTDEVICE_HANDLER_H__
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_soc.h"
+#include "ble.h"
+#include "app_error.h"
+#define NRF_CLOCK_LFCLKSRC_XTAL_20_PPM 5
+typedef void (*ble_evt_handler_t) (ble_evt_t * p_ble_evt);
+typedef void (*sys_evt_handler_t) (uint32_t evt_id);
+uint32_t softdevice_handler_init(uint32_t clock_source, void * p_evt_buffer, uint16_t evt_buffer_size, void * evt_schedule_func);
+#define SOFTDEVICE_HANDLER_INIT(CLOCK_SOURCE, USE_SCHEDULER) do { APP_ERROR_CHECK(softdevice_handler_init((CLOCK_SOURCE), 0, 0, 0)); } while (0)
+uint32_t softdevice_ble_evt_handler_set(ble_evt_handler_t ble_evt_handler);
+uint32_t softdevice_sys_evt_handler_set(sys_evt_handler_t sys_evt_handler);
+#endif
@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "rgb_lcd.h"
+#include "rgb_glyph.h"
+#include "rgb_bigfont.h"
+
+
+#define BIGFONT_ROM_FULL        0xFF                                 /**< ROM character with every pixel set. */
+#define BIGFONT_ROM_BLANK       ' '
+
+/**@brief Cell contents of the font. The segments are in the order of their glyph IDs, from
+ *        RGB_GLYPH_SEG_TOP on.
+ */
+enum
+{
+    BIGFONT_TOP,                                                     /**< Bar at the top. */
+    BIGFONT_BOTTOM,                                                  /**< Bar at the bottom. */
+    BIGFONT_BOTH,                                                    /**< Bars at the top and the bottom. */
+    BIGFONT_DOT,                                                     /**< Half of a colon. */
+    BIGFONT_SEG_COUNT,                                               /**< Number of segment glyphs, not a cell. */
+    BIGFONT_FULL = BIGFONT_SEG_COUNT,                                /**< Full block. */
+    BIGFONT_BLANK
+};
+
+#define BIGFONT_COLON           10                                   /**< Index of ':' in m_font. */
+#define BIGFONT_SPACE           11                                   /**< Index of ' ' in m_font. */
+
+/**@brief Characters, line by line. A colon only uses the first column. */
+static const uint8_t m_font[][LCD_ROWS][RGB_BIGFONT_DIGIT_WIDTH] =
+{
+    {{BIGFONT_FULL,   BIGFONT_TOP,    BIGFONT_FULL},
+     {BIGFONT_FULL,   BIGFONT_BOTTOM, BIGFONT_FULL}},
+    {{BIGFONT_TOP,    BIGFONT_FULL,   BIGFONT_BLANK},
+     {BIGFONT_BOTTOM, BIGFONT_FULL,   BIGFONT_BOTTOM}},
+    {{BIGFONT_BOTH,   BIGFONT_BOTH,   BIGFONT_FULL},
+     {BIGFONT_FULL,   BIGFONT_BOTTOM, BIGFONT_BOTTOM}},
+    {{BIGFONT_BOTH,   BIGFONT_BOTH,   BIGFONT_FULL},
+     {BIGFONT_BOTTOM, BIGFONT_BOTTOM, BIGFONT_FULL}},
+    {{BIGFONT_FULL,   BIGFONT_BOTTOM, BIGFONT_FULL},
+     {BIGFONT_BLANK,  BIGFONT_BLANK,  BIGFONT_FULL}},
+    {{BIGFONT_FULL,   BIGFONT_BOTH,   BIGFONT_BOTH},
+     {BIGFONT_BOTTOM, BIGFONT_BOTTOM, BIGFONT_FULL}},
+    {{BIGFONT_FULL,   BIGFONT_BOTH,   BIGFONT_BOTH},
+     {BIGFONT_FULL,   BIGFONT_BOTTOM, BIGFONT_FULL}},
+    {{BIGFONT_TOP,    BIGFONT_TOP,    BIGFONT_FULL},
+     {BIGFONT_BLANK,  BIGFONT_BLANK,  BIGFONT_FULL}},
+    {{BIGFONT_FULL,   BIGFONT_BOTH,   BIGFONT_FULL},
+     {BIGFONT_FULL,   BIGFONT_BOTTOM, BIGFONT_FULL}},
+    {{BIGFONT_FULL,   BIGFONT_BOTH,   BIGFONT_FULL},
+     {BIGFONT_BOTTOM, BIGFONT_BOTTOM, BIGFONT_FULL}},
+    [BIGFONT_COLON] = {{BIGFONT_DOT,    BIGFONT_BLANK,  BIGFONT_BLANK},
+                       {BIGFONT_DOT,    BIGFONT_BLANK,  BIGFONT_BLANK}},
+    [BIGFONT_SPACE] = {{BIGFONT_BLANK,  BIGFONT_BLANK,  BIGFONT_BLANK},
+                       {BIGFONT_BLANK,  BIGFONT_BLANK,  BIGFONT_BLANK}},
+};
+
+
+static uint8_t bigfont_index(uint8_t c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+    return (c == ':') ? BIGFONT_COLON : BIGFONT_SPACE;
+}
+
+
+/**@brief Function for getting the blank columns before a character.
+ *
+ * @param[in] p_text  Characters.
+ * @param[in] i       Index of the character.
+ */
+static uint8_t bigfont_gap(const uint8_t * p_text, uint8_t i)
+{
+    if ((i == 0) || (p_text[i] == ':') || (p_text[i - 1] == ':'))
+    {
+        return 0;
+    }
+    return RGB_BIGFONT_GAP_WIDTH;
+}
+
+
+static uint8_t bigfont_char_width(uint8_t c)
+{
+    return (c == ':') ? RGB_BIGFONT_COLON_WIDTH : RGB_BIGFONT_DIGIT_WIDTH;
+}
+
+
+uint8_t rgb_bigfont_width(const uint8_t * p_text, uint8_t length)
+{
+    uint8_t width = 0;
+    uint8_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        width += bigfont_gap(p_text, i) + bigfont_char_width(p_text[i]);
+    }
+    return width;
+}
+
+
+uint32_t rgb_bigfont_write(uint8_t col, const uint8_t * p_text, uint8_t length)
+{
+    uint8_t  cells[LCD_ROWS][LCD_DDRAM_LINE_LEN];
+    uint8_t  codes[BIGFONT_SEG_COUNT];
+    uint8_t  needed = 0;
+    uint8_t  slots  = 0;
+    uint8_t  width  = 0;
+    uint8_t  i;
+    uint8_t  row;
+    uint8_t  x;
+    uint32_t err_code;
+
+    if (col >= LCD_DDRAM_LINE_LEN)
+    {
+        return NRF_SUCCESS;
+    }
+
+    // Lay the text out as font cells, clipped at the end of the line.
+    for (i = 0; (i < length) && (width < LCD_DDRAM_LINE_LEN - col); i++)
+    {
+        const uint8_t (* p_char)[RGB_BIGFONT_DIGIT_WIDTH] = m_font[bigfont_index(p_text[i])];
+        uint8_t         gap        = bigfont_gap(p_text, i);
+        uint8_t         char_width = gap + bigfont_char_width(p_text[i]);
+
+        for (x = 0; (x < char_width) && (width < LCD_DDRAM_LINE_LEN - col); x++, width++)
+        {
+            for (row = 0; row < LCD_ROWS; row++)
+            {
+                cells[row][width] = (x < gap) ? BIGFONT_BLANK : p_char[row][x - gap];
+                if (cells[row][width] < BIGFONT_SEG_COUNT)
+                {
+                    needed |= 1 << cells[row][width];
+                }
+            }
+        }
+    }
+
+    // A segment loaded into the slot of another one just loaded means the cache has too few
+    // free slots, the two would show the same glyph.
+    for (i = 0; i < BIGFONT_SEG_COUNT; i++)
+    {
+        if (!(needed & (1 << i)))
+        {
+            continue;
+        }
+        err_code = rgb_glyph_code(RGB_GLYPH_SEG_TOP + i, &codes[i]);
+        if ((err_code == NRF_SUCCESS) && (slots & (1 << codes[i])))
+        {
+            err_code = NRF_ERROR_NO_MEM;
+        }
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        slots |= 1 << codes[i];
+    }
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        for (x = 0; x < width; x++)
+        {
+            switch (cells[row][x])
+            {
+                case BIGFONT_FULL:
+                    cells[row][x] = BIGFONT_ROM_FULL;
+                    break;
+
+                case BIGFONT_BLANK:
+                    cells[row][x] = BIGFONT_ROM_BLANK;
+                    break;
+
+                default:
+                    cells[row][x] = codes[cells[row][x]];
+                    break;
+            }
+        }
+        rgb_lcd_write_at(col, row, cells[row], width);
+    }
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,44 @@
+/**@file
+ *
+ * @brief    Big digits over both lines of the RGB LCD.
+ *
+ * @details  Digits are 3 cells wide and 2 lines high, built from the ROM full block and four
+ *           segment glyphs (bars at the top, the bottom or both, and half a colon) kept by the
+ *           glyph cache. The segments are uploaded to CGRAM the first time they are needed and
+ *           stay resident while they are on the display, so redrawing never uploads them again.
+ *
+ *           Text is written with @ref rgb_lcd_write_at, which leaves unchanged cells alone: when
+ *           a clock ticks only the cells of the digits that changed go to the controller.
+ *
+ *           Consecutive digits are separated by a blank column, a colon takes one column and
+ *           needs no separation, so "12:34" is 15 columns wide.
+ */
+
+#ifndef RGB_BIGFONT_H__
+#define RGB_BIGFONT_H__
+
+#include <stdint.h>
+
+#define RGB_BIGFONT_DIGIT_WIDTH     3                                /**< Columns of a digit or a space. */
+#define RGB_BIGFONT_COLON_WIDTH     1                                /**< Columns of a colon. */
+#define RGB_BIGFONT_GAP_WIDTH       1                                /**< Blank columns between two digits. */
+
+/**@brief Function for getting the columns a text takes.
+ *
+ * @param[in] p_text  Characters.
+ * @param[in] length  Number of characters.
+ */
+uint8_t rgb_bigfont_width(const uint8_t * p_text, uint8_t length);
+
+/**@brief Function for writing big text over both lines, leaving the cursor where it is.
+ *
+ * @param[in] col     Column of the left edge, 0 based.
+ * @param[in] p_text  Characters '0' to '9', ':' and ' '. Others show as a space.
+ * @param[in] length  Number of characters.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_NO_MEM if the glyph cache has no slot left for a segment, in
+ *         which case nothing is written.
+ */
+uint32_t rgb_bigfont_write(uint8_t col, const uint8_t * p_text, uint8_t length);
+
+#endif // RGB_BIGFONT_H__
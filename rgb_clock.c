@@ -0,0 +1,267 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "rgb_lcd.h"
+#include "rgb_bigfont.h"
+#include "adv_status.h"
+#include "rgb_clock.h"
+
+
+#define CLOCK_TIMER_PRESCALER   0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define CLOCK_TICK_MS           1000                                 /**< Tick interval, a whole number of RTC ticks so the clock does not drift. */
+#define CLOCK_TEXT_MAX_LEN      8                                    /**< Characters of the longest format. */
+#define CLOCK_TEXT_LEN          5                                    /**< Characters of the formats other than hh:mm:ss. */
+#define CLOCK_BIG_LEN           (4 * RGB_BIGFONT_DIGIT_WIDTH + RGB_BIGFONT_COLON_WIDTH + 2 * RGB_BIGFONT_GAP_WIDTH) /**< Columns of "hh:mm" in big digits. */
+#define CLOCK_FIELD_MAX_LEN     CLOCK_BIG_LEN                        /**< Cells per line of the widest format. */
+#define CLOCK_SECONDS_MAX       (99UL * 3600 + 59 * 60 + 59)         /**< Longest time the formats can show. */
+#define CLOCK_MINUTES_MAX       (ADV_STATUS_MINUTES_UNKNOWN - 1)     /**< Most remaining minutes in the advertising status record. */
+
+/**@brief Field placement. */
+typedef struct
+{
+    uint8_t col;
+    uint8_t row;
+    uint8_t format;                                                  /**< @ref rgb_clock_format_t. */
+} clock_field_t;
+
+/**@brief Cells used by each format on each of its lines. */
+static const uint8_t m_format_len[RGB_CLOCK_FORMAT_COUNT] =
+{
+    [RGB_CLOCK_FORMAT_NONE]      = 0,
+    [RGB_CLOCK_FORMAT_HH_MM]     = CLOCK_TEXT_LEN,
+    [RGB_CLOCK_FORMAT_HH_MM_SS]  = CLOCK_TEXT_MAX_LEN,
+    [RGB_CLOCK_FORMAT_MM_SS]     = CLOCK_TEXT_LEN,
+    [RGB_CLOCK_FORMAT_BIG_HH_MM] = CLOCK_BIG_LEN,
+    [RGB_CLOCK_FORMAT_BIG_MM_SS] = CLOCK_BIG_LEN,
+};
+
+static app_timer_id_t    m_timer_id;
+static bool              m_timer_running;
+static volatile uint32_t m_now;                                      /**< Seconds counted by the tick, the time base of both fields. */
+static volatile bool     m_redraw_due;                               /**< Set by the tick and by changes, cleared when the fields are drawn. */
+static bool              m_time_valid;                               /**< The time of day has been set. */
+static uint32_t          m_time_base;                                /**< Time of day at m_now == 0. */
+static bool              m_countdown_valid;                          /**< The end of the wash cycle has been set. */
+static uint32_t          m_countdown_end;                            /**< Value of m_now at the end of the wash cycle. */
+static uint8_t           m_minutes;                                  /**< Remaining minutes last given to the advertising status. */
+static clock_field_t     m_fields[RGB_CLOCK_FIELD_COUNT];
+
+
+/**@brief Function for handling the clock tick.
+ *
+ * @details Counts the second here, so none is lost if the main loop is late, and leaves the
+ *          drawing to the main loop.
+ */
+static void clock_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_now++;
+    m_redraw_due = true;
+}
+
+
+static void clock_tick_start(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_stop(m_timer_id);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_start(m_timer_id,
+                               APP_TIMER_TICKS(CLOCK_TICK_MS, CLOCK_TIMER_PRESCALER),
+                               NULL);
+    APP_ERROR_CHECK(err_code);
+    m_timer_running = true;
+}
+
+
+static bool clock_format_is_big(uint8_t format)
+{
+    return (format == RGB_CLOCK_FORMAT_BIG_HH_MM) || (format == RGB_CLOCK_FORMAT_BIG_MM_SS);
+}
+
+
+/**@brief Function for checking whether a format shows seconds. */
+static bool clock_format_has_seconds(uint8_t format)
+{
+    return (format != RGB_CLOCK_FORMAT_HH_MM) && (format != RGB_CLOCK_FORMAT_BIG_HH_MM);
+}
+
+
+static uint8_t * clock_digits_put(uint8_t * p_text, uint32_t value)
+{
+    p_text[0] = '0' + value / 10;
+    p_text[1] = '0' + value % 10;
+    return p_text + 2;
+}
+
+
+/**@brief Function for formatting a time.
+ *
+ * @param[in]  seconds  Time to show, capped at what the format can show.
+ * @param[in]  format   Format, not RGB_CLOCK_FORMAT_NONE.
+ * @param[out] p_text   At least CLOCK_TEXT_MAX_LEN characters.
+ */
+static void clock_format(uint32_t seconds, uint8_t format, uint8_t * p_text)
+{
+    if ((format == RGB_CLOCK_FORMAT_MM_SS) || (format == RGB_CLOCK_FORMAT_BIG_MM_SS))
+    {
+        seconds = MIN(seconds, 99 * 60 + 59);
+        p_text  = clock_digits_put(p_text, seconds / 60);
+    }
+    else
+    {
+        seconds = MIN(seconds, CLOCK_SECONDS_MAX);
+        p_text  = clock_digits_put(p_text, seconds / 3600);
+        *p_text++ = ':';
+        p_text  = clock_digits_put(p_text, (seconds / 60) % 60);
+        if (format != RGB_CLOCK_FORMAT_HH_MM_SS)
+        {
+            return;
+        }
+    }
+    *p_text++ = ':';
+    (void)clock_digits_put(p_text, seconds % 60);
+}
+
+
+static void clock_field_draw(const clock_field_t * p_field, uint32_t seconds)
+{
+    uint8_t text[CLOCK_TEXT_MAX_LEN];
+
+    if (p_field->format == RGB_CLOCK_FORMAT_NONE)
+    {
+        return;
+    }
+    clock_format(seconds, p_field->format, text);
+    if (clock_format_is_big(p_field->format))
+    {
+        // With every glyph slot taken by other characters on display the field is left as it
+        // is, the next tick tries again.
+        (void)rgb_bigfont_write(p_field->col, text, CLOCK_TEXT_LEN);
+        return;
+    }
+    rgb_lcd_write_at(p_field->col, p_field->row, text, m_format_len[p_field->format]);
+}
+
+
+void rgb_clock_init(void)
+{
+    uint32_t err_code;
+
+    m_minutes = ADV_STATUS_MINUTES_UNKNOWN;
+
+    err_code = app_timer_create(&m_timer_id,
+                                APP_TIMER_MODE_REPEATED,
+                                clock_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_clock_time_set(uint32_t seconds)
+{
+    uint32_t now = m_now;
+
+    m_time_base  = ((seconds % RGB_CLOCK_SECONDS_PER_DAY) + RGB_CLOCK_SECONDS_PER_DAY
+                    - (now % RGB_CLOCK_SECONDS_PER_DAY)) % RGB_CLOCK_SECONDS_PER_DAY;
+    m_time_valid = true;
+    m_redraw_due = true;
+    if (!m_timer_running)
+    {
+        clock_tick_start();
+    }
+}
+
+
+void rgb_clock_countdown_set(uint32_t seconds)
+{
+    m_countdown_end   = m_now + seconds;
+    m_countdown_valid = true;
+    m_redraw_due      = true;
+    if (!m_timer_running)
+    {
+        clock_tick_start();
+    }
+}
+
+
+uint32_t rgb_clock_field_set(rgb_clock_field_t field, uint8_t col, uint8_t row, rgb_clock_format_t format)
+{
+    clock_field_t * p_field;
+    uint8_t         blank[CLOCK_FIELD_MAX_LEN];
+    uint8_t         line;
+
+    if ((field >= RGB_CLOCK_FIELD_COUNT) || (col >= LCD_DDRAM_LINE_LEN) || (row >= LCD_ROWS))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    p_field = &m_fields[field];
+
+    memset(blank, ' ', sizeof(blank));
+    for (line = 0; line < LCD_ROWS; line++)
+    {
+        if ((line == p_field->row) || clock_format_is_big(p_field->format))
+        {
+            rgb_lcd_write_at(p_field->col, line, blank, m_format_len[p_field->format]);
+        }
+    }
+
+    p_field->col    = col;
+    p_field->row    = row;
+    p_field->format = (format < RGB_CLOCK_FORMAT_COUNT) ? format : RGB_CLOCK_FORMAT_NONE;
+    m_redraw_due    = true;
+    return NRF_SUCCESS;
+}
+
+
+void rgb_clock_process(void)
+{
+    const clock_field_t * p_countdown = &m_fields[RGB_CLOCK_FIELD_COUNTDOWN];
+    uint32_t              now;
+    uint32_t              remaining = 0;
+    uint8_t               minutes   = ADV_STATUS_MINUTES_UNKNOWN;
+    uint32_t              err_code;
+
+    if (!m_redraw_due)
+    {
+        return;
+    }
+    m_redraw_due = false;
+    now          = m_now;
+
+    if (m_time_valid)
+    {
+        clock_field_draw(&m_fields[RGB_CLOCK_FIELD_TIME],
+                         (m_time_base + now) % RGB_CLOCK_SECONDS_PER_DAY);
+    }
+
+    if (m_countdown_valid)
+    {
+        remaining = (m_countdown_end > now) ? m_countdown_end - now : 0;
+        // Without seconds the display shows 0 minutes only once the cycle has ended.
+        clock_field_draw(p_countdown,
+                         clock_format_has_seconds(p_countdown->format) ? remaining : remaining + 59);
+        if (p_countdown->format != RGB_CLOCK_FORMAT_NONE)
+        {
+            minutes = MIN((remaining + 59) / 60, CLOCK_MINUTES_MAX);
+        }
+    }
+
+    if (minutes != m_minutes)
+    {
+        m_minutes = minutes;
+        adv_status_minutes_set(minutes);
+    }
+
+    // With no time of day and an ended cycle nothing changes any more, rest until the next set.
+    if (m_timer_running && !m_time_valid && (remaining == 0))
+    {
+        err_code = app_timer_stop(m_timer_id);
+        APP_ERROR_CHECK(err_code);
+        m_timer_running = false;
+    }
+}
@@ -0,0 +1,89 @@
+/**@file
+ *
+ * @brief    Clock and wash countdown fields for the RGB LCD.
+ *
+ * @details  The client syncs the time of day and the remaining wash time once; from then on the
+ *           firmware keeps both on a 1 s app_timer tick (RTC1) and renders them itself, so the
+ *           link can stay idle or be dropped while the display keeps counting.
+ *
+ *           Each field is a fixed width run of digits at a column and line of the frame. On every
+ *           tick the field is written with @ref rgb_lcd_write_at, which leaves unchanged cells
+ *           alone; the flush then sends only the digits that changed, usually one or two cells
+ *           per second.
+ *
+ *           The big formats use @ref rgb_bigfont_write over both lines; its segment glyphs stay
+ *           in CGRAM, so a tick costs the same few cells as with plain digits.
+ *
+ *           The remaining minutes of a shown countdown also go to the advertising status record.
+ */
+
+#ifndef RGB_CLOCK_H__
+#define RGB_CLOCK_H__
+
+#include <stdint.h>
+
+#define RGB_CLOCK_SECONDS_PER_DAY   86400UL                          /**< Time of day wraps to 0 here. */
+
+/**@brief Fields. */
+typedef enum
+{
+    RGB_CLOCK_FIELD_TIME,                                            /**< Time of day. */
+    RGB_CLOCK_FIELD_COUNTDOWN,                                       /**< Time left until the end of the wash cycle. */
+    RGB_CLOCK_FIELD_COUNT                                            /**< Number of fields, not a field. */
+} rgb_clock_field_t;
+
+/**@brief Field formats. Hours and minutes of a countdown without seconds are rounded up. */
+typedef enum
+{
+    RGB_CLOCK_FORMAT_NONE      = 0,                                  /**< Field not shown. */
+    RGB_CLOCK_FORMAT_HH_MM     = 1,                                  /**< "hh:mm", 5 cells. */
+    RGB_CLOCK_FORMAT_HH_MM_SS  = 2,                                  /**< "hh:mm:ss", 8 cells. */
+    RGB_CLOCK_FORMAT_MM_SS     = 3,                                  /**< "mm:ss", 5 cells, up to 99:59. */
+    RGB_CLOCK_FORMAT_BIG_HH_MM = 4,                                  /**< "hh:mm" in big digits, 15 columns of both lines. */
+    RGB_CLOCK_FORMAT_BIG_MM_SS = 5,                                  /**< "mm:ss" in big digits, 15 columns of both lines. */
+    RGB_CLOCK_FORMAT_COUNT                                           /**< Number of formats, not a format. */
+} rgb_clock_format_t;
+
+/**@brief Function for initializing the clock module.
+ *
+ * @details Requires the app_timer module to be initialized.
+ */
+void rgb_clock_init(void);
+
+/**@brief Function for setting the time of day.
+ *
+ * @details A running tick is kept, so a resync does not hold back the countdown. The shown
+ *          seconds may roll over up to a second after the client clock does.
+ *
+ * @param[in] seconds  Seconds since midnight, taken modulo RGB_CLOCK_SECONDS_PER_DAY.
+ */
+void rgb_clock_time_set(uint32_t seconds);
+
+/**@brief Function for setting the end of the wash cycle.
+ *
+ * @details The end is given relative to now, so it does not depend on the time of day having
+ *          been set.
+ *
+ * @param[in] seconds  Seconds until the cycle ends, 0 for an ended cycle.
+ */
+void rgb_clock_countdown_set(uint32_t seconds);
+
+/**@brief Function for placing a field on the display, or removing it.
+ *
+ * @details The cells of the field at its previous place are blanked. A time field shows nothing
+ *          until the time has been set, a countdown field nothing until the end has been set.
+ *
+ * @param[in] field   Field.
+ * @param[in] col     Column, 0 based, below LCD_DDRAM_LINE_LEN.
+ * @param[in] row     Line, 0 based, below LCD_ROWS. Ignored by the big formats.
+ * @param[in] format  Format, RGB_CLOCK_FORMAT_NONE removes the field.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_INVALID_PARAM for a field or position out of range, in which
+ *         case the field is left as it is.
+ */
+uint32_t rgb_clock_field_set(rgb_clock_field_t field, uint8_t col, uint8_t row, rgb_clock_format_t format);
+
+/**@brief Function for redrawing the fields after a tick. Called from the main loop. */
+void rgb_clock_process(void);
+
+#endif // RGB_CLOCK_H__
@@ -0,0 +1,235 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "lcd_defs.h"
+#include "rgb_lcd.h"
+#include "rgb_fx.h"
+#include "adv_status.h"
+
+
+#define FX_TIMER_PRESCALER      0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define FX_STEP_MS              20                                   /**< Time between two fade steps. */
+#define FX_STEP_INTERVAL        APP_TIMER_TICKS(FX_STEP_MS, FX_TIMER_PRESCALER)
+#define FX_BLINK_STEPS_PER_SEC  24                                   /**< GRPFREQ unit, blink period = (GRPFREQ + 1) / 24 s. */
+#define FX_GAMMA_LEVELS         (sizeof(m_gamma) / sizeof(m_gamma[0]))
+#define FX_CHANNELS             3
+
+/**@brief PWM value for each perceived brightness level, gamma 2.2. */
+static const uint8_t m_gamma[] =
+{
+      0,   0,   0,   0,   1,   1,   1,   2,   3,   4,   4,   5,   7,   8,   9,  11,
+     13,  14,  16,  18,  20,  23,  25,  28,  31,  33,  36,  40,  43,  46,  50,  54,
+     57,  61,  66,  70,  74,  79,  84,  89,  94,  99, 105, 110, 116, 122, 128, 134,
+    140, 147, 153, 160, 167, 174, 182, 189, 197, 205, 213, 221, 229, 238, 246, 255
+};
+
+static app_timer_id_t   m_fade_timer_id;
+static volatile bool    m_fade_step_due;                             /**< Set by the fade timer, cleared when the step is sent. */
+static uint16_t         m_fade_step;                                 /**< Steps sent so far. */
+static uint16_t         m_fade_steps;                                /**< Total number of steps, 0 when no fade is running. */
+static uint16_t         m_fade_from[FX_CHANNELS];                    /**< Start levels (8.8 fixed point) in PWM register order (blue, green, red). */
+static uint16_t         m_fade_to[FX_CHANNELS];                      /**< Target levels (8.8 fixed point). */
+static uint8_t          m_fade_target[FX_CHANNELS];                  /**< Exact target PWM values. */
+static uint8_t          m_fade_last[FX_CHANNELS];                    /**< PWM values written by the last step. */
+
+
+/**@brief Function for converting a PWM value into a perceived brightness level.
+ *
+ * @return Level in 8.8 fixed point, 0 to (FX_GAMMA_LEVELS - 1) * 256.
+ */
+static uint16_t fx_pwm_to_level(uint8_t pwm)
+{
+    uint8_t lo = 0;
+    uint8_t hi = FX_GAMMA_LEVELS - 1;
+
+    // Last table entry not above pwm.
+    while (lo < hi)
+    {
+        uint8_t mid = (lo + hi + 1) / 2;
+
+        if (m_gamma[mid] <= pwm)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+
+    if ((lo == FX_GAMMA_LEVELS - 1) || (m_gamma[lo + 1] == m_gamma[lo]))
+    {
+        return lo << 8;
+    }
+    return (lo << 8) + ((pwm - m_gamma[lo]) << 8) / (m_gamma[lo + 1] - m_gamma[lo]);
+}
+
+
+/**@brief Function for converting a perceived brightness level (8.8 fixed point) into a PWM value. */
+static uint8_t fx_level_to_pwm(uint16_t level)
+{
+    uint8_t idx  = level >> 8;
+    uint8_t frac = level & 0xFF;
+
+    if (idx >= FX_GAMMA_LEVELS - 1)
+    {
+        return m_gamma[FX_GAMMA_LEVELS - 1];
+    }
+    return m_gamma[idx] + (((m_gamma[idx + 1] - m_gamma[idx]) * frac) >> 8);
+}
+
+
+static void fx_fade_stop(void)
+{
+    uint32_t err_code;
+
+    m_fade_steps    = 0;
+    m_fade_step_due = false;
+
+    err_code = app_timer_stop(m_fade_timer_id);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for handling the fade timer timeout.
+ *
+ * @details Only flags the step, the main loop wakes up on this interrupt and sends it.
+ */
+static void fx_fade_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_fade_step_due = true;
+}
+
+
+/**@brief Function for setting group PWM/blink mode.
+ *
+ * @param[in] blink    True for blinking (DMBLNK set), false for dimming.
+ * @param[in] grppwm   Group duty cycle.
+ * @param[in] grpfreq  Group frequency (blink only).
+ * @param[in] ledout   LEDOUT value, RGB_LEDOUT_PWM_GROUP to apply the group PWM.
+ */
+static void fx_group_set(bool blink, uint8_t grppwm, uint8_t grpfreq, uint8_t ledout)
+{
+    uint8_t mode2 = rgb_lcd_getReg(REG_MODE2);
+    uint8_t group[2];
+
+    mode2 = blink ? (mode2 | RGB_MODE2_DMBLNK) : (mode2 & ~RGB_MODE2_DMBLNK);
+
+    group[0] = grppwm;
+    group[1] = grpfreq;
+
+    rgb_lcd_setReg(REG_MODE2, mode2);
+    rgb_lcd_setRegs(REG_GRPPWM, group, sizeof(group));
+    rgb_lcd_setReg(REG_OUTPUT, ledout);
+}
+
+
+void rgb_fx_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_fade_timer_id,
+                                APP_TIMER_MODE_REPEATED,
+                                fx_fade_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_fx_blink(uint16_t period_ms, uint8_t duty)
+{
+    uint32_t grpfreq = ((uint32_t)period_ms * FX_BLINK_STEPS_PER_SEC) / 1000;
+
+    grpfreq = (grpfreq > 0) ? grpfreq - 1 : 0;
+    fx_group_set(true, duty, MIN(grpfreq, 0xFF), RGB_LEDOUT_PWM_GROUP);
+}
+
+
+void rgb_fx_dim(uint8_t level)
+{
+    fx_group_set(false, level, rgb_lcd_getReg(REG_GRPFREQ), RGB_LEDOUT_PWM_GROUP);
+}
+
+
+void rgb_fx_stop(void)
+{
+    fx_group_set(false, 0xFF, rgb_lcd_getReg(REG_GRPFREQ), RGB_LEDOUT_PWM);
+}
+
+
+void rgb_fx_fade(uint8_t r, uint8_t g, uint8_t b, uint16_t duration_ms)
+{
+    uint32_t err_code;
+    uint8_t  ch;
+
+    if (m_fade_steps != 0)
+    {
+        fx_fade_stop();
+    }
+
+    m_fade_target[0] = b;
+    m_fade_target[1] = g;
+    m_fade_target[2] = r;
+
+    if (duration_ms < FX_STEP_MS)
+    {
+        rgb_lcd_setRGB(r, g, b);
+        return;
+    }
+
+    for (ch = 0; ch < FX_CHANNELS; ch++)
+    {
+        m_fade_last[ch] = rgb_lcd_getReg(REG_BLUE + ch);
+        m_fade_from[ch] = fx_pwm_to_level(m_fade_last[ch]);
+        m_fade_to[ch]   = fx_pwm_to_level(m_fade_target[ch]);
+    }
+    m_fade_step  = 0;
+    m_fade_steps = duration_ms / FX_STEP_MS;
+
+    err_code = app_timer_start(m_fade_timer_id, FX_STEP_INTERVAL, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_fx_process(void)
+{
+    uint8_t pwm[FX_CHANNELS];
+    uint8_t ch;
+
+    if (!m_fade_step_due || (m_fade_steps == 0))
+    {
+        return;
+    }
+    m_fade_step_due = false;
+
+    // Someone else has set a color since the last step, that one wins.
+    for (ch = 0; ch < FX_CHANNELS; ch++)
+    {
+        if (rgb_lcd_getReg(REG_BLUE + ch) != m_fade_last[ch])
+        {
+            fx_fade_stop();
+            return;
+        }
+    }
+
+    m_fade_step++;
+    for (ch = 0; ch < FX_CHANNELS; ch++)
+    {
+        int32_t level = m_fade_from[ch] +
+                        ((int32_t)(m_fade_to[ch] - m_fade_from[ch]) * m_fade_step) / m_fade_steps;
+
+        pwm[ch] = (m_fade_step < m_fade_steps) ? fx_level_to_pwm(level) : m_fade_target[ch];
+    }
+
+    rgb_lcd_setRGB(pwm[2], pwm[1], pwm[0]);
+    memcpy(m_fade_last, pwm, sizeof(m_fade_last));
+
+    if (m_fade_step >= m_fade_steps)
+    {
+        fx_fade_stop();
+        adv_status_touch();
+    }
+}
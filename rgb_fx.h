@@ -0,0 +1,56 @@
+/**@file
+ *
+ * @brief    Backlight effects for the RGB LCD.
+ *
+ * @details  Blink and dim run inside the PCA9633 on its group PWM (GRPPWM, GRPFREQ and the MODE2
+ *           DMBLNK bit), so once started they cost neither CPU time nor bus traffic. Only color
+ *           cross-fades are stepped in software, in perceptually even steps taken from a gamma
+ *           table.
+ *
+ *           Fade steps are timed by an app_timer but sent from the main loop through
+ *           @ref rgb_fx_process, so the backlight registers are only ever written from one
+ *           context.
+ */
+
+#ifndef RGB_FX_H__
+#define RGB_FX_H__
+
+#include <stdint.h>
+
+/**@brief Function for initializing the effects module.
+ *
+ * @details Requires the app_timer module to be initialized.
+ */
+void rgb_fx_init(void);
+
+/**@brief Function for blinking the backlight from the LED driver.
+ *
+ * @param[in] period_ms  Blink period, 42 ms to 10.6 s.
+ * @param[in] duty       Part of the period the backlight is on, 0 (never) to 255 (always).
+ */
+void rgb_fx_blink(uint16_t period_ms, uint8_t duty);
+
+/**@brief Function for dimming all backlight channels together, keeping the color.
+ *
+ * @param[in] level  Overall brightness, 255 is the undimmed color.
+ */
+void rgb_fx_dim(uint8_t level);
+
+/**@brief Function for stopping blink and dim, the backlight shows the plain color again. */
+void rgb_fx_stop(void);
+
+/**@brief Function for cross-fading from the current color to a new one.
+ *
+ * @details A direct color change (@ref rgb_lcd_setRGB) while the fade runs cancels it.
+ *
+ * @param[in] r            Target red.
+ * @param[in] g            Target green.
+ * @param[in] b            Target blue.
+ * @param[in] duration_ms  Fade time, 0 sets the color right away.
+ */
+void rgb_fx_fade(uint8_t r, uint8_t g, uint8_t b, uint16_t duration_ms);
+
+/**@brief Function for sending a due fade step. Called from the main loop. */
+void rgb_fx_process(void);
+
+#endif // RGB_FX_H__
@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "rgb_lcd.h"
+#include "rgb_glyph.h"
+
+
+#define GLYPH_CLIENT_LAST       (RGB_GLYPH_CLIENT_FIRST + RGB_GLYPH_CLIENT_COUNT - 1)
+
+/**@brief Bitmaps of the built in glyphs, indexed by rgb_glyph_builtin_t. */
+static const uint8_t m_builtin[RGB_GLYPH_BUILTIN_COUNT][LCD_GLYPH_ROWS] =
+{
+    [RGB_GLYPH_DRUM]       = {0x1F, 0x11, 0x0E, 0x1B, 0x1B, 0x0E, 0x11, 0x1F},
+    [RGB_GLYPH_LOCK]       = {0x0E, 0x11, 0x11, 0x1F, 0x1B, 0x1B, 0x1F, 0x00},
+    [RGB_GLYPH_DROP]       = {0x04, 0x04, 0x0A, 0x0A, 0x11, 0x11, 0x0E, 0x00},
+    [RGB_GLYPH_BAR_1]      = {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10},
+    [RGB_GLYPH_BAR_2]      = {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
+    [RGB_GLYPH_BAR_3]      = {0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C},
+    [RGB_GLYPH_BAR_4]      = {0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E},
+    [RGB_GLYPH_SEG_TOP]    = {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00},
+    [RGB_GLYPH_SEG_BOTTOM] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F},
+    [RGB_GLYPH_SEG_BOTH]   = {0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x1F, 0x1F, 0x1F},
+    [RGB_GLYPH_SEG_DOT]    = {0x00, 0x00, 0x00, 0x0E, 0x0E, 0x00, 0x00, 0x00},
+};
+
+static uint8_t  m_client[RGB_GLYPH_CLIENT_COUNT][LCD_GLYPH_ROWS];    /**< Bitmaps of the run time glyphs. */
+static uint16_t m_client_defined;                                    /**< Bit mask of the defined m_client entries. */
+
+static uint8_t  m_slot_id[LCD_GLYPH_COUNT];                          /**< Glyph held by each CGRAM slot. */
+static uint8_t  m_slot_loaded;                                       /**< Bit mask of the slots holding a glyph. */
+static uint16_t m_slot_used[LCD_GLYPH_COUNT];                        /**< Value of m_use_clock when each slot was last asked for. */
+static uint16_t m_use_clock;                                         /**< Counts glyph requests, orders the slots for LRU replacement. */
+static uint8_t  m_slot_pinned;                                       /**< Bit mask of the slots taken by the run being resolved. */
+
+
+/**@brief Function for getting the bitmap of a glyph.
+ *
+ * @return Pixel rows, NULL if the ID is not defined.
+ */
+static const uint8_t * glyph_rows(uint8_t id)
+{
+    if (id < RGB_GLYPH_BUILTIN_COUNT)
+    {
+        return m_builtin[id];
+    }
+    if ((id >= RGB_GLYPH_CLIENT_FIRST) && (id <= GLYPH_CLIENT_LAST) &&
+        (m_client_defined & (1 << (id - RGB_GLYPH_CLIENT_FIRST))))
+    {
+        return m_client[id - RGB_GLYPH_CLIENT_FIRST];
+    }
+    return NULL;
+}
+
+
+/**@brief Function for finding the slot holding a glyph.
+ *
+ * @return Slot, LCD_GLYPH_COUNT if the glyph is not resident.
+ */
+static uint8_t glyph_slot_find(uint8_t id)
+{
+    uint8_t slot;
+
+    for (slot = 0; slot < LCD_GLYPH_COUNT; slot++)
+    {
+        if ((m_slot_loaded & (1 << slot)) && (m_slot_id[slot] == id))
+        {
+            break;
+        }
+    }
+    return slot;
+}
+
+
+/**@brief Function for choosing the slot to load a glyph into.
+ *
+ * @details An empty slot if there is one, otherwise the least recently used slot. Slots whose
+ *          character is in the frame, or that hold another glyph of the run being resolved, are
+ *          never chosen, even if the cache has not loaded them (e.g. restored from flash).
+ *
+ * @return Slot, LCD_GLYPH_COUNT if every slot is in use.
+ */
+static uint8_t glyph_slot_victim(void)
+{
+    uint8_t  in_use = rgb_lcd_glyphs_in_use() | m_slot_pinned;
+    uint8_t  victim = LCD_GLYPH_COUNT;
+    uint16_t oldest = 0;
+    uint8_t  slot;
+
+    for (slot = 0; slot < LCD_GLYPH_COUNT; slot++)
+    {
+        uint16_t age = m_use_clock - m_slot_used[slot];
+
+        if (in_use & (1 << slot))
+        {
+            continue;
+        }
+        if (!(m_slot_loaded & (1 << slot)))
+        {
+            return slot;
+        }
+        if ((victim == LCD_GLYPH_COUNT) || (age > oldest))
+        {
+            victim = slot;
+            oldest = age;
+        }
+    }
+    return victim;
+}
+
+
+uint32_t rgb_glyph_define(uint8_t id, const uint8_t * p_rows)
+{
+    uint8_t slot;
+
+    if ((id < RGB_GLYPH_CLIENT_FIRST) || (id > GLYPH_CLIENT_LAST))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    memcpy(m_client[id - RGB_GLYPH_CLIENT_FIRST], p_rows, LCD_GLYPH_ROWS);
+    m_client_defined |= 1 << (id - RGB_GLYPH_CLIENT_FIRST);
+
+    slot = glyph_slot_find(id);
+    if (slot < LCD_GLYPH_COUNT)
+    {
+        rgb_lcd_define_glyph(slot, p_rows);
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t rgb_glyph_code(uint8_t id, uint8_t * p_code)
+{
+    const uint8_t * p_rows = glyph_rows(id);
+    uint8_t         slot;
+
+    if (p_rows == NULL)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    slot = glyph_slot_find(id);
+    if (slot == LCD_GLYPH_COUNT)
+    {
+        slot = glyph_slot_victim();
+        if (slot == LCD_GLYPH_COUNT)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+
+        m_slot_id[slot] = id;
+        m_slot_loaded  |= 1 << slot;
+        rgb_lcd_define_glyph(slot, p_rows);
+    }
+
+    m_slot_used[slot] = ++m_use_clock;
+    *p_code           = slot;
+    return NRF_SUCCESS;
+}
+
+
+void rgb_glyph_codes(const uint8_t * p_ids, uint8_t * p_codes, size_t count, uint8_t fill)
+{
+    size_t i;
+
+    m_slot_pinned = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (rgb_glyph_code(p_ids[i], &p_codes[i]) == NRF_SUCCESS)
+        {
+            m_slot_pinned |= 1 << p_codes[i];
+        }
+        else
+        {
+            p_codes[i] = fill;
+        }
+    }
+    m_slot_pinned = 0;
+}
@@ -0,0 +1,77 @@
+/**@file
+ *
+ * @brief    Glyph cache for the user defined characters of the RGB LCD.
+ *
+ * @details  Glyphs are referred to by a stable ID and mapped onto the LCD_GLYPH_COUNT CGRAM slots
+ *           on demand. A glyph that is already resident is reused without an upload; otherwise
+ *           the least recently used slot whose character is not in the frame is replaced, and
+ *           the bitmap goes out with the next flush as one burst.
+ *
+ *           IDs below @ref RGB_GLYPH_BUILTIN_COUNT are built into the firmware, IDs from
+ *           @ref RGB_GLYPH_CLIENT_FIRST on can be defined at run time.
+ */
+
+#ifndef RGB_GLYPH_H__
+#define RGB_GLYPH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RGB_GLYPH_CLIENT_FIRST      0x80                             /**< First ID that can be defined with @ref rgb_glyph_define. */
+#define RGB_GLYPH_CLIENT_COUNT      16                               /**< Number of IDs that can be defined. */
+
+/**@brief Built in glyph IDs. */
+typedef enum
+{
+    RGB_GLYPH_DRUM,                                                  /**< Washing machine drum. */
+    RGB_GLYPH_LOCK,                                                  /**< Closed lock. */
+    RGB_GLYPH_DROP,                                                  /**< Water drop. */
+    RGB_GLYPH_BAR_1,                                                 /**< Progress bar cell, 1 of 5 columns filled. A full cell is ROM character 0xFF. */
+    RGB_GLYPH_BAR_2,                                                 /**< Progress bar cell, 2 of 5 columns filled. */
+    RGB_GLYPH_BAR_3,                                                 /**< Progress bar cell, 3 of 5 columns filled. */
+    RGB_GLYPH_BAR_4,                                                 /**< Progress bar cell, 4 of 5 columns filled. */
+    RGB_GLYPH_SEG_TOP,                                               /**< Big digit segment, bar at the top of the cell. */
+    RGB_GLYPH_SEG_BOTTOM,                                            /**< Big digit segment, bar at the bottom of the cell. */
+    RGB_GLYPH_SEG_BOTH,                                              /**< Big digit segment, bars at the top and the bottom of the cell. */
+    RGB_GLYPH_SEG_DOT,                                               /**< Big digit segment, half of a colon. */
+    RGB_GLYPH_BUILTIN_COUNT                                          /**< Number of built in glyphs, not an ID. */
+} rgb_glyph_builtin_t;
+
+/**@brief Function for defining or redefining a run time glyph.
+ *
+ * @details A resident glyph is updated in place, cells showing it change with the next flush.
+ *
+ * @param[in] id      Glyph ID, RGB_GLYPH_CLIENT_FIRST to RGB_GLYPH_CLIENT_FIRST + RGB_GLYPH_CLIENT_COUNT - 1.
+ * @param[in] p_rows  LCD_GLYPH_ROWS pixel rows, top first.
+ *
+ * @return NRF_SUCCESS, or NRF_ERROR_INVALID_PARAM for an ID outside the run time range.
+ */
+uint32_t rgb_glyph_define(uint8_t id, const uint8_t * p_rows);
+
+/**@brief Function for making a glyph resident and getting its character code.
+ *
+ * @details The code is only valid as long as the character stays in the frame; once it is no
+ *          longer shown the slot may be given to another glyph.
+ *
+ * @param[in]  id      Glyph ID.
+ * @param[out] p_code  Character code to write to the frame.
+ *
+ * @return NRF_SUCCESS, NRF_ERROR_NOT_FOUND for an undefined ID, or NRF_ERROR_NO_MEM if every slot
+ *         holds a glyph that is in the frame.
+ */
+uint32_t rgb_glyph_code(uint8_t id, uint8_t * p_code);
+
+/**@brief Function for making a run of glyphs resident and getting their character codes.
+ *
+ * @details Like @ref rgb_glyph_code for each ID, except that a glyph is never loaded into the slot
+ *          of another one in the run, although the run is not in the frame yet.
+ *
+ * @param[in]  p_ids    Glyph IDs.
+ * @param[out] p_codes  Character codes to write to the frame, @p fill for an undefined glyph or
+ *                      one that finds no free slot.
+ * @param[in]  count    Number of glyphs.
+ * @param[in]  fill     Character shown in place of a glyph that cannot be loaded.
+ */
+void rgb_glyph_codes(const uint8_t * p_ids, uint8_t * p_codes, size_t count, uint8_t fill);
+
+#endif // RGB_GLYPH_H__
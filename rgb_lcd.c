@@ -0,0 +1,873 @@
+#include <stdint.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "twi_async.h"
+#include "lcd_defs.h"
+#include "rgb_lcd.h"
+
+
+#define LCD_CELLS               (LCD_ROWS * LCD_DDRAM_LINE_LEN)      /**< Number of DDRAM cells mirrored in RAM. */
+#define LCD_CURSOR_UNKNOWN      0xFF                                 /**< Address counter value used when the controller position is not known (e.g. after a CGRAM access). */
+
+#define LCD_EXEC_TIME_DATA_NS   41000                                /**< Execution time of a data write, 37 us plus 4 us to update the address counter. */
+#define LCD_BYTE_TIME_NS        (9 * 1000000 / TWI_ASYNC_KHZ)        /**< Time of one byte on the bus, eight bits and the acknowledge. */
+#define LCD_BURST_PACED         (LCD_BYTE_TIME_NS < LCD_EXEC_TIME_DATA_NS) /**< Set if the next byte of a burst would reach the controller while it still executes a data write. */
+#define LCD_BURST_LEN           (LCD_BURST_PACED ? 2 : TWI_ASYNC_MAX_DATA_LEN) /**< Bytes in a data burst, including the control byte. */
+
+#define LCD_COST_SET_CURSOR     3                                    /**< Bus bytes for a set DDRAM address instruction (address, control byte, instruction). */
+#define LCD_COST_BURST          (LCD_BURST_PACED ? 0 : 2)            /**< Bus bytes for starting a data burst (address, control byte), counted per character if paced. */
+#define LCD_COST_DATA           (LCD_BURST_PACED ? 3 : 1)            /**< Bus bytes for one more character inside a data burst. */
+#define LCD_COST_CLEAR          3                                    /**< Bus bytes for a clear display instruction. */
+
+#define LCD_TIMER_PRESCALER     0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define LCD_POWER_ON_DELAY_US   50000                                /**< Time from power on until the controller accepts instructions. */
+#define LCD_EXEC_TIME_SLOW_US   1530                                 /**< Execution time of clear display and return home. */
+#define LCD_INIT_DONE           (sizeof(m_init_steps) / sizeof(m_init_steps[0])) /**< Value of m_init_step once the init sequence has been sent. */
+
+/**@brief Converts a time in microseconds to app_timer ticks, never below the app_timer minimum. */
+#define LCD_US_TO_TICKS(US)                                                                         \
+        MAX(ROUNDED_DIV((uint64_t)(US) * APP_TIMER_CLOCK_FREQ, (LCD_TIMER_PRESCALER + 1) * 1000000), \
+            APP_TIMER_MIN_TIMEOUT_TICKS)
+
+/**@brief Step of the controller init sequence. */
+typedef struct
+{
+    uint8_t  command;                                                /**< Instruction to send. */
+    uint16_t delay_us;                                               /**< Time to wait after the instruction, 0 for its normal execution time. */
+} lcd_init_step_t;
+
+/**@brief Controller init sequence (HD44780 datasheet, initializing by instruction). */
+static const lcd_init_step_t m_init_steps[] =
+{
+    {LCD_FUNCTIONSET | LCD_2LINE,                                       4100},
+    {LCD_FUNCTIONSET | LCD_2LINE,                                       100},
+    {LCD_FUNCTIONSET | LCD_2LINE,                                       0},
+    {LCD_FUNCTIONSET | LCD_2LINE,                                       0},
+    {LCD_DISPLAYCONTROL | LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF, 0},
+    {LCD_CLEARDISPLAY,                                                  0},
+    {LCD_ENTRYMODESET | LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT,        0},
+};
+
+
+uint8_t _displayfunction;
+uint8_t _displaycontrol;
+uint8_t _displaymode;
+
+static uint8_t m_ddram[LCD_CELLS];                                   /**< Mirror of the controller DDRAM, indexed by cell (line * LCD_DDRAM_LINE_LEN + column). */
+static uint8_t m_frame[LCD_CELLS];                                   /**< Contents requested by the application, pushed by rgb_lcd_flush(). */
+static uint8_t m_hw_cursor = LCD_CURSOR_UNKNOWN;                     /**< Cell the controller address counter points at. */
+static uint8_t m_cursor;                                             /**< Cell the next rgb_lcd_write() goes to. */
+static bool    m_frame_dirty;                                        /**< Set when m_frame may differ from m_ddram. */
+static bool    m_composing;                                          /**< Set between rgb_lcd_compose() and rgb_lcd_commit(), the frame is held back. */
+static uint8_t m_burst[LCD_BURST_LEN] = {0x40};                      /**< Data burst being assembled, starting with the data control byte. */
+static uint8_t m_burst_len = 1;                                      /**< Number of bytes used in m_burst. */
+static uint8_t m_cgram[LCD_GLYPH_COUNT][LCD_GLYPH_ROWS];             /**< Glyphs requested by the application, pushed by rgb_lcd_flush(). */
+static uint8_t m_cgram_dirty;                                        /**< Bit mask of the m_cgram glyphs not yet uploaded. */
+static uint8_t m_hw_shift;                                           /**< Display shift of the controller, in columns to the left. */
+static uint8_t m_shift;                                              /**< Display shift requested by the application, pushed by rgb_lcd_flush(). */
+static uint8_t m_cgram_valid;                                        /**< Bit mask of the m_cgram glyphs uploaded at least once (CGRAM is random after power on). */
+
+static uint8_t          m_rgb_regs[REG_COUNT];                       /**< Mirror of the PCA9633 registers. */
+static uint16_t         m_rgb_regs_valid;                            /**< Bit mask of the m_rgb_regs entries that match the hardware. */
+
+static app_timer_id_t   m_pace_timer_id;                             /**< Times the execution of slow instructions. */
+static uint32_t         m_pace_ticks;                                /**< Execution time of the instruction on the bus. */
+static volatile bool    m_busy;                                      /**< Set while an instruction is executing, no other display transfers may be queued. */
+static volatile bool    m_resync;                                    /**< Set when a transfer timed out, the display and the backlight are set up again. */
+static volatile uint8_t m_init_step;                                 /**< Next step of m_init_steps to send. */
+
+
+/**@brief Function for noting a transfer that timed out.
+ *
+ * @details Called from the TWI interrupt, or wherever the timeout was found. What the display and
+ *          the backlight got of the transfer is unknown, rgb_lcd_flush() sets both up again.
+ */
+static void lcd_twi_sent(uint32_t result, void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (result == NRF_ERROR_TIMEOUT)
+    {
+        m_resync = true;
+    }
+}
+
+
+/**@brief Function for queuing a transfer to the display or the backlight.
+ *
+ * @details Returns as soon as the transfer is queued. Only waits if the queue is full, in which
+ *          case the TWI interrupt keeps draining it; a hung bus times out the transfer on it.
+ */
+static void lcd_twi_write(uint8_t address, const uint8_t * p_data, uint8_t length, twi_async_prio_t prio)
+{
+    while (twi_async_write(address, p_data, length, prio, lcd_twi_sent, NULL) == NRF_ERROR_NO_MEM)
+    {
+        // Wait for a free queue entry.
+    }
+}
+
+
+// On a bus too fast for bursts every data byte gets a transfer of its own. The next one reaches
+// the controller after the address, control and data byte, which covers a data write.
+STATIC_ASSERT(3 * LCD_BYTE_TIME_NS >= LCD_EXEC_TIME_DATA_NS);
+
+/**@brief Function for getting the time the controller needs to execute an instruction.
+ *
+ * @details Instructions not listed complete within 37 us. The next transfer reaches the
+ *          controller after at least its address and control byte and one more byte, which
+ *          takes longer at any bus clock, so they need no pacing. Data writes are paced by
+ *          LCD_BURST_LEN.
+ *
+ * @return  Execution time in microseconds, 0 if no pacing is needed.
+ */
+static uint32_t lcd_exec_time_us(uint8_t value)
+{
+    if ((value == LCD_CLEARDISPLAY) || ((value & ~0x01) == LCD_RETURNHOME))
+    {
+        return LCD_EXEC_TIME_SLOW_US;
+    }
+    return 0;
+}
+
+
+/**@brief Function for converting a DDRAM address into a cell index.
+ *
+ * @return Cell index, or LCD_CURSOR_UNKNOWN for addresses outside the visible DDRAM ranges.
+ */
+static uint8_t lcd_addr_to_cell(uint8_t addr)
+{
+    uint8_t row = (addr >= LCD_DDRAM_LINE_OFFSET) ? 1 : 0;
+    uint8_t col = addr - row * LCD_DDRAM_LINE_OFFSET;
+
+    if (col >= LCD_DDRAM_LINE_LEN)
+    {
+        return LCD_CURSOR_UNKNOWN;
+    }
+    return row * LCD_DDRAM_LINE_LEN + col;
+}
+
+
+/**@brief Function for converting a cell index into a DDRAM address. */
+static uint8_t lcd_cell_to_addr(uint8_t cell)
+{
+    return (cell / LCD_DDRAM_LINE_LEN) * LCD_DDRAM_LINE_OFFSET + (cell % LCD_DDRAM_LINE_LEN);
+}
+
+
+/**@brief Function for advancing a cell index the way the controller address counter does
+ *        in increment mode (end of line 1 continues on line 2, end of line 2 wraps to line 1).
+ */
+static uint8_t lcd_next_cell(uint8_t cell)
+{
+    return (cell + 1 < LCD_CELLS) ? cell + 1 : 0;
+}
+
+
+/**@brief Function for updating the mirrored controller state after an instruction.
+ *
+ * @note  Data writes are assumed to use LCD_ENTRYLEFT without display shift, which is the only
+ *        entry mode this driver sets.
+ */
+static void lcd_track_command(uint8_t value)
+{
+    if (value & LCD_SETDDRAMADDR)
+    {
+        m_hw_cursor = lcd_addr_to_cell(value & ~LCD_SETDDRAMADDR);
+    }
+    else if (value & LCD_SETCGRAMADDR)
+    {
+        // Following data writes go to CGRAM, the DDRAM position has to be set again.
+        m_hw_cursor = LCD_CURSOR_UNKNOWN;
+    }
+    else if (value & LCD_FUNCTIONSET)
+    {
+        _displayfunction = value & ~LCD_FUNCTIONSET;
+    }
+    else if (value & LCD_CURSORSHIFT)
+    {
+        if (!(value & LCD_DISPLAYMOVE))
+        {
+            m_hw_cursor = LCD_CURSOR_UNKNOWN;
+        }
+        else if (value & LCD_MOVERIGHT)
+        {
+            m_hw_shift = (m_hw_shift + LCD_DDRAM_LINE_LEN - 1) % LCD_DDRAM_LINE_LEN;
+        }
+        else
+        {
+            // Shifting the display leaves the address counter alone.
+            m_hw_shift = (m_hw_shift + 1) % LCD_DDRAM_LINE_LEN;
+        }
+    }
+    else if (value & LCD_DISPLAYCONTROL)
+    {
+        _displaycontrol = value & ~LCD_DISPLAYCONTROL;
+    }
+    else if (value & LCD_ENTRYMODESET)
+    {
+        _displaymode = value & ~LCD_ENTRYMODESET;
+    }
+    else if (value & LCD_RETURNHOME)
+    {
+        m_hw_cursor = 0;
+        m_hw_shift  = 0;
+    }
+    else if (value & LCD_CLEARDISPLAY)
+    {
+        memset(m_ddram, ' ', sizeof(m_ddram));
+        m_hw_cursor   = 0;
+        m_hw_shift    = 0;
+        m_frame_dirty = true;
+    }
+}
+
+
+/**@brief Function for sending the buffered data burst, if any, as a single transfer. */
+static void lcd_burst_end(void)
+{
+    if (m_burst_len > 1)
+    {
+        lcd_twi_write(LCD_ADDRESS, m_burst, m_burst_len, TWI_ASYNC_PRIO_NORMAL);
+    }
+    m_burst_len = 1;
+}
+
+
+/**@brief Function for appending a character to the data burst.
+ *
+ * @details The controller keeps accepting data bytes after a single 0x40 control byte, so
+ *          consecutive characters share one START, address and control byte, as long as a byte
+ *          takes longer on the bus than the controller needs for a data write. On a faster bus
+ *          a burst holds a single character.
+ */
+static void lcd_burst_put(uint8_t value)
+{
+    if (m_burst_len >= sizeof(m_burst))
+    {
+        lcd_burst_end();
+    }
+    m_burst[m_burst_len++] = value;
+
+    if (m_hw_cursor != LCD_CURSOR_UNKNOWN)
+    {
+        m_ddram[m_hw_cursor] = value;
+        m_hw_cursor          = lcd_next_cell(m_hw_cursor);
+    }
+}
+
+
+/**@brief Function for starting the execution timer once a paced instruction is on the bus.
+ *
+ * @details Called like lcd_twi_sent(). The timer is started after a timeout too, so the display
+ *          is released and can be set up again.
+ */
+static void lcd_paced_command_sent(uint32_t result, void * p_context)
+{
+    uint32_t err_code;
+
+    lcd_twi_sent(result, p_context);
+
+    err_code = app_timer_start(m_pace_timer_id, m_pace_ticks, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for sending an instruction and holding further display transfers until it has
+ *        been executed.
+ */
+static void lcd_send_paced(uint8_t value, uint32_t delay_us)
+{
+    unsigned char dta[2] = {0x80, value};
+
+    lcd_burst_end();
+
+    m_busy       = true;
+    m_pace_ticks = LCD_US_TO_TICKS(delay_us);
+    while (twi_async_write(LCD_ADDRESS, dta, 2, TWI_ASYNC_PRIO_NORMAL, lcd_paced_command_sent, NULL)
+           == NRF_ERROR_NO_MEM)
+    {
+        // Wait for a free queue entry.
+    }
+    lcd_track_command(value);
+}
+
+
+static void lcd_send_command(uint8_t value)
+{
+    unsigned char dta[2]  = {0x80, value};
+    uint32_t      exec_us = lcd_exec_time_us(value);
+
+    if (exec_us != 0)
+    {
+        lcd_send_paced(value, exec_us);
+        return;
+    }
+
+    lcd_burst_end();
+    lcd_twi_write(LCD_ADDRESS, dta, 2, TWI_ASYNC_PRIO_NORMAL);
+    lcd_track_command(value);
+}
+
+
+/**@brief Function for handling the end of a paced instruction.
+ *
+ * @details Sends the next step while the init sequence is running, otherwise releases the display
+ *          for rgb_lcd_flush(). The main loop wakes up on this interrupt and flushes what has
+ *          been held back.
+ */
+static void lcd_pace_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_init_step < LCD_INIT_DONE)
+    {
+        const lcd_init_step_t * p_step   = &m_init_steps[m_init_step++];
+        uint32_t                delay_us = (p_step->delay_us != 0) ? p_step->delay_us
+                                                                   : lcd_exec_time_us(p_step->command);
+
+        if (delay_us != 0)
+        {
+            lcd_send_paced(p_step->command, delay_us);
+            return;
+        }
+
+        lcd_send_command(p_step->command);
+        // Nothing to wait for, go on with the next step right away.
+        lcd_pace_timeout_handler(NULL);
+        return;
+    }
+
+    m_busy = false;
+}
+
+
+/**@brief Function for bringing the controller DDRAM in line with the frame.
+ *
+ * @details Walks the cells in address counter order. For every gap of unchanged cells between
+ *          two changed ones it either rewrites the gap inside the running data burst or ends the
+ *          burst and jumps over the gap with a set DDRAM address instruction, whichever is
+ *          cheaper on the bus.
+ *
+ * @param[in] emit          If false, nothing is sent and only the cost is computed.
+ * @param[in] assume_clear  Compute the cost as if the DDRAM had just been cleared. Only used
+ *                          together with emit == false.
+ *
+ * @return  Number of bus bytes needed (or used) for the update.
+ */
+static uint32_t lcd_sync(bool emit, bool assume_clear)
+{
+    uint32_t cost     = 0;
+    bool     in_burst = false;
+    uint8_t  pos      = assume_clear ? 0 : m_hw_cursor;
+    uint8_t  cell;
+
+    for (cell = 0; cell < LCD_CELLS; cell++)
+    {
+        uint8_t before = assume_clear ? ' ' : m_ddram[cell];
+
+        if (m_frame[cell] == before)
+        {
+            continue;
+        }
+
+        if (pos != cell)
+        {
+            uint32_t gap = cell - pos;
+
+            if ((pos != LCD_CURSOR_UNKNOWN) && (pos < cell) &&
+                (gap * LCD_COST_DATA <= LCD_COST_SET_CURSOR + (in_burst ? LCD_COST_BURST : 0)))
+            {
+                // Cheaper to rewrite the unchanged cells than to move the address counter.
+                cost += gap * LCD_COST_DATA;
+                while (emit && (pos != cell))
+                {
+                    lcd_burst_put(m_frame[pos]);
+                    pos = lcd_next_cell(pos);
+                }
+            }
+            else
+            {
+                cost    += LCD_COST_SET_CURSOR;
+                in_burst = false;
+                if (emit)
+                {
+                    lcd_send_command(LCD_SETDDRAMADDR | lcd_cell_to_addr(cell));
+                }
+            }
+        }
+
+        if (!in_burst)
+        {
+            cost    += LCD_COST_BURST;
+            in_burst = true;
+        }
+        cost += LCD_COST_DATA;
+        if (emit)
+        {
+            lcd_burst_put(m_frame[cell]);
+        }
+        pos = lcd_next_cell(cell);
+    }
+
+    if (emit)
+    {
+        lcd_burst_end();
+    }
+    return cost;
+}
+
+
+/**@brief Function for uploading the changed glyphs to the controller CGRAM.
+ *
+ * @details Runs of consecutive changed glyphs are sent as one data burst, the CGRAM address
+ *          counter moves on to the next glyph by itself.
+ */
+static void lcd_cgram_sync(void)
+{
+    uint8_t slot;
+    uint8_t row;
+    bool    in_burst = false;
+
+    for (slot = 0; slot < LCD_GLYPH_COUNT; slot++)
+    {
+        if (!(m_cgram_dirty & (1 << slot)))
+        {
+            in_burst = false;
+            continue;
+        }
+
+        if (!in_burst)
+        {
+            lcd_send_command(LCD_SETCGRAMADDR | (slot * LCD_GLYPH_ROWS));
+            in_burst = true;
+        }
+        for (row = 0; row < LCD_GLYPH_ROWS; row++)
+        {
+            lcd_burst_put(m_cgram[slot][row]);
+        }
+    }
+    lcd_burst_end();
+    m_cgram_valid |= m_cgram_dirty;
+    m_cgram_dirty  = 0;
+}
+
+
+/**@brief Function for bringing the controller display shift in line with the requested one.
+ *
+ * @details Shifts one column per instruction in the shorter direction. Going back to no shift
+ *          from further away uses return home, a single (paced) instruction.
+ */
+static void lcd_shift_sync(void)
+{
+    uint8_t left = (m_shift + LCD_DDRAM_LINE_LEN - m_hw_shift) % LCD_DDRAM_LINE_LEN;
+    uint8_t command;
+
+    if (left == 0)
+    {
+        return;
+    }
+
+    if ((m_shift == 0) && (MIN(left, LCD_DDRAM_LINE_LEN - left) > 1))
+    {
+        lcd_send_command(LCD_RETURNHOME);
+        return;
+    }
+
+    command = LCD_CURSORSHIFT | LCD_DISPLAYMOVE |
+              ((left <= LCD_DDRAM_LINE_LEN / 2) ? LCD_MOVELEFT : LCD_MOVERIGHT);
+    while (m_hw_shift != m_shift)
+    {
+        lcd_send_command(command);
+    }
+}
+
+
+/**@brief Function for setting the display and the backlight up again after a transfer timed out.
+ *
+ * @details Runs the init sequence again, its clear instruction also resets the DDRAM mirror, and
+ *          rewrites every uploaded glyph and every backlight register. The frame follows once the
+ *          sequence has completed.
+ */
+static void lcd_resync(void)
+{
+    unsigned char regs[REG_COUNT];
+    uint32_t      err_code;
+
+    m_resync       = false;
+    m_busy         = true;
+    m_init_step    = 0;
+    m_hw_cursor    = LCD_CURSOR_UNKNOWN;
+    m_cgram_dirty |= m_cgram_valid;
+
+    memcpy(regs, m_rgb_regs, sizeof(regs));
+    m_rgb_regs_valid = 0;
+    rgb_lcd_setRegs(REG_MODE1, regs, REG_COUNT);
+
+    err_code = app_timer_start(m_pace_timer_id, LCD_US_TO_TICKS(0), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_lcd_flush(void)
+{
+    if (m_busy)
+    {
+        // Flushed again when the executing instruction has completed.
+        return;
+    }
+
+    if (m_resync)
+    {
+        lcd_resync();
+        return;
+    }
+
+    if (m_composing)
+    {
+        // Glyphs and shift are held back too, a redefined glyph would change cells on display.
+        return;
+    }
+
+    if (m_cgram_dirty)
+    {
+        // Leaves the address counter in CGRAM, the frame sync below moves it back.
+        lcd_cgram_sync();
+    }
+
+    if (m_frame_dirty)
+    {
+        // A mostly blank frame is cheaper to get with a clear instruction.
+        if ((lcd_sync(false, true) + LCD_COST_CLEAR) < lcd_sync(false, false))
+        {
+            lcd_send_command(LCD_CLEARDISPLAY);
+            return;
+        }
+        lcd_sync(true, false);
+        m_frame_dirty = false;
+    }
+
+    lcd_shift_sync();
+    if (m_busy)
+    {
+        return;
+    }
+
+    // Keep a visible cursor where the application expects it.
+    if ((_displaycontrol & (LCD_CURSORON | LCD_BLINKON)) && (m_hw_cursor != m_cursor))
+    {
+        lcd_send_command(LCD_SETDDRAMADDR | lcd_cell_to_addr(m_cursor));
+    }
+}
+
+
+bool rgb_lcd_is_idle(void)
+{
+    return !m_busy && !m_resync && !m_frame_dirty && !m_cgram_dirty && (m_shift == m_hw_shift) &&
+           twi_async_is_idle();
+}
+
+// send data
+size_t rgb_lcd_write(uint8_t value)
+{
+    m_frame[m_cursor] = value;
+    m_cursor          = lcd_next_cell(m_cursor);
+    m_frame_dirty     = true;
+    return 1; // assume sucess
+}
+
+size_t rgb_lcd_write_buf(const uint8_t * p_data, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        m_frame[m_cursor] = p_data[i];
+        m_cursor          = lcd_next_cell(m_cursor);
+    }
+    m_frame_dirty = m_frame_dirty || (length > 0);
+    return length;
+}
+
+void rgb_lcd_write_at(uint8_t col, uint8_t row, const uint8_t * p_data, size_t length)
+{
+    uint8_t cell;
+    size_t  i;
+
+    // Checked here, not by the DDRAM address: a column past the line would wrap onto line 2.
+    if ((col >= LCD_DDRAM_LINE_LEN) || (row >= LCD_ROWS))
+    {
+        return;
+    }
+    cell = row * LCD_DDRAM_LINE_LEN + col;
+
+    // Clipped at the end of the line, unchanged cells leave the frame clean.
+    length = MIN(length, (size_t)(LCD_DDRAM_LINE_LEN - col));
+    for (i = 0; i < length; i++, cell++)
+    {
+        if (m_frame[cell] != p_data[i])
+        {
+            m_frame[cell] = p_data[i];
+            m_frame_dirty = true;
+        }
+    }
+}
+
+void rgb_lcd_define_glyph(uint8_t slot, const uint8_t * p_rows)
+{
+    uint8_t row;
+
+    if (slot >= LCD_GLYPH_COUNT)
+    {
+        return;
+    }
+
+    if (!(m_cgram_valid & (1 << slot)))
+    {
+        m_cgram_dirty |= (1 << slot);
+    }
+    for (row = 0; row < LCD_GLYPH_ROWS; row++)
+    {
+        uint8_t bits = p_rows[row] & LCD_GLYPH_ROW_MASK;
+
+        if (m_cgram[slot][row] != bits)
+        {
+            m_cgram[slot][row] = bits;
+            m_cgram_dirty     |= (1 << slot);
+        }
+    }
+}
+
+void rgb_lcd_set_shift(uint8_t columns)
+{
+    m_shift = columns % LCD_DDRAM_LINE_LEN;
+}
+
+void rgb_lcd_compose(void)
+{
+    m_composing = true;
+}
+
+void rgb_lcd_commit(void)
+{
+    m_composing = false;
+}
+
+bool rgb_lcd_is_composing(void)
+{
+    return m_composing;
+}
+
+uint8_t rgb_lcd_glyphs_in_use(void)
+{
+    uint8_t in_use = 0;
+    uint8_t cell;
+
+    for (cell = 0; cell < LCD_CELLS; cell++)
+    {
+        // Codes 8-15 show the same CGRAM characters as 0-7.
+        if (m_frame[cell] < 2 * LCD_GLYPH_COUNT)
+        {
+            in_use |= 1 << (m_frame[cell] % LCD_GLYPH_COUNT);
+        }
+    }
+    return in_use;
+}
+
+void rgb_lcd_setRegs(unsigned char addr, const unsigned char * p_values, unsigned char count)
+{
+    unsigned char dta[1 + REG_COUNT];
+    unsigned char first = REG_COUNT;
+    unsigned char last  = 0;
+    unsigned char reg;
+
+    if ((addr >= REG_COUNT) || (count == 0) || (count > REG_COUNT - addr))
+    {
+        return;
+    }
+
+    // Only the span between the first and the last register that actually changes is sent.
+    for (reg = addr; reg < addr + count; reg++)
+    {
+        if (!(m_rgb_regs_valid & (1 << reg)) || (m_rgb_regs[reg] != p_values[reg - addr]))
+        {
+            first = MIN(first, reg);
+            last  = reg;
+        }
+    }
+    if (first == REG_COUNT)
+    {
+        return;
+    }
+
+    dta[0] = RGB_AUTO_INCREMENT | first;
+    memcpy(&dta[1], &p_values[first - addr], last - first + 1);
+    lcd_twi_write(RGB_ADDRESS, dta, last - first + 2, TWI_ASYNC_PRIO_HIGH);
+
+    memcpy(&m_rgb_regs[first], &p_values[first - addr], last - first + 1);
+    for (reg = first; reg <= last; reg++)
+    {
+        m_rgb_regs_valid |= (1 << reg);
+    }
+}
+
+void rgb_lcd_setReg(unsigned char addr, unsigned char value)
+{
+    rgb_lcd_setRegs(addr, &value, 1);
+}
+
+unsigned char rgb_lcd_getReg(unsigned char addr)
+{
+    if (addr >= REG_COUNT)
+    {
+        return 0;
+    }
+    return m_rgb_regs[addr];
+}
+
+void rgb_lcd_setRGB(unsigned char r, unsigned char g, unsigned char b)
+{
+    // PWM0..PWM2 are consecutive registers, so one auto-increment write covers all channels.
+    const unsigned char pwm[3] = {b, g, r};
+
+    rgb_lcd_setRegs(REG_BLUE, pwm, sizeof(pwm));
+}
+
+const unsigned char color_define[4][3] =
+{
+    {255, 255, 255},             // white
+    {255, 0,   0},               // red
+    {0,   255, 0},               // green
+    {0,   0,   255},             // blue
+};
+
+void rgb_lcd_setColor(unsigned char color)
+{
+    if(color > 3)return ;
+    rgb_lcd_setRGB(color_define[color][0], color_define[color][1], color_define[color][2]);
+}
+
+
+void rgb_lcd_clear(void)
+{
+    memset(m_frame, ' ', sizeof(m_frame));
+    m_cursor      = 0;
+    m_shift       = 0;
+    m_frame_dirty = true;
+}
+
+void rgb_lcd_home(void)
+{
+    m_cursor = 0;
+    m_shift  = 0;
+}
+
+void rgb_set_cursor(uint8_t col, uint8_t row)
+{
+    m_cursor = lcd_addr_to_cell((row == 0 ? 0 : LCD_DDRAM_LINE_OFFSET) + col);
+    if (m_cursor == LCD_CURSOR_UNKNOWN)
+    {
+        m_cursor = 0;
+    }
+}
+
+
+void rgb_lcd_default(void)
+{
+    rgb_lcd_setRGB(0, 232, 181);
+}
+void rgb_lcd_connected(void)
+{
+    rgb_lcd_setRGB(0, 232, 181);
+    rgb_lcd_clear();
+    rgb_lcd_flush();
+}
+void rgb_lcd_sleep(void)
+{
+    rgb_lcd_setRGB(230, 0, 233);
+    rgb_lcd_clear();
+    rgb_lcd_write_buf((const uint8_t *)"zZzZ", 4);
+    rgb_lcd_flush();
+}
+void rgb_lcd_error(void)
+{
+    rgb_lcd_setRGB(232, 207, 0);
+    rgb_lcd_clear();
+    rgb_lcd_write_buf((const uint8_t *)"ERR", 3);
+    rgb_lcd_flush();
+}
+
+void rgb_lcd_wash_open(void)
+{
+    rgb_lcd_setRGB(71, 233, 0);
+}
+
+void rgb_lcd_wash_closed(void)
+{
+    rgb_lcd_setRGB(233, 0, 0);
+}
+
+void rgb_lcd_state_get(rgb_lcd_state_t * p_state)
+{
+    memcpy(p_state->frame, m_frame, sizeof(p_state->frame));
+    p_state->rgb[0]         = m_rgb_regs[REG_RED];
+    p_state->rgb[1]         = m_rgb_regs[REG_GREEN];
+    p_state->rgb[2]         = m_rgb_regs[REG_BLUE];
+    p_state->glyphs_defined = m_cgram_valid | m_cgram_dirty;
+    memcpy(p_state->glyphs, m_cgram, sizeof(p_state->glyphs));
+}
+
+void rgb_lcd_begin(const rgb_lcd_state_t * p_state)
+{
+    uint32_t err_code;
+    uint8_t  slot;
+
+    err_code = app_timer_create(&m_pace_timer_id,
+                                APP_TIMER_MODE_SINGLE_SHOT,
+                                lcd_pace_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // The init sequence runs from the pace timer, starting once the controller has powered up.
+    // Display updates are held back until it has completed.
+    m_busy      = true;
+    m_init_step = 0;
+    err_code = app_timer_start(m_pace_timer_id, LCD_US_TO_TICKS(LCD_POWER_ON_DELAY_US), NULL);
+    APP_ERROR_CHECK(err_code);
+
+    // All backlight registers in one transfer: normal mode, individual PWM on every output,
+    // default color. The register mirror is valid from here on.
+    {
+        const unsigned char regs[REG_COUNT] =
+        {
+            [REG_MODE1]   = 0x00,
+            [REG_MODE2]   = 0x00,
+            [REG_BLUE]    = (p_state != NULL) ? p_state->rgb[2] : 181,
+            [REG_GREEN]   = (p_state != NULL) ? p_state->rgb[1] : 232,
+            [REG_RED]     = (p_state != NULL) ? p_state->rgb[0] : 0,
+            [REG_PWM3]    = 0,
+            [REG_GRPPWM]  = 0xFF,
+            [REG_GRPFREQ] = 0x00,
+            [REG_OUTPUT]  = 0xAA,
+        };
+        rgb_lcd_setRegs(REG_MODE1, regs, REG_COUNT);
+    }
+
+    // The clear instruction of the init sequence also initializes the DDRAM mirror.
+    rgb_lcd_clear();
+    if (p_state == NULL)
+    {
+        rgb_lcd_write_buf((const uint8_t *)"OK", 2);
+        return;
+    }
+
+    memcpy(m_frame, p_state->frame, sizeof(m_frame));
+    for (slot = 0; slot < LCD_GLYPH_COUNT; slot++)
+    {
+        if (p_state->glyphs_defined & (1 << slot))
+        {
+            rgb_lcd_define_glyph(slot, p_state->glyphs[slot]);
+        }
+    }
+}
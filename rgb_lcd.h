@@ -0,0 +1,198 @@
+/**@file
+ *
+ * @brief    Driver for the Seeed Grove RGB backlight 16x2 LCD.
+ *
+ * @details  The display is an HD44780 compatible controller (AiP31068) behind I2C address
+ *           @ref LCD_ADDRESS, the backlight is a PCA9633 LED driver behind @ref RGB_ADDRESS.
+ *
+ *           The driver keeps a RAM mirror of the controller DDRAM together with its address
+ *           counter and the display control/entry mode registers. Text functions only update the
+ *           requested frame; @ref rgb_lcd_flush compares that frame against the mirror and sends
+ *           the cells that actually changed as data bursts, choosing between cursor jumps and
+ *           rewriting unchanged cells, whichever costs fewer bus bytes.
+ */
+
+#ifndef RGB_LCD_H__
+#define RGB_LCD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LCD_COLS                16                                   /**< Number of visible columns. */
+#define LCD_ROWS                2                                    /**< Number of display lines. */
+#define LCD_DDRAM_LINE_LEN      40                                   /**< Number of DDRAM cells per line in 2-line mode. */
+#define LCD_DDRAM_LINE_OFFSET   0x40                                 /**< DDRAM address of the first cell of the second line. */
+#define LCD_GLYPH_COUNT         8                                    /**< Number of user defined characters (codes 0-7, repeated at 8-15). */
+#define LCD_GLYPH_ROWS          8                                    /**< CGRAM bytes per user defined character. */
+#define LCD_GLYPH_ROW_MASK      0x1F                                 /**< Pixels used in each CGRAM byte, bit 4 is the leftmost. */
+
+/**@brief Display contents, as saved and restored across resets. */
+typedef struct
+{
+    uint8_t frame[LCD_ROWS * LCD_DDRAM_LINE_LEN];                    /**< Frame cells, line by line, all DDRAM columns. */
+    uint8_t rgb[3];                                                  /**< Backlight red, green and blue. */
+    uint8_t glyphs_defined;                                          /**< Bit mask of the user defined characters in glyphs. */
+    uint8_t glyphs[LCD_GLYPH_COUNT][LCD_GLYPH_ROWS];                 /**< User defined characters. */
+} rgb_lcd_state_t;
+
+/**@brief Function for initializing the controller and the backlight.
+ *
+ * @details Returns right away. The controller init sequence is paced by an app_timer, the frame
+ *          is shown by the first @ref rgb_lcd_flush after it has completed. Requires the app_timer
+ *          module and the TWI driver to be initialized.
+ *
+ * @param[in] p_state  Contents to start with, e.g. read from flash. NULL for the default "OK"
+ *                     screen.
+ */
+void rgb_lcd_begin(const rgb_lcd_state_t * p_state);
+
+/**@brief Function for getting the current frame, backlight color and user defined characters.
+ *
+ * @param[out] p_state  Display contents.
+ */
+void rgb_lcd_state_get(rgb_lcd_state_t * p_state);
+
+/**@brief Function for writing one character at the cursor position.
+ *
+ * @details Only the frame is updated, the controller is written on the next @ref rgb_lcd_flush.
+ *
+ * @return  Number of characters written.
+ */
+size_t rgb_lcd_write(uint8_t value);
+
+/**@brief Function for writing a run of characters starting at the cursor position.
+ *
+ * @details Like @ref rgb_lcd_write, only the frame is updated. Consecutive changed characters are
+ *          sent to the controller as one data burst by @ref rgb_lcd_flush.
+ *
+ * @param[in] p_data  Characters to write.
+ * @param[in] length  Number of characters.
+ *
+ * @return  Number of characters written.
+ */
+size_t rgb_lcd_write_buf(const uint8_t * p_data, size_t length);
+
+/**@brief Function for writing a run of characters at a position, leaving the cursor where it is.
+ *
+ * @details For fields the firmware keeps up to date between client writes. Characters past the
+ *          end of the DDRAM line are dropped, and the frame only becomes dirty if a cell changes.
+ *          A position outside the frame writes nothing.
+ *
+ * @param[in] col     Column, 0 based, below LCD_DDRAM_LINE_LEN.
+ * @param[in] row     Line, 0 based, below LCD_ROWS.
+ * @param[in] p_data  Characters to write.
+ * @param[in] length  Number of characters.
+ */
+void rgb_lcd_write_at(uint8_t col, uint8_t row, const uint8_t * p_data, size_t length);
+
+/**@brief Function for defining one of the user defined characters.
+ *
+ * @details Like the text functions, only the driver copy is updated; changed glyphs are uploaded
+ *          to CGRAM by the next @ref rgb_lcd_flush. Cells already showing the character code
+ *          change with it.
+ *
+ * @param[in] slot    Character code, 0 to LCD_GLYPH_COUNT - 1.
+ * @param[in] p_rows  LCD_GLYPH_ROWS pixel rows, top first.
+ */
+void rgb_lcd_define_glyph(uint8_t slot, const uint8_t * p_rows);
+
+/**@brief Function for shifting the visible window over the DDRAM lines.
+ *
+ * @details Both lines shift together, column 0 of the frame moves out on the left. Like the text
+ *          functions this only takes effect on the next @ref rgb_lcd_flush, which sends one
+ *          2-byte shift instruction per column moved.
+ *
+ * @param[in] columns  Frame column shown at the left edge, 0 to LCD_DDRAM_LINE_LEN - 1.
+ */
+void rgb_lcd_set_shift(uint8_t columns);
+
+/**@brief Function for holding frame changes back from the display.
+ *
+ * @details Until @ref rgb_lcd_commit, @ref rgb_lcd_flush leaves the display, the user defined
+ *          characters and the shift as they are while the frame is drawn, over any number of
+ *          writes. The backlight is not held back.
+ */
+void rgb_lcd_compose(void);
+
+/**@brief Function for ending a composition.
+ *
+ * @details The next @ref rgb_lcd_flush sends everything that differs from the display in one
+ *          pass, so a cleared and redrawn screen never shows up blank or half drawn.
+ */
+void rgb_lcd_commit(void);
+
+/**@brief Function for checking whether frame changes are being held back. */
+bool rgb_lcd_is_composing(void);
+
+/**@brief Function for finding the user defined characters used by the frame.
+ *
+ * @return Bit mask, bit n is set if character code n (or n + 8) is in the frame.
+ */
+uint8_t rgb_lcd_glyphs_in_use(void);
+
+/**@brief Function for pushing all changed cells of the frame to the controller.
+ *
+ * @details Does nothing while the controller is executing a slow instruction (init, clear
+ *          display, return home); call again once the pace timer has expired. The main loop does
+ *          this on every wake-up.
+ */
+void rgb_lcd_flush(void);
+
+/**@brief Function for checking if the frame is on the display and all transfers have completed. */
+bool rgb_lcd_is_idle(void);
+
+/**@brief Function for writing consecutive PCA9633 registers.
+ *
+ * @details The driver mirrors the registers; only the span from the first to the last register
+ *          that differs from the mirror is sent, as one auto-increment transfer. Nothing is sent
+ *          if no register changes.
+ *
+ * @param[in] addr      First register.
+ * @param[in] p_values  Register values.
+ * @param[in] count     Number of registers.
+ */
+void rgb_lcd_setRegs(unsigned char addr, const unsigned char * p_values, unsigned char count);
+
+/**@brief Function for writing a PCA9633 register, skipped if it already has the value. */
+void rgb_lcd_setReg(unsigned char addr, unsigned char value);
+
+/**@brief Function for reading a PCA9633 register from the driver mirror, no bus access.
+ *
+ * @return  Register value, 0 for an address past the last register.
+ */
+unsigned char rgb_lcd_getReg(unsigned char addr);
+
+/**@brief Function for setting the backlight color in one transfer, skipped if it is already set. */
+void rgb_lcd_setRGB(unsigned char r, unsigned char g, unsigned char b);
+
+/**@brief Function for setting the backlight to one of the predefined colors (WHITE, RED, ...). */
+void rgb_lcd_setColor(unsigned char color);
+
+/**@brief Function for blanking the frame, moving the cursor to the top left cell and undoing the
+ *        display shift, like the clear display instruction.
+ *
+ * @note  A running marquee keeps shifting, stop it first (rgb_marquee_stop).
+ */
+void rgb_lcd_clear(void);
+
+/**@brief Function for moving the cursor to the top left cell and undoing the display shift, like
+ *        the return home instruction.
+ */
+void rgb_lcd_home(void);
+
+/**@brief Function for moving the cursor.
+ *
+ * @param[in] col  Column, 0 based.
+ * @param[in] row  Line, 0 based.
+ */
+void rgb_set_cursor(uint8_t col, uint8_t row);
+
+void rgb_lcd_default(void);
+void rgb_lcd_connected(void);
+void rgb_lcd_sleep(void);
+void rgb_lcd_error(void);
+void rgb_lcd_wash_open(void);
+void rgb_lcd_wash_closed(void);
+
+#endif // RGB_LCD_H__
@@ -0,0 +1,99 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "rgb_lcd.h"
+#include "rgb_marquee.h"
+
+
+#define MARQUEE_TIMER_PRESCALER 0                                    /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define MARQUEE_MIN_STEP_MS     50                                   /**< Fastest step, the display itself blurs faster scrolling. */
+
+static app_timer_id_t   m_timer_id;
+static volatile bool    m_step_due;                                  /**< Set by the timer, cleared when the step is taken. */
+static uint8_t          m_offset;                                    /**< Column shown at the left edge. */
+static uint8_t          m_max_offset;                                /**< Offset with the last text column at the right edge, 0 while stopped. */
+static uint16_t         m_step_ms;
+static uint16_t         m_pause_ms;
+
+
+/**@brief Function for handling the marquee timer timeout.
+ *
+ * @details Only flags the step, the main loop wakes up on this interrupt and takes it.
+ */
+static void marquee_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    m_step_due = true;
+}
+
+
+static void marquee_timer_start(uint16_t delay_ms)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_start(m_timer_id,
+                               MAX(APP_TIMER_TICKS(delay_ms, MARQUEE_TIMER_PRESCALER),
+                                   APP_TIMER_MIN_TIMEOUT_TICKS),
+                               NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_marquee_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_timer_id,
+                                APP_TIMER_MODE_SINGLE_SHOT,
+                                marquee_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+void rgb_marquee_start(uint8_t width, uint16_t step_ms, uint16_t pause_ms)
+{
+    rgb_marquee_stop();
+
+    if (width <= LCD_COLS)
+    {
+        return;
+    }
+
+    m_max_offset = MIN(width, LCD_DDRAM_LINE_LEN) - LCD_COLS;
+    m_step_ms    = MAX(step_ms, MARQUEE_MIN_STEP_MS);
+    m_pause_ms   = pause_ms;
+
+    marquee_timer_start(m_pause_ms);
+}
+
+
+void rgb_marquee_stop(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_stop(m_timer_id);
+    APP_ERROR_CHECK(err_code);
+
+    m_step_due   = false;
+    m_max_offset = 0;
+    m_offset     = 0;
+    rgb_lcd_set_shift(0);
+}
+
+
+void rgb_marquee_process(void)
+{
+    if (!m_step_due || (m_max_offset == 0))
+    {
+        return;
+    }
+    m_step_due = false;
+
+    // Back to the start once the end has been shown for the pause.
+    m_offset = (m_offset < m_max_offset) ? m_offset + 1 : 0;
+    rgb_lcd_set_shift(m_offset);
+
+    marquee_timer_start(((m_offset == 0) || (m_offset == m_max_offset)) ? m_pause_ms : m_step_ms);
+}
@@ -0,0 +1,39 @@
+/**@file
+ *
+ * @brief    Marquee mode for the RGB LCD.
+ *
+ * @details  Text wider than the display is written into the frame once, up to LCD_DDRAM_LINE_LEN
+ *           columns per line. The marquee then scrolls both lines by shifting the display window
+ *           (@ref rgb_lcd_set_shift): one 2-byte instruction per step and no further writes.
+ *
+ *           It pauses with the start of the text shown, scrolls until the last column is at the
+ *           right edge, pauses again and returns to the start.
+ */
+
+#ifndef RGB_MARQUEE_H__
+#define RGB_MARQUEE_H__
+
+#include <stdint.h>
+
+/**@brief Function for initializing the marquee module.
+ *
+ * @details Requires the app_timer module to be initialized.
+ */
+void rgb_marquee_init(void);
+
+/**@brief Function for starting to scroll.
+ *
+ * @param[in] width     Frame columns used by the text, LCD_COLS + 1 to LCD_DDRAM_LINE_LEN. A
+ *                      narrower text fits the display and is shown unscrolled.
+ * @param[in] step_ms   Time between two steps of one column.
+ * @param[in] pause_ms  Time the start and the end of the text stay on display.
+ */
+void rgb_marquee_start(uint8_t width, uint16_t step_ms, uint16_t pause_ms);
+
+/**@brief Function for stopping the marquee and showing the start of the text again. */
+void rgb_marquee_stop(void);
+
+/**@brief Function for taking a due marquee step. Called from the main loop. */
+void rgb_marquee_process(void);
+
+#endif // RGB_MARQUEE_H__
@@ -0,0 +1,352 @@
+#include <stdint.h>
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "nrf_gpio.h"
+#include "nrf_delay.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "twi_master_config.h"
+#include "twi_async.h"
+#include "diag.h"
+
+
+#define TWI_ASYNC_PRIO_NONE         TWI_ASYNC_PRIO_COUNT             /**< Value of m_active_prio while the bus is idle. */
+#define TWI_ASYNC_TIMER_PRESCALER   0                                /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+#define TWI_ASYNC_TIMEOUT_TICKS     APP_TIMER_TICKS(TWI_ASYNC_TIMEOUT_MS, TWI_ASYNC_TIMER_PRESCALER)
+#define TWI_ASYNC_CLEAR_PULSES      9                                /**< SCL pulses that let a slave holding SDA low finish its byte and the acknowledge. */
+#define TWI_ASYNC_CLEAR_DELAY_US    5                                /**< Half period of SCL while clearing the bus, 100 kHz. */
+
+#define TWI_ASYNC_PIN_CNF                                                           \
+        ((GPIO_PIN_CNF_DIR_Input     << GPIO_PIN_CNF_DIR_Pos)                       \
+        | (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos)                    \
+        | (GPIO_PIN_CNF_PULL_Pullup   << GPIO_PIN_CNF_PULL_Pos)                     \
+        | (GPIO_PIN_CNF_DRIVE_S0D1    << GPIO_PIN_CNF_DRIVE_Pos)                    \
+        | (GPIO_PIN_CNF_SENSE_Disabled << GPIO_PIN_CNF_SENSE_Pos))                  /**< Open drain pin configuration for SCL and SDA. */
+
+#define TWI_ASYNC_PIN_CNF_CLEAR                                                     \
+        ((GPIO_PIN_CNF_DIR_Output    << GPIO_PIN_CNF_DIR_Pos)                       \
+        | (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos)                    \
+        | (GPIO_PIN_CNF_PULL_Pullup   << GPIO_PIN_CNF_PULL_Pos)                     \
+        | (GPIO_PIN_CNF_DRIVE_S0D1    << GPIO_PIN_CNF_DRIVE_Pos)                    \
+        | (GPIO_PIN_CNF_SENSE_Disabled << GPIO_PIN_CNF_SENSE_Pos))                  /**< SCL and SDA driven by GPIO while the bus is cleared, still open drain. */
+
+/**@brief Queued write transaction. */
+typedef struct
+{
+    uint8_t                 address;                                 /**< 8-bit slave address. */
+    uint8_t                 length;                                  /**< Number of bytes in data. */
+    twi_async_evt_handler_t handler;                                 /**< Completion handler. */
+    void *                  p_context;                               /**< Context for the completion handler. */
+    uint8_t                 data[TWI_ASYNC_MAX_DATA_LEN];            /**< Bytes to send. */
+} twi_async_xfer_t;
+
+/**@brief Transaction queue of one priority. */
+typedef struct
+{
+    twi_async_xfer_t        xfers[TWI_ASYNC_QUEUE_SIZE];
+    uint8_t                 in;                                      /**< Free running write index. */
+    uint8_t                 out;                                     /**< Free running read index, the entry at out is the one on the bus while it is active. */
+} twi_async_queue_t;
+
+STATIC_ASSERT(IS_POWER_OF_TWO(TWI_ASYNC_QUEUE_SIZE));
+
+static twi_async_queue_t    m_queues[TWI_ASYNC_PRIO_COUNT];          /**< One queue per priority. */
+static volatile uint8_t     m_active_prio = TWI_ASYNC_PRIO_NONE;     /**< Priority of the transaction on the bus. */
+static uint8_t              m_tx_index;                              /**< Next byte of the active transaction to hand to TXD. */
+static uint32_t             m_result;                                /**< Result of the active transaction. */
+static uint32_t             m_start_ticks;                           /**< Start time of the active transaction, for diagnostics and the timeout. */
+static app_timer_id_t       m_timeout_timer_id;                      /**< Runs while the bus is busy, checks the active transaction for a timeout. */
+
+
+static uint8_t queue_count(const twi_async_queue_t * p_queue)
+{
+    return (uint8_t)(p_queue->in - p_queue->out);
+}
+
+
+/**@brief Function for starting the next queued transaction, if any.
+ *
+ * @note  Must be called with the bus idle, from the TWI0 interrupt or a critical region.
+ */
+static void xfer_start_next(void)
+{
+    uint32_t err_code;
+    uint8_t  prio;
+
+    for (prio = 0; prio < TWI_ASYNC_PRIO_COUNT; prio++)
+    {
+        twi_async_queue_t * p_queue = &m_queues[prio];
+
+        if (queue_count(p_queue) != 0)
+        {
+            twi_async_xfer_t * p_xfer = &p_queue->xfers[p_queue->out & (TWI_ASYNC_QUEUE_SIZE - 1)];
+
+            // The timeout timer runs from the first transaction on an idle bus to the last one.
+            if (m_active_prio == TWI_ASYNC_PRIO_NONE)
+            {
+                err_code = app_timer_start(m_timeout_timer_id, TWI_ASYNC_TIMEOUT_TICKS, NULL);
+                APP_ERROR_CHECK(err_code);
+            }
+
+            m_active_prio = prio;
+            m_tx_index    = 1;
+            m_result      = NRF_SUCCESS;
+            m_start_ticks = diag_ticks();
+
+            NRF_TWI0->ADDRESS        = p_xfer->address >> 1;
+            NRF_TWI0->EVENTS_TXDSENT = 0;
+            NRF_TWI0->EVENTS_STOPPED = 0;
+            NRF_TWI0->EVENTS_ERROR   = 0;
+            NRF_TWI0->TXD            = p_xfer->data[0];
+            NRF_TWI0->TASKS_STARTTX  = 1;
+            return;
+        }
+    }
+
+    if (m_active_prio != TWI_ASYNC_PRIO_NONE)
+    {
+        err_code = app_timer_stop(m_timeout_timer_id);
+        APP_ERROR_CHECK(err_code);
+    }
+    m_active_prio = TWI_ASYNC_PRIO_NONE;
+}
+
+
+/**@brief Function for retiring the active transaction and starting the next one. */
+static void xfer_complete(void)
+{
+    twi_async_queue_t *     p_queue   = &m_queues[m_active_prio];
+    twi_async_xfer_t *      p_xfer    = &p_queue->xfers[p_queue->out & (TWI_ASYNC_QUEUE_SIZE - 1)];
+    twi_async_evt_handler_t handler   = p_xfer->handler;
+    void *                  p_context = p_xfer->p_context;
+    uint32_t                result    = m_result;
+
+    diag_record(DIAG_HIST_TWI_XFER, m_start_ticks);
+    diag_count(DIAG_CNT_TWI_XFERS);
+    if (result != NRF_SUCCESS)
+    {
+        diag_count(DIAG_CNT_TWI_NACKS);
+    }
+
+    // Starting the next transaction resets m_result.
+    p_queue->out++;
+    xfer_start_next();
+
+    if (handler != NULL)
+    {
+        handler(result, p_context);
+    }
+}
+
+
+/**@brief Function for freeing a hung bus.
+ *
+ * @details Disabling TWI0 drops the transaction. A slave still holding SDA low is then clocked
+ *          by hand until it has shifted out the rest of its byte and the acknowledge, and a STOP
+ *          condition puts every slave back to idle.
+ */
+static void bus_clear(void)
+{
+    uint8_t i;
+
+    NRF_TWI0->ENABLE = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+
+    nrf_gpio_pin_set(TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER);
+    nrf_gpio_pin_set(TWI_MASTER_CONFIG_DATA_PIN_NUMBER);
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER] = TWI_ASYNC_PIN_CNF_CLEAR;
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_DATA_PIN_NUMBER]  = TWI_ASYNC_PIN_CNF_CLEAR;
+    nrf_delay_us(TWI_ASYNC_CLEAR_DELAY_US);
+
+    for (i = 0; (i < TWI_ASYNC_CLEAR_PULSES) && !nrf_gpio_pin_read(TWI_MASTER_CONFIG_DATA_PIN_NUMBER); i++)
+    {
+        nrf_gpio_pin_clear(TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER);
+        nrf_delay_us(TWI_ASYNC_CLEAR_DELAY_US);
+        nrf_gpio_pin_set(TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER);
+        nrf_delay_us(TWI_ASYNC_CLEAR_DELAY_US);
+    }
+
+    // STOP condition: SDA rises while SCL is high.
+    nrf_gpio_pin_clear(TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER);
+    nrf_gpio_pin_clear(TWI_MASTER_CONFIG_DATA_PIN_NUMBER);
+    nrf_delay_us(TWI_ASYNC_CLEAR_DELAY_US);
+    nrf_gpio_pin_set(TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER);
+    nrf_delay_us(TWI_ASYNC_CLEAR_DELAY_US);
+    nrf_gpio_pin_set(TWI_MASTER_CONFIG_DATA_PIN_NUMBER);
+
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER] = TWI_ASYNC_PIN_CNF;
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_DATA_PIN_NUMBER]  = TWI_ASYNC_PIN_CNF;
+
+    NRF_TWI0->EVENTS_TXDSENT = 0;
+    NRF_TWI0->EVENTS_STOPPED = 0;
+    NRF_TWI0->EVENTS_ERROR   = 0;
+    NRF_TWI0->ERRORSRC       = TWI_ERRORSRC_ANACK_Msk | TWI_ERRORSRC_DNACK_Msk | TWI_ERRORSRC_OVERRUN_Msk;
+    NRF_TWI0->ENABLE         = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+}
+
+
+/**@brief Function for aborting the active transaction if it has been on the bus for too long.
+ *
+ * @note  Must be called from a critical region.
+ */
+static void xfer_timeout_check(void)
+{
+    uint32_t ticks;
+
+    if (m_active_prio == TWI_ASYNC_PRIO_NONE)
+    {
+        return;
+    }
+    (void)app_timer_cnt_diff_compute(diag_ticks(), m_start_ticks, &ticks);
+    if (ticks < TWI_ASYNC_TIMEOUT_TICKS)
+    {
+        return;
+    }
+
+    bus_clear();
+    m_result = NRF_ERROR_TIMEOUT;
+    xfer_complete();
+}
+
+
+/**@brief Function for handling the timeout timer, which runs while the bus is busy. */
+static void timeout_timer_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    CRITICAL_REGION_ENTER();
+    xfer_timeout_check();
+    CRITICAL_REGION_EXIT();
+}
+
+
+void SPI0_TWI0_IRQHandler(void)
+{
+    if (NRF_TWI0->EVENTS_ERROR)
+    {
+        NRF_TWI0->EVENTS_ERROR = 0;
+        NRF_TWI0->ERRORSRC     = TWI_ERRORSRC_ANACK_Msk | TWI_ERRORSRC_DNACK_Msk | TWI_ERRORSRC_OVERRUN_Msk;
+        m_result               = NRF_ERROR_INTERNAL;
+        NRF_TWI0->TASKS_STOP   = 1;
+    }
+
+    if (NRF_TWI0->EVENTS_TXDSENT)
+    {
+        twi_async_queue_t * p_queue = &m_queues[m_active_prio];
+        twi_async_xfer_t *  p_xfer  = &p_queue->xfers[p_queue->out & (TWI_ASYNC_QUEUE_SIZE - 1)];
+
+        NRF_TWI0->EVENTS_TXDSENT = 0;
+        if ((m_result == NRF_SUCCESS) && (m_tx_index < p_xfer->length))
+        {
+            NRF_TWI0->TXD = p_xfer->data[m_tx_index++];
+        }
+        else
+        {
+            NRF_TWI0->TASKS_STOP = 1;
+        }
+    }
+
+    if (NRF_TWI0->EVENTS_STOPPED)
+    {
+        NRF_TWI0->EVENTS_STOPPED = 0;
+        xfer_complete();
+    }
+}
+
+
+uint32_t twi_async_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_timeout_timer_id, APP_TIMER_MODE_REPEATED, timeout_timer_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER] = TWI_ASYNC_PIN_CNF;
+    NRF_GPIO->PIN_CNF[TWI_MASTER_CONFIG_DATA_PIN_NUMBER]  = TWI_ASYNC_PIN_CNF;
+
+    NRF_TWI0->ENABLE    = TWI_ENABLE_ENABLE_Disabled << TWI_ENABLE_ENABLE_Pos;
+    NRF_TWI0->PSELSCL   = TWI_MASTER_CONFIG_CLOCK_PIN_NUMBER;
+    NRF_TWI0->PSELSDA   = TWI_MASTER_CONFIG_DATA_PIN_NUMBER;
+    NRF_TWI0->FREQUENCY = TWI_ASYNC_FREQUENCY << TWI_FREQUENCY_FREQUENCY_Pos;
+    NRF_TWI0->SHORTS    = 0;
+    NRF_TWI0->INTENSET  = (TWI_INTENSET_TXDSENT_Enabled << TWI_INTENSET_TXDSENT_Pos)
+                        | (TWI_INTENSET_STOPPED_Enabled << TWI_INTENSET_STOPPED_Pos)
+                        | (TWI_INTENSET_ERROR_Enabled   << TWI_INTENSET_ERROR_Pos);
+    NRF_TWI0->ENABLE    = TWI_ENABLE_ENABLE_Enabled << TWI_ENABLE_ENABLE_Pos;
+
+    memset(m_queues, 0, sizeof(m_queues));
+    m_active_prio = TWI_ASYNC_PRIO_NONE;
+
+    // Higher than the SoftDevice event handler, so a caller waiting for queue space from a BLE
+    // event still sees the bus drain.
+    NVIC_ClearPendingIRQ(SPI0_TWI0_IRQn);
+    NVIC_SetPriority(SPI0_TWI0_IRQn, APP_IRQ_PRIORITY_HIGH);
+    NVIC_EnableIRQ(SPI0_TWI0_IRQn);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t twi_async_write(uint8_t                 address,
+                         const uint8_t *         p_data,
+                         uint8_t                 length,
+                         twi_async_prio_t        prio,
+                         twi_async_evt_handler_t handler,
+                         void *                  p_context)
+{
+    twi_async_queue_t * p_queue;
+    twi_async_xfer_t *  p_xfer;
+    uint32_t            err_code = NRF_SUCCESS;
+
+    if ((length == 0) || (length > TWI_ASYNC_MAX_DATA_LEN) || (prio >= TWI_ASYNC_PRIO_COUNT))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_queue = &m_queues[prio];
+
+    CRITICAL_REGION_ENTER();
+
+    // A caller waiting for queue space may hold off the timeout timer, so check here as well.
+    if (queue_count(p_queue) >= TWI_ASYNC_QUEUE_SIZE)
+    {
+        xfer_timeout_check();
+    }
+    if (queue_count(p_queue) >= TWI_ASYNC_QUEUE_SIZE)
+    {
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        p_xfer            = &p_queue->xfers[p_queue->in & (TWI_ASYNC_QUEUE_SIZE - 1)];
+        p_xfer->address   = address;
+        p_xfer->length    = length;
+        p_xfer->handler   = handler;
+        p_xfer->p_context = p_context;
+        memcpy(p_xfer->data, p_data, length);
+        p_queue->in++;
+        diag_high_water(DIAG_HWM_TWI_QUEUE, queue_count(p_queue));
+
+        if (m_active_prio == TWI_ASYNC_PRIO_NONE)
+        {
+            xfer_start_next();
+        }
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+
+bool twi_async_is_idle(void)
+{
+    return (m_active_prio == TWI_ASYNC_PRIO_NONE);
+}
@@ -0,0 +1,93 @@
+/**@file
+ *
+ * @brief    Interrupt driven, non-blocking TWI master on the TWI0 peripheral.
+ *
+ * @details  Write transactions are copied into a fixed size queue and sent from the TWI0
+ *           interrupt, so callers never wait for the bus. Each transaction has a priority; when
+ *           the bus becomes free the oldest transaction of the highest non-empty priority is
+ *           started next. Transactions of the same priority are sent in order.
+ *
+ *           A transaction still on the bus after @ref TWI_ASYNC_TIMEOUT_MS, e.g. because a slave
+ *           holds SCL or SDA low, is aborted: TWI0 is disabled, the bus is cleared by clocking
+ *           SCL by hand, and the transaction completes with NRF_ERROR_TIMEOUT. So the queue keeps
+ *           draining, and a caller waiting for space in it waits a bounded time.
+ *
+ *           Device addresses use the same 8-bit (already shifted) form as @ref LCD_ADDRESS and
+ *           @ref RGB_ADDRESS.
+ */
+
+#ifndef TWI_ASYNC_H__
+#define TWI_ASYNC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TWI_ASYNC_QUEUE_SIZE        8                                /**< Number of queued transactions per priority, must be a power of two. */
+#define TWI_ASYNC_MAX_DATA_LEN      42                               /**< Maximum number of bytes in one transaction (control byte plus a full DDRAM line). */
+#define TWI_ASYNC_TIMEOUT_MS        10                               /**< Time a transaction may take on the bus, more than twice the longest one at 100 kHz. */
+#ifndef TWI_ASYNC_KHZ
+#define TWI_ASYNC_KHZ               100                              /**< Bus clock in kHz: 100, 250 or 400. rgb_lcd.c paces data writes to the display for it. */
+#endif
+
+#if TWI_ASYNC_KHZ == 400
+#define TWI_ASYNC_FREQUENCY         TWI_FREQUENCY_FREQUENCY_K400
+#elif TWI_ASYNC_KHZ == 250
+#define TWI_ASYNC_FREQUENCY         TWI_FREQUENCY_FREQUENCY_K250
+#elif TWI_ASYNC_KHZ == 100
+#define TWI_ASYNC_FREQUENCY         TWI_FREQUENCY_FREQUENCY_K100
+#else
+#error "TWI_ASYNC_KHZ must be 100, 250 or 400"
+#endif
+
+/**@brief Transaction priorities, lower value is sent first. */
+typedef enum
+{
+    TWI_ASYNC_PRIO_HIGH,                                             /**< Short, latency sensitive transfers such as backlight changes. */
+    TWI_ASYNC_PRIO_NORMAL,                                           /**< Bulk transfers such as display text. */
+    TWI_ASYNC_PRIO_COUNT
+} twi_async_prio_t;
+
+/**@brief Transaction completion handler type.
+ *
+ * @details Called from the TWI0 interrupt once the STOP condition has been sent. For a timed out
+ *          transaction, called from the context that found the timeout, with the TWI0 interrupt
+ *          held off.
+ *
+ * @param[in] result     NRF_SUCCESS, NRF_ERROR_INTERNAL if the slave did not acknowledge, or
+ *                       NRF_ERROR_TIMEOUT if the transaction was aborted.
+ * @param[in] p_context  Context given to @ref twi_async_write.
+ */
+typedef void (*twi_async_evt_handler_t)(uint32_t result, void * p_context);
+
+/**@brief Function for initializing the TWI0 peripheral and the transaction queue.
+ *
+ * @details Uses the pins from twi_master_config.h. Requires the app_timer module to be
+ *          initialized.
+ *
+ * @return  NRF_SUCCESS, or the error from creating the timeout timer.
+ */
+uint32_t twi_async_init(void);
+
+/**@brief Function for queuing a write transaction.
+ *
+ * @param[in] address    8-bit slave address.
+ * @param[in] p_data     Bytes to send, copied into the queue.
+ * @param[in] length     Number of bytes, at most @ref TWI_ASYNC_MAX_DATA_LEN.
+ * @param[in] prio       Transaction priority.
+ * @param[in] handler    Completion handler, may be NULL.
+ * @param[in] p_context  Context passed to the completion handler.
+ *
+ * @return  NRF_SUCCESS if the transaction was queued, NRF_ERROR_NO_MEM if the queue of the given
+ *          priority is full, NRF_ERROR_INVALID_PARAM on a bad length or priority.
+ */
+uint32_t twi_async_write(uint8_t                 address,
+                         const uint8_t *         p_data,
+                         uint8_t                 length,
+                         twi_async_prio_t        prio,
+                         twi_async_evt_handler_t handler,
+                         void *                  p_context);
+
+/**@brief Function for checking if all queued transactions have completed. */
+bool twi_async_is_idle(void);
+
+#endif // TWI_ASYNC_H__
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "nordic_common.h"
+#include "nrf.h"
+#include "nrf51_bitfields.h"
+#include "nrf_error.h"
+#include "nrf_gpio.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "uart_ring.h"
+#include "diag.h"
+
+
+#define UART_RING_TIMER_PRESCALER   0                                /**< Value of the RTC1 PRESCALER register, same as APP_TIMER_PRESCALER in main.c. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(UART_RING_RX_SIZE));
+
+static uint8_t           m_rx_buf[UART_RING_RX_SIZE];                /**< Receive ring. */
+static volatile uint16_t m_rx_in;                                    /**< Free running write index, only changed by the interrupt. */
+static volatile uint16_t m_rx_out;                                   /**< Free running read index, only changed by uart_ring_read(). */
+static volatile bool     m_rx_ready;                                 /**< Set when the consumer should read. */
+static volatile bool     m_rx_idle;                                  /**< Set by the idle timer, cleared by the next byte received. */
+static app_timer_id_t    m_idle_timer_id;
+static volatile bool     m_idle_timer_running;
+static uint16_t          m_idle_mark;                                /**< Value of m_rx_in when the idle timer was started. */
+
+
+/**@brief Function for handling the idle timer timeout.
+ *
+ * @details Without a byte since the timer was started, the partial line is handed to the
+ *          consumer. Otherwise the main loop, woken up by this interrupt, starts the timer again.
+ */
+static void idle_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if ((m_rx_in == m_idle_mark) && (m_rx_in != m_rx_out))
+    {
+        m_rx_idle  = true;
+        m_rx_ready = true;
+    }
+    m_idle_timer_running = false;
+}
+
+
+uint32_t uart_ring_init(uint8_t rts_pin, uint8_t txd_pin, uint8_t cts_pin, uint8_t rxd_pin,
+                        uint32_t baudrate, bool hwfc)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_create(&m_idle_timer_id, APP_TIMER_MODE_SINGLE_SHOT, idle_timeout_handler);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    nrf_gpio_pin_set(txd_pin);
+    nrf_gpio_cfg_output(txd_pin);
+    nrf_gpio_cfg_input(rxd_pin, NRF_GPIO_PIN_NOPULL);
+
+    NRF_UART0->PSELTXD = txd_pin;
+    NRF_UART0->PSELRXD = rxd_pin;
+
+    if (hwfc)
+    {
+        nrf_gpio_cfg_output(rts_pin);
+        nrf_gpio_cfg_input(cts_pin, NRF_GPIO_PIN_NOPULL);
+
+        NRF_UART0->PSELRTS = rts_pin;
+        NRF_UART0->PSELCTS = cts_pin;
+        NRF_UART0->CONFIG  = UART_CONFIG_HWFC_Enabled << UART_CONFIG_HWFC_Pos;
+    }
+    else
+    {
+        NRF_UART0->CONFIG  = 0;
+    }
+
+    m_rx_in    = 0;
+    m_rx_out   = 0;
+    m_rx_ready = false;
+    m_rx_idle  = false;
+
+    NRF_UART0->BAUDRATE      = baudrate << UART_BAUDRATE_BAUDRATE_Pos;
+    NRF_UART0->ENABLE        = UART_ENABLE_ENABLE_Enabled << UART_ENABLE_ENABLE_Pos;
+    NRF_UART0->EVENTS_RXDRDY = 0;
+    NRF_UART0->EVENTS_ERROR  = 0;
+    NRF_UART0->INTENSET      = (UART_INTENSET_RXDRDY_Enabled << UART_INTENSET_RXDRDY_Pos)
+                             | (UART_INTENSET_ERROR_Enabled  << UART_INTENSET_ERROR_Pos);
+    NRF_UART0->TASKS_STARTTX = 1;
+    NRF_UART0->TASKS_STARTRX = 1;
+
+    // The RX FIFO holds only a few bytes, so the interrupt must not wait behind SoftDevice event
+    // handling. It only touches the write side of the ring.
+    NVIC_ClearPendingIRQ(UART0_IRQn);
+    NVIC_SetPriority(UART0_IRQn, APP_IRQ_PRIORITY_HIGH);
+    NVIC_EnableIRQ(UART0_IRQn);
+
+    return NRF_SUCCESS;
+}
+
+
+bool uart_ring_rx_ready(void)
+{
+    uint32_t err_code;
+
+    // Started from here, not per byte from the interrupt. While bytes keep coming the timer
+    // expires and is started again about once per UART_RING_RX_IDLE_MS.
+    if (!m_rx_ready && !m_idle_timer_running && (m_rx_in != m_rx_out))
+    {
+        m_idle_mark          = m_rx_in;
+        m_idle_timer_running = true;
+
+        err_code = app_timer_start(m_idle_timer_id,
+                                   APP_TIMER_TICKS(UART_RING_RX_IDLE_MS, UART_RING_TIMER_PRESCALER),
+                                   NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+    return m_rx_ready;
+}
+
+
+bool uart_ring_rx_idle(void)
+{
+    return m_rx_idle;
+}
+
+
+uint16_t uart_ring_read(uint8_t * p_data, uint16_t max_length)
+{
+    uint16_t count;
+    uint16_t length;
+    uint16_t i;
+
+    // Cleared first, so a byte arriving while copying signals again.
+    m_rx_ready = false;
+
+    count  = m_rx_in - m_rx_out;
+    length = MIN(count, max_length);
+    for (i = 0; i < length; i++)
+    {
+        p_data[i] = m_rx_buf[(uint16_t)(m_rx_out + i) & (UART_RING_RX_SIZE - 1)];
+    }
+    m_rx_out += length;
+
+    if (length < count)
+    {
+        m_rx_ready = true;
+    }
+
+    // Resume reception if the interrupt stopped on a full ring, a pending RXDRDY fires right away.
+    NRF_UART0->INTENSET = UART_INTENSET_RXDRDY_Enabled << UART_INTENSET_RXDRDY_Pos;
+
+    return length;
+}
+
+
+/**@brief Function for handling the UART0 interrupt.
+ *
+ * @details Moves one received byte into the ring. On a full ring RXDRDY is left pending and its
+ *          interrupt disabled, so the byte stays in the RX FIFO until uart_ring_read() makes room.
+ */
+void UART0_IRQHandler(void)
+{
+    if (NRF_UART0->EVENTS_ERROR != 0)
+    {
+        // Overrun, parity, framing or break; the byte in question is lost either way.
+        NRF_UART0->EVENTS_ERROR = 0;
+        NRF_UART0->ERRORSRC     = NRF_UART0->ERRORSRC;
+        diag_count(DIAG_CNT_UART_OVERRUNS);
+    }
+
+    if (NRF_UART0->EVENTS_RXDRDY != 0)
+    {
+        uint16_t count = m_rx_in - m_rx_out;
+        uint8_t  data;
+
+        if (count >= UART_RING_RX_SIZE)
+        {
+            NRF_UART0->INTENCLR = UART_INTENCLR_RXDRDY_Clear << UART_INTENCLR_RXDRDY_Pos;
+            m_rx_ready          = true;
+            return;
+        }
+
+        NRF_UART0->EVENTS_RXDRDY = 0;
+        data                     = (uint8_t)NRF_UART0->RXD;
+
+        m_rx_buf[m_rx_in & (UART_RING_RX_SIZE - 1)] = data;
+        m_rx_in++;
+        m_rx_idle = false;
+        diag_high_water(DIAG_HWM_UART_RING, count + 1);
+
+        if ((data == UART_RING_RX_DELIMITER) || (count + 1 >= UART_RING_RX_HIGH_WATER))
+        {
+            m_rx_ready = true;
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/**@file
+ *
+ * @brief    Interrupt driven UART receiver with a ring buffer.
+ *
+ * @details  The UART0 interrupt only moves each received byte into a power-of-two ring, the main
+ *           loop takes the bytes out in batches once @ref uart_ring_rx_ready reports that a line
+ *           has ended, the ring is half full or the sender has gone quiet for
+ *           UART_RING_RX_IDLE_MS with a partial line in the ring.
+ *
+ *           When the ring is full the interrupt stops reading RXD. The bytes then stay in the
+ *           UART RX FIFO, and with hardware flow control the UART raises RTS before that FIFO
+ *           overflows, so the sender pauses instead of losing data. Reading from the ring resumes
+ *           reception.
+ *
+ * @note     The nRF51 UART has no EasyDMA; the ring gives the same batching to the consumer while
+ *           the hardware still raises one RXDRDY event per byte.
+ */
+
+#ifndef UART_RING_H__
+#define UART_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UART_RING_RX_SIZE           256                              /**< Size of the receive ring (in bytes), must be a power of two. */
+#define UART_RING_RX_HIGH_WATER     (UART_RING_RX_SIZE / 2)          /**< Fill level at which the consumer is signaled without a line end. */
+#define UART_RING_RX_DELIMITER      '\n'                             /**< Byte that ends a line and signals the consumer. */
+#define UART_RING_RX_IDLE_MS        10                               /**< Time without a byte after which a partial line signals the consumer. */
+
+/**@brief Function for configuring UART0 and starting reception.
+ *
+ * @details Requires the app_timer module to be initialized.
+ *
+ * @param[in] rts_pin   RTS pin number.
+ * @param[in] txd_pin   TXD pin number.
+ * @param[in] cts_pin   CTS pin number.
+ * @param[in] rxd_pin   RXD pin number.
+ * @param[in] baudrate  Value for the BAUDRATE register (UART_BAUDRATE_BAUDRATE_Baud*).
+ * @param[in] hwfc      True to enable RTS/CTS hardware flow control.
+ *
+ * @return NRF_SUCCESS, or the error code of app_timer_create.
+ */
+uint32_t uart_ring_init(uint8_t rts_pin, uint8_t txd_pin, uint8_t cts_pin, uint8_t rxd_pin,
+                        uint32_t baudrate, bool hwfc);
+
+/**@brief Function for checking if received data is waiting to be read. Called from the main loop.
+ *
+ * @details With a partial line in the ring, also starts the timer that watches for the sender
+ *          going quiet.
+ *
+ * @return True once a line end has been received, the ring has reached its high water mark,
+ *         the sender has gone quiet or the previous read left data behind.
+ */
+bool uart_ring_rx_ready(void);
+
+/**@brief Function for checking if the sender has gone quiet, so the data read is all there is
+ *        for now and should not wait for more.
+ */
+bool uart_ring_rx_idle(void);
+
+/**@brief Function for taking received bytes out of the ring.
+ *
+ * @param[out] p_data      Buffer for the bytes.
+ * @param[in]  max_length  Size of the buffer.
+ *
+ * @return Number of bytes copied.
+ */
+uint16_t uart_ring_read(uint8_t * p_data, uint16_t max_length);
+
+#endif // UART_RING_H__